@@ -74,6 +74,8 @@
 		#endif
 		#ifdef __AVX2__
 			#define KLAYGE_AVX2_SUPPORT
+			// /arch:AVX2 also turns on FMA3
+			#define KLAYGE_FMA_SUPPORT
 		#endif	
 	#elif defined(KLAYGE_COMPILER_GCC) || defined(KLAYGE_COMPILER_CLANG)
 		#ifdef __SSE3__
@@ -94,6 +96,9 @@
 		#ifdef __AVX2__
 			#define KLAYGE_AVX2_SUPPORT
 		#endif
+		#ifdef __FMA__
+			#define KLAYGE_FMA_SUPPORT
+		#endif
 	#endif
 #elif defined KLAYGE_CPU_X86
 	#if defined(KLAYGE_COMPILER_GCC) || defined(KLAYGE_COMPILER_CLANG)
@@ -124,6 +129,9 @@
 		#ifdef __AVX2__
 			#define KLAYGE_AVX2_SUPPORT
 		#endif
+		#ifdef __FMA__
+			#define KLAYGE_FMA_SUPPORT
+		#endif
 	#endif
 #elif defined KLAYGE_CPU_ARM
 	#if defined(KLAYGE_COMPILER_MSVC)
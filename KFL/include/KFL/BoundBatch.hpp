@@ -0,0 +1,105 @@
+/**
+ * @file BoundBatch.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KFL_BOUNDBATCH_HPP
+#define _KFL_BOUNDBATCH_HPP
+
+#pragma once
+
+#include <KFL/PreDeclare.hpp>
+#include <KFL/CXX2a/span.hpp>
+#include <KFL/Math.hpp>
+
+#include <vector>
+
+namespace KlayGE
+{
+	// Axis aligned boxes in structure-of-arrays layout. The batch functions in MathLib process 8 (AVX) or 4 (SSE) of
+	//  them per instruction.
+	struct AABBoxBatch
+	{
+		std::vector<float> min_x;
+		std::vector<float> min_y;
+		std::vector<float> min_z;
+		std::vector<float> max_x;
+		std::vector<float> max_y;
+		std::vector<float> max_z;
+
+		size_t size() const noexcept
+		{
+			return min_x.size();
+		}
+		void resize(size_t size);
+		void clear() noexcept;
+
+		void push_back(AABBox const & aabb);
+		void Set(size_t index, AABBox const & aabb) noexcept;
+		AABBox Get(size_t index) const noexcept;
+	};
+
+	// Spheres in structure-of-arrays layout.
+	struct SphereBatch
+	{
+		std::vector<float> center_x;
+		std::vector<float> center_y;
+		std::vector<float> center_z;
+		std::vector<float> radius;
+
+		size_t size() const noexcept
+		{
+			return center_x.size();
+		}
+		void resize(size_t size);
+		void clear() noexcept;
+
+		void push_back(Sphere const & sphere);
+		void Set(size_t index, Sphere const & sphere) noexcept;
+		Sphere Get(size_t index) const noexcept;
+	};
+
+	namespace MathLib
+	{
+		// Batch versions of transform_aabb, intersect_aabb_frustum, and intersect_sphere_frustum. Element i of the result
+		//  matches the single version for element i of the input up to floating-point rounding: either path may be
+		//  contracted into FMAs, so a bound within rounding distance of a plane can be classified differently.
+		void transform_aabbs(AABBoxBatch& out, AABBoxBatch const & aabbs, float4x4 const & mat);
+		// The intersect functions test out.size() bounds starting from first.
+		void intersect_aabbs_planes(std::span<BoundOverlap> out, AABBoxBatch const & aabbs, std::span<Plane const> planes,
+			size_t first = 0) noexcept;
+		void intersect_aabbs_frustum(std::span<BoundOverlap> out, AABBoxBatch const & aabbs, Frustum const & frustum,
+			size_t first = 0) noexcept;
+		void intersect_spheres_planes(std::span<BoundOverlap> out, SphereBatch const & spheres, std::span<Plane const> planes,
+			size_t first = 0) noexcept;
+		void intersect_spheres_frustum(std::span<BoundOverlap> out, SphereBatch const & spheres, Frustum const & frustum,
+			size_t first = 0) noexcept;
+	}
+}
+
+#endif		// _KFL_BOUNDBATCH_HPP
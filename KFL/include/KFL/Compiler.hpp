@@ -154,6 +154,7 @@
 
 	#define KLAYGE_ATTRIBUTE_NORETURN __attribute__((noreturn))
 	#define KLAYGE_BUILTIN_UNREACHABLE __builtin_unreachable()
+	#define KLAYGE_FORCEINLINE __attribute__((always_inline)) inline
 #elif defined(__GNUC__)
 	// GNU C++
 
@@ -214,6 +215,7 @@
 
 	#define KLAYGE_ATTRIBUTE_NORETURN __attribute__((noreturn))
 	#define KLAYGE_BUILTIN_UNREACHABLE __builtin_unreachable()
+	#define KLAYGE_FORCEINLINE __attribute__((always_inline)) inline
 #elif defined(_MSC_VER)
 	// MSVC
 
@@ -270,6 +272,7 @@
 
 	#define KLAYGE_ATTRIBUTE_NORETURN __declspec(noreturn)
 	#define KLAYGE_BUILTIN_UNREACHABLE __assume(false)
+	#define KLAYGE_FORCEINLINE __forceinline
 #else
 	#error "Unknown compiler. Please install vc, g++, or clang."
 #endif
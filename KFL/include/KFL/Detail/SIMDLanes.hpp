@@ -0,0 +1,316 @@
+/**
+ * @file SIMDLanes.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KFL_SIMDLANES_HPP
+#define _KFL_SIMDLANES_HPP
+
+#pragma once
+
+#include <KFL/Config.hpp>
+#include <KFL/Types.hpp>
+#include <KFL/SIMDMath.hpp>
+
+#include <cmath>
+
+// Lane types for structure-of-arrays loops. A kernel is written once as a template over them, and instantiated 8-wide
+//  (AVX), 4-wide (SSE) and 1-wide for the tail:
+//
+//	size_t i = begin;
+//	#if defined(SIMD_MATH_AVX)
+//	i = Kernel<SIMDLanes8>(..., i, end);
+//	#endif
+//	#if defined(SIMD_MATH_SSE)
+//	i = Kernel<SIMDLanes4>(..., i, end);
+//	#endif
+//	Kernel<SIMDLanes1>(..., i, end);
+//
+// Every op maps to exactly one IEEE operation, so the lanes compute what the scalar code with the same expression does.
+
+namespace KlayGE
+{
+	namespace detail
+	{
+		struct SIMDLanes1
+		{
+			typedef float Type;
+			typedef bool Mask;
+			static uint32_t constexpr WIDTH = 1;
+
+			static Type Load(float const * p) noexcept
+			{
+				return *p;
+			}
+			static void Store(float* p, Type v) noexcept
+			{
+				*p = v;
+			}
+			static Type Set1(float v) noexcept
+			{
+				return v;
+			}
+			static Type Zero() noexcept
+			{
+				return 0;
+			}
+
+			static Type Add(Type lhs, Type rhs) noexcept
+			{
+				return lhs + rhs;
+			}
+			static Type Sub(Type lhs, Type rhs) noexcept
+			{
+				return lhs - rhs;
+			}
+			static Type Mul(Type lhs, Type rhs) noexcept
+			{
+				return lhs * rhs;
+			}
+			static Type Div(Type lhs, Type rhs) noexcept
+			{
+				return lhs / rhs;
+			}
+			static Type Neg(Type v) noexcept
+			{
+				return -v;
+			}
+			static Type Abs(Type v) noexcept
+			{
+				return std::abs(v);
+			}
+			// Same operand order as std::min(cur, v) and std::max(cur, v)
+			static Type Min(Type cur, Type v) noexcept
+			{
+				return (v < cur) ? v : cur;
+			}
+			static Type Max(Type cur, Type v) noexcept
+			{
+				return (cur < v) ? v : cur;
+			}
+
+			static Mask Less(Type lhs, Type rhs) noexcept
+			{
+				return lhs < rhs;
+			}
+			static Mask LessEqual(Type lhs, Type rhs) noexcept
+			{
+				return lhs <= rhs;
+			}
+			static Mask Greater(Type lhs, Type rhs) noexcept
+			{
+				return lhs > rhs;
+			}
+			static Mask GreaterEqual(Type lhs, Type rhs) noexcept
+			{
+				return lhs >= rhs;
+			}
+			// mask ? lhs : rhs
+			static Type Select(Mask mask, Type lhs, Type rhs) noexcept
+			{
+				return mask ? lhs : rhs;
+			}
+			// Bit i is lane i of the mask
+			static uint32_t MoveMask(Mask mask) noexcept
+			{
+				return mask ? 1U : 0U;
+			}
+		};
+
+#if defined(SIMD_MATH_SSE)
+		struct SIMDLanes4
+		{
+			typedef __m128 Type;
+			typedef __m128 Mask;
+			static uint32_t constexpr WIDTH = 4;
+
+			static Type Load(float const * p) noexcept
+			{
+				return _mm_loadu_ps(p);
+			}
+			static void Store(float* p, Type v) noexcept
+			{
+				_mm_storeu_ps(p, v);
+			}
+			static Type Set1(float v) noexcept
+			{
+				return _mm_set1_ps(v);
+			}
+			static Type Zero() noexcept
+			{
+				return _mm_setzero_ps();
+			}
+
+			static Type Add(Type lhs, Type rhs) noexcept
+			{
+				return _mm_add_ps(lhs, rhs);
+			}
+			static Type Sub(Type lhs, Type rhs) noexcept
+			{
+				return _mm_sub_ps(lhs, rhs);
+			}
+			static Type Mul(Type lhs, Type rhs) noexcept
+			{
+				return _mm_mul_ps(lhs, rhs);
+			}
+			static Type Div(Type lhs, Type rhs) noexcept
+			{
+				return _mm_div_ps(lhs, rhs);
+			}
+			static Type Neg(Type v) noexcept
+			{
+				return _mm_xor_ps(v, _mm_set1_ps(-0.0f));
+			}
+			static Type Abs(Type v) noexcept
+			{
+				return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+			}
+			// minps/maxps return the second operand when the comparison fails, which is what std::min/std::max do
+			static Type Min(Type cur, Type v) noexcept
+			{
+				return _mm_min_ps(v, cur);
+			}
+			static Type Max(Type cur, Type v) noexcept
+			{
+				return _mm_max_ps(v, cur);
+			}
+
+			static Mask Less(Type lhs, Type rhs) noexcept
+			{
+				return _mm_cmplt_ps(lhs, rhs);
+			}
+			static Mask LessEqual(Type lhs, Type rhs) noexcept
+			{
+				return _mm_cmple_ps(lhs, rhs);
+			}
+			static Mask Greater(Type lhs, Type rhs) noexcept
+			{
+				return _mm_cmpgt_ps(lhs, rhs);
+			}
+			static Mask GreaterEqual(Type lhs, Type rhs) noexcept
+			{
+				return _mm_cmpge_ps(lhs, rhs);
+			}
+			static Type Select(Mask mask, Type lhs, Type rhs) noexcept
+			{
+				return _mm_or_ps(_mm_and_ps(mask, lhs), _mm_andnot_ps(mask, rhs));
+			}
+			static uint32_t MoveMask(Mask mask) noexcept
+			{
+				return static_cast<uint32_t>(_mm_movemask_ps(mask));
+			}
+		};
+#endif
+
+#if defined(SIMD_MATH_AVX)
+		struct SIMDLanes8
+		{
+			typedef __m256 Type;
+			typedef __m256 Mask;
+			static uint32_t constexpr WIDTH = 8;
+
+			static Type Load(float const * p) noexcept
+			{
+				return _mm256_loadu_ps(p);
+			}
+			static void Store(float* p, Type v) noexcept
+			{
+				_mm256_storeu_ps(p, v);
+			}
+			static Type Set1(float v) noexcept
+			{
+				return _mm256_set1_ps(v);
+			}
+			static Type Zero() noexcept
+			{
+				return _mm256_setzero_ps();
+			}
+
+			static Type Add(Type lhs, Type rhs) noexcept
+			{
+				return _mm256_add_ps(lhs, rhs);
+			}
+			static Type Sub(Type lhs, Type rhs) noexcept
+			{
+				return _mm256_sub_ps(lhs, rhs);
+			}
+			static Type Mul(Type lhs, Type rhs) noexcept
+			{
+				return _mm256_mul_ps(lhs, rhs);
+			}
+			static Type Div(Type lhs, Type rhs) noexcept
+			{
+				return _mm256_div_ps(lhs, rhs);
+			}
+			static Type Neg(Type v) noexcept
+			{
+				return _mm256_xor_ps(v, _mm256_set1_ps(-0.0f));
+			}
+			static Type Abs(Type v) noexcept
+			{
+				return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v);
+			}
+			static Type Min(Type cur, Type v) noexcept
+			{
+				return _mm256_min_ps(v, cur);
+			}
+			static Type Max(Type cur, Type v) noexcept
+			{
+				return _mm256_max_ps(v, cur);
+			}
+
+			static Mask Less(Type lhs, Type rhs) noexcept
+			{
+				return _mm256_cmp_ps(lhs, rhs, _CMP_LT_OQ);
+			}
+			static Mask LessEqual(Type lhs, Type rhs) noexcept
+			{
+				return _mm256_cmp_ps(lhs, rhs, _CMP_LE_OQ);
+			}
+			static Mask Greater(Type lhs, Type rhs) noexcept
+			{
+				return _mm256_cmp_ps(lhs, rhs, _CMP_GT_OQ);
+			}
+			static Mask GreaterEqual(Type lhs, Type rhs) noexcept
+			{
+				return _mm256_cmp_ps(lhs, rhs, _CMP_GE_OQ);
+			}
+			static Type Select(Mask mask, Type lhs, Type rhs) noexcept
+			{
+				return _mm256_blendv_ps(rhs, lhs, mask);
+			}
+			static uint32_t MoveMask(Mask mask) noexcept
+			{
+				return static_cast<uint32_t>(_mm256_movemask_ps(mask));
+			}
+		};
+#endif
+	}
+}
+
+#endif		// _KFL_SIMDLANES_HPP
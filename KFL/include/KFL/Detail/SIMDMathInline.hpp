@@ -0,0 +1,1201 @@
+/**
+ * @file SIMDMathInline.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KFL_SIMDMATHINLINE_HPP
+#define _KFL_SIMDMATHINLINE_HPP
+
+#pragma once
+
+// The small, hot part of SIMDMathLib. They are defined here instead of SIMDMath.cpp, so a vector op compiles down to a
+//  few instructions at the call site, instead of a call across translation units.
+
+namespace KlayGE
+{
+	namespace detail
+	{
+#if defined(SIMD_MATH_SSE)
+		// a * b + c
+		KLAYGE_FORCEINLINE __m128 SIMDMulAdd(__m128 a, __m128 b, __m128 c)
+		{
+#if defined(SIMD_MATH_FMA)
+			return _mm_fmadd_ps(a, b, c);
+#else
+			return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+		}
+
+		template <int N>
+		KLAYGE_FORCEINLINE __m128 SIMDSplat(__m128 v)
+		{
+			return _mm_shuffle_ps(v, v, _MM_SHUFFLE(N, N, N, N));
+		}
+
+#if defined(SIMD_MATH_AVX)
+		KLAYGE_FORCEINLINE __m256 SIMDMulAdd(__m256 a, __m256 b, __m256 c)
+		{
+#if defined(SIMD_MATH_FMA)
+			return _mm256_fmadd_ps(a, b, c);
+#else
+			return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+		}
+#endif
+#elif defined(SIMD_MATH_NEON)
+		// a + b * c[N]
+		template <int N>
+		KLAYGE_FORCEINLINE float32x4_t SIMDMulAddLane(float32x4_t a, float32x4_t b, float32x2_t c)
+		{
+#if defined(KLAYGE_CPU_ARM64)
+			return vfmaq_lane_f32(a, b, c, N);
+#else
+			return vmlaq_lane_f32(a, b, c, N);
+#endif
+		}
+
+		// The estimates are good to 8 bits. Each Newton-Raphson step doubles that.
+		KLAYGE_FORCEINLINE float32x4_t SIMDRecip(float32x4_t v)
+		{
+			float32x4_t e = vrecpeq_f32(v);
+			e = vmulq_f32(e, vrecpsq_f32(v, e));
+			e = vmulq_f32(e, vrecpsq_f32(v, e));
+			return e;
+		}
+
+		KLAYGE_FORCEINLINE float32x4_t SIMDRecipSqrt(float32x4_t v)
+		{
+			float32x4_t e = vrsqrteq_f32(v);
+			e = vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(v, e), e));
+			e = vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(v, e), e));
+			return e;
+		}
+
+		KLAYGE_FORCEINLINE float32x4_t SIMDSqrt(float32x4_t v)
+		{
+#if defined(KLAYGE_CPU_ARM64)
+			return vsqrtq_f32(v);
+#else
+			float32x4_t const zero = vdupq_n_f32(0);
+			return vbslq_f32(vceqq_f32(v, zero), zero, vmulq_f32(v, SIMDRecipSqrt(v)));
+#endif
+		}
+
+		KLAYGE_FORCEINLINE float32x4_t SIMDDivide(float32x4_t lhs, float32x4_t rhs)
+		{
+#if defined(KLAYGE_CPU_ARM64)
+			return vdivq_f32(lhs, rhs);
+#else
+			return vmulq_f32(lhs, SIMDRecip(rhs));
+#endif
+		}
+
+		// (y, z, x, w)
+		KLAYGE_FORCEINLINE float32x4_t SIMDSwizzleYZXW(float32x4_t v)
+		{
+			float32x2_t const xy = vget_low_f32(v);
+			float32x2_t const zw = vget_high_f32(v);
+			return vcombine_f32(vext_f32(xy, zw, 1), vset_lane_f32(vget_lane_f32(xy, 0), zw, 0));
+		}
+#endif
+	}
+
+	namespace SIMDMathLib
+	{
+		// General Vector
+		///////////////////////////////////////////////////////////////////////////////
+		KLAYGE_FORCEINLINE SIMDVectorF4 Add(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			ret.Vec() = _mm_add_ps(lhs.Vec(), rhs.Vec());
+#elif defined(SIMD_MATH_NEON)
+			ret.Vec() = vaddq_f32(lhs.Vec(), rhs.Vec());
+#else
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret.Vec()[i] = lhs.Vec()[i] + rhs.Vec()[i];
+			}
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 Substract(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			ret.Vec() = _mm_sub_ps(lhs.Vec(), rhs.Vec());
+#elif defined(SIMD_MATH_NEON)
+			ret.Vec() = vsubq_f32(lhs.Vec(), rhs.Vec());
+#else
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret.Vec()[i] = lhs.Vec()[i] - rhs.Vec()[i];
+			}
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 Multiply(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			ret.Vec() = _mm_mul_ps(lhs.Vec(), rhs.Vec());
+#elif defined(SIMD_MATH_NEON)
+			ret.Vec() = vmulq_f32(lhs.Vec(), rhs.Vec());
+#else
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret.Vec()[i] = lhs.Vec()[i] * rhs.Vec()[i];
+			}
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 Divide(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			ret.Vec() = _mm_div_ps(lhs.Vec(), rhs.Vec());
+#elif defined(SIMD_MATH_NEON)
+			ret.Vec() = detail::SIMDDivide(lhs.Vec(), rhs.Vec());
+#else
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret.Vec()[i] = lhs.Vec()[i] / rhs.Vec()[i];
+			}
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 Negative(SIMDVectorF4 const & rhs)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			ret.Vec() = _mm_sub_ps(_mm_setzero_ps(), rhs.Vec());
+#elif defined(SIMD_MATH_NEON)
+			ret.Vec() = vnegq_f32(rhs.Vec());
+#else
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret.Vec()[i] = -rhs.Vec()[i];
+			}
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 Lerp(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs, float s)
+		{
+#if defined(SIMD_MATH_SSE)
+			SIMDVectorF4 ret;
+			ret.Vec() = detail::SIMDMulAdd(_mm_sub_ps(rhs.Vec(), lhs.Vec()), _mm_set_ps1(s), lhs.Vec());
+			return ret;
+#else
+			return lhs + (rhs - lhs) * s;
+#endif
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 Abs(SIMDVectorF4 const & x)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			__m128 res = x.Vec();
+			__m128 data_temp = _mm_sub_ps(_mm_setzero_ps(), res);
+			ret.Vec() = _mm_max_ps(data_temp, res);
+#elif defined(SIMD_MATH_NEON)
+			ret.Vec() = vabsq_f32(x.Vec());
+#else
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret.Vec()[i] = MathLib::abs(x.Vec()[i]);
+			}
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 Sqr(SIMDVectorF4 const & x)
+		{
+			return x * x;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 Cube(SIMDVectorF4 const & x)
+		{
+			return Sqr(x) * x;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 LoadVector1(float v)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			ret.Vec() = _mm_load_ss(&v);
+#elif defined(SIMD_MATH_NEON)
+			ret.Vec() = vsetq_lane_f32(v, vdupq_n_f32(0), 0);
+#else
+			ret.Vec()[0] = v;
+			for (int i = 1; i < 4; ++ i)
+			{
+				ret.Vec()[i] = 0;
+			}
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 LoadVector2(float2 const & v)
+		{
+			return LoadVector2(&v[0]);
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 LoadVector3(float3 const & v)
+		{
+			return LoadVector3(&v[0]);
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 LoadVector4(float4 const & v)
+		{
+			return LoadVector4(&v[0]);
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 LoadVector2(float const * v)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			__m128 x = _mm_load_ss(&v[0]);
+			__m128 y = _mm_load_ss(&v[1]);
+			ret.Vec() = _mm_unpacklo_ps(x, y);
+#elif defined(SIMD_MATH_NEON)
+			ret.Vec() = vcombine_f32(vld1_f32(v), vdup_n_f32(0));
+#else
+			for (int i = 0; i < 2; ++ i)
+			{
+				ret.Vec()[i] = v[i];
+			}
+			for (int i = 2; i < 4; ++ i)
+			{
+				ret.Vec()[i] = 0;
+			}
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 LoadVector3(float const * v)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			__m128 x = _mm_load_ss(&v[0]);
+			__m128 y = _mm_load_ss(&v[1]);
+			__m128 z = _mm_load_ss(&v[2]);
+			__m128 xy = _mm_unpacklo_ps(x, y);
+			ret.Vec() = _mm_movelh_ps(xy, z);
+#elif defined(SIMD_MATH_NEON)
+			ret.Vec() = vcombine_f32(vld1_f32(v), vset_lane_f32(v[2], vdup_n_f32(0), 0));
+#else
+			for (int i = 0; i < 3; ++ i)
+			{
+				ret.Vec()[i] = v[i];
+			}
+			for (int i = 3; i < 4; ++ i)
+			{
+				ret.Vec()[i] = 0;
+			}
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 LoadVector4(float const * v)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			ret.Vec() = _mm_load_ps(&v[0]);
+#elif defined(SIMD_MATH_NEON)
+			ret.Vec() = vld1q_f32(v);
+#else
+			for (int i = 0; i < 4; ++i)
+			{
+				ret.Vec()[i] = v[i];
+			}
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE void StoreVector1(float& fs, SIMDVectorF4 const & v)
+		{
+#if defined(SIMD_MATH_SSE)
+			_mm_store_ss(&fs, v.Vec());
+#elif defined(SIMD_MATH_NEON)
+			vst1q_lane_f32(&fs, v.Vec(), 0);
+#else
+			fs = v.Vec()[0];
+#endif
+		}
+
+		KLAYGE_FORCEINLINE void StoreVector2(float2& fs, SIMDVectorF4 const & v)
+		{
+#if defined(SIMD_MATH_SSE)
+			__m128 x = v.Vec();
+			__m128 y = _mm_shuffle_ps(x, x, _MM_SHUFFLE(1, 1, 1, 1));
+			_mm_store_ss(&fs[0], x);
+			_mm_store_ss(&fs[1], y);
+#elif defined(SIMD_MATH_NEON)
+			vst1_f32(&fs[0], vget_low_f32(v.Vec()));
+#else
+			for (int i = 0; i < 2; ++ i)
+			{
+				fs[i] = v.Vec()[i];
+			}
+#endif
+		}
+
+		KLAYGE_FORCEINLINE void StoreVector3(float3& fs, SIMDVectorF4 const & v)
+		{
+#if defined(SIMD_MATH_SSE)
+			__m128 x = v.Vec();
+			__m128 y = _mm_shuffle_ps(x, x, _MM_SHUFFLE(1, 1, 1, 1));
+			__m128 z = _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 2, 2, 2));
+			_mm_store_ss(&fs[0], x);
+			_mm_store_ss(&fs[1], y);
+			_mm_store_ss(&fs[2], z);
+#elif defined(SIMD_MATH_NEON)
+			vst1_f32(&fs[0], vget_low_f32(v.Vec()));
+			vst1q_lane_f32(&fs[2], v.Vec(), 2);
+#else
+			for (int i = 0; i < 3; ++ i)
+			{
+				fs[i] = v.Vec()[i];
+			}
+#endif
+		}
+
+		KLAYGE_FORCEINLINE void StoreVector4(float4& fs, SIMDVectorF4 const & v)
+		{
+#if defined(SIMD_MATH_SSE)
+			_mm_store_ps(&fs[0], v.Vec());
+#elif defined(SIMD_MATH_NEON)
+			vst1q_f32(&fs[0], v.Vec());
+#else
+			for (int i = 0; i < 4; ++ i)
+			{
+				fs[i] = v.Vec()[i];
+			}
+#endif
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 SetVector(float x, float y, float z, float w)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			ret.Vec() = _mm_set_ps(w, z, y, x);
+#elif defined(SIMD_MATH_NEON)
+			float const v[] = { x, y, z, w };
+			ret.Vec() = vld1q_f32(v);
+#else
+			ret.Vec()[0] = x;
+			ret.Vec()[1] = y;
+			ret.Vec()[2] = z;
+			ret.Vec()[3] = w;
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 SetVector(float v)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			ret.Vec() = _mm_set_ps1(v);
+#elif defined(SIMD_MATH_NEON)
+			ret.Vec() = vdupq_n_f32(v);
+#else
+			ret.Vec()[0] = v;
+			ret.Vec()[1] = v;
+			ret.Vec()[2] = v;
+			ret.Vec()[3] = v;
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE float GetX(SIMDVectorF4 const & rhs)
+		{
+#if defined(SIMD_MATH_SSE)
+			return _mm_cvtss_f32(rhs.Vec());
+#elif defined(SIMD_MATH_NEON)
+			return vgetq_lane_f32(rhs.Vec(), 0);
+#else
+			return GetByIndex(rhs, 0);
+#endif
+		}
+
+		KLAYGE_FORCEINLINE float GetY(SIMDVectorF4 const & rhs)
+		{
+#if defined(SIMD_MATH_SSE)
+			__m128 tmp = _mm_shuffle_ps(rhs.Vec(), rhs.Vec(), _MM_SHUFFLE(1, 1, 1, 1));
+			return _mm_cvtss_f32(tmp);
+#elif defined(SIMD_MATH_NEON)
+			return vgetq_lane_f32(rhs.Vec(), 1);
+#else
+			return GetByIndex(rhs, 1);
+#endif
+		}
+
+		KLAYGE_FORCEINLINE float GetZ(SIMDVectorF4 const & rhs)
+		{
+#if defined(SIMD_MATH_SSE)
+			__m128 tmp = _mm_shuffle_ps(rhs.Vec(), rhs.Vec(), _MM_SHUFFLE(2, 2, 2, 2));
+			return _mm_cvtss_f32(tmp);
+#elif defined(SIMD_MATH_NEON)
+			return vgetq_lane_f32(rhs.Vec(), 2);
+#else
+			return GetByIndex(rhs, 2);
+#endif
+		}
+
+		KLAYGE_FORCEINLINE float GetW(SIMDVectorF4 const & rhs)
+		{
+#if defined(SIMD_MATH_SSE)
+			__m128 tmp = _mm_shuffle_ps(rhs.Vec(), rhs.Vec(), _MM_SHUFFLE(3, 3, 3, 3));
+			return _mm_cvtss_f32(tmp);
+#elif defined(SIMD_MATH_NEON)
+			return vgetq_lane_f32(rhs.Vec(), 3);
+#else
+			return GetByIndex(rhs, 3);
+#endif
+		}
+
+		KLAYGE_FORCEINLINE float GetByIndex(SIMDVectorF4 const & rhs, size_t index)
+		{
+#if defined(SIMD_MATH_SSE)
+#ifdef KLAYGE_COMPILER_MSVC
+			return rhs.Vec().m128_f32[index];
+#else
+			union
+			{
+				__m128 v;
+				float comp[4];
+			} converter;
+			converter.v = rhs.Vec();
+			return converter.comp[index];
+#endif
+#elif defined(SIMD_MATH_NEON)
+			float comp[4];
+			vst1q_f32(comp, rhs.Vec());
+			return comp[index];
+#else
+			return rhs.Vec()[index];
+#endif
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 SetX(SIMDVectorF4 const & rhs, float v)
+		{
+#if defined(SIMD_MATH_SSE)
+			SIMDVectorF4 ret;
+			ret.Vec() = _mm_move_ss(rhs.Vec(), _mm_set_ss(v));
+			return ret;
+#elif defined(SIMD_MATH_NEON)
+			SIMDVectorF4 ret;
+			ret.Vec() = vsetq_lane_f32(v, rhs.Vec(), 0);
+			return ret;
+#else
+			return SetByIndex(rhs, v, 0);
+#endif
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 SetY(SIMDVectorF4 const & rhs, float v)
+		{
+#if defined(SIMD_MATH_SSE)
+			SIMDVectorF4 ret;
+			__m128 yxzw = _mm_shuffle_ps(rhs.Vec(), rhs.Vec(), _MM_SHUFFLE(3, 2, 0, 1));
+			yxzw = _mm_move_ss(yxzw, _mm_set_ss(v));
+			ret.Vec() = _mm_shuffle_ps(yxzw, yxzw, _MM_SHUFFLE(3, 2, 0, 1));
+			return ret;
+#elif defined(SIMD_MATH_NEON)
+			SIMDVectorF4 ret;
+			ret.Vec() = vsetq_lane_f32(v, rhs.Vec(), 1);
+			return ret;
+#else
+			return SetByIndex(rhs, v, 1);
+#endif
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 SetZ(SIMDVectorF4 const & rhs, float v)
+		{
+#if defined(SIMD_MATH_SSE)
+			SIMDVectorF4 ret;
+			__m128 zyxw = _mm_shuffle_ps(rhs.Vec(), rhs.Vec(), _MM_SHUFFLE(3, 0, 1, 2));
+			zyxw = _mm_move_ss(zyxw, _mm_set_ss(v));
+			ret.Vec() = _mm_shuffle_ps(zyxw, zyxw, _MM_SHUFFLE(3, 0, 1, 2));
+			return ret;
+#elif defined(SIMD_MATH_NEON)
+			SIMDVectorF4 ret;
+			ret.Vec() = vsetq_lane_f32(v, rhs.Vec(), 2);
+			return ret;
+#else
+			return SetByIndex(rhs, v, 2);
+#endif
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 SetW(SIMDVectorF4 const & rhs, float v)
+		{
+#if defined(SIMD_MATH_SSE)
+			SIMDVectorF4 ret;
+			__m128 wyzx = _mm_shuffle_ps(rhs.Vec(), rhs.Vec(), _MM_SHUFFLE(0, 2, 1, 3));
+			wyzx = _mm_move_ss(wyzx, _mm_set_ss(v));
+			ret.Vec() = _mm_shuffle_ps(wyzx, wyzx, _MM_SHUFFLE(0, 2, 1, 3));
+			return ret;
+#elif defined(SIMD_MATH_NEON)
+			SIMDVectorF4 ret;
+			ret.Vec() = vsetq_lane_f32(v, rhs.Vec(), 3);
+			return ret;
+#else
+			return SetByIndex(rhs, v, 3);
+#endif
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 SetByIndex(SIMDVectorF4 const & rhs, float v, size_t index)
+		{
+			SIMDVectorF4 ret = rhs;
+#if defined(SIMD_MATH_SSE)
+#ifdef KLAYGE_COMPILER_MSVC
+			ret.Vec().m128_f32[index] = v;
+#else
+			union
+			{
+				__m128 v;
+				float comp[4];
+			} converter;
+			converter.v = rhs.Vec();
+			converter.comp[index] = v;
+			ret.Vec() = converter.v;
+#endif
+#elif defined(SIMD_MATH_NEON)
+			float comp[4];
+			vst1q_f32(comp, rhs.Vec());
+			comp[index] = v;
+			ret.Vec() = vld1q_f32(comp);
+#else
+			ret.Vec()[index] = v;
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 Maximize(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			ret.Vec() = _mm_max_ps(lhs.Vec(), rhs.Vec());
+#elif defined(SIMD_MATH_NEON)
+			ret.Vec() = vmaxq_f32(lhs.Vec(), rhs.Vec());
+#else
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret.Vec()[i] = std::max(lhs.Vec()[i], rhs.Vec()[i]);
+			}
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 Minimize(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			ret.Vec() = _mm_min_ps(lhs.Vec(), rhs.Vec());
+#elif defined(SIMD_MATH_NEON)
+			ret.Vec() = vminq_f32(lhs.Vec(), rhs.Vec());
+#else
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret.Vec()[i] = std::min(lhs.Vec()[i], rhs.Vec()[i]);
+			}
+#endif
+			return ret;
+		}
+
+		// 2D Vector
+		///////////////////////////////////////////////////////////////////////////////
+		KLAYGE_FORCEINLINE SIMDVectorF4 CrossVector2(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			__m128 res1 = lhs.Vec();
+			__m128 res2 = rhs.Vec();
+			res2 = _mm_shuffle_ps(res2, res2, _MM_SHUFFLE(0, 0, 0, 1));
+			res1 = _mm_mul_ps(res1, res2);
+			res2 = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(1, 1, 1, 1));
+			res1 = _mm_sub_ps(res1, res2);
+			ret.Vec() = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(0, 0, 0, 0));
+#else
+			ret = SetVector(GetX(lhs) * GetY(rhs) - GetY(lhs) * GetX(rhs));
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 DotVector2(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			__m128 res1 = lhs.Vec();
+			__m128 res2 = rhs.Vec();
+			res1 = _mm_mul_ps(res1, res2);
+			__m128 y = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(1, 1, 1, 1));
+			res1 = _mm_add_ps(res1, y);
+			ret.Vec() = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(0, 0, 0, 0));
+#elif defined(SIMD_MATH_NEON)
+			float32x2_t const xy = vmul_f32(vget_low_f32(lhs.Vec()), vget_low_f32(rhs.Vec()));
+			float32x2_t const dot = vpadd_f32(xy, xy);
+			ret.Vec() = vcombine_f32(dot, dot);
+#else
+			ret = SetVector(GetX(lhs) * GetX(rhs) + GetY(lhs) * GetY(rhs));
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 LengthSqVector2(SIMDVectorF4 const & rhs)
+		{
+			return DotVector2(rhs, rhs);
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 LengthVector2(SIMDVectorF4 const & rhs)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			ret.Vec() = _mm_sqrt_ps(LengthSqVector2(rhs).Vec());
+#elif defined(SIMD_MATH_NEON)
+			ret.Vec() = detail::SIMDSqrt(LengthSqVector2(rhs).Vec());
+#else
+			ret = SetVector(sqrt(GetX(LengthSqVector2(rhs))));
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 NormalizeVector2(SIMDVectorF4 const & rhs)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			__m128 temp = _mm_sqrt_ps(LengthSqVector2(rhs).Vec());
+			temp = _mm_rcp_ps(temp);
+			ret.Vec() = _mm_mul_ps(rhs.Vec(), temp);
+#elif defined(SIMD_MATH_NEON)
+			ret.Vec() = vmulq_f32(rhs.Vec(), detail::SIMDRecipSqrt(LengthSqVector2(rhs).Vec()));
+#else
+			ret = rhs * MathLib::recip_sqrt(GetX(LengthSqVector2(rhs)));
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 TransformCoordVector2(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			__m128 temp = v.Vec();
+			__m128 res = detail::SIMDMulAdd(detail::SIMDSplat<0>(temp), mat.Row(0).Vec(), mat.Row(3).Vec());
+			res = detail::SIMDMulAdd(detail::SIMDSplat<1>(temp), mat.Row(1).Vec(), res);
+			__m128 inv_w = _mm_rcp_ps(detail::SIMDSplat<3>(res));
+			ret.Vec() = _mm_mul_ps(res, inv_w);
+#elif defined(SIMD_MATH_NEON)
+			float32x2_t const xy = vget_low_f32(v.Vec());
+			float32x4_t res = detail::SIMDMulAddLane<0>(mat.Row(3).Vec(), mat.Row(0).Vec(), xy);
+			res = detail::SIMDMulAddLane<1>(res, mat.Row(1).Vec(), xy);
+			ret.Vec() = vmulq_f32(res, detail::SIMDRecip(vdupq_lane_f32(vget_high_f32(res), 1)));
+#else
+			SIMDVectorF4 temp;
+			for (int i = 0; i < 4; ++ i)
+			{
+				temp.Vec()[i] = GetX(v) * mat(0, i) + GetY(v) * mat(1, i) + mat(3, i);
+			}
+			if (MathLib::equal(GetW(temp), 0.0f))
+			{
+				ret = SIMDVectorF4::Zero();
+			}
+			else
+			{
+				for (int i = 0; i < 2; ++ i)
+				{
+					ret.Vec()[i] = temp.Vec()[i] / GetW(temp);
+				}
+				for (int i = 2; i < 4; ++ i)
+				{
+					ret.Vec()[i] = 0;
+				}
+			}
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 TransformNormalVector2(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			__m128 temp = v.Vec();
+			__m128 res = _mm_mul_ps(detail::SIMDSplat<0>(temp), mat.Row(0).Vec());
+			ret.Vec() = detail::SIMDMulAdd(detail::SIMDSplat<1>(temp), mat.Row(1).Vec(), res);
+#elif defined(SIMD_MATH_NEON)
+			float32x2_t const xy = vget_low_f32(v.Vec());
+			float32x4_t const res = vmulq_lane_f32(mat.Row(0).Vec(), xy, 0);
+			ret.Vec() = detail::SIMDMulAddLane<1>(res, mat.Row(1).Vec(), xy);
+#else
+			for (int i = 0; i < 2; ++ i)
+			{
+				ret.Vec()[i] = GetX(v) * mat(0, i) + GetY(v) * mat(1, i);
+			}
+			for (int i = 2; i < 4; ++ i)
+			{
+				ret.Vec()[i] = 0;
+			}
+#endif
+			return ret;
+		}
+
+		// 3D Vector
+		///////////////////////////////////////////////////////////////////////////////
+		KLAYGE_FORCEINLINE SIMDVectorF4 CrossVector3(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			__m128 m1 = _mm_shuffle_ps(lhs.Vec(), lhs.Vec(), _MM_SHUFFLE(0, 0, 2, 1));
+			__m128 m2 = _mm_shuffle_ps(rhs.Vec(), rhs.Vec(), _MM_SHUFFLE(0, 1, 0, 2));
+			__m128 res1 = _mm_mul_ps(m1, m2);
+			m1 = _mm_shuffle_ps(lhs.Vec(), lhs.Vec(), _MM_SHUFFLE(0, 1, 0, 2));
+			m2 = _mm_shuffle_ps(rhs.Vec(), rhs.Vec(), _MM_SHUFFLE(0, 0, 2, 1));
+			__m128 res2 = _mm_mul_ps(m1, m2);
+			ret.Vec() = _mm_sub_ps(res1, res2);
+#elif defined(SIMD_MATH_NEON)
+			// (lhs * rhs.yzx - lhs.yzx * rhs).yzx, with w kept at 0
+			float32x4_t const res = vmlsq_f32(vmulq_f32(lhs.Vec(), detail::SIMDSwizzleYZXW(rhs.Vec())),
+				detail::SIMDSwizzleYZXW(lhs.Vec()), rhs.Vec());
+			ret.Vec() = vsetq_lane_f32(0, detail::SIMDSwizzleYZXW(res), 3);
+#else
+			ret = SetVector(GetY(lhs) * GetZ(rhs) - GetZ(lhs) * GetY(rhs),
+				GetZ(lhs) * GetX(rhs) - GetX(lhs) * GetZ(rhs),
+				GetX(lhs) * GetY(rhs) - GetY(lhs) * GetX(rhs),
+				0.0f);
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 DotVector3(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			__m128 res1 = lhs.Vec();
+			__m128 res2 = rhs.Vec();
+			res1 = _mm_mul_ps(res1, res2);
+			__m128 y = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(1, 1, 1, 1));
+			__m128 z = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(2, 2, 2, 2));
+			res1 = _mm_add_ps(res1, y);
+			res1 = _mm_add_ps(res1, z);
+			ret.Vec() = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(0, 0, 0, 0));
+#elif defined(SIMD_MATH_NEON)
+			float32x4_t const res = vmulq_f32(lhs.Vec(), rhs.Vec());
+			float32x2_t dot = vpadd_f32(vget_low_f32(res), vget_low_f32(res));
+			dot = vadd_f32(dot, vdup_lane_f32(vget_high_f32(res), 0));
+			ret.Vec() = vcombine_f32(dot, dot);
+#else
+			ret = SetVector(GetX(lhs) * GetX(rhs) + GetY(lhs) * GetY(rhs)
+				+ GetZ(lhs) * GetZ(rhs));
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 LengthSqVector3(SIMDVectorF4 const & rhs)
+		{
+			return DotVector3(rhs, rhs);
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 LengthVector3(SIMDVectorF4 const & rhs)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			ret.Vec() = _mm_sqrt_ps(LengthSqVector3(rhs).Vec());
+#elif defined(SIMD_MATH_NEON)
+			ret.Vec() = detail::SIMDSqrt(LengthSqVector3(rhs).Vec());
+#else
+			ret = SetVector(sqrt(GetX(LengthSqVector3(rhs))));
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 NormalizeVector3(SIMDVectorF4 const & rhs)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			__m128 temp = _mm_sqrt_ps(LengthSqVector3(rhs).Vec());
+			temp = _mm_rcp_ps(temp);
+			ret.Vec() = _mm_mul_ps(rhs.Vec(), temp);
+#elif defined(SIMD_MATH_NEON)
+			ret.Vec() = vmulq_f32(rhs.Vec(), detail::SIMDRecipSqrt(LengthSqVector3(rhs).Vec()));
+#else
+			ret = rhs * MathLib::recip_sqrt(GetX(LengthSqVector3(rhs)));
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 TransformCoordVector3(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			__m128 temp = v.Vec();
+			__m128 res = detail::SIMDMulAdd(detail::SIMDSplat<0>(temp), mat.Row(0).Vec(), mat.Row(3).Vec());
+			res = detail::SIMDMulAdd(detail::SIMDSplat<1>(temp), mat.Row(1).Vec(), res);
+			res = detail::SIMDMulAdd(detail::SIMDSplat<2>(temp), mat.Row(2).Vec(), res);
+			__m128 inv_w = _mm_rcp_ps(detail::SIMDSplat<3>(res));
+			ret.Vec() = _mm_mul_ps(res, inv_w);
+#elif defined(SIMD_MATH_NEON)
+			float32x2_t const xy = vget_low_f32(v.Vec());
+			float32x2_t const zw = vget_high_f32(v.Vec());
+			float32x4_t res = detail::SIMDMulAddLane<0>(mat.Row(3).Vec(), mat.Row(0).Vec(), xy);
+			res = detail::SIMDMulAddLane<1>(res, mat.Row(1).Vec(), xy);
+			res = detail::SIMDMulAddLane<0>(res, mat.Row(2).Vec(), zw);
+			ret.Vec() = vmulq_f32(res, detail::SIMDRecip(vdupq_lane_f32(vget_high_f32(res), 1)));
+#else
+			SIMDVectorF4 temp;
+			for (int i = 0; i < 4; ++ i)
+			{
+				temp.Vec()[i] = GetX(v) * mat(0, i) + GetY(v) * mat(1, i)
+					+ GetZ(v) * mat(2, i) + mat(3, i);
+			}
+			if (MathLib::equal(GetW(temp), 0.0f))
+			{
+				ret = SIMDVectorF4::Zero();
+			}
+			else
+			{
+				for (int i = 0; i < 3; ++ i)
+				{
+					ret.Vec()[i] = temp.Vec()[i] / GetW(temp);
+				}
+				for (int i = 3; i < 4; ++ i)
+				{
+					ret.Vec()[i] = 0;
+				}
+			}
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 TransformNormalVector3(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			__m128 temp = v.Vec();
+			__m128 res = _mm_mul_ps(detail::SIMDSplat<0>(temp), mat.Row(0).Vec());
+			res = detail::SIMDMulAdd(detail::SIMDSplat<1>(temp), mat.Row(1).Vec(), res);
+			ret.Vec() = detail::SIMDMulAdd(detail::SIMDSplat<2>(temp), mat.Row(2).Vec(), res);
+#elif defined(SIMD_MATH_NEON)
+			float32x2_t const xy = vget_low_f32(v.Vec());
+			float32x2_t const zw = vget_high_f32(v.Vec());
+			float32x4_t res = vmulq_lane_f32(mat.Row(0).Vec(), xy, 0);
+			res = detail::SIMDMulAddLane<1>(res, mat.Row(1).Vec(), xy);
+			ret.Vec() = detail::SIMDMulAddLane<0>(res, mat.Row(2).Vec(), zw);
+#else
+			for (int i = 0; i < 3; ++ i)
+			{
+				ret.Vec()[i] = GetX(v) * mat(0, i) + GetY(v) * mat(1, i)
+					+ GetZ(v) * mat(2, i);
+			}
+			for (int i = 3; i < 4; ++ i)
+			{
+				ret.Vec()[i] = 0;
+			}
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 TransformQuat(SIMDVectorF4 const & v, SIMDVectorF4 const & quat)
+		{
+			return v + CrossVector3(quat, CrossVector3(quat, v) + GetW(quat) * v) * 2;
+		}
+
+		// 4D Vector
+		///////////////////////////////////////////////////////////////////////////////
+		KLAYGE_FORCEINLINE SIMDVectorF4 DotVector4(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			__m128 res1 = lhs.Vec();
+			__m128 res2 = rhs.Vec();
+			res1 = _mm_mul_ps(res1, res2);
+			__m128 yw = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(1, 1, 3, 3));
+			res1 = _mm_add_ps(res1, yw);
+			__m128 zw = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(2, 2, 2, 2));
+			res1 = _mm_add_ps(res1, zw);
+			ret.Vec() = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(0, 0, 0, 0));
+#elif defined(SIMD_MATH_NEON)
+			float32x4_t const res = vmulq_f32(lhs.Vec(), rhs.Vec());
+			float32x2_t dot = vadd_f32(vget_low_f32(res), vget_high_f32(res));
+			dot = vpadd_f32(dot, dot);
+			ret.Vec() = vcombine_f32(dot, dot);
+#else
+			ret = SetVector(GetX(lhs) * GetX(rhs) + GetY(lhs) * GetY(rhs)
+				+ GetZ(lhs) * GetZ(rhs) + GetW(lhs) * GetW(rhs));
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 LengthSqVector4(SIMDVectorF4 const & rhs)
+		{
+			return DotVector4(rhs, rhs);
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 LengthVector4(SIMDVectorF4 const & rhs)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			ret.Vec() = _mm_sqrt_ps(LengthSqVector4(rhs).Vec());
+#elif defined(SIMD_MATH_NEON)
+			ret.Vec() = detail::SIMDSqrt(LengthSqVector4(rhs).Vec());
+#else
+			ret = SetVector(sqrt(GetX(LengthSqVector4(rhs))));
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 NormalizeVector4(SIMDVectorF4 const & rhs)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			__m128 temp = _mm_sqrt_ps(LengthSqVector4(rhs).Vec());
+			temp = _mm_rcp_ps(temp);
+			ret.Vec() = _mm_mul_ps(rhs.Vec(), temp);
+#elif defined(SIMD_MATH_NEON)
+			ret.Vec() = vmulq_f32(rhs.Vec(), detail::SIMDRecipSqrt(LengthSqVector4(rhs).Vec()));
+#else
+			ret = rhs * MathLib::recip_sqrt(GetX(LengthSqVector4(rhs)));
+#endif
+			return ret;
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 TransformVector4(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			__m128 temp = v.Vec();
+			__m128 res = _mm_mul_ps(detail::SIMDSplat<0>(temp), mat.Row(0).Vec());
+			res = detail::SIMDMulAdd(detail::SIMDSplat<1>(temp), mat.Row(1).Vec(), res);
+			res = detail::SIMDMulAdd(detail::SIMDSplat<2>(temp), mat.Row(2).Vec(), res);
+			ret.Vec() = detail::SIMDMulAdd(detail::SIMDSplat<3>(temp), mat.Row(3).Vec(), res);
+#elif defined(SIMD_MATH_NEON)
+			float32x2_t const xy = vget_low_f32(v.Vec());
+			float32x2_t const zw = vget_high_f32(v.Vec());
+			float32x4_t res = vmulq_lane_f32(mat.Row(0).Vec(), xy, 0);
+			res = detail::SIMDMulAddLane<1>(res, mat.Row(1).Vec(), xy);
+			res = detail::SIMDMulAddLane<0>(res, mat.Row(2).Vec(), zw);
+			ret.Vec() = detail::SIMDMulAddLane<1>(res, mat.Row(3).Vec(), zw);
+#else
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret.Vec()[i] = GetX(v) * mat(0, i) + GetY(v) * mat(1, i)
+					+ GetZ(v) * mat(2, i) + GetW(v) * mat(3, i);
+			}
+#endif
+			return ret;
+		}
+
+		// 4D Matrix
+		///////////////////////////////////////////////////////////////////////////////
+		KLAYGE_FORCEINLINE SIMDMatrixF4 Add(SIMDMatrixF4 const & lhs, SIMDMatrixF4 const & rhs)
+		{
+			return SIMDMatrixF4(Add(lhs.Row(0), rhs.Row(0)),
+				Add(lhs.Row(1), rhs.Row(1)),
+				Add(lhs.Row(2), rhs.Row(2)),
+				Add(lhs.Row(3), rhs.Row(3)));
+		}
+
+		KLAYGE_FORCEINLINE SIMDMatrixF4 Substract(SIMDMatrixF4 const & lhs, SIMDMatrixF4 const & rhs)
+		{
+			return SIMDMatrixF4(Substract(lhs.Row(0), rhs.Row(0)),
+				Substract(lhs.Row(1), rhs.Row(1)),
+				Substract(lhs.Row(2), rhs.Row(2)),
+				Substract(lhs.Row(3), rhs.Row(3)));
+		}
+
+		KLAYGE_FORCEINLINE SIMDMatrixF4 Multiply(SIMDMatrixF4 const & lhs, SIMDMatrixF4 const & rhs)
+		{
+#if defined(SIMD_MATH_AVX)
+			// Two rows of lhs in each 256-bit register, against each row of rhs duplicated in both halves
+			__m256 const t0 = _mm256_broadcast_ps(&rhs.Row(0).Vec());
+			__m256 const t1 = _mm256_broadcast_ps(&rhs.Row(1).Vec());
+			__m256 const t2 = _mm256_broadcast_ps(&rhs.Row(2).Vec());
+			__m256 const t3 = _mm256_broadcast_ps(&rhs.Row(3).Vec());
+
+			__m256 const l01 = _mm256_insertf128_ps(_mm256_castps128_ps256(lhs.Row(0).Vec()), lhs.Row(1).Vec(), 1);
+			__m256 const l23 = _mm256_insertf128_ps(_mm256_castps128_ps256(lhs.Row(2).Vec()), lhs.Row(3).Vec(), 1);
+
+			__m256 r01 = _mm256_mul_ps(_mm256_permute_ps(l01, _MM_SHUFFLE(0, 0, 0, 0)), t0);
+			__m256 r23 = _mm256_mul_ps(_mm256_permute_ps(l23, _MM_SHUFFLE(0, 0, 0, 0)), t0);
+			r01 = detail::SIMDMulAdd(_mm256_permute_ps(l01, _MM_SHUFFLE(1, 1, 1, 1)), t1, r01);
+			r23 = detail::SIMDMulAdd(_mm256_permute_ps(l23, _MM_SHUFFLE(1, 1, 1, 1)), t1, r23);
+			r01 = detail::SIMDMulAdd(_mm256_permute_ps(l01, _MM_SHUFFLE(2, 2, 2, 2)), t2, r01);
+			r23 = detail::SIMDMulAdd(_mm256_permute_ps(l23, _MM_SHUFFLE(2, 2, 2, 2)), t2, r23);
+			r01 = detail::SIMDMulAdd(_mm256_permute_ps(l01, _MM_SHUFFLE(3, 3, 3, 3)), t3, r01);
+			r23 = detail::SIMDMulAdd(_mm256_permute_ps(l23, _MM_SHUFFLE(3, 3, 3, 3)), t3, r23);
+
+			SIMDVectorF4 row0;
+			SIMDVectorF4 row1;
+			SIMDVectorF4 row2;
+			SIMDVectorF4 row3;
+			row0.Vec() = _mm256_castps256_ps128(r01);
+			row1.Vec() = _mm256_extractf128_ps(r01, 1);
+			row2.Vec() = _mm256_castps256_ps128(r23);
+			row3.Vec() = _mm256_extractf128_ps(r23, 1);
+			return SIMDMatrixF4(row0, row1, row2, row3);
+#elif defined(SIMD_MATH_SSE) || defined(SIMD_MATH_NEON)
+			return SIMDMatrixF4(TransformVector4(lhs.Row(0), rhs),
+				TransformVector4(lhs.Row(1), rhs),
+				TransformVector4(lhs.Row(2), rhs),
+				TransformVector4(lhs.Row(3), rhs));
+#else
+			SIMDMatrixF4 const tmp = Transpose(rhs);
+
+			V4TYPE const & l0 = lhs.Row(0).Vec();
+			V4TYPE const & l1 = lhs.Row(1).Vec();
+			V4TYPE const & l2 = lhs.Row(2).Vec();
+			V4TYPE const & l3 = lhs.Row(3).Vec();
+
+			V4TYPE const & t0 = tmp.Row(0).Vec();
+			V4TYPE const & t1 = tmp.Row(1).Vec();
+			V4TYPE const & t2 = tmp.Row(2).Vec();
+			V4TYPE const & t3 = tmp.Row(3).Vec();
+
+			return SIMDMatrixF4(
+				l0[0] * t0[0] + l0[1] * t0[1] + l0[2] * t0[2] + l0[3] * t0[3],
+				l0[0] * t1[0] + l0[1] * t1[1] + l0[2] * t1[2] + l0[3] * t1[3],
+				l0[0] * t2[0] + l0[1] * t2[1] + l0[2] * t2[2] + l0[3] * t2[3],
+				l0[0] * t3[0] + l0[1] * t3[1] + l0[2] * t3[2] + l0[3] * t3[3],
+
+				l1[0] * t0[0] + l1[1] * t0[1] + l1[2] * t0[2] + l1[3] * t0[3],
+				l1[0] * t1[0] + l1[1] * t1[1] + l1[2] * t1[2] + l1[3] * t1[3],
+				l1[0] * t2[0] + l1[1] * t2[1] + l1[2] * t2[2] + l1[3] * t2[3],
+				l1[0] * t3[0] + l1[1] * t3[1] + l1[2] * t3[2] + l1[3] * t3[3],
+
+				l2[0] * t0[0] + l2[1] * t0[1] + l2[2] * t0[2] + l2[3] * t0[3],
+				l2[0] * t1[0] + l2[1] * t1[1] + l2[2] * t1[2] + l2[3] * t1[3],
+				l2[0] * t2[0] + l2[1] * t2[1] + l2[2] * t2[2] + l2[3] * t2[3],
+				l2[0] * t3[0] + l2[1] * t3[1] + l2[2] * t3[2] + l2[3] * t3[3],
+
+				l3[0] * t0[0] + l3[1] * t0[1] + l3[2] * t0[2] + l3[3] * t0[3],
+				l3[0] * t1[0] + l3[1] * t1[1] + l3[2] * t1[2] + l3[3] * t1[3],
+				l3[0] * t2[0] + l3[1] * t2[1] + l3[2] * t2[2] + l3[3] * t2[3],
+				l3[0] * t3[0] + l3[1] * t3[1] + l3[2] * t3[2] + l3[3] * t3[3]);
+#endif
+		}
+
+		KLAYGE_FORCEINLINE SIMDMatrixF4 Multiply(SIMDMatrixF4 const & lhs, float rhs)
+		{
+			SIMDVectorF4 r = SetVector(rhs);
+			return SIMDMatrixF4(Multiply(lhs.Row(0), r),
+				Multiply(lhs.Row(1), r),
+				Multiply(lhs.Row(2), r),
+				Multiply(lhs.Row(3), r));
+		}
+
+		KLAYGE_FORCEINLINE SIMDMatrixF4 Negative(SIMDMatrixF4 const & rhs)
+		{
+			return SIMDMatrixF4(Negative(rhs.Row(0)),
+				Negative(rhs.Row(1)),
+				Negative(rhs.Row(2)),
+				Negative(rhs.Row(3)));
+		}
+
+		KLAYGE_FORCEINLINE SIMDMatrixF4 Transpose(SIMDMatrixF4 const & rhs)
+		{
+#if defined(SIMD_MATH_SSE)
+			SIMDVectorF4 r0;
+			SIMDVectorF4 r1;
+			SIMDVectorF4 r2;
+			SIMDVectorF4 r3;
+			r0.Vec() = rhs.Row(0).Vec();
+			r1.Vec() = rhs.Row(1).Vec();
+			r2.Vec() = rhs.Row(2).Vec();
+			r3.Vec() = rhs.Row(3).Vec();
+			_MM_TRANSPOSE4_PS(r0.Vec(), r1.Vec(), r2.Vec(), r3.Vec());
+			return SIMDMatrixF4(r0, r1, r2, r3);
+#elif defined(SIMD_MATH_NEON)
+			float32x4x2_t const t01 = vtrnq_f32(rhs.Row(0).Vec(), rhs.Row(1).Vec());
+			float32x4x2_t const t23 = vtrnq_f32(rhs.Row(2).Vec(), rhs.Row(3).Vec());
+			SIMDVectorF4 r0;
+			SIMDVectorF4 r1;
+			SIMDVectorF4 r2;
+			SIMDVectorF4 r3;
+			r0.Vec() = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+			r1.Vec() = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+			r2.Vec() = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+			r3.Vec() = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+			return SIMDMatrixF4(r0, r1, r2, r3);
+#else
+			V4TYPE const & r0 = rhs.Row(0).Vec();
+			V4TYPE const & r1 = rhs.Row(1).Vec();
+			V4TYPE const & r2 = rhs.Row(2).Vec();
+			V4TYPE const & r3 = rhs.Row(3).Vec();
+			return SIMDMatrixF4(
+				r0[0], r1[0], r2[0], r3[0],
+				r0[1], r1[1], r2[1], r3[1],
+				r0[2], r1[2], r2[2], r3[2],
+				r0[3], r1[3], r2[3], r3[3]);
+#endif
+		}
+
+		// Quaternion
+		///////////////////////////////////////////////////////////////////////////////
+		KLAYGE_FORCEINLINE SIMDVectorF4 Conjugate(SIMDVectorF4 const & rhs)
+		{
+			return SetVector(-GetX(rhs), -GetY(rhs), -GetZ(rhs), GetW(rhs));
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 MultiplyQuat(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
+		{
+			// xyz = lhs.w * rhs.xyz + rhs.w * lhs.xyz + cross(rhs, lhs), w = lhs.w * rhs.w - dot(lhs.xyz, rhs.xyz)
+			float const lw = GetW(lhs);
+			float const rw = GetW(rhs);
+			SIMDVectorF4 const ret = rhs * lw + lhs * rw + CrossVector3(rhs, lhs);
+			return SetW(ret, lw * rw - GetX(DotVector3(lhs, rhs)));
+		}
+
+		// Plane
+		///////////////////////////////////////////////////////////////////////////////
+		KLAYGE_FORCEINLINE SIMDVectorF4 DotPlane(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
+		{
+			return DotVector4(lhs, rhs);
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 DotCoord(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
+		{
+			return DotVector4(lhs, SetW(rhs, 1));
+		}
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 DotNormal(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
+		{
+			return DotVector4(lhs, SetW(rhs, 0));
+		}
+
+		// Color
+		///////////////////////////////////////////////////////////////////////////////
+		KLAYGE_FORCEINLINE SIMDVectorF4 ModulateColor(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
+		{
+			return lhs * rhs;
+		}
+	}
+}
+
+#endif		// _KFL_SIMDMATHINLINE_HPP
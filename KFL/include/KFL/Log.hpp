@@ -33,12 +33,52 @@
 
 #pragma once
 
+#include <cstdint>
+#include <iosfwd>
+
+#include <KFL/CXX17/string_view.hpp>
+
 namespace KlayGE
 {
+	enum class LogSeverity : uint8_t
+	{
+		Debug,
+		Info,
+		Warn,
+		Error
+	};
+
+	enum class LogFormat : uint8_t
+	{
+		// "(INFO) KlayGE: message", or "(INFO) KlayGE/category: message"
+		Text,
+		// One object per line, {"ts":<ns since epoch>,"thread":<id>,"severity":"info","category":"...","msg":"..."}
+		JsonLines,
+		// Per record, little endian: uint64 ns since epoch, uint64 thread id, uint8 severity, uint8 0,
+		//  uint16 category length, uint32 message length, then the category and message bytes
+		Binary
+	};
+
+	// Each thread writes to its own streams. A record is complete at std::endl or flush, and is then queued for a
+	//  background thread to write out, so logging neither blocks on the console nor interleaves between threads.
+	//  Streams of filtered out severities or categories are in a failed state, so nothing is formatted into them.
+	//  Error records are the exception: they are written out before the flush returns, like LogFlush.
 	std::ostream& LogDebug();
 	std::ostream& LogInfo();
 	std::ostream& LogWarn();
 	std::ostream& LogError();
+
+	std::ostream& LogDebug(std::string_view category);
+	std::ostream& LogInfo(std::string_view category);
+	std::ostream& LogWarn(std::string_view category);
+	std::ostream& LogError(std::string_view category);
+
+	void LogMinSeverity(LogSeverity severity);
+	void LogCategoryEnabled(std::string_view category, bool enabled);
+	void LogOutputFormat(LogFormat format);
+
+	// Waits until all records completed before the call are written out
+	void LogFlush();
 }
 
 #endif		// _KFL_LOG_HPP
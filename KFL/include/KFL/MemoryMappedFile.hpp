@@ -0,0 +1,83 @@
+/**
+ * @file MemoryMappedFile.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KFL_MEMORY_MAPPED_FILE_HPP
+#define _KFL_MEMORY_MAPPED_FILE_HPP
+
+#pragma once
+
+#include <KFL/CXX17/string_view.hpp>
+#include <KFL/CXX2a/span.hpp>
+
+#include <boost/noncopyable.hpp>
+
+namespace KlayGE
+{
+	// Maps a whole file into memory. The view is copy-on-write, writing to it never touches the file, and only the
+	//  written pages get private copies.
+	class MemoryMappedFile final : boost::noncopyable
+	{
+	public:
+		MemoryMappedFile() noexcept;
+		~MemoryMappedFile();
+
+		bool Open(std::string_view path);
+		void Close();
+
+		bool Valid() const noexcept
+		{
+			return data_ != nullptr;
+		}
+
+		uint8_t* Data() const noexcept
+		{
+			return data_;
+		}
+		uint64_t Size() const noexcept
+		{
+			return size_;
+		}
+
+		std::span<uint8_t const> Span() const noexcept
+		{
+			return std::span<uint8_t const>(data_, static_cast<size_t>(size_));
+		}
+
+	private:
+		uint8_t* data_;
+		uint64_t size_;
+#ifdef KLAYGE_PLATFORM_WINDOWS
+		void* file_;
+		void* mapping_;
+#endif
+	};
+}
+
+#endif		// _KFL_MEMORY_MAPPED_FILE_HPP
@@ -34,13 +34,20 @@
 #pragma once
 
 #include <KFL/PreDeclare.hpp>
+#include <boost/assert.hpp>
 #include <KFL/CXX17/string_view.hpp>
+#include <KFL/CXX2a/span.hpp>
+#include <KFL/CustomizedStreamBuf.hpp>
+#include <algorithm>
+#include <cstring>
 #include <istream>
 #include <vector>
 #include <string>
 
 namespace KlayGE
 {
+	// Either wraps a stream, or holds the whole resource as one contiguous read-only block. In the latter, read/seekg/tellg
+	//  work on the block directly instead of going through a streambuf.
 	class ResIdentifier final
 	{
 	public:
@@ -54,6 +61,13 @@ namespace KlayGE
 			: res_name_(name), timestamp_(timestamp), istream_(is), streambuf_(streambuf)
 		{
 		}
+		// The data is kept alive by owner, e.g. a mapped file or a decoded package item
+		ResIdentifier(std::string_view name, uint64_t timestamp,
+				std::span<uint8_t const> data, std::shared_ptr<void const> const & owner)
+			: res_name_(name), timestamp_(timestamp), data_(data), owner_(owner)
+		{
+			BOOST_ASSERT(owner_);
+		}
 
 		void ResName(std::string_view name)
 		{
@@ -75,49 +89,162 @@ namespace KlayGE
 
 		void read(void* p, size_t size)
 		{
-			istream_->read(static_cast<char*>(p), static_cast<std::streamsize>(size));
+			if (owner_)
+			{
+				size_t const count = fail_ ? 0 : std::min(size, static_cast<size_t>(data_.size()) - pos_);
+				if (count > 0)
+				{
+					std::memcpy(p, data_.data() + pos_, count);
+				}
+				pos_ += count;
+				gcount_ = count;
+				fail_ |= (count < size);
+			}
+			else
+			{
+				istream_->read(static_cast<char*>(p), static_cast<std::streamsize>(size));
+			}
 		}
 
 		int64_t gcount() const
 		{
-			return static_cast<int64_t>(istream_->gcount());
+			if (owner_)
+			{
+				return static_cast<int64_t>(gcount_);
+			}
+			else
+			{
+				return static_cast<int64_t>(istream_->gcount());
+			}
 		}
 
 		void seekg(int64_t offset, std::ios_base::seekdir way)
 		{
-			istream_->seekg(static_cast<std::istream::off_type>(offset), way);
+			if (owner_)
+			{
+				if (!fail_)
+				{
+					int64_t base;
+					if (way == std::ios_base::beg)
+					{
+						base = 0;
+					}
+					else if (way == std::ios_base::cur)
+					{
+						base = static_cast<int64_t>(pos_);
+					}
+					else
+					{
+						base = static_cast<int64_t>(data_.size());
+					}
+
+					int64_t const new_pos = base + offset;
+					if ((new_pos >= 0) && (new_pos <= static_cast<int64_t>(data_.size())))
+					{
+						pos_ = static_cast<size_t>(new_pos);
+					}
+					else
+					{
+						fail_ = true;
+					}
+				}
+			}
+			else
+			{
+				istream_->seekg(static_cast<std::istream::off_type>(offset), way);
+			}
 		}
 
 		int64_t tellg()
 		{
-			return static_cast<int64_t>(istream_->tellg());
+			if (owner_)
+			{
+				return fail_ ? -1 : static_cast<int64_t>(pos_);
+			}
+			else
+			{
+				return static_cast<int64_t>(istream_->tellg());
+			}
 		}
 
 		void clear()
 		{
-			istream_->clear();
+			if (owner_)
+			{
+				fail_ = false;
+			}
+			else
+			{
+				istream_->clear();
+			}
 		}
 
 		operator bool() const
 		{
-			return !istream_->fail();
+			return owner_ ? !fail_ : !istream_->fail();
 		}
 
 		bool operator!() const
 		{
-			return istream_->operator!();
+			return owner_ ? fail_ : istream_->operator!();
 		}
 
+		// For a contiguous resource, the stream is created on demand at the current position. Reading from it doesn't
+		//  move the position of read().
 		std::istream& input_stream()
 		{
+			if (owner_)
+			{
+				auto buff = std::make_shared<MemInputStreamBuf>(data_.data(), static_cast<std::streamsize>(data_.size()));
+				istream_ = std::make_shared<std::istream>(buff.get());
+				streambuf_ = buff;
+				istream_->seekg(static_cast<std::istream::off_type>(pos_), std::ios_base::beg);
+			}
 			return *istream_;
 		}
 
+		bool Contiguous() const
+		{
+			return static_cast<bool>(owner_);
+		}
+
+		// The whole resource as one read-only block. A stream backed resource is read into an owned buffer the first
+		//  time and becomes contiguous, keeping its position.
+		std::span<uint8_t const> Data()
+		{
+			if (!owner_)
+			{
+				istream_->clear();
+				int64_t const pos = static_cast<int64_t>(istream_->tellg());
+				istream_->seekg(0, std::ios_base::end);
+				int64_t const size = static_cast<int64_t>(istream_->tellg());
+				istream_->seekg(0, std::ios_base::beg);
+
+				auto buff = std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(std::max<int64_t>(size, 0)));
+				istream_->read(reinterpret_cast<char*>(buff->data()), static_cast<std::streamsize>(buff->size()));
+				buff->resize(static_cast<size_t>(istream_->gcount()));
+
+				data_ = MakeSpan(*buff);
+				owner_ = buff;
+				pos_ = std::min(static_cast<size_t>(std::max<int64_t>(pos, 0)), static_cast<size_t>(data_.size()));
+				istream_.reset();
+				streambuf_.reset();
+			}
+
+			return data_;
+		}
+
 	private:
 		std::string res_name_;
 		uint64_t timestamp_;
 		std::shared_ptr<std::istream> istream_;
 		std::shared_ptr<std::streambuf> streambuf_;
+
+		std::span<uint8_t const> data_;
+		std::shared_ptr<void const> owner_;
+		size_t pos_ = 0;
+		size_t gcount_ = 0;
+		bool fail_ = false;
 	};
 }
 
@@ -34,10 +34,23 @@
 #pragma once
 
 #include <KFL/PreDeclare.hpp>
+#include <KFL/Math.hpp>
 
 #if defined(KLAYGE_SSE_SUPPORT)
 	#define SIMD_MATH_SSE
 	#include <xmmintrin.h>
+	#if defined(KLAYGE_AVX_SUPPORT)
+		#define SIMD_MATH_AVX
+	#endif
+	#if defined(KLAYGE_FMA_SUPPORT)
+		#define SIMD_MATH_FMA
+	#endif
+	#if defined(SIMD_MATH_AVX) || defined(SIMD_MATH_FMA)
+		#include <immintrin.h>
+	#endif
+#elif defined(KLAYGE_NEON_SUPPORT)
+	#define SIMD_MATH_NEON
+	#include <arm_neon.h>
 #else
 	#define SIMD_MATH_GENERAL
 #endif
@@ -51,11 +64,11 @@ namespace KlayGE
 	{
 		// General Vector
 		///////////////////////////////////////////////////////////////////////////////
-		SIMDVectorF4 Add(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 Substract(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 Multiply(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 Divide(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 Negative(SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 Add(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 Substract(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 Multiply(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 Divide(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 Negative(SIMDVectorF4 const & rhs);
 
 		SIMDVectorF4 BaryCentric(SIMDVectorF4 const & v1, SIMDVectorF4 const & v2, SIMDVectorF4 const & v3,
 			float f, float g);
@@ -67,64 +80,64 @@ namespace KlayGE
 			SIMDVectorF4 const & v2, SIMDVectorF4 const & v3, float s);
 		SIMDVectorF4 Hermite(SIMDVectorF4 const & v1, SIMDVectorF4 const & t1,
 			SIMDVectorF4 const & v2, SIMDVectorF4 const & t2, float s);
-		SIMDVectorF4 Lerp(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs, float s);
+		KLAYGE_FORCEINLINE SIMDVectorF4 Lerp(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs, float s);
 
-		SIMDVectorF4 Abs(SIMDVectorF4 const & x);
+		KLAYGE_FORCEINLINE SIMDVectorF4 Abs(SIMDVectorF4 const & x);
 		SIMDVectorF4 Sgn(SIMDVectorF4 const & x);
-		SIMDVectorF4 Sqr(SIMDVectorF4 const & x);
-		SIMDVectorF4 Cube(SIMDVectorF4 const & x);
-
-		SIMDVectorF4 LoadVector1(float v);
-		SIMDVectorF4 LoadVector2(float2 const & v);
-		SIMDVectorF4 LoadVector3(float3 const & v);
-		SIMDVectorF4 LoadVector4(float4 const & v);
-		SIMDVectorF4 LoadVector2(float const * v);
-		SIMDVectorF4 LoadVector3(float const * v);
-		SIMDVectorF4 LoadVector4(float const * v);
-		void StoreVector1(float& fs, SIMDVectorF4 const & v);
-		void StoreVector2(float2& fs, SIMDVectorF4 const & v);
-		void StoreVector3(float3& fs, SIMDVectorF4 const & v);
-		void StoreVector4(float4& fs, SIMDVectorF4 const & v);
-		SIMDVectorF4 SetVector(float x, float y, float z, float w);
-		SIMDVectorF4 SetVector(float v);
-		float GetX(SIMDVectorF4 const & rhs);
-		float GetY(SIMDVectorF4 const & rhs);
-		float GetZ(SIMDVectorF4 const & rhs);
-		float GetW(SIMDVectorF4 const & rhs);
-		float GetByIndex(SIMDVectorF4 const & rhs, size_t index);
-		SIMDVectorF4 SetX(SIMDVectorF4 const & rhs, float v);
-		SIMDVectorF4 SetY(SIMDVectorF4 const & rhs, float v);
-		SIMDVectorF4 SetZ(SIMDVectorF4 const & rhs, float v);
-		SIMDVectorF4 SetW(SIMDVectorF4 const & rhs, float v);
-		SIMDVectorF4 SetByIndex(SIMDVectorF4 const & rhs, float v, size_t index);
-
-		SIMDVectorF4 Maximize(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 Minimize(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 Sqr(SIMDVectorF4 const & x);
+		KLAYGE_FORCEINLINE SIMDVectorF4 Cube(SIMDVectorF4 const & x);
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 LoadVector1(float v);
+		KLAYGE_FORCEINLINE SIMDVectorF4 LoadVector2(float2 const & v);
+		KLAYGE_FORCEINLINE SIMDVectorF4 LoadVector3(float3 const & v);
+		KLAYGE_FORCEINLINE SIMDVectorF4 LoadVector4(float4 const & v);
+		KLAYGE_FORCEINLINE SIMDVectorF4 LoadVector2(float const * v);
+		KLAYGE_FORCEINLINE SIMDVectorF4 LoadVector3(float const * v);
+		KLAYGE_FORCEINLINE SIMDVectorF4 LoadVector4(float const * v);
+		KLAYGE_FORCEINLINE void StoreVector1(float& fs, SIMDVectorF4 const & v);
+		KLAYGE_FORCEINLINE void StoreVector2(float2& fs, SIMDVectorF4 const & v);
+		KLAYGE_FORCEINLINE void StoreVector3(float3& fs, SIMDVectorF4 const & v);
+		KLAYGE_FORCEINLINE void StoreVector4(float4& fs, SIMDVectorF4 const & v);
+		KLAYGE_FORCEINLINE SIMDVectorF4 SetVector(float x, float y, float z, float w);
+		KLAYGE_FORCEINLINE SIMDVectorF4 SetVector(float v);
+		KLAYGE_FORCEINLINE float GetX(SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE float GetY(SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE float GetZ(SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE float GetW(SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE float GetByIndex(SIMDVectorF4 const & rhs, size_t index);
+		KLAYGE_FORCEINLINE SIMDVectorF4 SetX(SIMDVectorF4 const & rhs, float v);
+		KLAYGE_FORCEINLINE SIMDVectorF4 SetY(SIMDVectorF4 const & rhs, float v);
+		KLAYGE_FORCEINLINE SIMDVectorF4 SetZ(SIMDVectorF4 const & rhs, float v);
+		KLAYGE_FORCEINLINE SIMDVectorF4 SetW(SIMDVectorF4 const & rhs, float v);
+		KLAYGE_FORCEINLINE SIMDVectorF4 SetByIndex(SIMDVectorF4 const & rhs, float v, size_t index);
+
+		KLAYGE_FORCEINLINE SIMDVectorF4 Maximize(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 Minimize(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
 
 		SIMDVectorF4 Reflect(SIMDVectorF4 const & incident, SIMDVectorF4 const & normal);
 		SIMDVectorF4 Refract(SIMDVectorF4 const & incident, SIMDVectorF4 const & normal, float refraction_index);
 
 		// 2D Vector
 		///////////////////////////////////////////////////////////////////////////////
-		SIMDVectorF4 CrossVector2(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 DotVector2(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 LengthSqVector2(SIMDVectorF4 const & rhs);
-		SIMDVectorF4 LengthVector2(SIMDVectorF4 const & rhs);
-		SIMDVectorF4 NormalizeVector2(SIMDVectorF4 const & rhs);
-		SIMDVectorF4 TransformCoordVector2(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat);
-		SIMDVectorF4 TransformNormalVector2(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat);
+		KLAYGE_FORCEINLINE SIMDVectorF4 CrossVector2(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 DotVector2(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 LengthSqVector2(SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 LengthVector2(SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 NormalizeVector2(SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 TransformCoordVector2(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat);
+		KLAYGE_FORCEINLINE SIMDVectorF4 TransformNormalVector2(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat);
 
 		// 3D Vector
 		///////////////////////////////////////////////////////////////////////////////
 		SIMDVectorF4 Angle(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 CrossVector3(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 DotVector3(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 LengthSqVector3(SIMDVectorF4 const & rhs);
-		SIMDVectorF4 LengthVector3(SIMDVectorF4 const & rhs);
-		SIMDVectorF4 NormalizeVector3(SIMDVectorF4 const & rhs);
-		SIMDVectorF4 TransformCoordVector3(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat);
-		SIMDVectorF4 TransformNormalVector3(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat);
-		SIMDVectorF4 TransformQuat(SIMDVectorF4 const & v, SIMDVectorF4 const & quat);
+		KLAYGE_FORCEINLINE SIMDVectorF4 CrossVector3(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 DotVector3(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 LengthSqVector3(SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 LengthVector3(SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 NormalizeVector3(SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 TransformCoordVector3(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat);
+		KLAYGE_FORCEINLINE SIMDVectorF4 TransformNormalVector3(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat);
+		KLAYGE_FORCEINLINE SIMDVectorF4 TransformQuat(SIMDVectorF4 const & v, SIMDVectorF4 const & quat);
 		SIMDVectorF4 Project(SIMDVectorF4 const & vec,
 			SIMDMatrixF4 const & world, SIMDMatrixF4 const & view, SIMDMatrixF4 const & proj,
 			int const viewport[4], float near_plane, float far_plane);
@@ -135,20 +148,20 @@ namespace KlayGE
 		// 4D Vector
 		///////////////////////////////////////////////////////////////////////////////
 		SIMDVectorF4 CrossVector4(SIMDVectorF4 const & v1, SIMDVectorF4 const & v2, SIMDVectorF4 const & v3);
-		SIMDVectorF4 DotVector4(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 LengthSqVector4(SIMDVectorF4 const & rhs);
-		SIMDVectorF4 LengthVector4(SIMDVectorF4 const & rhs);
-		SIMDVectorF4 NormalizeVector4(SIMDVectorF4 const & rhs);
-		SIMDVectorF4 TransformVector4(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat);
+		KLAYGE_FORCEINLINE SIMDVectorF4 DotVector4(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 LengthSqVector4(SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 LengthVector4(SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 NormalizeVector4(SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 TransformVector4(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat);
 
 		// 4D Matrix
 		///////////////////////////////////////////////////////////////////////////////
-		SIMDMatrixF4 Add(SIMDMatrixF4 const & lhs, SIMDMatrixF4 const & rhs);
-		SIMDMatrixF4 Substract(SIMDMatrixF4 const & lhs, SIMDMatrixF4 const & rhs);
-		SIMDMatrixF4 Multiply(SIMDMatrixF4 const & lhs, SIMDMatrixF4 const & rhs);
-		SIMDMatrixF4 Multiply(SIMDMatrixF4 const & lhs, float rhs);
+		KLAYGE_FORCEINLINE SIMDMatrixF4 Add(SIMDMatrixF4 const & lhs, SIMDMatrixF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDMatrixF4 Substract(SIMDMatrixF4 const & lhs, SIMDMatrixF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDMatrixF4 Multiply(SIMDMatrixF4 const & lhs, SIMDMatrixF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDMatrixF4 Multiply(SIMDMatrixF4 const & lhs, float rhs);
 		SIMDVectorF4 Determinant(SIMDMatrixF4 const & rhs);
-		SIMDMatrixF4 Negative(SIMDMatrixF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDMatrixF4 Negative(SIMDMatrixF4 const & rhs);
 		SIMDMatrixF4 Inverse(SIMDMatrixF4 const & rhs);
 
 		SIMDMatrixF4 LookAtLH(SIMDVectorF4 const & eye, SIMDVectorF4 const & at);
@@ -191,7 +204,7 @@ namespace KlayGE
 		SIMDMatrixF4 Translation(float x, float y, float z);
 		SIMDMatrixF4 Translation(SIMDVectorF4 const & pos);
 
-		SIMDMatrixF4 Transpose(SIMDMatrixF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDMatrixF4 Transpose(SIMDMatrixF4 const & rhs);
 
 		SIMDMatrixF4 LHToRH(SIMDMatrixF4 const & rhs);
 		SIMDMatrixF4 RHToLH(SIMDMatrixF4 const & rhs);
@@ -202,7 +215,7 @@ namespace KlayGE
 
 		// Quaternion
 		///////////////////////////////////////////////////////////////////////////////
-		SIMDVectorF4 Conjugate(SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 Conjugate(SIMDVectorF4 const & rhs);
 
 		SIMDVectorF4 AxisToAxis(SIMDVectorF4 const & from, SIMDVectorF4 const & to);
 		SIMDVectorF4 UnitAxisToUnitAxis(SIMDVectorF4 const & from, SIMDVectorF4 const & to);
@@ -215,7 +228,7 @@ namespace KlayGE
 
 		SIMDVectorF4 Inverse(SIMDVectorF4 const & rhs);
 
-		SIMDVectorF4 MultiplyQuat(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 MultiplyQuat(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
 
 		SIMDVectorF4 RotationAxis(SIMDVectorF4 const & v, float angle);
 		SIMDVectorF4 RotationQuatYawPitchRoll(float yaw, float pitch, float roll);
@@ -236,9 +249,9 @@ namespace KlayGE
 
 		// Plane
 		///////////////////////////////////////////////////////////////////////////////
-		SIMDVectorF4 DotPlane(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 DotCoord(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
-		SIMDVectorF4 DotNormal(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 DotPlane(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 DotCoord(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 DotNormal(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
 
 		SIMDVectorF4 FromPointNormal(SIMDVectorF4 const & point, SIMDVectorF4 const & normal);
 		SIMDVectorF4 FromPoints(SIMDVectorF4 const & v0, SIMDVectorF4 const & v1, SIMDVectorF4 const & v2);
@@ -255,11 +268,12 @@ namespace KlayGE
 		// Color
 		///////////////////////////////////////////////////////////////////////////////
 		SIMDVectorF4 NegativeColor(SIMDVectorF4 const & rhs);
-		SIMDVectorF4 ModulateColor(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 ModulateColor(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
 	}
 }
 
 #include <KFL/SIMDVector.hpp>
 #include <KFL/SIMDMatrix.hpp>
+#include <KFL/Detail/SIMDMathInline.hpp>
 
 #endif		// _KFL_SIMDMATH_HPP
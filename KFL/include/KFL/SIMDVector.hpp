@@ -33,12 +33,15 @@
 
 #pragma once
 
+#include <array>
 #include <boost/operators.hpp>
 
 namespace KlayGE
 {
 #if defined(SIMD_MATH_SSE)
 	typedef __m128 V4TYPE;
+#elif defined(SIMD_MATH_NEON)
+	typedef float32x4_t V4TYPE;
 #else
 	typedef std::array<float, 4> V4TYPE;
 #endif
@@ -56,14 +59,21 @@ namespace KlayGE
 		SIMDVectorF4()
 		{
 		}
-		SIMDVectorF4(SIMDVectorF4 const & rhs);
+		SIMDVectorF4(SIMDVectorF4 const & rhs)
+			: vec_(rhs.vec_)
+		{
+		}
 
 		static size_t size()
 		{
 			return 4;
 		}
 
-		static SIMDVectorF4 const & Zero();
+		static SIMDVectorF4 const & Zero()
+		{
+			static SIMDVectorF4 const zero = SIMDMathLib::SetVector(0.0f);
+			return zero;
+		}
 
 		V4TYPE& Vec()
 		{
@@ -74,21 +84,65 @@ namespace KlayGE
 			return vec_;
 		}
 
-		SIMDVectorF4 const & operator+=(SIMDVectorF4 const & rhs);
-		SIMDVectorF4 const & operator+=(float rhs);
-		SIMDVectorF4 const & operator-=(SIMDVectorF4 const & rhs);
-		SIMDVectorF4 const & operator-=(float rhs);
-		SIMDVectorF4 const & operator*=(SIMDVectorF4 const & rhs);
-		SIMDVectorF4 const & operator*=(float rhs);
-		SIMDVectorF4 const & operator/=(SIMDVectorF4 const & rhs);
-		SIMDVectorF4 const & operator/=(float rhs);
+		KLAYGE_FORCEINLINE SIMDVectorF4 const & operator+=(SIMDVectorF4 const & rhs)
+		{
+			*this = SIMDMathLib::Add(*this, rhs);
+			return *this;
+		}
+		KLAYGE_FORCEINLINE SIMDVectorF4 const & operator+=(float rhs)
+		{
+			*this = SIMDMathLib::Add(*this, SIMDMathLib::SetVector(rhs));
+			return *this;
+		}
+		KLAYGE_FORCEINLINE SIMDVectorF4 const & operator-=(SIMDVectorF4 const & rhs)
+		{
+			*this = SIMDMathLib::Substract(*this, rhs);
+			return *this;
+		}
+		KLAYGE_FORCEINLINE SIMDVectorF4 const & operator-=(float rhs)
+		{
+			*this = SIMDMathLib::Substract(*this, SIMDMathLib::SetVector(rhs));
+			return *this;
+		}
+		KLAYGE_FORCEINLINE SIMDVectorF4 const & operator*=(SIMDVectorF4 const & rhs)
+		{
+			*this = SIMDMathLib::Multiply(*this, rhs);
+			return *this;
+		}
+		KLAYGE_FORCEINLINE SIMDVectorF4 const & operator*=(float rhs)
+		{
+			*this = SIMDMathLib::Multiply(*this, SIMDMathLib::SetVector(rhs));
+			return *this;
+		}
+		KLAYGE_FORCEINLINE SIMDVectorF4 const & operator/=(SIMDVectorF4 const & rhs)
+		{
+			*this = SIMDMathLib::Divide(*this, rhs);
+			return *this;
+		}
+		KLAYGE_FORCEINLINE SIMDVectorF4 const & operator/=(float rhs)
+		{
+			return this->operator*=(1.0f / rhs);
+		}
 
-		SIMDVectorF4& operator=(SIMDVectorF4 const & rhs);
+		SIMDVectorF4& operator=(SIMDVectorF4 const & rhs)
+		{
+			vec_ = rhs.vec_;
+			return *this;
+		}
 
-		SIMDVectorF4 const operator+() const;
-		SIMDVectorF4 const operator-() const;
+		SIMDVectorF4 const operator+() const
+		{
+			return *this;
+		}
+		KLAYGE_FORCEINLINE SIMDVectorF4 const operator-() const
+		{
+			return SIMDMathLib::Negative(*this);
+		}
 
-		void swap(SIMDVectorF4& rhs);
+		void swap(SIMDVectorF4& rhs)
+		{
+			std::swap(vec_, rhs.vec_);
+		}
 
 	private:
 		V4TYPE vec_{};
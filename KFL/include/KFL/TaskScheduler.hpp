@@ -0,0 +1,147 @@
+/**
+ * @file TaskScheduler.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KFL_TASK_SCHEDULER_HPP
+#define _KFL_TASK_SCHEDULER_HPP
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <KFL/CXX2a/span.hpp>
+
+namespace KlayGE
+{
+	class TaskScheduler;
+
+	// A unit of work. Tasks are cheap to create and meant to be small, the scheduler runs them on a fixed set of
+	//  worker threads. A task can depend on other tasks, it's scheduled once all of them are finished. An exception
+	//  thrown by a task finishes it, and is rethrown by Wait. Its dependents still run.
+	class Task final : boost::noncopyable
+	{
+		friend class TaskScheduler;
+
+	public:
+		explicit Task(std::function<void()> func);
+
+		bool Finished() const
+		{
+			return finished_.load(std::memory_order_acquire);
+		}
+
+	private:
+		std::function<void()> func_;
+
+		// Number of unfinished dependencies, plus 1 held until the task is submitted
+		std::atomic<uint32_t> num_pending_deps_;
+		std::atomic<bool> finished_;
+		std::exception_ptr exception_;
+
+		std::mutex dependents_mutex_;
+		std::vector<std::shared_ptr<Task>> dependents_;
+	};
+
+	typedef std::shared_ptr<Task> TaskPtr;
+
+	// Work-stealing scheduler. Each worker owns a deque, it pushes and pops at the back, and steals from the front of
+	//  the others' when it runs dry. Tasks submitted from outside the workers go to a shared injection queue.
+	//  Waiting on a task from any thread executes queued tasks until it's done, so nested waits don't deadlock, and
+	//  sleeps when there are none. The tasks run by a waiting thread can be unrelated to the awaited ones. So never
+	//  wait while holding a lock that any task may take, or the waiting thread can deadlock on itself.
+	class TaskScheduler final : boost::noncopyable
+	{
+	public:
+		// 0 means one worker per hardware thread, minus one for the thread that submits and waits.
+		explicit TaskScheduler(uint32_t num_workers = 0);
+		~TaskScheduler();
+
+		uint32_t NumWorkers() const
+		{
+			return static_cast<uint32_t>(workers_.size());
+		}
+
+		TaskPtr Submit(std::function<void()> func);
+		TaskPtr Submit(std::function<void()> func, std::span<TaskPtr const> dependencies);
+
+		// Rethrows the exception of a failed task. With several tasks, all of them are waited on before the first
+		//  exception is rethrown.
+		void Wait(TaskPtr const & task);
+		void Wait(std::span<TaskPtr const> tasks);
+
+		// Calls func(sub_begin, sub_end) over [begin, end) split into chunks of at most grain_size, and waits for all of
+		//  them. 0 grain_size picks a size that gives each worker a few chunks to balance with. The waiting rule of the
+		//  class applies, and an exception from any chunk is rethrown after all chunks are done.
+		void ParallelFor(uint32_t begin, uint32_t end, uint32_t grain_size,
+			std::function<void(uint32_t sub_begin, uint32_t sub_end)> const & func);
+
+	private:
+		struct Worker
+		{
+			std::mutex mutex;
+			std::deque<TaskPtr> tasks;
+			std::thread thread;
+		};
+
+		void Schedule(TaskPtr const & task);
+		void Execute(TaskPtr const & task);
+		TaskPtr FetchTask(uint32_t worker_index);
+		bool RunOneTask();
+		void WakeWaiters();
+		void WorkerFunc(uint32_t index);
+
+	private:
+		std::vector<std::unique_ptr<Worker>> workers_;
+
+		std::mutex injection_mutex_;
+		std::deque<TaskPtr> injection_tasks_;
+
+		std::mutex sleep_mutex_;
+		std::condition_variable sleep_cv_;
+		std::atomic<int32_t> num_queued_tasks_;
+		bool quit_;
+
+		// Threads in Wait sleep here while nothing is queued, until a task finishes or gets queued
+		std::mutex wait_mutex_;
+		std::condition_variable wait_cv_;
+		std::atomic<uint32_t> num_waiters_;
+	};
+}
+
+#endif		// _KFL_TASK_SCHEDULER_HPP
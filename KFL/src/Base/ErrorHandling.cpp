@@ -54,6 +54,7 @@ namespace KlayGE
 	{
 		if (!x)
 		{
+			LogFlush();
 			TERRC(std::errc::function_not_supported);
 		}
 	}
@@ -74,6 +75,7 @@ namespace KlayGE
 			LogError() << "UNREACHABLE executed." << std::endl;
 		}
 
+		LogFlush();
 		TMSG("Unreachable.");
 	}
 #endif
@@ -29,171 +29,679 @@
  */
 
 #include <KFL/KFL.hpp>
-#include <KFL/CXX2a/span.hpp>
-#include <KFL/CustomizedStreamBuf.hpp>
 
-#include <cstdarg>
-#include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
 
 #ifdef KLAYGE_PLATFORM_ANDROID
 #include <android/log.h>
-#include <cstring>
 #else
 #include <fstream>
 #endif
 
+#include <KFL/ErrorHandling.hpp>
 #include <KFL/Log.hpp>
 
 namespace
 {
 	using namespace KlayGE;
 
-#ifdef KLAYGE_PLATFORM_ANDROID
-	class AndroidLogStreamCallback : boost::noncopyable
+	struct LogRecord
+	{
+		uint64_t timestamp;
+		uint64_t thread_id;
+		LogSeverity severity;
+		// Taken when the record is completed, so a change of format only affects the records after it
+		LogFormat format;
+		std::string category;
+		std::string message;
+	};
+
+	// Bounded queue for many producers and one consumer, after Dmitry Vyukov's. The sequence number in each slot tells
+	//  whose turn the slot is, so a push is a CAS on the tail and a store, and producers never wait for each other.
+	class LogQueue : boost::noncopyable
 	{
 	public:
-		explicit AndroidLogStreamCallback(int prio)
-			: prio_(prio)
+		static uint32_t constexpr CAPACITY = 1024;
+
+		LogQueue()
+			: slots_(MakeUniquePtr<Slot[]>(CAPACITY)), tail_(0), head_(0)
 		{
+			for (uint32_t i = 0; i < CAPACITY; ++ i)
+			{
+				slots_[i].seq.store(i, std::memory_order_relaxed);
+			}
 		}
-		AndroidLogStreamCallback(AndroidLogStreamCallback&& rhs)
-			: prio_(rhs.prio_)
+
+		// Moves from record only if there is room
+		bool TryPush(LogRecord& record)
 		{
+			uint64_t pos = tail_.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				Slot& slot = slots_[pos & (CAPACITY - 1)];
+				int64_t const diff = static_cast<int64_t>(slot.seq.load(std::memory_order_acquire) - pos);
+				if (diff == 0)
+				{
+					if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					{
+						slot.record = std::move(record);
+						slot.seq.store(pos + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (diff < 0)
+				{
+					return false;
+				}
+				else
+				{
+					pos = tail_.load(std::memory_order_relaxed);
+				}
+			}
 		}
 
-		std::streambuf::int_type operator()(void const * buff, std::streamsize count)
+		// Consumer only
+		bool TryPop(LogRecord& record)
 		{
-			auto tmp = MakeUniquePtr<char[]>(count + 1);
-			std::memcpy(tmp.get(), buff, count);
-			tmp[count] = 0;
-			__android_log_write(prio_, "KlayGE", tmp.get());
-			return static_cast<std::streambuf::int_type>(count);
+			Slot& slot = slots_[head_ & (CAPACITY - 1)];
+			if (slot.seq.load(std::memory_order_acquire) != head_ + 1)
+			{
+				return false;
+			}
+
+			record = std::move(slot.record);
+			slot.seq.store(head_ + CAPACITY, std::memory_order_release);
+			++ head_;
+			return true;
+		}
+
+		// Consumer only
+		bool Empty() const
+		{
+			return slots_[head_ & (CAPACITY - 1)].seq.load(std::memory_order_acquire) != head_ + 1;
+		}
+
+		// Records pushed or being pushed so far
+		uint64_t NumClaimed() const
+		{
+			return tail_.load(std::memory_order_acquire);
 		}
 
 	private:
-		int prio_;
+		struct Slot
+		{
+			std::atomic<uint64_t> seq;
+			LogRecord record;
+		};
+
+		std::unique_ptr<Slot[]> slots_;
+		alignas(64) std::atomic<uint64_t> tail_;
+		alignas(64) uint64_t head_;
 	};
 
-	template <int PRIO>
-	std::ostream& AndroidLog()
+	char const * SeverityName(LogSeverity severity, bool upper_case)
 	{
-		static CallbackOutputStreamBuf<AndroidLogStreamCallback> log_stream_buff((AndroidLogStreamCallback(PRIO)));
-		static std::ostream log_stream(&log_stream_buff);
-		return log_stream;
+		static char const * const upper_names[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+		static char const * const lower_names[] = { "debug", "info", "warn", "error" };
+		uint32_t const index = static_cast<uint32_t>(severity);
+		return upper_case ? upper_names[index] : lower_names[index];
 	}
-#else
-	class MultiOStreamsCallback : boost::noncopyable
+
+	void AppendJsonString(std::string& out, std::string_view str)
 	{
-	public:
-		explicit MultiOStreamsCallback(std::span<std::ostream*> oss)
-			: oss_(oss)
+		static char const hex_digits[] = "0123456789abcdef";
+
+		out += '"';
+		for (char const ch : str)
 		{
+			switch (ch)
+			{
+			case '"':
+				out += "\\\"";
+				break;
+
+			case '\\':
+				out += "\\\\";
+				break;
+
+			case '\n':
+				out += "\\n";
+				break;
+
+			case '\r':
+				out += "\\r";
+				break;
+
+			case '\t':
+				out += "\\t";
+				break;
+
+			default:
+				if (static_cast<uint8_t>(ch) < 0x20)
+				{
+					out += "\\u00";
+					out += hex_digits[static_cast<uint8_t>(ch) >> 4];
+					out += hex_digits[static_cast<uint8_t>(ch) & 0xF];
+				}
+				else
+				{
+					out += ch;
+				}
+				break;
+			}
 		}
-		MultiOStreamsCallback(MultiOStreamsCallback&& rhs) noexcept
-			: oss_(std::move(rhs.oss_))
+		out += '"';
+	}
+
+	template <typename T>
+	void AppendLittleEndian(std::string& out, T value)
+	{
+		for (uint32_t i = 0; i < sizeof(T); ++ i)
 		{
+			out += static_cast<char>(static_cast<uint64_t>(value) >> (i * 8));
 		}
+	}
 
-		std::streambuf::int_type operator()(void const * buff, std::streamsize count)
+	void FormatRecord(std::string& out, LogRecord const & record, LogFormat format)
+	{
+		std::string_view message = record.message;
+		if (format != LogFormat::Binary)
 		{
-			for (auto& os : oss_)
+			if (!message.empty() && (message.back() == '\n'))
 			{
-				os->write(static_cast<char const *>(buff), count);
+				message.remove_suffix(1);
 			}
-			return static_cast<std::streambuf::int_type>(count);
 		}
 
-	private:
-		std::span<std::ostream*> oss_;
-	};
+		switch (format)
+		{
+		case LogFormat::Text:
+#ifndef KLAYGE_PLATFORM_ANDROID
+			// Logcat has its own tag and priority columns
+			out += '(';
+			out += SeverityName(record.severity, true);
+			out += ") KlayGE";
+			if (!record.category.empty())
+			{
+				out += '/';
+				out += record.category;
+			}
+			out += ": ";
+#endif
+			out += message;
+			out += '\n';
+			break;
+
+		case LogFormat::JsonLines:
+			out += "{\"ts\":";
+			out += std::to_string(record.timestamp);
+			out += ",\"thread\":";
+			out += std::to_string(record.thread_id);
+			out += ",\"severity\":\"";
+			out += SeverityName(record.severity, false);
+			out += "\",\"category\":";
+			AppendJsonString(out, record.category);
+			out += ",\"msg\":";
+			AppendJsonString(out, message);
+			out += "}\n";
+			break;
+
+		case LogFormat::Binary:
+			AppendLittleEndian(out, record.timestamp);
+			AppendLittleEndian(out, record.thread_id);
+			AppendLittleEndian(out, static_cast<uint8_t>(record.severity));
+			AppendLittleEndian(out, static_cast<uint8_t>(0));
+			AppendLittleEndian(out, static_cast<uint16_t>(std::min<size_t>(record.category.size(), 0xFFFF)));
+			AppendLittleEndian(out, static_cast<uint32_t>(message.size()));
+			out.append(record.category, 0, 0xFFFF);
+			out += message;
+			break;
+
+		default:
+			KFL_UNREACHABLE("Invalid log format");
+		}
+	}
 
-	std::ostream& Log()
+	std::atomic<bool> logger_alive(false);
+
+	class Logger : boost::noncopyable
 	{
+	public:
+		static Logger& Instance()
+		{
+			static Logger logger;
+			return logger;
+		}
+
+		Logger()
+			: min_severity_(
+#ifdef KLAYGE_DEBUG
+					LogSeverity::Debug
+#else
+					LogSeverity::Info
+#endif
+				),
+				disabled_categories_(nullptr), format_(LogFormat::Text), num_written_(0), num_flushers_(0),
+				writer_sleeping_(false), quit_(false)
+		{
+#ifndef KLAYGE_PLATFORM_ANDROID
 #ifdef KLAYGE_DEBUG
-		static std::ofstream log_file("KlayGE.log");
+			log_file_.open("KlayGE.log", std::ios_base::binary);
+			oss_.push_back(&log_file_);
 #endif
+			oss_.push_back(&std::clog);
+#endif
+
+			writer_ = std::thread([this] { this->WriterFunc(); });
+			logger_alive.store(true, std::memory_order_release);
+		}
+
+		~Logger()
+		{
+			logger_alive.store(false, std::memory_order_release);
+
+			{
+				std::lock_guard<std::mutex> lock(sleep_mutex_);
+				quit_ = true;
+			}
+			sleep_cv_.notify_one();
+			writer_.join();
+		}
+
+		bool Enabled(LogSeverity severity, std::string_view category) const
+		{
+			if (severity < min_severity_.load(std::memory_order_relaxed))
+			{
+				return false;
+			}
+
+			if (!category.empty())
+			{
+				CategorySet const * disabled = disabled_categories_.load(std::memory_order_acquire);
+				if (disabled != nullptr)
+				{
+					return std::find(disabled->begin(), disabled->end(), category) == disabled->end();
+				}
+			}
+
+			return true;
+		}
+
+		void MinSeverity(LogSeverity severity)
+		{
+			min_severity_.store(severity, std::memory_order_relaxed);
+		}
+
+		void CategoryEnabled(std::string_view category, bool enabled)
+		{
+			std::lock_guard<std::mutex> lock(categories_mutex_);
+
+			CategorySet disabled;
+			if (CategorySet const * current = disabled_categories_.load(std::memory_order_relaxed))
+			{
+				disabled = *current;
+			}
+
+			auto iter = std::find(disabled.begin(), disabled.end(), category);
+			if (enabled)
+			{
+				if (iter == disabled.end())
+				{
+					return;
+				}
+				disabled.erase(iter);
+			}
+			else
+			{
+				if (iter != disabled.end())
+				{
+					return;
+				}
+				disabled.emplace_back(category);
+			}
+
+			if (disabled.empty())
+			{
+				disabled_categories_.store(nullptr, std::memory_order_release);
+			}
+			else
+			{
+				category_sets_.push_back(MakeUniquePtr<CategorySet>(std::move(disabled)));
+				disabled_categories_.store(category_sets_.back().get(), std::memory_order_release);
+			}
+		}
+
+		void OutputFormat(LogFormat format)
+		{
+			format_.store(format, std::memory_order_relaxed);
+		}
+
+		LogFormat OutputFormat() const
+		{
+			return format_.load(std::memory_order_relaxed);
+		}
+
+		void Submit(LogRecord& record)
+		{
+			while (!queue_.TryPush(record))
+			{
+				// Full. Waits for the writer rather than losing records.
+				sleep_cv_.notify_one();
+				std::this_thread::yield();
+			}
+
+			// A wake-up that slips between the writer's last check and its wait only costs the wait's timeout
+			if (writer_sleeping_.load(std::memory_order_relaxed))
+			{
+				sleep_cv_.notify_one();
+			}
+		}
+
+		void Flush()
+		{
+			if (std::this_thread::get_id() == writer_.get_id())
+			{
+				// From inside the writer, e.g. an error while formatting. Waiting on itself would never return.
+				return;
+			}
 
-		static std::ostream* oss[] =
+			uint64_t const target = queue_.NumClaimed();
+
+			++ num_flushers_;
+			std::unique_lock<std::mutex> lock(sleep_mutex_);
+			sleep_cv_.notify_one();
+			flushed_cv_.wait(lock, [this, target] { return num_written_.load() >= target; });
+			-- num_flushers_;
+		}
+
+	private:
+		void WriterFunc()
 		{
+			for (;;)
+			{
+				this->Drain();
+
+				std::unique_lock<std::mutex> lock(sleep_mutex_);
+				if (quit_)
+				{
+					lock.unlock();
+					this->Drain();
+					break;
+				}
+
+				writer_sleeping_.store(true, std::memory_order_relaxed);
+				if (queue_.Empty())
+				{
+					sleep_cv_.wait_for(lock, std::chrono::milliseconds(10));
+				}
+				writer_sleeping_.store(false, std::memory_order_relaxed);
+			}
+		}
+
+		void Drain()
+		{
+			uint64_t num_written = num_written_.load(std::memory_order_relaxed);
+			bool any = false;
+			LogRecord record;
+			while (queue_.TryPop(record))
+			{
+				line_.clear();
+				FormatRecord(line_, record, record.format);
+
+#ifdef KLAYGE_PLATFORM_ANDROID
+				static int const prios[] = { ANDROID_LOG_DEBUG, ANDROID_LOG_INFO, ANDROID_LOG_WARN, ANDROID_LOG_ERROR };
+				__android_log_write(prios[static_cast<uint32_t>(record.severity)], "KlayGE", line_.c_str());
+#else
+				for (auto& os : oss_)
+				{
+					os->write(line_.data(), line_.size());
+				}
+#endif
+
+				++ num_written;
+				any = true;
+			}
+
+			if (any)
+			{
+#ifndef KLAYGE_PLATFORM_ANDROID
+				for (auto& os : oss_)
+				{
+					os->flush();
+				}
+#endif
+				num_written_.store(num_written);
+				if (num_flushers_.load() > 0)
+				{
+					// Both sides are seq_cst, so either the flusher sees the new count or it is counted here
+					std::lock_guard<std::mutex> lock(sleep_mutex_);
+					flushed_cv_.notify_all();
+				}
+			}
+		}
+
+	private:
+		typedef std::vector<std::string> CategorySet;
+
+		std::atomic<LogSeverity> min_severity_;
+
+		// Readers only load the pointer. A change makes a new set and swaps it in, and the old ones are kept until the
+		//  logger goes away, because a reader may still be looking at them. Changes are rare, so that's little memory.
+		std::mutex categories_mutex_;
+		std::vector<std::unique_ptr<CategorySet const>> category_sets_;
+		std::atomic<CategorySet const *> disabled_categories_;
+
+		std::atomic<LogFormat> format_;
+
+		LogQueue queue_;
+		std::atomic<uint64_t> num_written_;
+		std::atomic<uint32_t> num_flushers_;
+
+		std::mutex sleep_mutex_;
+		std::condition_variable sleep_cv_;
+		std::condition_variable flushed_cv_;
+		std::atomic<bool> writer_sleeping_;
+		bool quit_;
+
+		// Writer thread only
+		std::string line_;
+#ifndef KLAYGE_PLATFORM_ANDROID
 #ifdef KLAYGE_DEBUG
-			&log_file,
+		std::ofstream log_file_;
 #endif
-			&std::clog
-		};
-		static CallbackOutputStreamBuf<MultiOStreamsCallback> log_stream_buff((MultiOStreamsCallback(oss)));
-		static std::ostream log_stream(&log_stream_buff);
-		return log_stream;
-	}
+		std::vector<std::ostream*> oss_;
 #endif
 
-#ifndef KLAYGE_DEBUG
-	class EmptyOStreamsCallback : boost::noncopyable
+		std::thread writer_;
+	};
+
+	// Collects one thread's text for a severity. The text becomes a record when the stream is flushed, which std::endl
+	//  does.
+	class StagingStreamBuf : public std::streambuf, boost::noncopyable
 	{
 	public:
-		EmptyOStreamsCallback()
+		explicit StagingStreamBuf(LogSeverity severity)
+			: severity_(severity)
+		{
+		}
+
+		~StagingStreamBuf() override
+		{
+			this->Commit();
+		}
+
+		void Category(std::string_view category)
+		{
+			if (category != category_)
+			{
+				this->Commit();
+				category_.assign(category.begin(), category.end());
+			}
+		}
+
+	protected:
+		std::streamsize xsputn(char_type const * s, std::streamsize count) override
+		{
+			message_.append(s, static_cast<size_t>(count));
+			return count;
+		}
+
+		int_type overflow(int_type ch = traits_type::eof()) override
+		{
+			if (!traits_type::eq_int_type(ch, traits_type::eof()))
+			{
+				message_ += traits_type::to_char_type(ch);
+			}
+			return traits_type::not_eof(ch);
+		}
+
+		int sync() override
 		{
+			this->Commit();
+			return 0;
 		}
-		EmptyOStreamsCallback(EmptyOStreamsCallback&& rhs) noexcept
+
+	private:
+		void Commit()
 		{
-			KFL_UNUSED(rhs);
+			if (message_.empty())
+			{
+				return;
+			}
+
+			if (logger_alive.load(std::memory_order_acquire))
+			{
+				LogRecord record;
+				record.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::system_clock::now().time_since_epoch()).count();
+				record.thread_id = std::hash<std::thread::id>()(std::this_thread::get_id());
+				record.severity = severity_;
+				record.format = Logger::Instance().OutputFormat();
+				record.category = category_;
+				record.message = std::move(message_);
+				Logger::Instance().Submit(record);
+
+				if (severity_ == LogSeverity::Error)
+				{
+					// An error is often followed by a throw or a crash, so it's written out before the caller goes on
+					Logger::Instance().Flush();
+				}
+			}
+			message_.clear();
 		}
 
-		std::streambuf::int_type operator()(void const * buff, std::streamsize count)
+	private:
+		LogSeverity const severity_;
+		std::string category_;
+		std::string message_;
+	};
+
+	struct ThreadLogStream
+	{
+		explicit ThreadLogStream(LogSeverity severity)
+			: buff(severity), stream(&buff)
 		{
-			KFL_UNUSED(buff);
-			return static_cast<std::streambuf::int_type>(count);
 		}
+
+		StagingStreamBuf buff;
+		std::ostream stream;
 	};
 
-	std::ostream& EmptyLog()
+	std::ostream& Log(LogSeverity severity, std::string_view category)
 	{
-		static CallbackOutputStreamBuf<EmptyOStreamsCallback> empty_stream_buff((EmptyOStreamsCallback()));
-		static std::ostream empty_stream(&empty_stream_buff);
-		return empty_stream;
+		if (!Logger::Instance().Enabled(severity, category))
+		{
+			thread_local std::ostream null_stream(nullptr);
+			return null_stream;
+		}
+
+		thread_local ThreadLogStream streams[] =
+		{
+			ThreadLogStream(LogSeverity::Debug),
+			ThreadLogStream(LogSeverity::Info),
+			ThreadLogStream(LogSeverity::Warn),
+			ThreadLogStream(LogSeverity::Error)
+		};
+		auto& stream = streams[static_cast<uint32_t>(severity)];
+		stream.buff.Category(category);
+		return stream.stream;
 	}
-#endif
 }
 
 namespace KlayGE
 {
 	std::ostream& LogDebug()
 	{
-#ifdef KLAYGE_DEBUG
-#ifdef KLAYGE_PLATFORM_ANDROID
-		return AndroidLog<ANDROID_LOG_DEBUG>();
-#else
-		return Log() << "(DEBUG) KlayGE: ";
-#endif
-#else
-		return EmptyLog();
-#endif
+		return Log(LogSeverity::Debug, std::string_view());
 	}
 
 	std::ostream& LogInfo()
 	{
-#ifdef KLAYGE_PLATFORM_ANDROID
-		return AndroidLog<ANDROID_LOG_INFO>();
-#else
-		return Log() << "(INFO) KlayGE: ";
-#endif
+		return Log(LogSeverity::Info, std::string_view());
 	}
 
 	std::ostream& LogWarn()
 	{
-#ifdef KLAYGE_PLATFORM_ANDROID
-		return AndroidLog<ANDROID_LOG_WARN>();
-#else
-		return Log() << "(WARN) KlayGE: ";
-#endif
+		return Log(LogSeverity::Warn, std::string_view());
 	}
 
 	std::ostream& LogError()
 	{
-#ifdef KLAYGE_PLATFORM_ANDROID
-		return AndroidLog<ANDROID_LOG_ERROR>();
-#else
-		return Log() << "(ERROR) KlayGE: ";
-#endif
+		return Log(LogSeverity::Error, std::string_view());
+	}
+
+	std::ostream& LogDebug(std::string_view category)
+	{
+		return Log(LogSeverity::Debug, category);
+	}
+
+	std::ostream& LogInfo(std::string_view category)
+	{
+		return Log(LogSeverity::Info, category);
+	}
+
+	std::ostream& LogWarn(std::string_view category)
+	{
+		return Log(LogSeverity::Warn, category);
+	}
+
+	std::ostream& LogError(std::string_view category)
+	{
+		return Log(LogSeverity::Error, category);
+	}
+
+	void LogMinSeverity(LogSeverity severity)
+	{
+		Logger::Instance().MinSeverity(severity);
+	}
+
+	void LogCategoryEnabled(std::string_view category, bool enabled)
+	{
+		Logger::Instance().CategoryEnabled(category, enabled);
+	}
+
+	void LogOutputFormat(LogFormat format)
+	{
+		Logger::Instance().OutputFormat(format);
+	}
+
+	void LogFlush()
+	{
+		if (logger_alive.load(std::memory_order_acquire))
+		{
+			Logger::Instance().Flush();
+		}
 	}
 }
@@ -0,0 +1,363 @@
+/**
+ * @file TaskScheduler.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KFL/KFL.hpp>
+
+#include <algorithm>
+
+#include <KFL/TaskScheduler.hpp>
+
+namespace
+{
+	// Which scheduler and worker the current thread belongs to, if any
+	thread_local KlayGE::TaskScheduler const * tls_scheduler = nullptr;
+	thread_local uint32_t tls_worker_index = 0;
+}
+
+namespace KlayGE
+{
+	Task::Task(std::function<void()> func)
+		: func_(std::move(func)), num_pending_deps_(1), finished_(false)
+	{
+	}
+
+
+	TaskScheduler::TaskScheduler(uint32_t num_workers)
+		: num_queued_tasks_(0), quit_(false), num_waiters_(0)
+	{
+		if (num_workers == 0)
+		{
+			num_workers = std::max(std::thread::hardware_concurrency(), 2U) - 1;
+		}
+
+		workers_.resize(num_workers);
+		for (auto& worker : workers_)
+		{
+			worker = MakeUniquePtr<Worker>();
+		}
+		for (uint32_t i = 0; i < num_workers; ++ i)
+		{
+			workers_[i]->thread = std::thread([this, i] { this->WorkerFunc(i); });
+		}
+	}
+
+	TaskScheduler::~TaskScheduler()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex_);
+			quit_ = true;
+		}
+		sleep_cv_.notify_all();
+
+		for (auto& worker : workers_)
+		{
+			worker->thread.join();
+		}
+	}
+
+	TaskPtr TaskScheduler::Submit(std::function<void()> func)
+	{
+		return this->Submit(std::move(func), std::span<TaskPtr const>());
+	}
+
+	TaskPtr TaskScheduler::Submit(std::function<void()> func, std::span<TaskPtr const> dependencies)
+	{
+		auto task = MakeSharedPtr<Task>(std::move(func));
+		for (auto const & dep : dependencies)
+		{
+			std::lock_guard<std::mutex> lock(dep->dependents_mutex_);
+			if (!dep->Finished())
+			{
+				task->num_pending_deps_.fetch_add(1, std::memory_order_relaxed);
+				dep->dependents_.push_back(task);
+			}
+		}
+
+		if (task->num_pending_deps_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			this->Schedule(task);
+		}
+
+		return task;
+	}
+
+	void TaskScheduler::Wait(TaskPtr const & task)
+	{
+		while (!task->Finished())
+		{
+			if (!this->RunOneTask())
+			{
+				std::unique_lock<std::mutex> lock(wait_mutex_);
+				num_waiters_.fetch_add(1);
+				wait_cv_.wait(lock, [this, &task] { return task->finished_.load() || (num_queued_tasks_.load() > 0); });
+				num_waiters_.fetch_sub(1);
+			}
+		}
+
+		if (task->exception_)
+		{
+			std::rethrow_exception(task->exception_);
+		}
+	}
+
+	void TaskScheduler::Wait(std::span<TaskPtr const> tasks)
+	{
+		std::exception_ptr exception;
+		for (auto const & task : tasks)
+		{
+			try
+			{
+				this->Wait(task);
+			}
+			catch (...)
+			{
+				if (!exception)
+				{
+					exception = std::current_exception();
+				}
+			}
+		}
+
+		if (exception)
+		{
+			std::rethrow_exception(exception);
+		}
+	}
+
+	void TaskScheduler::ParallelFor(uint32_t begin, uint32_t end, uint32_t grain_size,
+		std::function<void(uint32_t sub_begin, uint32_t sub_end)> const & func)
+	{
+		if (begin >= end)
+		{
+			return;
+		}
+
+		uint32_t const count = end - begin;
+		if (grain_size == 0)
+		{
+			uint32_t const num_chunks = (this->NumWorkers() + 1) * 4;
+			grain_size = std::max((count + num_chunks - 1) / num_chunks, 1U);
+		}
+
+		uint32_t const num_chunks = (count + grain_size - 1) / grain_size;
+		if (num_chunks == 1)
+		{
+			func(begin, end);
+			return;
+		}
+
+		std::vector<TaskPtr> tasks;
+		tasks.reserve(num_chunks - 1);
+		for (uint32_t i = 1; i < num_chunks; ++ i)
+		{
+			uint32_t const sub_begin = begin + i * grain_size;
+			uint32_t const sub_end = std::min(sub_begin + grain_size, end);
+			tasks.push_back(this->Submit([&func, sub_begin, sub_end] { func(sub_begin, sub_end); }));
+		}
+
+		// The calling thread takes the first chunk instead of just blocking. The other chunks reference func, so they
+		//  have to finish even if this one throws.
+		std::exception_ptr exception;
+		try
+		{
+			func(begin, std::min(begin + grain_size, end));
+		}
+		catch (...)
+		{
+			exception = std::current_exception();
+		}
+
+		if (exception)
+		{
+			try
+			{
+				this->Wait(tasks);
+			}
+			catch (...)
+			{
+			}
+			std::rethrow_exception(exception);
+		}
+		this->Wait(tasks);
+	}
+
+	void TaskScheduler::Schedule(TaskPtr const & task)
+	{
+		if (tls_scheduler == this)
+		{
+			auto& worker = *workers_[tls_worker_index];
+			std::lock_guard<std::mutex> lock(worker.mutex);
+			worker.tasks.push_back(task);
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(injection_mutex_);
+			injection_tasks_.push_back(task);
+		}
+
+		num_queued_tasks_.fetch_add(1);
+		{
+			// Pairs with the predicate check in WorkerFunc, so a worker going to sleep can't miss this task
+			std::lock_guard<std::mutex> lock(sleep_mutex_);
+		}
+		sleep_cv_.notify_one();
+
+		this->WakeWaiters();
+	}
+
+	void TaskScheduler::Execute(TaskPtr const & task)
+	{
+		try
+		{
+			task->func_();
+		}
+		catch (...)
+		{
+			task->exception_ = std::current_exception();
+		}
+		task->func_ = nullptr;
+
+		std::vector<TaskPtr> dependents;
+		{
+			std::lock_guard<std::mutex> lock(task->dependents_mutex_);
+			task->finished_.store(true);
+			dependents.swap(task->dependents_);
+		}
+
+		this->WakeWaiters();
+
+		for (auto const & dependent : dependents)
+		{
+			if (dependent->num_pending_deps_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				this->Schedule(dependent);
+			}
+		}
+	}
+
+	TaskPtr TaskScheduler::FetchTask(uint32_t worker_index)
+	{
+		uint32_t const num_workers = this->NumWorkers();
+
+		TaskPtr task;
+		if (worker_index < num_workers)
+		{
+			auto& worker = *workers_[worker_index];
+			std::lock_guard<std::mutex> lock(worker.mutex);
+			if (!worker.tasks.empty())
+			{
+				task = std::move(worker.tasks.back());
+				worker.tasks.pop_back();
+			}
+		}
+
+		if (!task)
+		{
+			std::lock_guard<std::mutex> lock(injection_mutex_);
+			if (!injection_tasks_.empty())
+			{
+				task = std::move(injection_tasks_.front());
+				injection_tasks_.pop_front();
+			}
+		}
+
+		if (!task)
+		{
+			uint32_t const start = (worker_index < num_workers) ? worker_index + 1 : 0;
+			for (uint32_t i = 0; (i < num_workers) && !task; ++ i)
+			{
+				auto& victim = *workers_[(start + i) % num_workers];
+				std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+				if (lock.owns_lock() && !victim.tasks.empty())
+				{
+					task = std::move(victim.tasks.front());
+					victim.tasks.pop_front();
+				}
+			}
+		}
+
+		if (task)
+		{
+			num_queued_tasks_.fetch_sub(1, std::memory_order_relaxed);
+		}
+		return task;
+	}
+
+	bool TaskScheduler::RunOneTask()
+	{
+		uint32_t const worker_index = (tls_scheduler == this) ? tls_worker_index : this->NumWorkers();
+		TaskPtr task = this->FetchTask(worker_index);
+		if (task)
+		{
+			this->Execute(task);
+			return true;
+		}
+		return false;
+	}
+
+	void TaskScheduler::WakeWaiters()
+	{
+		// The sequentially consistent counters and flags make sure either the waiter sees the change, or this sees the
+		//  waiter
+		if (num_waiters_.load() > 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(wait_mutex_);
+			}
+			wait_cv_.notify_all();
+		}
+	}
+
+	void TaskScheduler::WorkerFunc(uint32_t index)
+	{
+		tls_scheduler = this;
+		tls_worker_index = index;
+
+		for (;;)
+		{
+			TaskPtr task = this->FetchTask(index);
+			if (task)
+			{
+				this->Execute(task);
+			}
+			else
+			{
+				std::unique_lock<std::mutex> lock(sleep_mutex_);
+				sleep_cv_.wait(lock, [this] { return quit_ || (num_queued_tasks_.load(std::memory_order_acquire) > 0); });
+				if (quit_)
+				{
+					break;
+				}
+			}
+		}
+
+		tls_scheduler = nullptr;
+	}
+}
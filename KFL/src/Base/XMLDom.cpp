@@ -32,6 +32,7 @@
 #include <KFL/Util.hpp>
 #include <KFL/ResIdentifier.hpp>
 
+#include <cstring>
 #include <string>
 #ifdef KLAYGE_CXX17_LIBRARY_CHARCONV_SUPPORT
 #include <charconv>
@@ -68,12 +69,11 @@ namespace KlayGE
 
 	XMLNodePtr XMLDocument::Parse(ResIdentifier& source)
 	{
-		source.seekg(0, std::ios_base::end);
-		int len = static_cast<int>(source.tellg());
-		source.seekg(0, std::ios_base::beg);
-		xml_src_ = MakeUniquePtr<char[]>(len + 1);
-		source.read(&xml_src_[0], len);
-		xml_src_[len] = 0;
+		// rapidxml parses in place and needs a terminating 0, so it takes one copy straight from the source's data
+		auto const data = source.Data();
+		xml_src_ = MakeUniquePtr<char[]>(data.size() + 1);
+		std::memcpy(&xml_src_[0], data.data(), data.size());
+		xml_src_[data.size()] = 0;
 
 		doc_->parse<0>(xml_src_.get());
 		root_ = MakeSharedPtr<XMLNode>(doc_->first_node());
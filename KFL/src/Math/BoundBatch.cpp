@@ -0,0 +1,371 @@
+/**
+ * @file BoundBatch.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KFL/KFL.hpp>
+
+#include <boost/assert.hpp>
+
+#include <KFL/Detail/SIMDLanes.hpp>
+#include <KFL/BoundBatch.hpp>
+
+#include <cfloat>
+
+namespace
+{
+	using namespace KlayGE;
+	using namespace KlayGE::detail;
+
+	// The kernels do the operations in the same order as the single versions in Math.cpp. The results still only
+	//  match up to rounding, because the compiler may contract either path into FMAs.
+	template <typename L>
+	typename L::Type DotCoord(Plane const & plane, typename L::Type x, typename L::Type y, typename L::Type z) noexcept
+	{
+		return L::Add(L::Add(L::Add(L::Mul(L::Set1(plane.a()), x), L::Mul(L::Set1(plane.b()), y)),
+			L::Mul(L::Set1(plane.c()), z)), L::Set1(plane.d()));
+	}
+
+	void StoreOverlaps(BoundOverlap* out, uint32_t width, uint32_t outside, uint32_t partial) noexcept
+	{
+		for (uint32_t l = 0; l < width; ++ l)
+		{
+			if (outside & (1UL << l))
+			{
+				out[l] = BoundOverlap::No;
+			}
+			else
+			{
+				out[l] = (partial & (1UL << l)) ? BoundOverlap::Partial : BoundOverlap::Yes;
+			}
+		}
+	}
+
+	template <typename L>
+	size_t TransformAABBs(AABBoxBatch& out, AABBoxBatch const & in, float4x4 const & mat, size_t begin) noexcept
+	{
+		typedef typename L::Type V;
+
+		V const m[4][4] =
+		{
+			{ L::Set1(mat(0, 0)), L::Set1(mat(0, 1)), L::Set1(mat(0, 2)), L::Set1(mat(0, 3)) },
+			{ L::Set1(mat(1, 0)), L::Set1(mat(1, 1)), L::Set1(mat(1, 2)), L::Set1(mat(1, 3)) },
+			{ L::Set1(mat(2, 0)), L::Set1(mat(2, 1)), L::Set1(mat(2, 2)), L::Set1(mat(2, 3)) },
+			{ L::Set1(mat(3, 0)), L::Set1(mat(3, 1)), L::Set1(mat(3, 2)), L::Set1(mat(3, 3)) }
+		};
+		V const one = L::Set1(1.0f);
+		V const epsilon = L::Set1(FLT_EPSILON);
+
+		size_t const size = in.size();
+		size_t i = begin;
+		for (; i + L::WIDTH <= size; i += L::WIDTH)
+		{
+			V const src[2][3] =
+			{
+				{ L::Load(&in.min_x[i]), L::Load(&in.min_y[i]), L::Load(&in.min_z[i]) },
+				{ L::Load(&in.max_x[i]), L::Load(&in.max_y[i]), L::Load(&in.max_z[i]) }
+			};
+
+			V min[3];
+			V max[3];
+			for (uint32_t j = 0; j < 8; ++ j)
+			{
+				V const x = src[(j >> 0) & 1][0];
+				V const y = src[(j >> 1) & 1][1];
+				V const z = src[(j >> 2) & 1][2];
+
+				// transform_coord
+				V t[4];
+				for (uint32_t c = 0; c < 4; ++ c)
+				{
+					t[c] = L::Add(L::Add(L::Add(L::Mul(x, m[0][c]), L::Mul(y, m[1][c])), L::Mul(z, m[2][c])), m[3][c]);
+				}
+				V const inv_w = L::Div(one, t[3]);
+				V const abs_w = L::Abs(t[3]);
+				V vec[3];
+				for (uint32_t c = 0; c < 3; ++ c)
+				{
+					vec[c] = L::Select(L::LessEqual(abs_w, epsilon), L::Zero(), L::Mul(t[c], inv_w));
+				}
+
+				if (0 == j)
+				{
+					for (uint32_t c = 0; c < 3; ++ c)
+					{
+						min[c] = max[c] = vec[c];
+					}
+				}
+				else
+				{
+					for (uint32_t c = 0; c < 3; ++ c)
+					{
+						min[c] = L::Min(min[c], vec[c]);
+						max[c] = L::Max(max[c], vec[c]);
+					}
+				}
+			}
+
+			L::Store(&out.min_x[i], min[0]);
+			L::Store(&out.min_y[i], min[1]);
+			L::Store(&out.min_z[i], min[2]);
+			L::Store(&out.max_x[i], max[0]);
+			L::Store(&out.max_y[i], max[1]);
+			L::Store(&out.max_z[i], max[2]);
+		}
+
+		return i;
+	}
+
+	template <typename L>
+	size_t IntersectAABBsPlanes(BoundOverlap* out, AABBoxBatch const & aabbs, std::span<Plane const> planes, size_t first,
+		size_t begin, size_t end) noexcept
+	{
+		typedef typename L::Type V;
+
+		V const zero = L::Zero();
+
+		size_t i = begin;
+		for (; i + L::WIDTH <= end; i += L::WIDTH)
+		{
+			V const min_x = L::Load(&aabbs.min_x[i]);
+			V const min_y = L::Load(&aabbs.min_y[i]);
+			V const min_z = L::Load(&aabbs.min_z[i]);
+			V const max_x = L::Load(&aabbs.max_x[i]);
+			V const max_y = L::Load(&aabbs.max_y[i]);
+			V const max_z = L::Load(&aabbs.max_z[i]);
+
+			uint32_t outside = 0;
+			uint32_t partial = 0;
+			for (auto const & plane : planes)
+			{
+				// The corner choice only depends on the plane, so it's the same for all lanes. v1 is diagonally opposed to v0.
+				bool const neg_a = plane.a() < 0;
+				bool const neg_b = plane.b() < 0;
+				bool const neg_c = plane.c() < 0;
+				V const d0 = DotCoord<L>(plane, neg_a ? min_x : max_x, neg_b ? min_y : max_y, neg_c ? min_z : max_z);
+				V const d1 = DotCoord<L>(plane, neg_a ? max_x : min_x, neg_b ? max_y : min_y, neg_c ? max_z : min_z);
+
+				outside |= L::MoveMask(L::Less(d0, zero));
+				partial |= L::MoveMask(L::Less(d1, zero));
+			}
+
+			StoreOverlaps(&out[i - first], L::WIDTH, outside, partial);
+		}
+
+		return i;
+	}
+
+	template <typename L>
+	size_t IntersectSpheresPlanes(BoundOverlap* out, SphereBatch const & spheres, std::span<Plane const> planes, size_t first,
+		size_t begin, size_t end) noexcept
+	{
+		typedef typename L::Type V;
+
+		size_t i = begin;
+		for (; i + L::WIDTH <= end; i += L::WIDTH)
+		{
+			V const x = L::Load(&spheres.center_x[i]);
+			V const y = L::Load(&spheres.center_y[i]);
+			V const z = L::Load(&spheres.center_z[i]);
+			V const r = L::Load(&spheres.radius[i]);
+			V const neg_r = L::Neg(r);
+
+			uint32_t outside = 0;
+			uint32_t partial = 0;
+			for (auto const & plane : planes)
+			{
+				V const d = DotCoord<L>(plane, x, y, z);
+				outside |= L::MoveMask(L::LessEqual(d, neg_r));
+				partial |= L::MoveMask(L::Greater(d, r));
+			}
+
+			StoreOverlaps(&out[i - first], L::WIDTH, outside, partial);
+		}
+
+		return i;
+	}
+
+	std::span<Plane const> FrustumPlanes(Frustum const & frustum) noexcept
+	{
+		return std::span<Plane const>(&frustum.FrustumPlane(0), 6);
+	}
+}
+
+namespace KlayGE
+{
+	void AABBoxBatch::resize(size_t size)
+	{
+		min_x.resize(size);
+		min_y.resize(size);
+		min_z.resize(size);
+		max_x.resize(size);
+		max_y.resize(size);
+		max_z.resize(size);
+	}
+
+	void AABBoxBatch::clear() noexcept
+	{
+		min_x.clear();
+		min_y.clear();
+		min_z.clear();
+		max_x.clear();
+		max_y.clear();
+		max_z.clear();
+	}
+
+	void AABBoxBatch::push_back(AABBox const & aabb)
+	{
+		min_x.push_back(aabb.Min().x());
+		min_y.push_back(aabb.Min().y());
+		min_z.push_back(aabb.Min().z());
+		max_x.push_back(aabb.Max().x());
+		max_y.push_back(aabb.Max().y());
+		max_z.push_back(aabb.Max().z());
+	}
+
+	void AABBoxBatch::Set(size_t index, AABBox const & aabb) noexcept
+	{
+		BOOST_ASSERT(index < this->size());
+
+		min_x[index] = aabb.Min().x();
+		min_y[index] = aabb.Min().y();
+		min_z[index] = aabb.Min().z();
+		max_x[index] = aabb.Max().x();
+		max_y[index] = aabb.Max().y();
+		max_z[index] = aabb.Max().z();
+	}
+
+	AABBox AABBoxBatch::Get(size_t index) const noexcept
+	{
+		BOOST_ASSERT(index < this->size());
+
+		return AABBox(float3(min_x[index], min_y[index], min_z[index]), float3(max_x[index], max_y[index], max_z[index]));
+	}
+
+	void SphereBatch::resize(size_t size)
+	{
+		center_x.resize(size);
+		center_y.resize(size);
+		center_z.resize(size);
+		radius.resize(size);
+	}
+
+	void SphereBatch::clear() noexcept
+	{
+		center_x.clear();
+		center_y.clear();
+		center_z.clear();
+		radius.clear();
+	}
+
+	void SphereBatch::push_back(Sphere const & sphere)
+	{
+		center_x.push_back(sphere.Center().x());
+		center_y.push_back(sphere.Center().y());
+		center_z.push_back(sphere.Center().z());
+		radius.push_back(sphere.Radius());
+	}
+
+	void SphereBatch::Set(size_t index, Sphere const & sphere) noexcept
+	{
+		BOOST_ASSERT(index < this->size());
+
+		center_x[index] = sphere.Center().x();
+		center_y[index] = sphere.Center().y();
+		center_z[index] = sphere.Center().z();
+		radius[index] = sphere.Radius();
+	}
+
+	Sphere SphereBatch::Get(size_t index) const noexcept
+	{
+		BOOST_ASSERT(index < this->size());
+
+		return Sphere(float3(center_x[index], center_y[index], center_z[index]), radius[index]);
+	}
+
+	namespace MathLib
+	{
+		void transform_aabbs(AABBoxBatch& out, AABBoxBatch const & aabbs, float4x4 const & mat)
+		{
+			out.resize(aabbs.size());
+
+			size_t i = 0;
+#if defined(SIMD_MATH_AVX)
+			i = TransformAABBs<SIMDLanes8>(out, aabbs, mat, i);
+#endif
+#if defined(SIMD_MATH_SSE)
+			i = TransformAABBs<SIMDLanes4>(out, aabbs, mat, i);
+#endif
+			TransformAABBs<SIMDLanes1>(out, aabbs, mat, i);
+		}
+
+		void intersect_aabbs_planes(std::span<BoundOverlap> out, AABBoxBatch const & aabbs, std::span<Plane const> planes,
+			size_t first) noexcept
+		{
+			size_t const end = first + out.size();
+			BOOST_ASSERT(end <= aabbs.size());
+
+			size_t i = first;
+#if defined(SIMD_MATH_AVX)
+			i = IntersectAABBsPlanes<SIMDLanes8>(out.data(), aabbs, planes, first, i, end);
+#endif
+#if defined(SIMD_MATH_SSE)
+			i = IntersectAABBsPlanes<SIMDLanes4>(out.data(), aabbs, planes, first, i, end);
+#endif
+			IntersectAABBsPlanes<SIMDLanes1>(out.data(), aabbs, planes, first, i, end);
+		}
+
+		void intersect_aabbs_frustum(std::span<BoundOverlap> out, AABBoxBatch const & aabbs, Frustum const & frustum,
+			size_t first) noexcept
+		{
+			intersect_aabbs_planes(out, aabbs, FrustumPlanes(frustum), first);
+		}
+
+		void intersect_spheres_planes(std::span<BoundOverlap> out, SphereBatch const & spheres, std::span<Plane const> planes,
+			size_t first) noexcept
+		{
+			size_t const end = first + out.size();
+			BOOST_ASSERT(end <= spheres.size());
+
+			size_t i = first;
+#if defined(SIMD_MATH_AVX)
+			i = IntersectSpheresPlanes<SIMDLanes8>(out.data(), spheres, planes, first, i, end);
+#endif
+#if defined(SIMD_MATH_SSE)
+			i = IntersectSpheresPlanes<SIMDLanes4>(out.data(), spheres, planes, first, i, end);
+#endif
+			IntersectSpheresPlanes<SIMDLanes1>(out.data(), spheres, planes, first, i, end);
+		}
+
+		void intersect_spheres_frustum(std::span<BoundOverlap> out, SphereBatch const & spheres, Frustum const & frustum,
+			size_t first) noexcept
+		{
+			intersect_spheres_planes(out, spheres, FrustumPlanes(frustum), first);
+		}
+	}
+}
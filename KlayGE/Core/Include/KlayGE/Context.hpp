@@ -35,6 +35,7 @@
 
 #include <KlayGE/RenderSettings.hpp>
 #include <KFL/DllLoader.hpp>
+#include <KFL/TaskScheduler.hpp>
 
 #ifdef KLAYGE_PLATFORM_ANDROID
 struct android_app;
@@ -175,6 +176,12 @@ namespace KlayGE
 			return *gtp_instance_;
 		}
 
+		// For fine-grained jobs. ThreadPool() is for long running loops that own a thread.
+		TaskScheduler& TaskSchedulerInstance()
+		{
+			return *task_scheduler_;
+		}
+
 	private:
 		void DestroyAll();
 
@@ -216,6 +223,7 @@ namespace KlayGE
 #endif
 
 		std::unique_ptr<thread_pool> gtp_instance_;
+		std::unique_ptr<TaskScheduler> task_scheduler_;
 	};
 }
 
@@ -144,7 +144,8 @@ namespace KlayGE
 	class KLAYGE_CORE_API SoftwareGraphicsBuffer : public GraphicsBuffer
 	{
 	public:
-		SoftwareGraphicsBuffer(uint32_t size_in_byte, bool ref_only);
+		// With ref_only, the buffer points to the init data instead of copying it. ref_owner keeps that memory alive.
+		SoftwareGraphicsBuffer(uint32_t size_in_byte, bool ref_only, std::shared_ptr<void const> ref_owner = nullptr);
 
 		void CopyToBuffer(GraphicsBuffer& target) override;
 		void CopyToSubBuffer(GraphicsBuffer& target,
@@ -162,6 +163,7 @@ namespace KlayGE
 
 	private:
 		bool ref_only_;
+		std::shared_ptr<void const> ref_owner_;
 
 		uint8_t* subres_data_ = nullptr;
 		std::vector<uint8_t> data_block_;
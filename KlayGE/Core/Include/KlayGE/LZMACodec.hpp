@@ -54,6 +54,20 @@ namespace KlayGE
 		void Decode(std::vector<uint8_t>& output, ResIdentifierPtr const & res, uint64_t len, uint64_t original_len);
 		void Decode(std::vector<uint8_t>& output, std::span<uint8_t const> input, uint64_t original_len);
 		void Decode(void* output, std::span<uint8_t const> input, uint64_t original_len);
+
+		// Block framed streams. The input is cut into blocks that are compressed independently, behind an index of their
+		//  offsets. Blocks are encoded and decoded on the task scheduler, and each one can be decoded alone. All the Decode
+		//  functions take both block framed and single LZMA streams.
+		void EncodeBlocks(std::vector<uint8_t>& output, std::span<uint8_t const> input, uint32_t block_size = 1UL << 20);
+
+		static bool IsBlockFramed(std::span<uint8_t const> input);
+		static uint32_t NumBlocks(std::span<uint8_t const> input);
+		static uint32_t BlockSize(std::span<uint8_t const> input);
+		// Decodes the block_index-th block, which starts at block_index * BlockSize(input) of the original data.
+		void DecodeBlock(std::vector<uint8_t>& output, std::span<uint8_t const> input, uint32_t block_index);
+
+	private:
+		void DecodeBlocks(void* output, std::span<uint8_t const> input, uint64_t original_len);
 	};
 }
 
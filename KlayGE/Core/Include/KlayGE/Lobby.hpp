@@ -18,9 +18,11 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <vector>
 #include <list>
-#include <KlayGE/Socket.hpp>
+#include <KlayGE/NetEventLoop.hpp>
 
 namespace KlayGE
 {
@@ -51,9 +53,13 @@ namespace KlayGE
 		std::string		name;
 		sockaddr_in		addr;
 
-		uint32_t		time;
+		std::chrono::steady_clock::time_point time;
 
+		// Reliable messages, [type][ID, 4 bytes][payload]. Each one is resent until a message from the player carries
+		//  the same ID. The timer only resends this player's messages, and backs off while none is acknowledged.
 		std::list<std::vector<char>> msgs;
+		uint64_t		retransmit_timer = 0;
+		std::chrono::milliseconds retransmit_interval{0};
 	};
 
 	class KLAYGE_CORE_API Lobby final : boost::noncopyable
@@ -79,6 +85,9 @@ namespace KlayGE
 		int Receive(void* buf, int maxSize, sockaddr_in& from);
 		int Send(void const * buf, int maxSize, sockaddr_in const & to);
 
+		// Can be called from any thread while Create is running
+		void SendReliable(uint32_t id, void const * buf, int size);
+
 		void TimeOut(uint32_t timeOut)
 			{ this->socket_.TimeOut(timeOut); }
 		uint32_t TimeOut()
@@ -88,6 +97,12 @@ namespace KlayGE
 			{ return this->sockAddr_; }
 
 	private:
+		void OnReceive(std::span<uint8_t const> data, sockaddr_in const & from, Processor const & pro);
+		void OnAck(PlayerAddrsIter iter, uint32_t msgID);
+		void ScheduleRetransmit(uint32_t id);
+		void Retransmit(uint32_t id);
+		void ScheduleTimeOutCheck(Processor const & pro);
+
 		void OnJoin(char* revbuf, char* sendbuf, int& sendnum, sockaddr_in& From, Processor const & pro);
 		void OnQuit(PlayerAddrsIter iter, char* sendbuf, int& sendnum, Processor const & pro);
 
@@ -98,6 +113,9 @@ namespace KlayGE
 
 	private:
 		Socket			socket_;
+		NetEventLoop	loop_;
+		std::atomic<bool> running_{false};
+		uint64_t		timeOutTimer_ = 0;
 		PlayerAddrs		players_;
 
 		sockaddr_in		sockAddr_;
@@ -29,6 +29,7 @@
 
 #include <KlayGE/PreDeclare.hpp>
 #include <KFL/CXX17/string_view.hpp>
+#include <KFL/CXX2a/span.hpp>
 #include <KlayGE/Renderable.hpp>
 #include <KlayGE/RenderLayout.hpp>
 #include <KFL/Math.hpp>
@@ -293,9 +294,51 @@ namespace KlayGE
 		std::vector<Quaternion> bind_dual;
 		std::vector<float> bind_scale;
 
+		// Quantized keys, filled by Compress(). Rotations are 48-bit smallest three quaternions, translations and scales are
+		//  16-bit fractions of their range in the track. Translations whose range is too wide for 16 bits are kept in
+		//  wide_translations instead. A track that never changes packs no keys, only its first value.
+		struct PackedKeys
+		{
+			std::vector<uint16_t> rotations;
+			std::vector<uint16_t> translations;
+			std::vector<float3> wide_translations;
+			std::vector<uint16_t> scales;
+
+			Quaternion first_rotation;
+			float3 translation_min;
+			float3 translation_extent;
+			float scale_min;
+			float scale_extent;
+		};
+		PackedKeys packed;
+
 		std::tuple<Quaternion, Quaternion, float> Frame(float frame) const;
+
+		// Locates the keys around frame and the blend factor between them. The search starts from cursor and leaves the key
+		//  it found there, so a monotonic playback moves the cursor a step at most.
+		std::tuple<uint32_t, uint32_t, float> FindKeys(float frame, uint32_t& cursor) const;
+
+		// Moves bind_real, bind_dual and bind_scale into packed keys, and back
+		void Compress();
+		void Decompress();
+		bool Compressed() const
+		{
+			return !frame_id.empty() && bind_real.empty();
+		}
+
+		std::tuple<Quaternion, Quaternion, float> Key(uint32_t index) const;
+		size_t NumBytes() const;
+
+		// Upper bounds of the rotation (radians), translation and scale errors Compress() adds to a track whose
+		//  translations and scales span no more than the extents
+		static std::tuple<float, float, float> MaxQuantizationError(float3 const & translation_extent, float scale_extent);
 	};
 
+	// Samples all key frame sets at frame, several joints at once with SIMD. The keys are blended with a normalized linear
+	//  blend of the dual quaternions. Adjacent keys are close, so it stays near to the sclerp in KeyFrameSet::Frame.
+	KLAYGE_CORE_API void SampleKeyFrameSets(std::span<KeyFrameSet const> key_frame_sets, float frame, std::span<uint32_t> cursors,
+		std::span<Quaternion> reals, std::span<Quaternion> duals, std::span<float> scales);
+
 	struct KLAYGE_CORE_API AABBKeyFrameSet
 	{
 		std::vector<uint32_t> frame_id;
@@ -311,6 +354,18 @@ namespace KlayGE
 		uint32_t end_frame;
 	};
 
+	// A clip played on a layer of a SkinnedModel. frame is relative to the start of the animation and wraps around its end.
+	//  joint_mask scales weight per joint, empty for every joint at full weight.
+	struct KLAYGE_CORE_API AnimationLayer
+	{
+		uint32_t animation;
+		float frame;
+		float weight;
+		std::vector<float> joint_mask;
+	};
+
+	class SkinnedPoseCache;
+
 	class KLAYGE_CORE_API SkinnedModel : public RenderModel
 	{
 	public:
@@ -342,12 +397,10 @@ namespace KlayGE
 		void AssignJoints(ForwardIterator first, ForwardIterator last)
 		{
 			joints_.assign(first, last);
+			joint_parents_.clear();
 			this->UpdateBinds();
 		}
-		void AttachKeyFrameSets(std::shared_ptr<std::vector<KeyFrameSet>> const & kf)
-		{
-			key_frame_sets_ = kf;
-		}
+		void AttachKeyFrameSets(std::shared_ptr<std::vector<KeyFrameSet>> const & kf);
 		std::shared_ptr<std::vector<KeyFrameSet>> const & GetKeyFrameSets() const
 		{
 			return key_frame_sets_;
@@ -385,8 +438,33 @@ namespace KlayGE
 		uint32_t NumAnimations() const;
 		void GetAnimation(uint32_t index, std::string& name, uint32_t& start_frame, uint32_t& end_frame);
 
+		// Layered playback. With any layer added, the model plays its layers instead of the timeline of SetFrame. The first
+		//  layer is the base pose. Each next layer blends over the pose so far by its weight, so two layers crossfade, and a
+		//  masked one plays on part of the body. Call UpdateAnimationLayers after changing them.
+		uint32_t AddAnimationLayer(uint32_t animation, float weight = 1, std::vector<float> joint_mask = std::vector<float>());
+		void ClearAnimationLayers();
+		uint32_t NumAnimationLayers() const
+		{
+			return static_cast<uint32_t>(animation_layers_.size());
+		}
+		AnimationLayer& GetAnimationLayer(uint32_t index)
+		{
+			return animation_layers_[index].layer;
+		}
+		AnimationLayer const& GetAnimationLayer(uint32_t index) const
+		{
+			return animation_layers_[index].layer;
+		}
+		void UpdateAnimationLayers();
+
+		// A mask of 1 on a joint and everything under it, 0 elsewhere
+		std::vector<float> JointSubtreeMask(uint32_t root_joint);
+
 	protected:
 		void BuildBones(float frame);
+		void SampleAnimationLayers();
+		void UpdateJointHierarchy();
+		void ComposeJoints();
 		void UpdateBinds();
 		void SetToEffect();
 
@@ -395,9 +473,28 @@ namespace KlayGE
 		std::vector<float4> bind_reals_;
 		std::vector<float4> bind_duals_;
 
+		// Parent index of every joint, -1 for roots, and an order that visits parents before children
+		std::vector<int32_t> joint_parents_;
+		std::vector<uint32_t> joint_eval_order_;
+
 		std::shared_ptr<std::vector<KeyFrameSet>> key_frame_sets_;
 		float last_frame_;
 
+		std::vector<uint32_t> key_frame_cursors_;
+		std::vector<Quaternion> pose_reals_;
+		std::vector<Quaternion> pose_duals_;
+		std::vector<float> pose_scales_;
+		std::shared_ptr<SkinnedPoseCache> pose_cache_;
+
+		struct AnimationLayerState
+		{
+			AnimationLayer layer;
+			std::vector<uint32_t> key_frame_cursors;
+		};
+		std::vector<AnimationLayerState> animation_layers_;
+		std::vector<float> pose_soa_;
+		std::vector<float> layer_soa_;
+
 		uint32_t num_frames_;
 		uint32_t frame_rate_;
 
@@ -433,7 +530,7 @@ namespace KlayGE
 		std::function<StaticMeshPtr(std::wstring_view)> CreateMeshFactoryFunc = CreateMeshFactory<StaticMesh>);
 	KLAYGE_CORE_API RenderModelPtr LoadSoftwareModel(std::string_view model_name);
 
-	KLAYGE_CORE_API void SaveModel(RenderModel const & model, std::string_view model_name);
+	KLAYGE_CORE_API void SaveModel(RenderModel const & model, std::string_view model_name, bool compress_geometry = false);
 
 
 	class KLAYGE_CORE_API RenderableLightSourceProxy : public StaticMesh
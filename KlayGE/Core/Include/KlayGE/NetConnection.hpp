@@ -0,0 +1,248 @@
+/**
+ * @file NetConnection.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef KLAYGE_CORE_NET_CONNECTION_HPP
+#define KLAYGE_CORE_NET_CONNECTION_HPP
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <KFL/CXX2a/span.hpp>
+#include <KlayGE/NetEventLoop.hpp>
+
+namespace KlayGE
+{
+	enum class NetChannelType
+	{
+		// Sent once, may be lost or arrive out of order. A message of several fragments is lost with any of them.
+		Unreliable,
+		// Resent until acknowledged, delivered once, in arrival order
+		Reliable,
+		// Resent until acknowledged, delivered once, in send order
+		ReliableOrdered
+	};
+
+	// One end of a connection over UDP. Each packet carries a sequence number, plus the latest received sequence and
+	//  a bitfield of the 32 before it, so every packet acknowledges the recent ones of the other end. Reliable
+	//  messages are split in fragments, and only the fragments whose packets weren't acknowledged in time are resent.
+	//  The send rate is limited by a token bucket, which grows while packets are acknowledged and halves on loss.
+	//
+	// NetConnection doesn't own a socket. Packets go out through a SendHandler, and the ones received for this
+	//  connection are passed to OnPacket. Everything is driven by Update, so a connection lives on one thread,
+	//  usually the one running its NetEventLoop.
+	class KLAYGE_CORE_API NetConnection final : boost::noncopyable
+	{
+	public:
+		using Clock = NetEventLoop::Clock;
+		using SendHandler = std::function<void(std::span<uint8_t const> packet)>;
+		using ReceiveHandler = std::function<void(uint32_t channel, std::span<uint8_t const> message)>;
+		using AckHandler = std::function<void(uint32_t channel, uint16_t id)>;
+
+		static uint32_t constexpr MAX_PACKET_SIZE = NetEventLoop::MAX_DATAGRAM_SIZE;
+		static uint32_t constexpr FRAGMENT_SIZE = 1024;
+		static uint32_t constexpr MAX_FRAGMENTS = 256;
+		static uint32_t constexpr MAX_CHANNELS = 16;
+		// Space kept for messages being reassembled. A packet that would start a message beyond it is dropped
+		//  unacknowledged, so the sender resends it once some messages are complete.
+		static uint32_t constexpr MAX_REASSEMBLY_SIZE = 4 * 1024 * 1024;
+
+	public:
+		explicit NetConnection(SendHandler const & send_handler);
+		NetConnection(NetEventLoop& loop, Socket& socket, sockaddr_in const & peer);
+
+		uint32_t AddChannel(NetChannelType type);
+
+		// Messages are delivered from OnPacket
+		void OnReceive(ReceiveHandler const & handler);
+		// Called when the packets carrying a whole message are acknowledged
+		void OnAck(AckHandler const & handler);
+
+		// Returns the message ID, which is also passed to the ack handler. Throws if the message is larger than
+		//  FRAGMENT_SIZE * MAX_FRAGMENTS.
+		uint16_t Send(uint32_t channel, void const * data, uint32_t size);
+		void OnPacket(std::span<uint8_t const> packet, Clock::time_point now);
+
+		// Sends whatever the send rate allows. Unreliable messages that don't make it are dropped.
+		void Update(Clock::time_point now);
+
+		Clock::duration RoundTripTime() const
+		{
+			return rtt_;
+		}
+		// In bytes per second
+		uint32_t SendRate() const
+		{
+			return static_cast<uint32_t>(send_rate_);
+		}
+		uint64_t PacketsSent() const
+		{
+			return packets_sent_;
+		}
+		uint64_t PacketsLost() const
+		{
+			return packets_lost_;
+		}
+		// Reliable messages sent but not acknowledged yet
+		uint32_t NumPendingMessages() const;
+
+	private:
+		// A fragment goes back to unsent when the packet carrying it is lost
+		struct Fragment
+		{
+			bool sent = false;
+			bool acked = false;
+		};
+
+		struct OutMessage
+		{
+			uint16_t id;
+			std::vector<uint8_t> data;
+			std::vector<Fragment> fragments;
+			uint32_t num_acked = 0;
+		};
+
+		// The data grows as fragments arrive, but the whole message is counted in reassembly_size_ from the start
+		struct InMessage
+		{
+			std::vector<uint8_t> data;
+			std::vector<bool> received;
+			uint32_t num_received = 0;
+			uint32_t size = 0;
+		};
+
+		struct UnreliableMessage
+		{
+			uint32_t channel;
+			uint16_t id;
+			std::vector<uint8_t> data;
+		};
+
+		struct Channel
+		{
+			NetChannelType type;
+
+			uint16_t next_send_id = 0;
+			std::deque<OutMessage> out_messages;
+
+			uint16_t next_receive_id = 0;
+			std::unordered_map<uint16_t, InMessage> partial_messages;
+			// Unreliable: fragments sent but not acknowledged yet, per message
+			std::unordered_map<uint16_t, uint32_t> unacked_fragments;
+			// Reliable: delivered ahead of next_receive_id. ReliableOrdered: complete, waiting for the ones before.
+			std::unordered_set<uint16_t> received_ahead;
+			std::unordered_map<uint16_t, std::vector<uint8_t>> ordered_ahead;
+		};
+
+		struct FragmentRef
+		{
+			uint8_t channel;
+			uint16_t id;
+			uint16_t fragment;
+		};
+
+		struct ReceivedFragment
+		{
+			uint8_t channel;
+			uint16_t id;
+			uint16_t fragment;
+			uint16_t num_fragments;
+			uint32_t offset;
+			uint32_t size;
+		};
+
+		struct SentPacket
+		{
+			uint16_t sequence;
+			bool valid = false;
+			bool acked = false;
+			// Not acknowledged within the resend timeout, its fragments are sent again
+			bool timed_out = false;
+			// Packets sent after it were acknowledged but it wasn't
+			bool lost = false;
+			uint32_t size;
+			Clock::time_point sent_time;
+			std::vector<FragmentRef> fragments;
+		};
+
+		static uint32_t constexpr SENT_PACKET_HISTORY = 1024;
+
+		void ProcessAck(uint16_t sequence, bool latest, Clock::time_point now);
+		void ConfirmLoss(uint16_t ack, Clock::time_point now);
+		void DetectTimeOut(Clock::time_point now);
+		void ReleaseFragments(SentPacket& record);
+		void SendPacket(uint32_t size, std::vector<FragmentRef>& fragments, Clock::time_point now);
+		OutMessage* FindOutMessage(Channel& channel, uint16_t id);
+		bool StartsMessage(ReceivedFragment const & fragment) const;
+		void ReceiveFragment(uint32_t channel, uint16_t id, uint16_t fragment, uint16_t num_fragments,
+			std::span<uint8_t const> data);
+		void Deliver(uint32_t channel, uint16_t id, std::span<uint8_t const> message);
+		Clock::duration ResendTimeout() const;
+
+	private:
+		SendHandler send_handler_;
+		ReceiveHandler receive_handler_;
+		AckHandler ack_handler_;
+
+		std::vector<Channel> channels_;
+		std::vector<UnreliableMessage> unreliable_queue_;
+
+		uint16_t local_sequence_ = 0;
+		std::vector<SentPacket> sent_packets_;
+
+		bool has_received_ = false;
+		bool ack_pending_ = false;
+		uint16_t remote_sequence_ = 0;
+		uint32_t remote_ack_bits_ = 0;
+		std::vector<ReceivedFragment> received_fragments_;
+		uint32_t reassembly_size_ = 0;
+
+		Clock::duration rtt_ = std::chrono::milliseconds(100);
+		uint32_t resend_backoff_ = 1;
+		double send_rate_;
+		double send_budget_ = 0;
+		Clock::time_point last_update_;
+		Clock::time_point last_rate_decrease_;
+
+		uint64_t packets_sent_ = 0;
+		uint64_t packets_lost_ = 0;
+
+		std::vector<uint8_t> packet_buff_;
+	};
+}
+
+#endif		// KLAYGE_CORE_NET_CONNECTION_HPP
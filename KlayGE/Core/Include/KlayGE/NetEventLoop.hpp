@@ -0,0 +1,164 @@
+/**
+ * @file NetEventLoop.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef KLAYGE_CORE_NET_EVENT_LOOP_HPP
+#define KLAYGE_CORE_NET_EVENT_LOOP_HPP
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <KFL/CXX2a/span.hpp>
+#include <KlayGE/Socket.hpp>
+
+#if !defined(KLAYGE_PLATFORM_WINDOWS) && !defined(KLAYGE_PLATFORM_LINUX) && !defined(KLAYGE_PLATFORM_ANDROID)
+#include <poll.h>
+#endif
+
+namespace KlayGE
+{
+	// Drives a set of UDP sockets from one thread. Readiness comes from epoll on Linux and Android, poll elsewhere
+	//  (WSAPoll on Windows), so unlike select the number of sockets isn't bound by FD_SETSIZE.
+	//  Datagrams are received in batches of up to MAX_BATCH with recvmmsg, and sends queued during an iteration go out
+	//  together with sendmmsg at its end. On platforms without them, each datagram is one recvfrom/sendto call.
+	//
+	// Everything except Post, Stop and Running must be called on the loop thread, or while the loop isn't running.
+	class KLAYGE_CORE_API NetEventLoop final : boost::noncopyable
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+		using ReceiveHandler = std::function<void(Socket& socket, std::span<uint8_t const> data, sockaddr_in const & from)>;
+		using TimerHandler = std::function<void()>;
+
+		static uint32_t constexpr MAX_BATCH = 64;
+		static uint32_t constexpr MAX_DATAGRAM_SIZE = 1472;
+
+	public:
+		NetEventLoop();
+		~NetEventLoop();
+
+		// The socket is switched to non-blocking. It must stay alive until it's removed.
+		void AddSocket(Socket& socket, ReceiveHandler const & handler);
+		void RemoveSocket(Socket& socket);
+
+		// Queued until the end of the current iteration, or the next Flush. A datagram that doesn't fit in the socket's
+		//  send buffer is dropped, like one lost on the wire.
+		void SendTo(Socket& socket, void const * buf, int len, sockaddr_in const & to);
+		void Send(Socket& socket, void const * buf, int len);
+		void Flush();
+
+		// Timers fire once, on the loop thread. Cancelling a timer that has fired is a no-op.
+		uint64_t AddTimer(Clock::duration delay, TimerHandler const & handler);
+		void CancelTimer(uint64_t id);
+
+		void Run();
+		void RunOnce(Clock::duration max_wait);
+
+		// Runs func on the loop thread, at the next iteration
+		void Post(std::function<void()> const & func);
+		void Stop();
+		bool Running() const
+		{
+			return running_;
+		}
+
+	private:
+		struct SocketEntry
+		{
+			Socket* socket;
+			ReceiveHandler handler;
+		};
+
+		struct PendingSend
+		{
+			Socket* socket;
+			bool connected;
+			sockaddr_in to;
+			uint32_t offset;
+			uint32_t size;
+		};
+
+		struct TimerEntry
+		{
+			Clock::time_point deadline;
+			uint64_t id;
+
+			bool operator>(TimerEntry const & rhs) const
+			{
+				return deadline > rhs.deadline;
+			}
+		};
+
+		// A null to sends on the connected address
+		void QueueSend(Socket& socket, void const * buf, int len, sockaddr_in const * to);
+		void Wait(Clock::duration max_wait);
+		void ReceiveBatch(SOCKET fd);
+		void FireTimers();
+		void RunPosted();
+		void Wake();
+
+	private:
+#if defined(KLAYGE_PLATFORM_LINUX) || defined(KLAYGE_PLATFORM_ANDROID)
+		int epoll_fd_;
+		int wake_fd_;
+#else
+		Socket wake_socket_;
+		sockaddr_in wake_addr_;
+		// Rebuilt from sockets_ on every wait, the wake socket first
+		std::vector<pollfd> poll_fds_;
+#endif
+
+		std::unordered_map<SOCKET, SocketEntry> sockets_;
+
+		std::vector<uint8_t> recv_buff_;
+		std::vector<uint8_t> send_buff_;
+		std::vector<PendingSend> pending_sends_;
+
+		std::priority_queue<TimerEntry, std::vector<TimerEntry>, std::greater<TimerEntry>> timer_queue_;
+		std::unordered_map<uint64_t, TimerHandler> timers_;
+		uint64_t next_timer_id_ = 1;
+
+		std::mutex posted_mutex_;
+		std::vector<std::function<void()>> posted_;
+
+		std::atomic<bool> running_{false};
+		std::atomic<bool> stop_requested_{false};
+	};
+}
+
+#endif		// KLAYGE_CORE_NET_EVENT_LOOP_HPP
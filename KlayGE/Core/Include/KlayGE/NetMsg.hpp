@@ -15,6 +15,7 @@
 
 #pragma once
 
+#include <cstdint>
 
 namespace KlayGE
 {
@@ -26,7 +27,20 @@ namespace KlayGE
 		MSG_GETLOBBYINFO,
 
 		MSG_NOP,
+
+		// A NetConnection packet
+		MSG_CONNECTION,
 	};
+
+	// 16-bit sequence numbers wrap around. a is newer than b if it's less than half the range ahead.
+	inline int32_t SequenceDiff(uint16_t a, uint16_t b)
+	{
+		return static_cast<int16_t>(static_cast<uint16_t>(a - b));
+	}
+	inline bool SequenceGreater(uint16_t a, uint16_t b)
+	{
+		return SequenceDiff(a, b) > 0;
+	}
 }
 
 #endif			// _NETMSG_HPP
@@ -0,0 +1,99 @@
+/**
+ * @file NetSnapshot.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef KLAYGE_CORE_NET_SNAPSHOT_HPP
+#define KLAYGE_CORE_NET_SNAPSHOT_HPP
+
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <KFL/CXX2a/span.hpp>
+
+namespace KlayGE
+{
+	// The replicated state of a set of entities, keyed by entity ID
+	struct NetSnapshot
+	{
+		using EntityMap = std::map<uint32_t, std::vector<uint8_t>>;
+
+		uint16_t sequence = 0;
+		EntityMap entities;
+	};
+
+	// Encodes snapshots against the latest one the receiver acknowledged. Unchanged entities are skipped, removed
+	//  ones are listed by ID, and changed ones of the same size are sent as a run-length coded XOR with the baseline.
+	//  Without a baseline, or once it falls out of the history, the snapshot is sent in full.
+	//
+	// Snapshots usually go on an unreliable channel. The sequence returned by Encode is what the receiving end
+	//  acknowledges, e.g. from NetConnection's ack handler. A snapshot larger than NetConnection::FRAGMENT_SIZE is
+	//  split in fragments and lost with any of them, so full snapshots should stay within a few fragments.
+	class KLAYGE_CORE_API NetSnapshotEncoder final : boost::noncopyable
+	{
+	public:
+		static uint32_t constexpr HISTORY_SIZE = 32;
+
+	public:
+		NetSnapshotEncoder();
+
+		uint16_t Encode(NetSnapshot::EntityMap const & entities, std::vector<uint8_t>& out);
+		void Ack(uint16_t sequence);
+
+	private:
+		std::vector<NetSnapshot> history_;
+		std::vector<bool> history_valid_;
+		uint16_t next_sequence_ = 0;
+
+		bool has_acked_ = false;
+		uint16_t acked_sequence_ = 0;
+	};
+
+	class KLAYGE_CORE_API NetSnapshotDecoder final : boost::noncopyable
+	{
+	public:
+		NetSnapshotDecoder();
+
+		// Fails if the data is malformed, older than the latest decoded snapshot, or based on a snapshot this end
+		//  doesn't have
+		bool Decode(std::span<uint8_t const> data, NetSnapshot& snapshot);
+
+	private:
+		std::vector<NetSnapshot> history_;
+		std::vector<bool> history_valid_;
+
+		bool has_latest_ = false;
+		uint16_t latest_sequence_ = 0;
+	};
+}
+
+#endif		// KLAYGE_CORE_NET_SNAPSHOT_HPP
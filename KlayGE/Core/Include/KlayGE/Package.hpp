@@ -35,11 +35,20 @@
 
 #include <KlayGE/PreDeclare.hpp>
 #include <KFL/CXX17/string_view.hpp>
+#include <KFL/CXX2a/span.hpp>
+
+#include <iosfwd>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 struct IInArchive;
 
 namespace KlayGE
 {
+	// Reads 7z archives, and native packages (.kpk) written by PackageWriter
 	class KLAYGE_CORE_API Package final
 	{
 	public:
@@ -54,8 +63,45 @@ namespace KlayGE
 			return archive_is_.get();
 		}
 
+		// The bytes of a stored entry in a native package, straight from the memory mapped package. Empty for anything
+		//  else, or if the package can't be mapped. The view lives as long as the package.
+		std::span<uint8_t const> MappedView(std::string_view extract_file_path) const;
+
+		// Recently extracted items are kept decoded, up to this many bytes in total. 0 turns the cache off.
+		void CacheBudget(size_t bytes);
+		size_t CacheBudget() const;
+
 	private:
-		uint32_t Find(std::string_view extract_file_path);
+		struct ItemInfo
+		{
+			uint32_t index;
+			uint64_t mtime;
+		};
+
+		struct NativeEntry
+		{
+			uint64_t offset;
+			uint64_t size;
+			uint64_t original_size;
+			uint8_t codec;
+		};
+
+		struct CachedItem
+		{
+			uint32_t index;
+			std::shared_ptr<std::string const> data;
+		};
+
+		void Open7z();
+		void OpenNative();
+
+		ItemInfo const * Find(std::string_view extract_file_path) const;
+		ResIdentifierPtr ExtractNative(ItemInfo const & item, std::string_view res_name);
+		std::span<uint8_t const> MappedView(NativeEntry const & entry) const;
+
+		std::shared_ptr<std::string const> FetchFromCache(uint32_t index);
+		void AddToCache(uint32_t index, std::shared_ptr<std::string const> const & data);
+		void TrimCache(size_t budget);
 
 	private:
 		ResIdentifierPtr archive_is_;
@@ -63,7 +109,66 @@ namespace KlayGE
 		std::shared_ptr<IInArchive> archive_;
 		std::string password_;
 
-		uint32_t num_items_;
+		// Native packages only. The data is empty if the package stream isn't contiguous.
+		bool native_ = false;
+		std::vector<NativeEntry> native_entries_;
+		std::span<uint8_t const> archive_data_;
+
+		// Keyed on lower case item paths with '/' separators. It's built in the constructor and read only after that, so
+		//  lookups don't lock.
+		std::unordered_map<std::string, ItemInfo> items_;
+
+		// An archive decodes one request at a time
+		std::mutex archive_mutex_;
+
+		mutable std::mutex cache_mutex_;
+		std::list<CachedItem> cache_lru_;
+		std::unordered_map<uint32_t, std::list<CachedItem>::iterator> cache_items_;
+		size_t cache_size_ = 0;
+		size_t cache_budget_ = 16 * 1024 * 1024;
+	};
+
+	// Writes a native package. Each file is compressed on its own, so any of them can be read without touching the others.
+	class KLAYGE_CORE_API PackageWriter final : boost::noncopyable
+	{
+	public:
+		enum class Codec
+		{
+			// LZMA if it saves at least an eighth of the size, otherwise stored
+			Auto,
+			Stored,
+			LZMA
+		};
+
+	public:
+		// os has to be seekable, the header is filled in last
+		explicit PackageWriter(std::ostream& os);
+
+		// If several files have the same path, ignoring case, the first one added is the one that's read back.
+		void AddFile(std::string_view path_in_package, std::span<uint8_t const> data, uint64_t mtime, Codec codec = Codec::Auto);
+
+		// Writes the table of contents and the header. No file can be added after that.
+		void Finish();
+
+	private:
+		struct EntryInfo
+		{
+			std::string path;
+			uint64_t offset;
+			uint64_t size;
+			uint64_t original_size;
+			uint64_t mtime;
+			uint8_t codec;
+		};
+
+		void Pad();
+
+	private:
+		std::ostream& os_;
+		uint64_t start_pos_;
+		uint64_t pos_;
+		std::vector<EntryInfo> entries_;
+		bool finished_ = false;
 	};
 }
 
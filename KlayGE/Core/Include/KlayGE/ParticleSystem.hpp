@@ -35,8 +35,10 @@
 
 #include <KlayGE/PreDeclare.hpp>
 #include <KFL/Math.hpp>
+#include <KFL/TaskScheduler.hpp>
 #include <KlayGE/SceneNode.hpp>
 
+#include <array>
 #include <mutex>
 #include <random>
 #include <vector>
@@ -55,6 +57,31 @@ namespace KlayGE
 		float init_life;
 	};
 
+	// All particles of a system, in structure-of-arrays layout. Updaters work on a range of them at a time.
+	struct KLAYGE_CORE_API ParticleStorage
+	{
+		std::vector<float> pos_x;
+		std::vector<float> pos_y;
+		std::vector<float> pos_z;
+		std::vector<float> vel_x;
+		std::vector<float> vel_y;
+		std::vector<float> vel_z;
+		std::vector<float> life;
+		std::vector<float> spin;
+		std::vector<float> size;
+		std::vector<float> alpha;
+		std::vector<float> init_life;
+
+		uint32_t NumParticles() const
+		{
+			return static_cast<uint32_t>(life.size());
+		}
+		void Resize(uint32_t num_particles);
+
+		Particle Get(uint32_t index) const;
+		void Set(uint32_t index, Particle const & par);
+	};
+
 	class KLAYGE_CORE_API ParticleEmitter
 	{
 	public:
@@ -212,6 +239,9 @@ namespace KlayGE
 		virtual ParticleUpdaterPtr Clone() = 0;
 
 		virtual void Update(Particle& par, float elapse_time) = 0;
+		// Updates the alive particles (life > 0) in [begin, end). It can be called from several threads at the same time
+		//  on different ranges. The default one calls the single particle version on each of them.
+		virtual void Update(ParticleStorage& particles, uint32_t begin, uint32_t end, float elapse_time);
 		virtual void SnapParams() = 0;
 
 	protected:
@@ -225,6 +255,7 @@ namespace KlayGE
 	{
 	public:
 		explicit ParticleSystem(uint32_t max_num_particles, bool sort_particles = false);
+		~ParticleSystem();
 
 		ParticleSystemPtr Clone();
 
@@ -289,19 +320,17 @@ namespace KlayGE
 
 		uint32_t NumParticles() const
 		{
-			return static_cast<uint32_t>(particles_.size());
+			return particles_.NumParticles();
 		}
 		uint32_t NumActiveParticles() const;
 		uint32_t GetActiveParticleIndex(uint32_t i) const;
-		Particle const & GetParticle(uint32_t i) const
+		Particle GetParticle(uint32_t i) const
 		{
-			BOOST_ASSERT(i < particles_.size());
-			return particles_[i];
+			return particles_.Get(i);
 		}
-		Particle& GetParticle(uint32_t i)
+		void SetParticle(uint32_t i, Particle const & par)
 		{
-			BOOST_ASSERT(i < particles_.size());
-			return particles_[i];
+			particles_.Set(i, par);
 		}
 		void ClearParticles();
 
@@ -330,8 +359,13 @@ namespace KlayGE
 
 	private:
 		void UpdateParticlesNoLock(float elapsed_time);
+		void UpdateActiveParticlesNoLock();
 		void UpdateParticleBufferNoLock();
 
+	private:
+		// Instance buffers are written in turn, so the CPU doesn't wait for the GPU to finish with the last frame's
+		static uint32_t constexpr NUM_INSTANCE_BUFFERS = 3;
+
 	private:
 		SceneNodePtr root_node_;
 		RenderablePtr render_particles_;
@@ -339,10 +373,18 @@ namespace KlayGE
 		std::vector<ParticleEmitterPtr> emitters_;
 		std::vector<ParticleUpdaterPtr> updaters_;
 
-		std::vector<Particle> particles_;
+		ParticleStorage particles_;
 		std::vector<std::pair<uint32_t, float>> actived_particles_;
+		std::vector<std::pair<uint32_t, float>> sort_scratch_;
 		mutable std::mutex actived_particles_mutex_;
 
+		// Large enough for all particles, so they are never reallocated
+		std::array<GraphicsBufferPtr, NUM_INSTANCE_BUFFERS> instance_buffers_;
+		uint32_t curr_instance_buffer_ = 0;
+
+		// Systems are simulated as tasks, so independent systems run on different workers
+		TaskPtr update_task_;
+
 		float gravity_;
 		float3 force_;
 		float media_density_;
@@ -418,6 +460,7 @@ namespace KlayGE
 		}
 
 		void Update(Particle& par, float elapse_time) override;
+		void Update(ParticleStorage& particles, uint32_t begin, uint32_t end, float elapse_time) override;
 		void SnapParams() override;
 
 	private:
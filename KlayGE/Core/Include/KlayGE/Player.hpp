@@ -18,10 +18,12 @@
 
 #pragma once
 
+#include <chrono>
 #include <list>
 #include <vector>
 
 #include <KFL/Thread.hpp>
+#include <KlayGE/NetEventLoop.hpp>
 #include <KlayGE/Socket.hpp>
 
 namespace KlayGE
@@ -51,9 +53,16 @@ namespace KlayGE
 
 		int Receive(void* buf, int maxSize, sockaddr_in& from);
 		int Send(void const * buf, int size);
+		// Bytes 1..4 are the message ID. The message is resent with backoff until the lobby echoes the ID.
+		void SendReliable(void const * buf, int size);
 
 		void ReceiveFunc();
 
+	private:
+		void OnReceive(std::span<uint8_t const> data);
+		void ScheduleNop();
+		void ScheduleRetransmit();
+
 	private:
 		Socket		socket_;
 
@@ -64,6 +73,11 @@ namespace KlayGE
 		bool			receiveLoop_;
 
 		std::list<std::vector<char>> sendQueue_;
+
+		NetEventLoop	loop_;
+		uint64_t		nopTimer_;
+		uint64_t		retransmitTimer_;
+		std::chrono::milliseconds retransmitInterval_;
 	};
 }
 
@@ -40,6 +40,7 @@ namespace KlayGE
 	class ResLoadingDesc;
 	typedef std::shared_ptr<ResLoadingDesc> ResLoadingDescPtr;
 	class ResLoader;
+	enum class ResLoadingPriority : uint32_t;
 	class PerfRange;
 	typedef std::shared_ptr<PerfRange> PerfRangePtr;
 	class PerfProfiler;
@@ -339,6 +340,11 @@ namespace KlayGE
 	typedef std::shared_ptr<UIProgressBar> UIProgressBarPtr;
 
 	class Socket;
+	class NetEventLoop;
+	class NetConnection;
+	struct NetSnapshot;
+	class NetSnapshotEncoder;
+	class NetSnapshotDecoder;
 	class Lobby;
 	class Player;
 
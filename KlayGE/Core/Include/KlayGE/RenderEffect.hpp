@@ -59,6 +59,7 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <unordered_map>
 
 #include <KlayGE/RenderEngine.hpp>
 #include <KlayGE/Texture.hpp>
@@ -642,6 +643,8 @@ namespace KlayGE
 #endif
 
 		std::vector<ShaderDesc> shader_descs_;
+		// Hash of profile, func_name and macros_hash to indices in shader_descs_, for finding duplicates quickly
+		std::unordered_multimap<size_t, uint32_t> shader_desc_index_;
 
 		std::vector<RenderShaderGraphNode> shader_graph_nodes_;
 	};
@@ -651,7 +654,6 @@ namespace KlayGE
 	public:
 #if KLAYGE_IS_DEV_PLATFORM
 		void Load(RenderEffect& effect, XMLNode const& node, uint32_t tech_index);
-		void CompileShaders(RenderEffect& effect, uint32_t tech_index);
 #endif
 		void CreateHwShaders(RenderEffect& effect, uint32_t tech_index);
 
@@ -747,7 +749,7 @@ namespace KlayGE
 #if KLAYGE_IS_DEV_PLATFORM
 		void Load(RenderEffect& effect, XMLNode const& node, uint32_t tech_index, uint32_t pass_index, RenderPass const* inherit_pass);
 		void Load(RenderEffect& effect, uint32_t tech_index, uint32_t pass_index, RenderPass const* inherit_pass);
-		void CompileShaders(RenderEffect& effect, uint32_t tech_index, uint32_t pass_index);
+		void CompileShader(RenderEffect const& effect, uint32_t tech_index, uint32_t pass_index, ShaderStage stage) const;
 #endif
 		void CreateHwShaders(RenderEffect& effect, uint32_t tech_index, uint32_t pass_index);
 
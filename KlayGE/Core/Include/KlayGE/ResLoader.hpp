@@ -34,8 +34,12 @@
 #pragma once
 
 #include <KlayGE/PreDeclare.hpp>
+#include <array>
+#include <atomic>
+#include <deque>
 #include <istream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <KFL/ResIdentifier.hpp>
@@ -47,6 +51,15 @@ struct AAsset;
 
 namespace KlayGE
 {
+	enum class ResLoadingPriority : uint32_t
+	{
+		High,		// Needed for the current frame
+		Normal,
+		Prefetch,	// Speculative loading, e.g. streaming ahead of the camera
+
+		NumPriorities
+	};
+
 	class KLAYGE_CORE_API ResLoadingDesc : boost::noncopyable
 	{
 	public:
@@ -65,6 +78,9 @@ namespace KlayGE
 
 		virtual bool HasSubThreadStage() const = 0;
 
+		// A hash of everything Match() compares (type, resource name, loading flags). Two descs that Match must have
+		// the same key. It is used to index the loaded and loading resources, Match() is only called inside a bucket.
+		virtual uint64_t Key() const = 0;
 		virtual bool Match(ResLoadingDesc const & rhs) const = 0;
 		virtual void CopyDataFrom(ResLoadingDesc const & rhs) = 0;
 		virtual std::shared_ptr<void> CloneResourceFrom(std::shared_ptr<void> const & resource) = 0;
@@ -101,8 +117,11 @@ namespace KlayGE
 		std::string AbsPath(std::string_view path);
 
 		std::shared_ptr<void> SyncQuery(ResLoadingDescPtr const & res_desc);
-		std::shared_ptr<void> ASyncQuery(ResLoadingDescPtr const & res_desc);
+		std::shared_ptr<void> ASyncQuery(ResLoadingDescPtr const & res_desc,
+			ResLoadingPriority priority = ResLoadingPriority::Normal);
 		void Unload(std::shared_ptr<void> const & res);
+		// Drops a resource from the loading queue if no worker has picked it up yet. Returns false if it's too late.
+		bool CancelLoading(std::shared_ptr<void> const & res);
 
 		template <typename T>
 		std::shared_ptr<T> SyncQueryT(ResLoadingDescPtr const & res_desc)
@@ -111,9 +130,10 @@ namespace KlayGE
 		}
 
 		template <typename T>
-		std::shared_ptr<T> ASyncQueryT(ResLoadingDescPtr const & res_desc)
+		std::shared_ptr<T> ASyncQueryT(ResLoadingDescPtr const & res_desc,
+			ResLoadingPriority priority = ResLoadingPriority::Normal)
 		{
-			return std::static_pointer_cast<T>(this->ASyncQuery(res_desc));
+			return std::static_pointer_cast<T>(this->ASyncQuery(res_desc, priority));
 		}
 
 		template <typename T>
@@ -128,6 +148,35 @@ namespace KlayGE
 		{
 			return static_cast<uint32_t>(loading_res_.size());
 		}
+		uint32_t NumLoadedResources();
+
+		// Number of worker threads running SubThreadStage. Default is half of the hardware threads.
+		void NumLoadingThreads(uint32_t num);
+		uint32_t NumLoadingThreads() const
+		{
+			return static_cast<uint32_t>(loading_threads_.size());
+		}
+
+		// Time budget of MainThreadStage in each Update(), in seconds. At least one resource is finished per Update().
+		// 0 means unlimited.
+		void MainThreadStageBudget(float budget)
+		{
+			main_thread_stage_budget_ = budget;
+		}
+		float MainThreadStageBudget() const
+		{
+			return main_thread_stage_budget_;
+		}
+
+	private:
+		enum LoadingStatus
+		{
+			LS_Loading,
+			LS_SubThreadStage,
+			LS_Complete,
+			LS_CanBeRemoved
+		};
+		typedef std::shared_ptr<std::atomic<LoadingStatus>> LoadingStatusPtr;
 
 	private:
 		std::string RealPath(std::string_view path);
@@ -136,10 +185,14 @@ namespace KlayGE
 		void DecomposePackageName(std::string_view path,
 			std::string& package_path, std::string& password, std::string& path_in_package);
 
+		void AddLoadingResource(uint64_t key, ResLoadingDescPtr const & res_desc, LoadingStatusPtr const & status,
+			std::shared_ptr<void> const & res);
 		void AddLoadedResource(ResLoadingDescPtr const & res_desc, std::shared_ptr<void> const & res);
 		std::shared_ptr<void> FindMatchLoadedResource(ResLoadingDescPtr const & res_desc);
-		void RemoveUnrefResources();
+		void RemoveUnrefResources(uint32_t shard);
 
+		void StartLoadingThreads(uint32_t num);
+		void StopLoadingThreads();
 		void LoadingThreadFunc();
 
 #if defined(KLAYGE_PLATFORM_ANDROID)
@@ -153,30 +206,45 @@ namespace KlayGE
 	private:
 		static std::unique_ptr<ResLoader> res_loader_instance_;
 
-		enum LoadingStatus
-		{
-			LS_Loading,
-			LS_Complete,
-			LS_CanBeRemoved
-		};
-
 		std::string exe_path_;
 		std::string local_path_;
 		std::vector<std::tuple<uint64_t, uint32_t, std::string, PackagePtr>> paths_;
 		std::mutex paths_mutex_;
 
-		std::mutex loaded_mutex_;
+		// Loaded resources are indexed by ResLoadingDesc::Key(), and split into shards so that queries of different
+		// resources don't contend on one lock. Expired entries are swept one shard per Update().
+		static uint32_t constexpr NUM_LOADED_RES_SHARDS = 16;
+		struct LoadedResShard
+		{
+			std::mutex mutex;
+			std::unordered_multimap<uint64_t, std::pair<ResLoadingDescPtr, std::weak_ptr<void>>> res;
+		};
+		std::array<LoadedResShard, NUM_LOADED_RES_SHARDS> loaded_res_;
+		uint32_t next_sweep_shard_ = 0;
+
+		// Key -> (issue order, desc, status, resource). The issue order keeps MainThreadStage in the order of the
+		// queries. The resource is the one handed out by ASyncQuery, and loading_res_keys_ maps it back to the key, so
+		// CancelLoading doesn't have to scan.
+		typedef std::tuple<uint64_t, ResLoadingDescPtr, LoadingStatusPtr, void const *> LoadingRes;
 		std::mutex loading_mutex_;
-		std::vector<std::pair<ResLoadingDescPtr, std::weak_ptr<void>>> loaded_res_;
-		std::vector<std::pair<ResLoadingDescPtr, std::shared_ptr<volatile LoadingStatus>>> loading_res_;
+		std::unordered_multimap<uint64_t, LoadingRes> loading_res_;
+		std::unordered_multimap<void const *, uint64_t> loading_res_keys_;
+		uint64_t loading_res_order_ = 0;
 
-		bool non_empty_loading_res_queue_ = false;
+		// Signaled when a worker finishes a sub thread stage, for SyncQuery waiting to take over the load
+		std::mutex sub_thread_stage_mutex_;
+		std::condition_variable sub_thread_stage_cv_;
+
+		// One FIFO per priority, workers always drain the higher priorities first
 		std::condition_variable loading_res_queue_cv_;
 		std::mutex loading_res_queue_mutex_;
-		std::vector<std::pair<ResLoadingDescPtr, std::shared_ptr<volatile LoadingStatus>>> loading_res_queue_;
+		std::array<std::deque<std::pair<ResLoadingDescPtr, LoadingStatusPtr>>,
+			static_cast<size_t>(ResLoadingPriority::NumPriorities)> loading_res_queue_;
+
+		std::vector<joiner<void>> loading_threads_;
+		bool quit_{false};
 
-		std::unique_ptr<joiner<void>> loading_thread_;
-		volatile bool quit_{false};
+		float main_thread_stage_budget_ = 0;
 	};
 }
 
@@ -26,8 +26,11 @@
 #include <KlayGE/SceneNode.hpp>
 #include <KlayGE/Renderable.hpp>
 #include <KFL/Frustum.hpp>
+#include <KFL/BoundBatch.hpp>
+#include <KFL/TaskScheduler.hpp>
 #include <KFL/Thread.hpp>
 
+#include <list>
 #include <vector>
 #include <unordered_map>
 
@@ -44,6 +47,15 @@ namespace KlayGE
 
 		void SmallObjectThreshold(float area);
 		void SceneUpdateElapse(float elapse);
+
+		// Memory budget of the visibility results kept for reuse, in bytes. 0 disables the cache.
+		void VisibleMarksCacheBudget(size_t bytes);
+		size_t VisibleMarksCacheBudget() const;
+		size_t VisibleMarksCacheSize() const;
+		uint64_t NumVisibleMarksCacheHits() const;
+		uint64_t NumVisibleMarksCacheMisses() const;
+		uint64_t NumVisibleMarksCacheInvalidations() const;
+		void ResetVisibleMarksCacheStats();
 		virtual void ClipScene();
 
 		uint32_t NumFrameCameras() const;
@@ -79,6 +91,10 @@ namespace KlayGE
 
 		void AddRenderable(Renderable* node);
 
+		// For SubThreadUpdate handlers that hand work to the task scheduler. The update thread waits for the task before
+		//  it releases the update mutex, so the task may touch the scene the same way the handler does.
+		void AddSubThreadUpdateTask(TaskPtr const & task);
+
 		virtual BoundOverlap AABBVisible(AABBox const & aabb) const;
 		virtual BoundOverlap OBBVisible(OBBox const & obb) const;
 		virtual BoundOverlap SphereVisible(Sphere const & sphere) const;
@@ -95,7 +111,7 @@ namespace KlayGE
 		uint32_t NumDrawCalls() const;
 		uint32_t NumDispatchCalls() const;
 
-		virtual void OnSceneChanged() = 0;
+		virtual void OnSceneChanged();
 
 		bool NodesUpdated() const
 		{
@@ -112,6 +128,9 @@ namespace KlayGE
 
 		BoundOverlap VisibleTestFromParent(SceneNode const & node, uint32_t camera_index);
 
+		// Fills node_frustum_marks_ and node_large_enough_marks_ for all_scene_nodes_, in parallel over node ranges
+		void CullSceneNodes(uint32_t num_cameras);
+
 	protected:
 		std::vector<CameraPtr> frame_cameras_;
 		std::vector<Frustum const*> camera_frustums_;
@@ -120,8 +139,34 @@ namespace KlayGE
 		SceneNode scene_root_;
 		SceneNode overlay_root_;
 
-		std::unordered_map<size_t, std::unique_ptr<std::array<BoundOverlap, RenderEngine::PredefinedCameraCBuffer::max_num_cameras>[]>>
-			visible_marks_map_;
+		// Visible marks of all scene nodes for a camera set, keyed by the visible list, the cameras and their matrices.
+		//  A key is cached on its second miss, and kept across frames in LRU order until the entries exceed the budget.
+		//  A node moving within the frustums of an entry drops that entry, a change of the scene structure or too many
+		//  moved nodes drop all of them.
+		struct VisibleMarksEntry
+		{
+			size_t key;
+			uint32_t num_nodes;
+			uint32_t num_cameras;
+			bool has_omni_camera;
+			std::vector<Frustum> frustums;
+			std::vector<BoundOverlap> marks;
+
+			size_t NumBytes() const;
+		};
+		std::list<VisibleMarksEntry> visible_marks_lru_;
+		std::unordered_map<size_t, std::list<VisibleMarksEntry>::iterator> visible_marks_map_;
+		size_t visible_marks_cache_budget_;
+		size_t visible_marks_cache_size_;
+		uint64_t num_visible_marks_cache_hits_;
+		uint64_t num_visible_marks_cache_misses_;
+		uint64_t num_visible_marks_cache_invalidations_;
+		bool scene_structure_changed_;
+		// Recent keys that missed once, in a ring
+		std::vector<size_t> visible_marks_candidates_;
+		size_t next_visible_marks_candidate_;
+		// Pairs of old and new world space bounds of the nodes moved in this frame
+		std::vector<AABBox> changed_bounds_;
 
 		float small_obj_threshold_;
 		float update_elapse_;
@@ -129,9 +174,19 @@ namespace KlayGE
 		std::vector<SceneNode*> all_scene_nodes_;
 		std::vector<SceneNode*> all_overlay_nodes_;
 
+		// World space bounds of all_scene_nodes_, for testing several boxes at once
+		AABBoxBatch node_bounds_ws_;
+		// Frustum test result of each node against each camera. Yes for omni-directional cameras.
+		std::vector<std::array<BoundOverlap, RenderEngine::PredefinedCameraCBuffer::max_num_cameras>> node_frustum_marks_;
+		// Bit i is set if the node is larger than small_obj_threshold_ in camera i
+		std::vector<uint8_t> node_large_enough_marks_;
+
 	private:
 		void FlushScene();
 
+		void ClearVisibleMarksCache();
+		void InvalidateVisibleMarksCache();
+
 	private:
 		uint32_t urt_;
 
@@ -146,6 +201,7 @@ namespace KlayGE
 
 		std::mutex update_mutex_;
 		std::unique_ptr<joiner<void>> update_thread_;
+		std::vector<TaskPtr> sub_thread_update_tasks_;
 		volatile bool quit_;
 
 		bool deferred_mode_;
@@ -151,7 +151,9 @@ namespace KlayGE
 		AABBox const& PosBoundOS() const;
 		AABBox const& PosBoundWS() const;
 		void UpdateTransforms();
-		void UpdatePosBoundSubtree();
+		// If changed_bounds isn't null, the old and new world space bounds of each node whose bounds changed are
+		//  appended to it. Otherwise the scene manager is told the scene changed, if this node is in the scene.
+		void UpdatePosBoundSubtree(std::vector<AABBox>* changed_bounds = nullptr);
 		bool Updated() const;
 		void FillVisibleMark(BoundOverlap vm);
 		void VisibleMark(uint32_t camera_index, BoundOverlap vm);
@@ -199,6 +201,7 @@ namespace KlayGE
 
 		void Parent(SceneNode* so);
 		void EmitSceneChanged();
+		bool DoUpdatePosBoundSubtree(std::vector<AABBox>* changed_bounds);
 
 	protected:
 		std::wstring name_;
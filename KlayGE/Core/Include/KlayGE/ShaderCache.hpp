@@ -0,0 +1,133 @@
+/**
+ * @file ShaderCache.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef KLAYGE_CORE_SHADER_CACHE_HPP
+#define KLAYGE_CORE_SHADER_CACHE_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+
+#if KLAYGE_IS_DEV_PLATFORM
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <KFL/CXX17/string_view.hpp>
+#include <KFL/CXX2a/span.hpp>
+
+namespace KlayGE
+{
+	// 128-bit FNV-1a of everything the compiler sees: its identity, the source text, entry point, profile, macros and
+	//  flags. It names the entry and is stored in it, so a hit is checked against the full digest.
+	class KLAYGE_CORE_API ShaderCacheDigest final
+	{
+	public:
+		ShaderCacheDigest();
+
+		void Append(void const * data, size_t size);
+		// Length prefixed, so consecutive strings can't run into each other
+		void Append(std::string_view str);
+
+		uint64_t High() const
+		{
+			return hi_;
+		}
+		uint64_t Low() const
+		{
+			return lo_;
+		}
+
+		bool operator==(ShaderCacheDigest const & rhs) const
+		{
+			return (hi_ == rhs.hi_) && (lo_ == rhs.lo_);
+		}
+
+	private:
+		uint64_t hi_;
+		uint64_t lo_;
+	};
+
+	// On-disk cache of compiled shader code, shared by all effects, processes and runs that use the same folder.
+	//  Entries are content addressed, one file per key. When the total size goes over the limit, the least recently
+	//  used entries are removed.
+	class KLAYGE_CORE_API ShaderCache final : boost::noncopyable
+	{
+	public:
+		ShaderCache();
+
+		static ShaderCache& Instance();
+
+		void Enabled(bool enabled);
+		bool Enabled() const;
+
+		// Defaults to ShaderCache/ in the local folder of ResLoader
+		void Folder(std::string_view folder);
+		std::string Folder() const;
+
+		void MaxSize(uint64_t bytes);
+		uint64_t MaxSize() const;
+
+		bool Find(ShaderCacheDigest const & digest, std::vector<uint8_t>& code);
+		void Insert(ShaderCacheDigest const & digest, std::span<uint8_t const> code);
+
+		// Removes the least recently used entries until the cache fits in MaxSize
+		void Trim();
+
+		uint64_t NumHits() const;
+		uint64_t NumMisses() const;
+
+	private:
+		std::string EntryPath(ShaderCacheDigest const & digest) const;
+		void ScanNoLock();
+		void TrimNoLock();
+
+	private:
+		mutable std::mutex mutex_;
+
+		bool enabled_ = true;
+		std::string folder_;
+		uint64_t max_size_;
+
+		bool scanned_ = false;
+		uint64_t curr_size_ = 0;
+
+		std::atomic<uint64_t> num_hits_{0};
+		std::atomic<uint64_t> num_misses_{0};
+	};
+}
+
+#endif
+
+#endif		// KLAYGE_CORE_SHADER_CACHE_HPP
@@ -37,6 +37,7 @@
 #include <KlayGE/RenderLayout.hpp>
 
 #include <array>
+#include <mutex>
 
 namespace KlayGE
 {
@@ -157,6 +158,10 @@ namespace KlayGE
 		static void ReflectDXBC(std::vector<uint8_t> const & code, void** reflector);
 		static std::vector<uint8_t> StripDXBC(std::vector<uint8_t> const & code, uint32_t strip_flags);
 
+		// Effects compile their stages on several workers. Held while one of them logs a compile error, so the lines
+		//  of one report stay together.
+		static std::mutex& CompileLogMutex();
+
 		virtual std::string_view GetShaderProfile(RenderEffect const& effect, uint32_t shader_desc_id) const = 0;
 
 		virtual void StageSpecificStreamIn(ResIdentifier& res)
@@ -66,6 +66,11 @@ namespace KlayGE
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) = 0;
 		virtual void DecodeBlock(void* output, void const * input) = 0;
 
+		// Batched versions of EncodeBlock/DecodeBlock. The uncompressed side has the blocks one after another,
+		//  BlockWidth * BlockHeight texels each, the compressed side has them packed like a row of blocks.
+		virtual void EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method);
+		virtual void DecodeBlocks(void* output, void const * input, uint32_t num_blocks);
+
 		virtual void EncodeMem(uint32_t width, uint32_t height, 
 			void* output, uint32_t out_row_pitch, uint32_t out_slice_pitch,
 			void const * input, uint32_t in_row_pitch, uint32_t in_slice_pitch,
@@ -77,6 +82,11 @@ namespace KlayGE
 		virtual void EncodeTex(TexturePtr const & out_tex, TexturePtr const & in_tex, TexCompressionMethod method);
 		virtual void DecodeTex(TexturePtr const & out_tex, TexturePtr const & in_tex);
 
+	protected:
+		// EncodeMem and DecodeMem split the rows of blocks over the task scheduler. Codecs that keep per-block state
+		//  in members return a new instance here, one for each chunk of rows. nullptr means this one can be shared.
+		virtual std::unique_ptr<TexCompression> CreateWorkerCodec() const;
+
 	protected:
 		ElementFormat compression_format_;
 	};
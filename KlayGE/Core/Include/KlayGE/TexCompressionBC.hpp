@@ -34,6 +34,7 @@
 #pragma once
 
 #include <cstring>
+#include <utility>
 
 #include <KlayGE/TexCompression.hpp>
 
@@ -87,6 +88,8 @@ namespace KlayGE
 
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual void EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method) override;
+		virtual void DecodeBlocks(void* output, void const * input, uint32_t num_blocks) override;
 
 		void EncodeBC1Internal(BC1Block& bc1, ARGBColor32 const * argb, bool alpha, TexCompressionMethod method) const;
 
@@ -105,6 +108,8 @@ namespace KlayGE
 
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual void EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method) override;
+		virtual void DecodeBlocks(void* output, void const * input, uint32_t num_blocks) override;
 
 	private:
 		TexCompressionBC1 bc1_codec_;
@@ -117,6 +122,8 @@ namespace KlayGE
 
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual void EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method) override;
+		virtual void DecodeBlocks(void* output, void const * input, uint32_t num_blocks) override;
 	};
 
 	class KLAYGE_CORE_API TexCompressionBC3 final : public TexCompression
@@ -126,6 +133,8 @@ namespace KlayGE
 
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual void EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method) override;
+		virtual void DecodeBlocks(void* output, void const * input, uint32_t num_blocks) override;
 
 	private:
 		TexCompressionBC1 bc1_codec_;
@@ -139,6 +148,8 @@ namespace KlayGE
 
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual void EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method) override;
+		virtual void DecodeBlocks(void* output, void const * input, uint32_t num_blocks) override;
 
 	private:
 		TexCompressionBC4 bc4_codec_;
@@ -151,10 +162,14 @@ namespace KlayGE
 
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual void EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method) override;
+		virtual void DecodeBlocks(void* output, void const * input, uint32_t num_blocks) override;
 
+		void EncodeBC6Internal(void* output, void const * input, TexCompressionMethod method, bool signed_fmt);
 		void DecodeBC6Internal(void* output, void const * input, bool signed_fmt);
 
 	private:
+		int Quantize(int unq, uint8_t bits_per_comp, bool signed_fmt);
 		int Unquantize(int comp, uint8_t bits_per_comp, bool signed_fmt);
 		int FinishUnquantize(int comp, bool signed_fmt);
 
@@ -203,6 +218,20 @@ namespace KlayGE
 		static ModeDescriptor const mode_desc_[][82];
 		static ModeInfo const mode_info_[];
 		static int const mode_to_info_[];
+
+		struct CompressParams
+		{
+			uint32_t mode_index;
+			uint32_t shape;
+			std::array<std::pair<int3, int3>, BC6_MAX_REGIONS> end_pts;	// As stored in the block, deltas if transformed
+			std::array<uint8_t, BC6_MAX_INDICES> indices;
+		};
+
+		void GeneratePalette(std::pair<int3, int3> const & end_pts, ModeInfo const & info, bool signed_fmt,
+			float3* palette);
+		float TryCompress(uint32_t mode_index, uint32_t shape, float3 const * pixels, float3 const * unq_pixels,
+			bool signed_fmt, uint32_t num_refinements, CompressParams& params);
+		void PackBC6Block(void* output, CompressParams const & params) const;
 	};
 
 	class KLAYGE_CORE_API TexCompressionBC6S final : public TexCompression
@@ -212,6 +241,8 @@ namespace KlayGE
 
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual void EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method) override;
+		virtual void DecodeBlocks(void* output, void const * input, uint32_t num_blocks) override;
 
 	private:
 		TexCompressionBC6U bc6u_codec_;
@@ -278,6 +309,9 @@ namespace KlayGE
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
 
+	protected:
+		virtual std::unique_ptr<TexCompression> CreateWorkerCodec() const override;
+
 	private:
 		void PackBC7UniformBlock(void* output, ARGBColor32 const & pixel);
 		void PackBC7Block(int mode, CompressParams& params, void* output);
@@ -382,6 +382,8 @@ namespace KlayGE
 	KLAYGE_CORE_API TexturePtr LoadSoftwareTexture(std::string_view tex_name);
 	KLAYGE_CORE_API TexturePtr SyncLoadTexture(std::string_view tex_name, uint32_t access_hint);
 	KLAYGE_CORE_API TexturePtr ASyncLoadTexture(std::string_view tex_name, uint32_t access_hint);
+	KLAYGE_CORE_API TexturePtr ASyncLoadTexture(std::string_view tex_name, uint32_t access_hint,
+		ResLoadingPriority priority);
 
 	KLAYGE_CORE_API void SaveTexture(TexturePtr const & texture, std::string const & tex_name);
 
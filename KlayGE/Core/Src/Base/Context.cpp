@@ -126,6 +126,7 @@ namespace KlayGE
 #endif
 
 		gtp_instance_ = MakeUniquePtr<thread_pool>(1, 16);
+		task_scheduler_ = MakeUniquePtr<TaskScheduler>();
 	}
 
 	Context::~Context()
@@ -154,6 +155,7 @@ namespace KlayGE
 
 		app_ = nullptr;
 
+		task_scheduler_.reset();
 		gtp_instance_.reset();
 	}
 
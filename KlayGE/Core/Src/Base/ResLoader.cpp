@@ -30,6 +30,8 @@
 
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/MemoryMappedFile.hpp>
+#include <KFL/Timer.hpp>
 #include <KFL/Util.hpp>
 #include <KlayGE/Package.hpp>
 #include <KFL/CXX17/filesystem.hpp>
@@ -39,6 +41,7 @@
 #endif
 #include <fstream>
 #include <sstream>
+#include <thread>
 
 #if defined KLAYGE_PLATFORM_WINDOWS_DESKTOP
 #include <windows.h>
@@ -73,26 +76,28 @@ namespace
 {
 	std::mutex singleton_mutex;
 
-#ifdef KLAYGE_PLATFORM_ANDROID
-	class AAssetStreamBuf : public KlayGE::MemInputStreamBuf
+	uint32_t LoadedResShardIndex(uint64_t key, uint32_t num_shards)
 	{
-	public:
-		explicit AAssetStreamBuf(AAsset* asset)
-			: MemInputStreamBuf(AAsset_getBuffer(asset), AAsset_getLength(asset)),
-				asset_(asset)
+		return static_cast<uint32_t>((key >> 32) ^ key) % num_shards;
+	}
+
+	// Plain files are mapped, so loaders can parse them in place. Files that can't be mapped, e.g. empty ones, fall back to
+	//  a stream.
+	KlayGE::ResIdentifierPtr OpenPlainFile(std::string_view name, uint64_t timestamp, std::string const & res_name)
+	{
+		using namespace KlayGE;
+
+		auto mapped_file = MakeSharedPtr<MemoryMappedFile>();
+		if (mapped_file->Open(res_name))
 		{
-			BOOST_ASSERT(asset_ != nullptr);
+			return MakeSharedPtr<ResIdentifier>(name, timestamp, mapped_file->Span(), mapped_file);
 		}
-
-		~AAssetStreamBuf()
+		else
 		{
-			AAsset_close(asset_);
+			return MakeSharedPtr<ResIdentifier>(
+				name, timestamp, MakeSharedPtr<std::ifstream>(res_name.c_str(), std::ios_base::binary));
 		}
-
-	private:
-		AAsset* asset_;
-	};
-#endif
+	}
 }
 
 namespace KlayGE
@@ -203,21 +208,12 @@ namespace KlayGE
 #endif
 #endif
 
-		loading_thread_ = MakeUniquePtr<joiner<void>>(Context::Instance().ThreadPool()(
-			[this] { this->LoadingThreadFunc(); }));
+		this->StartLoadingThreads(std::max(std::thread::hardware_concurrency() / 2, 1U));
 	}
 
 	ResLoader::~ResLoader()
 	{
-		quit_ = true;
-
-		{
-			std::unique_lock<std::mutex> lock(loading_res_queue_mutex_, std::try_to_lock);
-			non_empty_loading_res_queue_ = true;
-			loading_res_queue_cv_.notify_one();
-		}
-
-		(*loading_thread_)();
+		this->StopLoadingThreads();
 	}
 
 	ResLoader& ResLoader::Instance()
@@ -345,22 +341,36 @@ namespace KlayGE
 		password = "";
 		path_in_package = "";
 
+		// 7z archives, and native packages
+		static std::string_view const package_exts[] = { ".7z", ".kpk" };
+
 		size_t start_offset = 0;
 		for (;;)
 		{
-			auto const pkt_offset = path.find(".7z", start_offset);
+			auto pkt_offset = std::string_view::npos;
+			size_t pkt_end = 0;
+			for (auto const & ext : package_exts)
+			{
+				auto const offset = path.find(ext, start_offset);
+				if (offset < pkt_offset)
+				{
+					pkt_offset = offset;
+					pkt_end = offset + ext.size();
+				}
+			}
+
 			if (pkt_offset != std::string_view::npos)
 			{
-				package_path = std::string(path.substr(0, pkt_offset + 3));
+				package_path = std::string(path.substr(0, pkt_end));
 				std::filesystem::path pkt_path(package_path);
 				std::error_code ec;
 				if (std::filesystem::exists(pkt_path, ec)
 					&& (std::filesystem::is_regular_file(pkt_path) || std::filesystem::is_symlink(pkt_path)))
 				{
-					auto const next_slash_offset = path.find('/', pkt_offset + 3);
-					if ((path.size() > pkt_offset + 3) && (path[pkt_offset + 3] == '|'))
+					auto const next_slash_offset = path.find('/', pkt_end);
+					if ((path.size() > pkt_end) && (path[pkt_end] == '|'))
 					{
-						auto const password_start_offset = pkt_offset + 4;
+						auto const password_start_offset = pkt_end + 1;
 						if (next_slash_offset != std::string_view::npos)
 						{
 							password = std::string(path.substr(password_start_offset, next_slash_offset - password_start_offset));
@@ -378,7 +388,7 @@ namespace KlayGE
 				}
 				else
 				{
-					start_offset = pkt_offset + 3;
+					start_offset = pkt_end;
 				}
 			}
 			else
@@ -477,8 +487,7 @@ namespace KlayGE
 					if (!package)
 					{
 						uint64_t const timestamp = std::filesystem::last_write_time(package_path).time_since_epoch().count();
-						auto package_res = MakeSharedPtr<ResIdentifier>(
-							package_path, timestamp, MakeSharedPtr<std::ifstream>(package_path.c_str(), std::ios_base::binary));
+						auto package_res = OpenPlainFile(package_path, timestamp, package_path);
 
 						package = MakeSharedPtr<Package>(package_res, password);
 					}
@@ -593,9 +602,10 @@ namespace KlayGE
 		AAsset* asset = this->LocateFileAndroid(name);
 		if (asset != nullptr)
 		{
-			std::shared_ptr<AAssetStreamBuf> asb = MakeSharedPtr<AAssetStreamBuf>(asset);
-			std::shared_ptr<std::istream> asset_file = MakeSharedPtr<std::istream>(asb.get());
-			return MakeSharedPtr<ResIdentifier>(name, 0, asset_file, asb);
+			std::shared_ptr<AAsset> owner(asset, AAsset_close);
+			auto const * data = static_cast<uint8_t const *>(AAsset_getBuffer(asset));
+			return MakeSharedPtr<ResIdentifier>(name, 0,
+				std::span<uint8_t const>(data, static_cast<size_t>(AAsset_getLength(asset))), owner);
 		}
 #elif defined(KLAYGE_PLATFORM_IOS)
 		std::string const & res_name = this->LocateFileIOS(name);
@@ -603,13 +613,18 @@ namespace KlayGE
 		{
 			std::filesystem::path res_path(res_name);
 			uint64_t const timestamp = std::filesystem::last_write_time(res_path).time_since_epoch().count();
-			return MakeSharedPtr<ResIdentifier>(name, timestamp,
-				MakeSharedPtr<std::ifstream>(res_name.c_str(), std::ios_base::binary));
+			return OpenPlainFile(name, timestamp, res_name);
 		}
 #else
 		{
-			std::lock_guard<std::mutex> lock(paths_mutex_);
-			for (auto const & path : paths_)
+			// Works on a copy, so extracting from packages doesn't hold other loader threads up
+			decltype(paths_) paths;
+			{
+				std::lock_guard<std::mutex> lock(paths_mutex_);
+				paths = paths_;
+			}
+
+			for (auto const & path : paths)
 			{
 				if ((std::get<1>(path) != 0) || (HashRange(name.begin(), name.begin() + std::get<1>(path)) == std::get<0>(path)))
 				{
@@ -623,8 +638,7 @@ namespace KlayGE
 					if (std::filesystem::exists(res_path, ec))
 					{
 						uint64_t const timestamp = std::filesystem::last_write_time(res_path).time_since_epoch().count();
-						return MakeSharedPtr<ResIdentifier>(
-							name, timestamp, MakeSharedPtr<std::ifstream>(res_name.c_str(), std::ios_base::binary));
+						return OpenPlainFile(name, timestamp, res_name);
 					}
 					else
 					{
@@ -678,8 +692,6 @@ namespace KlayGE
 
 	std::shared_ptr<void> ResLoader::SyncQuery(ResLoadingDescPtr const & res_desc)
 	{
-		this->RemoveUnrefResources();
-
 		std::shared_ptr<void> loaded_res = this->FindMatchLoadedResource(res_desc);
 		std::shared_ptr<void> res;
 		if (loaded_res)
@@ -699,17 +711,20 @@ namespace KlayGE
 		}
 		else
 		{
-			std::shared_ptr<volatile LoadingStatus> async_is_done;
+			ResLoadingDescPtr async_desc;
+			LoadingStatusPtr async_is_done;
 			bool found = false;
 			{
 				std::lock_guard<std::mutex> lock(loading_mutex_);
 
-				for (auto const & lrq : loading_res_)
+				auto const range = loading_res_.equal_range(res_desc->Key());
+				for (auto iter = range.first; iter != range.second; ++ iter)
 				{
-					if (lrq.first->Match(*res_desc))
+					auto const & lrq = iter->second;
+					if (std::get<1>(lrq)->Match(*res_desc))
 					{
-						res_desc->CopyDataFrom(*lrq.first);
-						async_is_done = lrq.second;
+						async_desc = std::get<1>(lrq);
+						async_is_done = std::get<2>(lrq);
 						found = true;
 						break;
 					}
@@ -718,7 +733,15 @@ namespace KlayGE
 
 			if (found)
 			{
-				*async_is_done = LS_Complete;
+				// Takes over the asynchronous load if no worker has started it. Otherwise waits for the worker's sub
+				//  thread stage, which then marks it complete, so the data isn't copied while it's being written.
+				LoadingStatus expected = LS_Loading;
+				if (!async_is_done->compare_exchange_strong(expected, LS_Complete))
+				{
+					std::unique_lock<std::mutex> lock(sub_thread_stage_mutex_);
+					sub_thread_stage_cv_.wait(lock, [&async_is_done] { return LS_SubThreadStage != async_is_done->load(); });
+				}
+				res_desc->CopyDataFrom(*async_desc);
 			}
 			else
 			{
@@ -738,10 +761,8 @@ namespace KlayGE
 		return res;
 	}
 
-	std::shared_ptr<void> ResLoader::ASyncQuery(ResLoadingDescPtr const & res_desc)
+	std::shared_ptr<void> ResLoader::ASyncQuery(ResLoadingDescPtr const & res_desc, ResLoadingPriority priority)
 	{
-		this->RemoveUnrefResources();
-
 		std::shared_ptr<void> loaded_res = this->FindMatchLoadedResource(res_desc);
 		std::shared_ptr<void> res;
 		if (loaded_res)
@@ -761,17 +782,21 @@ namespace KlayGE
 		}
 		else
 		{
-			std::shared_ptr<volatile LoadingStatus> async_is_done;
+			uint64_t const key = res_desc->Key();
+
+			LoadingStatusPtr async_is_done;
 			bool found = false;
 			{
 				std::lock_guard<std::mutex> lock(loading_mutex_);
 
-				for (auto const & lrq : loading_res_)
+				auto const range = loading_res_.equal_range(key);
+				for (auto iter = range.first; iter != range.second; ++ iter)
 				{
-					if (lrq.first->Match(*res_desc))
+					auto const & lrq = iter->second;
+					if (std::get<1>(lrq)->Match(*res_desc))
 					{
-						res_desc->CopyDataFrom(*lrq.first);
-						async_is_done = lrq.second;
+						res_desc->CopyDataFrom(*std::get<1>(lrq));
+						async_is_done = std::get<2>(lrq);
 						found = true;
 						break;
 					}
@@ -784,8 +809,7 @@ namespace KlayGE
 
 				if (!res_desc->StateLess())
 				{
-					std::lock_guard<std::mutex> lock(loading_mutex_);
-					loading_res_.emplace_back(res_desc, async_is_done);
+					this->AddLoadingResource(key, res_desc, async_is_done, res);
 				}
 			}
 			else
@@ -794,18 +818,14 @@ namespace KlayGE
 				{
 					res = res_desc->CreateResource();
 
-					async_is_done = MakeSharedPtr<LoadingStatus>(LS_Loading);
+					async_is_done = MakeSharedPtr<std::atomic<LoadingStatus>>(LS_Loading);
 
+					this->AddLoadingResource(key, res_desc, async_is_done, res);
 					{
-						std::lock_guard<std::mutex> lock(loading_mutex_);
-						loading_res_.emplace_back(res_desc, async_is_done);
-					}
-					{
-						std::unique_lock<std::mutex> lock(loading_res_queue_mutex_, std::try_to_lock);
-						loading_res_queue_.emplace_back(res_desc, async_is_done);
-						non_empty_loading_res_queue_ = true;
-						loading_res_queue_cv_.notify_one();
+						std::lock_guard<std::mutex> lock(loading_res_queue_mutex_);
+						loading_res_queue_[static_cast<uint32_t>(priority)].emplace_back(res_desc, async_is_done);
 					}
+					loading_res_queue_cv_.notify_one();
 				}
 				else
 				{
@@ -820,25 +840,78 @@ namespace KlayGE
 
 	void ResLoader::Unload(std::shared_ptr<void> const & res)
 	{
-		std::lock_guard<std::mutex> lock(loaded_mutex_);
+		for (auto& shard : loaded_res_)
+		{
+			std::lock_guard<std::mutex> lock(shard.mutex);
 
-		for (auto iter = loaded_res_.begin(); iter != loaded_res_.end(); ++ iter)
+			for (auto iter = shard.res.begin(); iter != shard.res.end(); ++ iter)
+			{
+				if (res == iter->second.second.lock())
+				{
+					shard.res.erase(iter);
+					return;
+				}
+			}
+		}
+	}
+
+	bool ResLoader::CancelLoading(std::shared_ptr<void> const & res)
+	{
+		std::lock_guard<std::mutex> lock(loading_mutex_);
+
+		auto const key_iter = loading_res_keys_.find(res.get());
+		if (key_iter == loading_res_keys_.end())
+		{
+			return false;
+		}
+
+		auto const range = loading_res_.equal_range(key_iter->second);
+		for (auto iter = range.first; iter != range.second; ++ iter)
 		{
-			if (res == iter->second.lock())
+			if (std::get<3>(iter->second) == res.get())
 			{
-				loaded_res_.erase(iter);
-				break;
+				// The worker skips anything that isn't LS_Loading when popping it from the queue
+				LoadingStatus expected = LS_Loading;
+				return std::get<2>(iter->second)->compare_exchange_strong(expected, LS_CanBeRemoved);
 			}
 		}
+
+		return false;
+	}
+
+	void ResLoader::AddLoadingResource(uint64_t key, ResLoadingDescPtr const & res_desc, LoadingStatusPtr const & status,
+		std::shared_ptr<void> const & res)
+	{
+		std::lock_guard<std::mutex> lock(loading_mutex_);
+
+		loading_res_.emplace(key, std::make_tuple(loading_res_order_, res_desc, status, res.get()));
+		loading_res_keys_.emplace(res.get(), key);
+		++ loading_res_order_;
+	}
+
+	uint32_t ResLoader::NumLoadedResources()
+	{
+		uint32_t num = 0;
+		for (auto& shard : loaded_res_)
+		{
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			num += static_cast<uint32_t>(shard.res.size());
+		}
+		return num;
 	}
 
 	void ResLoader::AddLoadedResource(ResLoadingDescPtr const & res_desc, std::shared_ptr<void> const & res)
 	{
-		std::lock_guard<std::mutex> lock(loaded_mutex_);
+		uint64_t const key = res_desc->Key();
+		auto& shard = loaded_res_[LoadedResShardIndex(key, NUM_LOADED_RES_SHARDS)];
+
+		std::lock_guard<std::mutex> lock(shard.mutex);
 
 		bool found = false;
-		for (auto& c_desc : loaded_res_)
+		auto const range = shard.res.equal_range(key);
+		for (auto iter = range.first; iter != range.second; ++ iter)
 		{
+			auto& c_desc = iter->second;
 			if (c_desc.first == res_desc)
 			{
 				c_desc.second = std::weak_ptr<void>(res);
@@ -848,93 +921,152 @@ namespace KlayGE
 		}
 		if (!found)
 		{
-			loaded_res_.emplace_back(res_desc, std::weak_ptr<void>(res));
+			shard.res.emplace(key, std::make_pair(res_desc, std::weak_ptr<void>(res)));
 		}
 	}
 
 	std::shared_ptr<void> ResLoader::FindMatchLoadedResource(ResLoadingDescPtr const & res_desc)
 	{
-		std::lock_guard<std::mutex> lock(loaded_mutex_);
+		uint64_t const key = res_desc->Key();
+		auto& shard = loaded_res_[LoadedResShardIndex(key, NUM_LOADED_RES_SHARDS)];
+
+		std::lock_guard<std::mutex> lock(shard.mutex);
 
 		std::shared_ptr<void> loaded_res;
-		for (auto const & lr : loaded_res_)
+		auto const range = shard.res.equal_range(key);
+		for (auto iter = range.first; iter != range.second;)
 		{
-			if (lr.first->Match(*res_desc))
+			auto const & lr = iter->second;
+			if (lr.second.expired())
 			{
-				loaded_res = lr.second.lock();
-				break;
+				// Drop the dead entries we run into, the rest is left to the sweep in Update()
+				iter = shard.res.erase(iter);
+			}
+			else
+			{
+				if (lr.first->Match(*res_desc))
+				{
+					loaded_res = lr.second.lock();
+					if (loaded_res)
+					{
+						break;
+					}
+				}
+				++ iter;
 			}
 		}
 		return loaded_res;
 	}
 
-	void ResLoader::RemoveUnrefResources()
+	void ResLoader::RemoveUnrefResources(uint32_t shard_index)
 	{
-		std::lock_guard<std::mutex> lock(loaded_mutex_);
+		auto& shard = loaded_res_[shard_index];
 
-		for (auto iter = loaded_res_.begin(); iter != loaded_res_.end();)
+		std::lock_guard<std::mutex> lock(shard.mutex);
+
+		for (auto iter = shard.res.begin(); iter != shard.res.end();)
 		{
-			if (iter->second.lock())
+			if (iter->second.second.expired())
 			{
-				++ iter;
+				iter = shard.res.erase(iter);
 			}
 			else
 			{
-				iter = loaded_res_.erase(iter);
+				++ iter;
 			}
 		}
 	}
 
 	void ResLoader::Update()
 	{
-		std::vector<std::pair<ResLoadingDescPtr, std::shared_ptr<volatile LoadingStatus>>> tmp_loading_res;
+		this->RemoveUnrefResources(next_sweep_shard_);
+		next_sweep_shard_ = (next_sweep_shard_ + 1) % NUM_LOADED_RES_SHARDS;
+
+		std::vector<LoadingRes> tmp_loading_res;
 		{
 			std::lock_guard<std::mutex> lock(loading_mutex_);
-			tmp_loading_res = loading_res_;
+			tmp_loading_res.reserve(loading_res_.size());
+			for (auto const & lrq : loading_res_)
+			{
+				if (LS_Complete == *std::get<2>(lrq.second))
+				{
+					tmp_loading_res.push_back(lrq.second);
+				}
+			}
 		}
+		std::sort(tmp_loading_res.begin(), tmp_loading_res.end(),
+			[](auto const & lhs, auto const & rhs) { return std::get<0>(lhs) < std::get<0>(rhs); });
 
+		Timer timer;
+		std::vector<ResLoadingDescPtr> finished_res;
 		for (auto& lrq : tmp_loading_res)
 		{
-			if (LS_Complete == *lrq.second)
-			{
-				ResLoadingDescPtr const & res_desc = lrq.first;
+			ResLoadingDescPtr const & res_desc = std::get<1>(lrq);
 
-				std::shared_ptr<void> res;
-				std::shared_ptr<void> loaded_res = this->FindMatchLoadedResource(res_desc);
-				if (loaded_res)
+			std::shared_ptr<void> res;
+			std::shared_ptr<void> loaded_res = this->FindMatchLoadedResource(res_desc);
+			if (loaded_res)
+			{
+				if (!res_desc->StateLess())
 				{
-					if (!res_desc->StateLess())
+					res = res_desc->CloneResourceFrom(loaded_res);
+					if (res != loaded_res)
 					{
-						res = res_desc->CloneResourceFrom(loaded_res);
-						if (res != loaded_res)
-						{
-							this->AddLoadedResource(res_desc, res);
-						}
+						this->AddLoadedResource(res_desc, res);
 					}
 				}
-				else
-				{
-					res_desc->MainThreadStage();
-					res = res_desc->Resource();
-					this->AddLoadedResource(res_desc, res);
-				}
 			}
-		}
-		for (auto& lrq : tmp_loading_res)
-		{
-			if (LS_Complete == *lrq.second)
+			else
+			{
+				res_desc->MainThreadStage();
+				res = res_desc->Resource();
+				this->AddLoadedResource(res_desc, res);
+			}
+
+			finished_res.push_back(res_desc);
+
+			// Whatever is left stays LS_Complete and is picked up by the next Update()
+			if ((main_thread_stage_budget_ > 0) && (timer.elapsed() >= main_thread_stage_budget_))
 			{
-				*lrq.second = LS_CanBeRemoved;
+				break;
 			}
 		}
 
 		{
 			std::lock_guard<std::mutex> lock(loading_mutex_);
+
+			auto erase_loading_res = [this](auto iter)
+			{
+				auto const key_range = loading_res_keys_.equal_range(std::get<3>(iter->second));
+				for (auto key_iter = key_range.first; key_iter != key_range.second; ++ key_iter)
+				{
+					if (key_iter->second == iter->first)
+					{
+						loading_res_keys_.erase(key_iter);
+						break;
+					}
+				}
+				return loading_res_.erase(iter);
+			};
+
+			for (auto const & res_desc : finished_res)
+			{
+				auto const range = loading_res_.equal_range(res_desc->Key());
+				for (auto iter = range.first; iter != range.second; ++ iter)
+				{
+					if (std::get<1>(iter->second) == res_desc)
+					{
+						erase_loading_res(iter);
+						break;
+					}
+				}
+			}
+
 			for (auto iter = loading_res_.begin(); iter != loading_res_.end();)
 			{
-				if (LS_CanBeRemoved == *(iter->second))
+				if (LS_CanBeRemoved == *std::get<2>(iter->second))
 				{
-					iter = loading_res_.erase(iter);
+					iter = erase_loading_res(iter);
 				}
 				else
 				{
@@ -944,30 +1076,86 @@ namespace KlayGE
 		}
 	}
 
+	void ResLoader::NumLoadingThreads(uint32_t num)
+	{
+		num = std::max(num, 1U);
+		if (num != loading_threads_.size())
+		{
+			this->StopLoadingThreads();
+			this->StartLoadingThreads(num);
+		}
+	}
+
+	void ResLoader::StartLoadingThreads(uint32_t num)
+	{
+		{
+			std::lock_guard<std::mutex> lock(loading_res_queue_mutex_);
+			quit_ = false;
+		}
+
+		auto& tp = Context::Instance().ThreadPool();
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			loading_threads_.push_back(tp([this] { this->LoadingThreadFunc(); }));
+		}
+	}
+
+	void ResLoader::StopLoadingThreads()
+	{
+		{
+			std::lock_guard<std::mutex> lock(loading_res_queue_mutex_);
+			quit_ = true;
+		}
+		loading_res_queue_cv_.notify_all();
+
+		for (auto& thread : loading_threads_)
+		{
+			thread();
+		}
+		loading_threads_.clear();
+	}
+
 	void ResLoader::LoadingThreadFunc()
 	{
-		while (!quit_)
+		for (;;)
 		{
-			std::vector<std::pair<ResLoadingDescPtr, std::shared_ptr<volatile LoadingStatus>>> loading_res_queue_copy;
+			std::pair<ResLoadingDescPtr, LoadingStatusPtr> res_pair;
 
 			{
 				std::unique_lock<std::mutex> lock(loading_res_queue_mutex_);
-				loading_res_queue_cv_.wait(lock, [this] { return non_empty_loading_res_queue_; });
-
-				loading_res_queue_copy.swap(loading_res_queue_);
-				non_empty_loading_res_queue_ = false;
-			}
+				loading_res_queue_cv_.wait(lock, [this]
+					{
+						return quit_ || std::any_of(loading_res_queue_.begin(), loading_res_queue_.end(),
+							[](auto const & queue) { return !queue.empty(); });
+					});
+				if (quit_)
+				{
+					break;
+				}
 
-			for (auto& res_pair : loading_res_queue_copy)
-			{
-				if (LS_Loading == *res_pair.second)
+				for (auto& queue : loading_res_queue_)
 				{
-					res_pair.first->SubThreadStage();
-					*res_pair.second = LS_Complete;
+					if (!queue.empty())
+					{
+						res_pair = std::move(queue.front());
+						queue.pop_front();
+						break;
+					}
 				}
 			}
 
-			Sleep(10);
+			// Canceled or already finished by a SyncQuery
+			LoadingStatus expected = LS_Loading;
+			if (res_pair.second->compare_exchange_strong(expected, LS_SubThreadStage))
+			{
+				res_pair.first->SubThreadStage();
+
+				expected = LS_SubThreadStage;
+				res_pair.second->compare_exchange_strong(expected, LS_Complete);
+
+				std::lock_guard<std::mutex> lock(sub_thread_stage_mutex_);
+				sub_thread_stage_cv_.notify_all();
+			}
 		}
 	}
 
@@ -14,12 +14,18 @@
 #include <KlayGE/Player.hpp>
 
 #include <algorithm>
-#include <ctime>
 #include <cstring>
 
 #include <KlayGE/NetMsg.hpp>
 #include <KlayGE/Lobby.hpp>
 
+namespace
+{
+	std::chrono::milliseconds const RETRANSMIT_MIN_INTERVAL(100);
+	std::chrono::milliseconds const RETRANSMIT_MAX_INTERVAL(2000);
+	std::chrono::seconds const PLAYER_TIME_OUT(20);
+}
+
 namespace KlayGE
 {
 	// 캯
@@ -40,7 +46,7 @@ namespace KlayGE
 	{
 		for (auto iter = players_.begin(); iter != players_.end(); ++ iter)
 		{
-			if (0 == std::memcmp(&addr, &(iter->second.addr), sizeof(addr)))
+			if ((iter->first != 0) && (0 == std::memcmp(&addr, &(iter->second.addr), sizeof(addr))))
 			{
 				return iter;
 			}
@@ -58,74 +64,184 @@ namespace KlayGE
 		this->MaxPlayers(maxPlayers);
 
 		this->socket_.Bind(TransAddr("", port));
+		socklen_t len(sizeof(sockAddr_));
+		this->socket_.SockName(sockAddr_, len);
+
+		loop_.AddSocket(socket_,
+			[this, &pro](Socket& socket, std::span<uint8_t const> data, sockaddr_in const & from)
+			{
+				KFL_UNUSED(socket);
+				this->OnReceive(data, from, pro);
+			});
+		this->ScheduleTimeOutCheck(pro);
 
-		sockaddr_in from;
+		running_ = true;
+		loop_.Run();
+		running_ = false;
+
+		loop_.CancelTimer(timeOutTimer_);
+		loop_.RemoveSocket(socket_);
+		this->socket_.Close();
+	}
+
+	void Lobby::OnReceive(std::span<uint8_t const> data, sockaddr_in const & from, Processor const & pro)
+	{
+		if (data.empty())
+		{
+			return;
+		}
+
+		sockaddr_in reply_to = from;
 		char revBuf[Max_Buffer];
+		std::memset(revBuf, 0, sizeof(revBuf));
+		std::memcpy(revBuf, data.data(), std::min(static_cast<size_t>(data.size()), sizeof(revBuf)));
 		char sendBuf[Max_Buffer];
 		int numSend = 0;
-		for (;;)
-		{
-			this->Receive(revBuf, sizeof(revBuf), from);
-
-			// ÿϢǰ涼1ֽڵϢ
-			char* revPtr(&revBuf[1]);
-			char* sendPtr(&sendBuf[1]);
-			sendBuf[0] = revBuf[0];
 
-			switch (revBuf[0])
-			{
-			case MSG_JOIN:
-				this->OnJoin(revPtr, sendPtr, numSend, from, pro);
-				break;
-
-			case MSG_QUIT:
-				this->OnQuit(this->ID(from), sendPtr, numSend, pro);
-				break;
+		// ÿϢǰ涼1ֽڵϢ
+		char* revPtr(&revBuf[1]);
+		char* sendPtr(&sendBuf[1]);
+		sendBuf[0] = revBuf[0];
 
-			case MSG_GETLOBBYINFO:
-				this->OnGetLobbyInfo(sendPtr, numSend, pro);
-				break;
+		switch (revBuf[0])
+		{
+		case MSG_JOIN:
+			this->OnJoin(revPtr, sendPtr, numSend, reply_to, pro);
+			break;
 
-			case MSG_NOP:
-				this->OnNop(this->ID(from));
-				break;
+		case MSG_QUIT:
+			this->OnQuit(this->ID(from), sendPtr, numSend, pro);
+			break;
 
-			default:
-				pro.OnDefault(revBuf, sizeof(revBuf), sendBuf, numSend, from);
-				break;
-			}
+		case MSG_GETLOBBYINFO:
+			this->OnGetLobbyInfo(sendPtr, numSend, pro);
+			break;
 
-			if (numSend != 0)
-			{
-				this->Send(sendBuf, numSend + 1, from);
-			}
+		case MSG_NOP:
+			this->OnNop(this->ID(from));
+			break;
 
-			// Ϣ
-			for (auto const & player : players_)
+		default:
+			pro.OnDefault(revBuf, sizeof(revBuf), sendBuf, numSend, reply_to);
+			if (data.size() >= 5)
 			{
-				auto const & msgs = player.second.msgs;
-				for (auto const & msg : msgs)
+				auto iter = this->ID(from);
+				if (iter != players_.end())
 				{
-					socket_.SendTo(&msg[0], static_cast<int>(msg.size()), player.second.addr);
+					uint32_t msgID;
+					std::memcpy(&msgID, &revBuf[1], sizeof(msgID));
+					this->OnAck(iter, msgID);
 				}
 			}
+			break;
+		}
 
-			// Ƿûʱ
-			for (auto iter = players_.begin(); iter != players_.end();)
+		if (numSend != 0)
+		{
+			loop_.SendTo(socket_, sendBuf, numSend + 1, reply_to);
+		}
+	}
+
+	void Lobby::SendReliable(uint32_t id, void const * buf, int size)
+	{
+		BOOST_ASSERT(size >= 5);
+
+		auto const * p = static_cast<char const *>(buf);
+		std::vector<char> msg(p, p + size);
+		loop_.Post([this, id, msg]()
 			{
-				// 20
-				if (std::time(nullptr) - iter->second.time >= 20 * 1000)
+				if ((id == 0) || (id > players_.size()) || (players_[id - 1].first != id))
 				{
-					iter = players_.erase(iter);
+					return;
 				}
-				else
+
+				auto& player = players_[id - 1].second;
+				loop_.SendTo(socket_, msg.data(), static_cast<int>(msg.size()), player.addr);
+				player.msgs.push_back(msg);
+				if (0 == player.retransmit_timer)
 				{
-					++ iter;
+					player.retransmit_interval = RETRANSMIT_MIN_INTERVAL;
+					this->ScheduleRetransmit(id);
 				}
+			});
+	}
+
+	void Lobby::OnAck(PlayerAddrsIter iter, uint32_t msgID)
+	{
+		auto& player = iter->second;
+		bool acked = false;
+		for (auto msg_iter = player.msgs.begin(); msg_iter != player.msgs.end();)
+		{
+			uint32_t sendID;
+			std::memcpy(&sendID, &(*msg_iter)[1], sizeof(sendID));
+			if (sendID == msgID)
+			{
+				msg_iter = player.msgs.erase(msg_iter);
+				acked = true;
+			}
+			else
+			{
+				++ msg_iter;
+			}
+		}
+
+		if (acked)
+		{
+			player.retransmit_interval = RETRANSMIT_MIN_INTERVAL;
+			if (player.msgs.empty() && (player.retransmit_timer != 0))
+			{
+				loop_.CancelTimer(player.retransmit_timer);
+				player.retransmit_timer = 0;
 			}
 		}
 	}
 
+	void Lobby::ScheduleRetransmit(uint32_t id)
+	{
+		auto& player = players_[id - 1].second;
+		player.retransmit_timer = loop_.AddTimer(player.retransmit_interval, [this, id]() { this->Retransmit(id); });
+	}
+
+	void Lobby::Retransmit(uint32_t id)
+	{
+		auto& slot = players_[id - 1];
+		slot.second.retransmit_timer = 0;
+		if ((slot.first != id) || slot.second.msgs.empty())
+		{
+			return;
+		}
+
+		// Ϣ
+		for (auto const & msg : slot.second.msgs)
+		{
+			loop_.SendTo(socket_, msg.data(), static_cast<int>(msg.size()), slot.second.addr);
+		}
+
+		slot.second.retransmit_interval = std::min(slot.second.retransmit_interval * 2, RETRANSMIT_MAX_INTERVAL);
+		this->ScheduleRetransmit(id);
+	}
+
+	void Lobby::ScheduleTimeOutCheck(Processor const & pro)
+	{
+		timeOutTimer_ = loop_.AddTimer(std::chrono::seconds(1), [this, &pro]()
+			{
+				// Ƿûʱ
+				auto const now = std::chrono::steady_clock::now();
+				for (auto iter = players_.begin(); iter != players_.end(); ++ iter)
+				{
+					// 20
+					if ((iter->first != 0) && (now - iter->second.time >= PLAYER_TIME_OUT))
+					{
+						char sendBuf[Max_Buffer];
+						int numSend = 0;
+						this->OnQuit(iter, sendBuf, numSend, pro);
+					}
+				}
+
+				this->ScheduleTimeOutCheck(pro);
+			});
+	}
+
 	// 
 	/////////////////////////////////////////////////////////////////////////////////
 	char Lobby::NumPlayer() const
@@ -179,7 +295,15 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void Lobby::Close()
 	{
-		this->socket_.Close();
+		// Create closes the socket itself once the loop exits
+		if (running_)
+		{
+			loop_.Stop();
+		}
+		else
+		{
+			this->socket_.Close();
+		}
 	}
 
 	// 
@@ -218,6 +342,7 @@ namespace KlayGE
 				iter->first			= id;
 				iter->second.name	= name;
 				iter->second.addr	= from;
+				iter->second.time	= std::chrono::steady_clock::now();
 
 				pro.OnJoin(iter->first);
 				break;
@@ -230,11 +355,11 @@ namespace KlayGE
 		// Ѿ
 		if (iter == players_.end())
 		{
-			sendBuf[0] = 1;
+			sendBuf[0] = 0;
 		}
 		else
 		{
-			sendBuf[0] = 0;
+			sendBuf[0] = id;
 		}
 
 		numSend = 1;
@@ -247,6 +372,12 @@ namespace KlayGE
 		{
 			pro.OnQuit(iter->first);
 			iter->first = 0;
+			iter->second.msgs.clear();
+			if (iter->second.retransmit_timer != 0)
+			{
+				loop_.CancelTimer(iter->second.retransmit_timer);
+				iter->second.retransmit_timer = 0;
+			}
 			sendBuf[0] = 0;
 		}
 		else
@@ -275,7 +406,7 @@ namespace KlayGE
 	{
 		if (iter != this->players_.end())
 		{
-			iter->second.time = static_cast<uint32_t>(std::time(nullptr));
+			iter->second.time = std::chrono::steady_clock::now();
 		}
 	}
 }
@@ -0,0 +1,803 @@
+/**
+ * @file NetConnection.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/ErrorHandling.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include <boost/assert.hpp>
+
+#include <KlayGE/NetMsg.hpp>
+#include <KlayGE/NetConnection.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	// [MSG_CONNECTION][sequence, 2 bytes][ack, 2 bytes][ack bits, 4 bytes]
+	uint32_t const PACKET_HEADER_SIZE = 9;
+	// [channel, 1 byte, high bit set if fragmented][ID, 2 bytes][size, 2 bytes]
+	//  followed by [fragment, 1 byte][number of fragments - 1, 1 byte] if fragmented
+	uint32_t const MESSAGE_HEADER_SIZE = 5;
+	uint32_t const FRAGMENT_HEADER_SIZE = 2;
+	uint8_t const FRAGMENTED_FLAG = 0x80;
+
+	// Reliable messages further than this ahead of the oldest unacknowledged one wait. It keeps the IDs in flight
+	//  well inside the 16-bit range, so the receiver can tell new ones from duplicates.
+	uint32_t const MESSAGE_WINDOW = 1024;
+
+	// Incomplete unreliable messages this far behind the newest one are given up
+	uint32_t const UNRELIABLE_REASSEMBLY_WINDOW = 16;
+
+	// A packet is lost once one sent this many later is acknowledged, and it isn't. Tolerates some reordering.
+	uint32_t const LOSS_REORDER_THRESHOLD = 3;
+	uint32_t const LOSS_SCAN_RANGE = 64;
+
+	uint32_t const MAX_RESEND_BACKOFF = 8;
+
+	double const INITIAL_SEND_RATE = 256 * 1024;
+	double const MIN_SEND_RATE = 16 * 1024;
+	double const MAX_SEND_RATE = 8 * 1024 * 1024;
+
+	template <typename T>
+	void Write(std::vector<uint8_t>& buff, uint32_t& offset, T value)
+	{
+		std::memcpy(&buff[offset], &value, sizeof(value));
+		offset += sizeof(value);
+	}
+
+	template <typename T>
+	bool Read(std::span<uint8_t const> buff, uint32_t& offset, T& value)
+	{
+		if (offset + sizeof(value) > static_cast<size_t>(buff.size()))
+		{
+			return false;
+		}
+
+		std::memcpy(&value, &buff[offset], sizeof(value));
+		offset += sizeof(value);
+		return true;
+	}
+
+	uint32_t NumFragments(uint32_t size)
+	{
+		return std::max((size + NetConnection::FRAGMENT_SIZE - 1) / NetConnection::FRAGMENT_SIZE, 1U);
+	}
+}
+
+namespace KlayGE
+{
+	NetConnection::NetConnection(SendHandler const & send_handler)
+		: send_handler_(send_handler),
+			sent_packets_(SENT_PACKET_HISTORY),
+			send_rate_(INITIAL_SEND_RATE),
+			packet_buff_(MAX_PACKET_SIZE)
+	{
+	}
+
+	NetConnection::NetConnection(NetEventLoop& loop, Socket& socket, sockaddr_in const & peer)
+		: NetConnection([&loop, &socket, peer](std::span<uint8_t const> packet)
+			{
+				loop.SendTo(socket, packet.data(), static_cast<int>(packet.size()), peer);
+			})
+	{
+	}
+
+	uint32_t NetConnection::AddChannel(NetChannelType type)
+	{
+		BOOST_ASSERT(channels_.size() < MAX_CHANNELS);
+
+		channels_.emplace_back();
+		channels_.back().type = type;
+		return static_cast<uint32_t>(channels_.size() - 1);
+	}
+
+	void NetConnection::OnReceive(ReceiveHandler const & handler)
+	{
+		receive_handler_ = handler;
+	}
+
+	void NetConnection::OnAck(AckHandler const & handler)
+	{
+		ack_handler_ = handler;
+	}
+
+	uint16_t NetConnection::Send(uint32_t channel, void const * data, uint32_t size)
+	{
+		BOOST_ASSERT(channel < channels_.size());
+
+		if (size > FRAGMENT_SIZE * MAX_FRAGMENTS)
+		{
+			TERRC(std::errc::message_size);
+		}
+
+		auto& ch = channels_[channel];
+		uint16_t const id = ch.next_send_id;
+		++ ch.next_send_id;
+
+		auto const * p = static_cast<uint8_t const *>(data);
+		if (NetChannelType::Unreliable == ch.type)
+		{
+			unreliable_queue_.push_back(UnreliableMessage{ channel, id, std::vector<uint8_t>(p, p + size) });
+		}
+		else
+		{
+			OutMessage msg;
+			msg.id = id;
+			msg.data.assign(p, p + size);
+			msg.fragments.resize(NumFragments(size));
+			ch.out_messages.push_back(std::move(msg));
+		}
+
+		return id;
+	}
+
+	uint32_t NetConnection::NumPendingMessages() const
+	{
+		uint32_t num = 0;
+		for (auto const & ch : channels_)
+		{
+			for (auto const & msg : ch.out_messages)
+			{
+				if (msg.num_acked < msg.fragments.size())
+				{
+					++ num;
+				}
+			}
+		}
+		return num;
+	}
+
+	void NetConnection::OnPacket(std::span<uint8_t const> packet, Clock::time_point now)
+	{
+		uint32_t offset = 0;
+		uint8_t type;
+		uint16_t sequence;
+		uint16_t ack;
+		uint32_t ack_bits;
+		if (!Read(packet, offset, type) || (type != MSG_CONNECTION)
+			|| !Read(packet, offset, sequence) || !Read(packet, offset, ack) || !Read(packet, offset, ack_bits))
+		{
+			return;
+		}
+
+		// Duplicates and packets too old to be acknowledged are dropped as a whole
+		int32_t const diff = has_received_ ? SequenceDiff(sequence, remote_sequence_) : 1;
+		if ((diff == 0) || (diff < -32) || ((diff < 0) && (remote_ack_bits_ & (1U << (-diff - 1)))))
+		{
+			return;
+		}
+
+		// The whole payload is checked before anything in it is used
+		received_fragments_.clear();
+		uint32_t const payload_offset = offset;
+		while (offset < static_cast<uint32_t>(packet.size()))
+		{
+			uint8_t channel;
+			uint16_t id;
+			uint16_t size;
+			if (!Read(packet, offset, channel) || !Read(packet, offset, id) || !Read(packet, offset, size))
+			{
+				return;
+			}
+
+			uint8_t fragment = 0;
+			uint8_t last_fragment = 0;
+			if (channel & FRAGMENTED_FLAG)
+			{
+				channel &= ~FRAGMENTED_FLAG;
+				if (!Read(packet, offset, fragment) || !Read(packet, offset, last_fragment) || (fragment > last_fragment))
+				{
+					return;
+				}
+			}
+
+			if ((channel >= channels_.size()) || (size > FRAGMENT_SIZE) || (size > static_cast<uint32_t>(packet.size()) - offset))
+			{
+				return;
+			}
+
+			received_fragments_.push_back(ReceivedFragment{ channel, id, fragment, static_cast<uint16_t>(last_fragment + 1),
+				offset, size });
+			offset += size;
+		}
+
+		// Without room for the messages it starts, the packet is treated as lost. Not acknowledging it makes the
+		//  sender resend it later, fragments already received always have room.
+		uint64_t reassembly_size = reassembly_size_;
+		for (auto const & fragment : received_fragments_)
+		{
+			if (this->StartsMessage(fragment))
+			{
+				reassembly_size += fragment.num_fragments * FRAGMENT_SIZE;
+			}
+		}
+		if (reassembly_size > MAX_REASSEMBLY_SIZE)
+		{
+			return;
+		}
+
+		// Record the sequence for the acks we send back
+		if (!has_received_)
+		{
+			has_received_ = true;
+			remote_sequence_ = sequence;
+			remote_ack_bits_ = 0;
+		}
+		else
+		{
+			if (diff > 0)
+			{
+				// The previous latest becomes bit diff - 1
+				if (diff < 32)
+				{
+					remote_ack_bits_ = (remote_ack_bits_ << diff) | (1U << (diff - 1));
+				}
+				else
+				{
+					remote_ack_bits_ = (32 == diff) ? (1U << 31) : 0;
+				}
+				remote_sequence_ = sequence;
+			}
+			else
+			{
+				remote_ack_bits_ |= 1U << (-diff - 1);
+			}
+		}
+		// Packets with only acks aren't acknowledged themselves, or two idle ends would keep acking each other
+		if (payload_offset < static_cast<uint32_t>(packet.size()))
+		{
+			ack_pending_ = true;
+		}
+
+		this->ProcessAck(ack, true, now);
+		for (uint32_t i = 0; i < 32; ++ i)
+		{
+			if (ack_bits & (1U << i))
+			{
+				this->ProcessAck(static_cast<uint16_t>(ack - 1 - i), false, now);
+			}
+		}
+		this->ConfirmLoss(ack, now);
+
+		for (auto const & fragment : received_fragments_)
+		{
+			this->ReceiveFragment(fragment.channel, fragment.id, fragment.fragment, fragment.num_fragments,
+				packet.subspan(fragment.offset, fragment.size));
+		}
+	}
+
+	void NetConnection::Update(Clock::time_point now)
+	{
+		if (last_update_ == Clock::time_point())
+		{
+			last_update_ = now;
+			last_rate_decrease_ = now;
+		}
+
+		this->DetectTimeOut(now);
+
+		// Up to about 50ms worth of data can go out at once
+		double const dt = std::chrono::duration<double>(now - last_update_).count();
+		last_update_ = now;
+		double const max_budget = std::max(send_rate_ * 0.05, static_cast<double>(MAX_PACKET_SIZE) * 2);
+		send_budget_ = std::min(send_budget_ + send_rate_ * dt, max_budget);
+
+		uint32_t size = PACKET_HEADER_SIZE;
+		std::vector<FragmentRef> fragments;
+		bool sent_any = false;
+
+		auto append = [this, &size, &fragments, &sent_any, now](uint32_t channel, uint16_t id, uint32_t fragment,
+			uint32_t num_fragments, uint8_t const * data, uint32_t data_size)
+		{
+			uint32_t const header_size = MESSAGE_HEADER_SIZE + ((num_fragments > 1) ? FRAGMENT_HEADER_SIZE : 0);
+			if (size + header_size + data_size > MAX_PACKET_SIZE)
+			{
+				this->SendPacket(size, fragments, now);
+				size = PACKET_HEADER_SIZE;
+				sent_any = true;
+
+				if (send_budget_ <= 0)
+				{
+					return false;
+				}
+			}
+
+			uint8_t channel_byte = static_cast<uint8_t>(channel);
+			if (num_fragments > 1)
+			{
+				channel_byte |= FRAGMENTED_FLAG;
+			}
+			Write(packet_buff_, size, channel_byte);
+			Write(packet_buff_, size, id);
+			Write(packet_buff_, size, static_cast<uint16_t>(data_size));
+			if (num_fragments > 1)
+			{
+				Write(packet_buff_, size, static_cast<uint8_t>(fragment));
+				Write(packet_buff_, size, static_cast<uint8_t>(num_fragments - 1));
+			}
+			if (data_size > 0)
+			{
+				std::memcpy(&packet_buff_[size], data, data_size);
+				size += data_size;
+			}
+
+			fragments.push_back(FragmentRef{ static_cast<uint8_t>(channel), id, static_cast<uint16_t>(fragment) });
+			return true;
+		};
+
+		// Unreliable messages first, they're stale by the next update. Reliable ones take what's left.
+		bool budget_left = (send_budget_ > 0);
+		for (size_t i = 0; budget_left && (i < unreliable_queue_.size()); ++ i)
+		{
+			auto const & msg = unreliable_queue_[i];
+			uint32_t const msg_size = static_cast<uint32_t>(msg.data.size());
+			uint32_t const num_fragments = NumFragments(msg_size);
+			for (uint32_t f = 0; f < num_fragments; ++ f)
+			{
+				uint32_t const begin = f * FRAGMENT_SIZE;
+				uint32_t const frag_size = std::min(msg_size - begin, static_cast<uint32_t>(FRAGMENT_SIZE));
+				if (!append(msg.channel, msg.id, f, num_fragments, msg.data.data() + begin, frag_size))
+				{
+					budget_left = false;
+					break;
+				}
+			}
+
+			if (budget_left)
+			{
+				auto& unacked = channels_[msg.channel].unacked_fragments;
+				if (unacked.size() >= MESSAGE_WINDOW)
+				{
+					// Messages with a lost fragment are never acknowledged
+					for (auto iter = unacked.begin(); iter != unacked.end();)
+					{
+						if (SequenceDiff(msg.id, iter->first) >= static_cast<int32_t>(MESSAGE_WINDOW))
+						{
+							iter = unacked.erase(iter);
+						}
+						else
+						{
+							++ iter;
+						}
+					}
+				}
+				unacked[msg.id] = num_fragments;
+			}
+		}
+		unreliable_queue_.clear();
+
+		for (uint32_t channel = 0; budget_left && (channel < channels_.size()); ++ channel)
+		{
+			auto& ch = channels_[channel];
+			uint32_t const num_messages = std::min(static_cast<uint32_t>(ch.out_messages.size()), MESSAGE_WINDOW);
+			for (uint32_t i = 0; budget_left && (i < num_messages); ++ i)
+			{
+				auto& msg = ch.out_messages[i];
+				uint32_t const num_fragments = static_cast<uint32_t>(msg.fragments.size());
+				for (uint32_t f = 0; f < num_fragments; ++ f)
+				{
+					auto& frag = msg.fragments[f];
+					if (frag.sent || frag.acked)
+					{
+						continue;
+					}
+
+					uint32_t const begin = f * FRAGMENT_SIZE;
+					uint32_t const frag_size = std::min(static_cast<uint32_t>(msg.data.size()) - begin,
+						static_cast<uint32_t>(FRAGMENT_SIZE));
+					if (!append(channel, msg.id, f, num_fragments, msg.data.data() + begin, frag_size))
+					{
+						budget_left = false;
+						break;
+					}
+					frag.sent = true;
+				}
+			}
+		}
+
+		// The last packet, or one with only the acks if nothing else went out
+		if ((size > PACKET_HEADER_SIZE) || (!sent_any && ack_pending_))
+		{
+			this->SendPacket(size, fragments, now);
+		}
+	}
+
+	void NetConnection::SendPacket(uint32_t size, std::vector<FragmentRef>& fragments, Clock::time_point now)
+	{
+		uint32_t offset = 0;
+		Write(packet_buff_, offset, static_cast<uint8_t>(MSG_CONNECTION));
+		Write(packet_buff_, offset, local_sequence_);
+		Write(packet_buff_, offset, remote_sequence_);
+		Write(packet_buff_, offset, remote_ack_bits_);
+
+		// A packet still in flight from a full cycle ago counts as timed out, so its fragments aren't stuck as sent
+		auto& record = sent_packets_[local_sequence_ % SENT_PACKET_HISTORY];
+		if (record.valid && !record.acked && !record.timed_out)
+		{
+			this->ReleaseFragments(record);
+		}
+		record.sequence = local_sequence_;
+		record.valid = true;
+		record.acked = false;
+		record.timed_out = false;
+		record.lost = false;
+		record.size = size;
+		record.sent_time = now;
+		record.fragments.swap(fragments);
+		fragments.clear();
+
+		++ local_sequence_;
+		++ packets_sent_;
+		send_budget_ -= size;
+		ack_pending_ = false;
+
+		send_handler_(std::span<uint8_t const>(packet_buff_.data(), size));
+	}
+
+	NetConnection::OutMessage* NetConnection::FindOutMessage(Channel& channel, uint16_t id)
+	{
+		if (channel.out_messages.empty())
+		{
+			return nullptr;
+		}
+
+		// IDs in the queue are consecutive
+		int32_t const index = SequenceDiff(id, channel.out_messages.front().id);
+		if ((index < 0) || (static_cast<uint32_t>(index) >= channel.out_messages.size()))
+		{
+			return nullptr;
+		}
+		return &channel.out_messages[index];
+	}
+
+	void NetConnection::ProcessAck(uint16_t sequence, bool latest, Clock::time_point now)
+	{
+		auto& record = sent_packets_[sequence % SENT_PACKET_HISTORY];
+		if (!record.valid || record.acked || (record.sequence != sequence))
+		{
+			return;
+		}
+		record.acked = true;
+
+		// The latest ack comes back as soon as the other end sends, the older ones in the bitfield would overestimate.
+		//  Every packet has its own sequence, so an ack after a timeout is still a valid sample. Without those, an RTT
+		//  above the resend timeout could never be measured.
+		if (latest)
+		{
+			rtt_ += (now - record.sent_time - rtt_) / 8;
+		}
+		if (!record.timed_out)
+		{
+			resend_backoff_ = 1;
+		}
+		send_rate_ = std::min(send_rate_ + record.size / 8.0, MAX_SEND_RATE);
+
+		for (auto const & ref : record.fragments)
+		{
+			auto& ch = channels_[ref.channel];
+			if (NetChannelType::Unreliable == ch.type)
+			{
+				auto iter = ch.unacked_fragments.find(ref.id);
+				if (iter != ch.unacked_fragments.end())
+				{
+					-- iter->second;
+					if (0 == iter->second)
+					{
+						ch.unacked_fragments.erase(iter);
+						if (ack_handler_)
+						{
+							ack_handler_(ref.channel, ref.id);
+						}
+					}
+				}
+				continue;
+			}
+
+			OutMessage* msg = this->FindOutMessage(ch, ref.id);
+			if ((msg == nullptr) || msg->fragments[ref.fragment].acked)
+			{
+				continue;
+			}
+
+			msg->fragments[ref.fragment].acked = true;
+			++ msg->num_acked;
+			if (msg->num_acked == msg->fragments.size())
+			{
+				if (ack_handler_)
+				{
+					ack_handler_(ref.channel, ref.id);
+				}
+
+				while (!ch.out_messages.empty() && (ch.out_messages.front().num_acked == ch.out_messages.front().fragments.size()))
+				{
+					ch.out_messages.pop_front();
+				}
+			}
+		}
+		record.fragments.clear();
+	}
+
+	void NetConnection::ConfirmLoss(uint16_t ack, Clock::time_point now)
+	{
+		for (uint32_t i = LOSS_REORDER_THRESHOLD + 1; i <= LOSS_SCAN_RANGE; ++ i)
+		{
+			uint16_t const sequence = static_cast<uint16_t>(ack - i);
+			auto& record = sent_packets_[sequence % SENT_PACKET_HISTORY];
+			if (!record.valid || record.acked || record.lost || (record.sequence != sequence))
+			{
+				continue;
+			}
+
+			// Packets with only acks are never acknowledged, that's not a loss
+			record.lost = true;
+			if (record.fragments.empty())
+			{
+				continue;
+			}
+
+			++ packets_lost_;
+			if (!record.timed_out)
+			{
+				record.timed_out = true;
+				this->ReleaseFragments(record);
+			}
+
+			// Once per round trip, so a burst of losses counts as one congestion event
+			if (now - last_rate_decrease_ > rtt_)
+			{
+				send_rate_ = std::max(send_rate_ / 2, MIN_SEND_RATE);
+				last_rate_decrease_ = now;
+			}
+		}
+	}
+
+	void NetConnection::DetectTimeOut(Clock::time_point now)
+	{
+		// Only resends. It could be a late ack as well as a loss, so the send rate stays.
+		Clock::duration const timeout = this->ResendTimeout();
+		bool any_timed_out = false;
+		for (auto& record : sent_packets_)
+		{
+			if (!record.valid || record.acked || record.timed_out || (now - record.sent_time < timeout))
+			{
+				continue;
+			}
+
+			// A late ack is still taken, the fragments just go out again meanwhile
+			record.timed_out = true;
+			if (!record.fragments.empty())
+			{
+				this->ReleaseFragments(record);
+				any_timed_out = true;
+			}
+		}
+
+		// Backs off until a packet is acknowledged in time, in case the timeout is below the actual RTT
+		if (any_timed_out)
+		{
+			resend_backoff_ = std::min(resend_backoff_ * 2, MAX_RESEND_BACKOFF);
+		}
+	}
+
+	void NetConnection::ReleaseFragments(SentPacket& record)
+	{
+		for (auto const & ref : record.fragments)
+		{
+			auto& ch = channels_[ref.channel];
+			if (ch.type != NetChannelType::Unreliable)
+			{
+				OutMessage* msg = this->FindOutMessage(ch, ref.id);
+				if ((msg != nullptr) && !msg->fragments[ref.fragment].acked)
+				{
+					msg->fragments[ref.fragment].sent = false;
+				}
+			}
+		}
+	}
+
+	NetConnection::Clock::duration NetConnection::ResendTimeout() const
+	{
+		return std::min(std::max(rtt_ * 2, Clock::duration(std::chrono::milliseconds(50))),
+			Clock::duration(std::chrono::seconds(1))) * resend_backoff_;
+	}
+
+	bool NetConnection::StartsMessage(ReceivedFragment const & fragment) const
+	{
+		auto const & ch = channels_[fragment.channel];
+		if ((fragment.num_fragments == 1) || (ch.partial_messages.find(fragment.id) != ch.partial_messages.end()))
+		{
+			return false;
+		}
+		if (NetChannelType::Unreliable != ch.type)
+		{
+			int32_t const ahead = SequenceDiff(fragment.id, ch.next_receive_id);
+			if ((ahead < 0) || (static_cast<uint32_t>(ahead) >= MESSAGE_WINDOW)
+				|| ch.received_ahead.count(fragment.id) || ch.ordered_ahead.count(fragment.id))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void NetConnection::ReceiveFragment(uint32_t channel, uint16_t id, uint16_t fragment, uint16_t num_fragments,
+		std::span<uint8_t const> data)
+	{
+		auto& ch = channels_[channel];
+		if (NetChannelType::Unreliable == ch.type)
+		{
+			if ((num_fragments > 1) && (ch.partial_messages.find(id) == ch.partial_messages.end()))
+			{
+				for (auto iter = ch.partial_messages.begin(); iter != ch.partial_messages.end();)
+				{
+					int32_t const behind = SequenceDiff(id, iter->first);
+					if (behind >= static_cast<int32_t>(UNRELIABLE_REASSEMBLY_WINDOW))
+					{
+						reassembly_size_ -= static_cast<uint32_t>(iter->second.received.size()) * FRAGMENT_SIZE;
+						iter = ch.partial_messages.erase(iter);
+					}
+					else if (behind <= -static_cast<int32_t>(UNRELIABLE_REASSEMBLY_WINDOW))
+					{
+						// A fragment of a message that's already given up
+						return;
+					}
+					else
+					{
+						++ iter;
+					}
+				}
+			}
+		}
+		else
+		{
+			int32_t const ahead = SequenceDiff(id, ch.next_receive_id);
+			if ((ahead < 0) || (static_cast<uint32_t>(ahead) >= MESSAGE_WINDOW)
+				|| ch.received_ahead.count(id) || ch.ordered_ahead.count(id))
+			{
+				return;
+			}
+		}
+
+		if (1 == num_fragments)
+		{
+			this->Deliver(channel, id, data);
+			return;
+		}
+
+		auto& msg = ch.partial_messages[id];
+		if (msg.received.empty())
+		{
+			msg.received.resize(num_fragments, false);
+			reassembly_size_ += num_fragments * FRAGMENT_SIZE;
+		}
+		if ((msg.received.size() != num_fragments) || msg.received[fragment])
+		{
+			return;
+		}
+		if ((fragment + 1U < num_fragments) && (data.size() != FRAGMENT_SIZE))
+		{
+			return;
+		}
+
+		uint32_t const end = fragment * FRAGMENT_SIZE + static_cast<uint32_t>(data.size());
+		if (msg.data.size() < end)
+		{
+			msg.data.resize(end);
+		}
+
+		msg.received[fragment] = true;
+		++ msg.num_received;
+		std::memcpy(&msg.data[fragment * FRAGMENT_SIZE], data.data(), data.size());
+		if (fragment + 1U == num_fragments)
+		{
+			msg.size = fragment * FRAGMENT_SIZE + static_cast<uint32_t>(data.size());
+		}
+
+		if (msg.num_received == num_fragments)
+		{
+			std::vector<uint8_t> complete;
+			complete.swap(msg.data);
+			complete.resize(msg.size);
+			reassembly_size_ -= num_fragments * FRAGMENT_SIZE;
+			ch.partial_messages.erase(id);
+
+			this->Deliver(channel, id, complete);
+		}
+	}
+
+	void NetConnection::Deliver(uint32_t channel, uint16_t id, std::span<uint8_t const> message)
+	{
+		auto& ch = channels_[channel];
+		switch (ch.type)
+		{
+		case NetChannelType::Unreliable:
+			if (receive_handler_)
+			{
+				receive_handler_(channel, message);
+			}
+			break;
+
+		case NetChannelType::Reliable:
+			if (receive_handler_)
+			{
+				receive_handler_(channel, message);
+			}
+			if (id == ch.next_receive_id)
+			{
+				++ ch.next_receive_id;
+				while (ch.received_ahead.erase(ch.next_receive_id) > 0)
+				{
+					++ ch.next_receive_id;
+				}
+			}
+			else
+			{
+				ch.received_ahead.insert(id);
+			}
+			break;
+
+		case NetChannelType::ReliableOrdered:
+			if (id != ch.next_receive_id)
+			{
+				ch.ordered_ahead.emplace(id, std::vector<uint8_t>(message.begin(), message.end()));
+				break;
+			}
+
+			if (receive_handler_)
+			{
+				receive_handler_(channel, message);
+			}
+			++ ch.next_receive_id;
+			for (;;)
+			{
+				auto iter = ch.ordered_ahead.find(ch.next_receive_id);
+				if (iter == ch.ordered_ahead.end())
+				{
+					break;
+				}
+
+				std::vector<uint8_t> const next = std::move(iter->second);
+				ch.ordered_ahead.erase(iter);
+				++ ch.next_receive_id;
+				if (receive_handler_)
+				{
+					receive_handler_(channel, next);
+				}
+			}
+			break;
+
+		default:
+			KFL_UNREACHABLE("Invalid channel type");
+		}
+	}
+}
@@ -0,0 +1,519 @@
+/**
+ * @file NetEventLoop.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/ErrorHandling.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <boost/assert.hpp>
+
+#if defined(KLAYGE_PLATFORM_LINUX) || defined(KLAYGE_PLATFORM_ANDROID)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include <KlayGE/NetEventLoop.hpp>
+
+namespace
+{
+	// Rounds up, so a timer due in 0.5ms doesn't turn into a busy loop of 0ms waits
+	int WaitMilliseconds(KlayGE::NetEventLoop::Clock::duration d)
+	{
+		if (d <= KlayGE::NetEventLoop::Clock::duration::zero())
+		{
+			return 0;
+		}
+
+		auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(d);
+		if (ms < d)
+		{
+			++ ms;
+		}
+		return static_cast<int>(std::min<std::chrono::milliseconds::rep>(ms.count(), 60 * 1000));
+	}
+}
+
+namespace KlayGE
+{
+	NetEventLoop::NetEventLoop()
+		: recv_buff_(MAX_BATCH * MAX_DATAGRAM_SIZE)
+	{
+#if defined(KLAYGE_PLATFORM_LINUX) || defined(KLAYGE_PLATFORM_ANDROID)
+		epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+		Verify(epoll_fd_ != -1);
+		wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		Verify(wake_fd_ != -1);
+
+		epoll_event ev{};
+		ev.events = EPOLLIN;
+		ev.data.fd = wake_fd_;
+		Verify(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev) != -1);
+#else
+		// Post and Stop wake a poll by sending a byte to this socket
+		wake_socket_.Create(SOCK_DGRAM);
+		wake_socket_.Bind(TransAddr("127.0.0.1", 0));
+		socklen_t len = sizeof(wake_addr_);
+		wake_socket_.SockName(wake_addr_, len);
+		wake_socket_.NonBlock(true);
+#endif
+	}
+
+	NetEventLoop::~NetEventLoop()
+	{
+#if defined(KLAYGE_PLATFORM_LINUX) || defined(KLAYGE_PLATFORM_ANDROID)
+		close(wake_fd_);
+		close(epoll_fd_);
+#endif
+	}
+
+	void NetEventLoop::AddSocket(Socket& socket, ReceiveHandler const & handler)
+	{
+		SOCKET const fd = socket.Handle();
+		BOOST_ASSERT(fd != INVALID_SOCKET);
+		BOOST_ASSERT(sockets_.find(fd) == sockets_.end());
+
+		socket.NonBlock(true);
+		sockets_.emplace(fd, SocketEntry{ &socket, handler });
+
+#if defined(KLAYGE_PLATFORM_LINUX) || defined(KLAYGE_PLATFORM_ANDROID)
+		epoll_event ev{};
+		ev.events = EPOLLIN;
+		ev.data.fd = fd;
+		Verify(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != -1);
+#endif
+	}
+
+	void NetEventLoop::RemoveSocket(Socket& socket)
+	{
+		SOCKET const fd = socket.Handle();
+		auto iter = sockets_.find(fd);
+		if (iter != sockets_.end())
+		{
+#if defined(KLAYGE_PLATFORM_LINUX) || defined(KLAYGE_PLATFORM_ANDROID)
+			epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+#endif
+			sockets_.erase(iter);
+
+			for (auto& send : pending_sends_)
+			{
+				if (send.socket == &socket)
+				{
+					send.socket = nullptr;
+				}
+			}
+		}
+	}
+
+	void NetEventLoop::SendTo(Socket& socket, void const * buf, int len, sockaddr_in const & to)
+	{
+		this->QueueSend(socket, buf, len, &to);
+	}
+
+	void NetEventLoop::Send(Socket& socket, void const * buf, int len)
+	{
+		this->QueueSend(socket, buf, len, nullptr);
+	}
+
+	void NetEventLoop::QueueSend(Socket& socket, void const * buf, int len, sockaddr_in const * to)
+	{
+		BOOST_ASSERT((len >= 0) && (static_cast<uint32_t>(len) <= MAX_DATAGRAM_SIZE));
+
+		PendingSend send;
+		send.socket = &socket;
+		send.connected = (nullptr == to);
+		if (to != nullptr)
+		{
+			send.to = *to;
+		}
+		else
+		{
+			std::memset(&send.to, 0, sizeof(send.to));
+		}
+		send.offset = static_cast<uint32_t>(send_buff_.size());
+		send.size = static_cast<uint32_t>(len);
+		pending_sends_.push_back(send);
+
+		auto const* p = static_cast<uint8_t const *>(buf);
+		send_buff_.insert(send_buff_.end(), p, p + len);
+
+		if (pending_sends_.size() >= MAX_BATCH * 4)
+		{
+			this->Flush();
+		}
+	}
+
+	void NetEventLoop::Flush()
+	{
+		size_t const num_sends = pending_sends_.size();
+
+#if defined(KLAYGE_PLATFORM_LINUX) || defined(KLAYGE_PLATFORM_ANDROID)
+		mmsghdr msgs[MAX_BATCH];
+		iovec iovs[MAX_BATCH];
+
+		size_t begin = 0;
+		while (begin < num_sends)
+		{
+			Socket* socket = pending_sends_[begin].socket;
+
+			// A run of sends on the same socket, at most MAX_BATCH long, is one sendmmsg call
+			size_t end = begin;
+			while ((end < num_sends) && (end - begin < MAX_BATCH) && (pending_sends_[end].socket == socket))
+			{
+				++ end;
+			}
+
+			if (socket != nullptr)
+			{
+				uint32_t const count = static_cast<uint32_t>(end - begin);
+				for (uint32_t i = 0; i < count; ++ i)
+				{
+					auto& send = pending_sends_[begin + i];
+
+					iovs[i].iov_base = &send_buff_[send.offset];
+					iovs[i].iov_len = send.size;
+
+					std::memset(&msgs[i], 0, sizeof(msgs[i]));
+					msgs[i].msg_hdr.msg_iov = &iovs[i];
+					msgs[i].msg_hdr.msg_iovlen = 1;
+					if (!send.connected)
+					{
+						msgs[i].msg_hdr.msg_name = &send.to;
+						msgs[i].msg_hdr.msg_namelen = sizeof(send.to);
+					}
+				}
+
+				uint32_t sent = 0;
+				while (sent < count)
+				{
+					int const ret = sendmmsg(socket->Handle(), &msgs[sent], count - sent, 0);
+					if (ret <= 0)
+					{
+						if ((ret < 0) && (errno == EINTR))
+						{
+							continue;
+						}
+
+						// Send buffer is full, or the datagram is rejected. Skip it, the reliability layer above resends.
+						++ sent;
+					}
+					else
+					{
+						sent += ret;
+					}
+				}
+			}
+
+			begin = end;
+		}
+#else
+		for (size_t i = 0; i < num_sends; ++ i)
+		{
+			auto const & send = pending_sends_[i];
+			if (send.socket != nullptr)
+			{
+				if (send.connected)
+				{
+					send.socket->Send(&send_buff_[send.offset], static_cast<int>(send.size));
+				}
+				else
+				{
+					send.socket->SendTo(&send_buff_[send.offset], static_cast<int>(send.size), send.to);
+				}
+			}
+		}
+#endif
+
+		pending_sends_.clear();
+		send_buff_.clear();
+	}
+
+	uint64_t NetEventLoop::AddTimer(Clock::duration delay, TimerHandler const & handler)
+	{
+		uint64_t const id = next_timer_id_;
+		++ next_timer_id_;
+
+		timers_.emplace(id, handler);
+		timer_queue_.push(TimerEntry{ Clock::now() + delay, id });
+		return id;
+	}
+
+	void NetEventLoop::CancelTimer(uint64_t id)
+	{
+		// The queue entry stays, it's skipped when it comes up
+		timers_.erase(id);
+	}
+
+	void NetEventLoop::Run()
+	{
+		running_ = true;
+		while (!stop_requested_)
+		{
+			this->RunOnce(std::chrono::seconds(1));
+		}
+		this->Flush();
+		stop_requested_ = false;
+		running_ = false;
+	}
+
+	void NetEventLoop::RunOnce(Clock::duration max_wait)
+	{
+		this->RunPosted();
+		this->Wait(max_wait);
+		this->FireTimers();
+		this->RunPosted();
+		this->Flush();
+	}
+
+	void NetEventLoop::Post(std::function<void()> const & func)
+	{
+		{
+			std::lock_guard<std::mutex> lock(posted_mutex_);
+			posted_.push_back(func);
+		}
+		this->Wake();
+	}
+
+	void NetEventLoop::Stop()
+	{
+		stop_requested_ = true;
+		this->Wake();
+	}
+
+	void NetEventLoop::Wait(Clock::duration max_wait)
+	{
+		Clock::duration wait = max_wait;
+		{
+			std::lock_guard<std::mutex> lock(posted_mutex_);
+			if (!posted_.empty())
+			{
+				wait = Clock::duration::zero();
+			}
+		}
+		if (stop_requested_)
+		{
+			wait = Clock::duration::zero();
+		}
+		while (!timer_queue_.empty() && (timers_.find(timer_queue_.top().id) == timers_.end()))
+		{
+			timer_queue_.pop();
+		}
+		if (!timer_queue_.empty())
+		{
+			wait = std::min(wait, timer_queue_.top().deadline - Clock::now());
+		}
+		int const timeout_ms = WaitMilliseconds(wait);
+
+#if defined(KLAYGE_PLATFORM_LINUX) || defined(KLAYGE_PLATFORM_ANDROID)
+		epoll_event events[MAX_BATCH];
+		int const num_events = epoll_wait(epoll_fd_, events, MAX_BATCH, timeout_ms);
+		for (int i = 0; i < num_events; ++ i)
+		{
+			int const fd = events[i].data.fd;
+			if (fd == wake_fd_)
+			{
+				uint64_t count;
+				while (read(wake_fd_, &count, sizeof(count)) > 0)
+				{
+				}
+			}
+			else
+			{
+				this->ReceiveBatch(fd);
+			}
+		}
+#else
+		poll_fds_.resize(sockets_.size() + 1);
+		poll_fds_[0].fd = wake_socket_.Handle();
+		size_t num_fds = 1;
+		for (auto const & socket : sockets_)
+		{
+			poll_fds_[num_fds].fd = socket.first;
+			++ num_fds;
+		}
+		for (auto& pfd : poll_fds_)
+		{
+			pfd.events = POLLIN;
+			pfd.revents = 0;
+		}
+
+#if defined(KLAYGE_PLATFORM_WINDOWS)
+		int const num_ready = WSAPoll(poll_fds_.data(), static_cast<ULONG>(poll_fds_.size()), timeout_ms);
+#else
+		int const num_ready = poll(poll_fds_.data(), static_cast<nfds_t>(poll_fds_.size()), timeout_ms);
+#endif
+		if (num_ready > 0)
+		{
+			if (poll_fds_[0].revents & POLLIN)
+			{
+				char drain[16];
+				while (wake_socket_.Receive(drain, sizeof(drain)) > 0)
+				{
+				}
+			}
+
+			// Handlers may add or remove sockets, so the ready ones are taken out of poll_fds_ first
+			std::vector<SOCKET> ready;
+			for (size_t i = 1; i < poll_fds_.size(); ++ i)
+			{
+				if (poll_fds_[i].revents & (POLLIN | POLLERR | POLLHUP))
+				{
+					ready.push_back(poll_fds_[i].fd);
+				}
+			}
+			for (auto fd : ready)
+			{
+				this->ReceiveBatch(fd);
+			}
+		}
+#endif
+	}
+
+	void NetEventLoop::ReceiveBatch(SOCKET fd)
+	{
+		auto iter = sockets_.find(fd);
+		if (iter == sockets_.end())
+		{
+			return;
+		}
+
+		// The handler can remove its own socket, so it's copied, and the socket is looked up again before every call
+		Socket* socket = iter->second.socket;
+		ReceiveHandler const handler = iter->second.handler;
+
+#if defined(KLAYGE_PLATFORM_LINUX) || defined(KLAYGE_PLATFORM_ANDROID)
+		mmsghdr msgs[MAX_BATCH];
+		iovec iovs[MAX_BATCH];
+		sockaddr_in addrs[MAX_BATCH];
+
+		// A few batches at most, so one busy socket doesn't starve the others. epoll is level triggered, the rest is
+		//  picked up in the next iteration.
+		for (uint32_t round = 0; round < 4; ++ round)
+		{
+			for (uint32_t i = 0; i < MAX_BATCH; ++ i)
+			{
+				iovs[i].iov_base = &recv_buff_[i * MAX_DATAGRAM_SIZE];
+				iovs[i].iov_len = MAX_DATAGRAM_SIZE;
+
+				std::memset(&msgs[i], 0, sizeof(msgs[i]));
+				msgs[i].msg_hdr.msg_iov = &iovs[i];
+				msgs[i].msg_hdr.msg_iovlen = 1;
+				msgs[i].msg_hdr.msg_name = &addrs[i];
+				msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+			}
+
+			int const num_msgs = recvmmsg(fd, msgs, MAX_BATCH, MSG_DONTWAIT, nullptr);
+			if (num_msgs <= 0)
+			{
+				break;
+			}
+
+			for (int i = 0; i < num_msgs; ++ i)
+			{
+				if (sockets_.find(fd) == sockets_.end())
+				{
+					return;
+				}
+
+				uint32_t const size = std::min(static_cast<uint32_t>(msgs[i].msg_len), static_cast<uint32_t>(MAX_DATAGRAM_SIZE));
+				handler(*socket, std::span<uint8_t const>(&recv_buff_[i * MAX_DATAGRAM_SIZE], size), addrs[i]);
+			}
+
+			if (static_cast<uint32_t>(num_msgs) < MAX_BATCH)
+			{
+				break;
+			}
+		}
+#else
+		for (uint32_t i = 0; i < MAX_BATCH; ++ i)
+		{
+			sockaddr_in from;
+			int const size = socket->ReceiveFrom(&recv_buff_[0], MAX_DATAGRAM_SIZE, from);
+			if (size < 0)
+			{
+				break;
+			}
+
+			handler(*socket, std::span<uint8_t const>(&recv_buff_[0], size), from);
+			if (sockets_.find(fd) == sockets_.end())
+			{
+				return;
+			}
+		}
+#endif
+	}
+
+	void NetEventLoop::FireTimers()
+	{
+		auto const now = Clock::now();
+		while (!timer_queue_.empty() && (timer_queue_.top().deadline <= now))
+		{
+			uint64_t const id = timer_queue_.top().id;
+			timer_queue_.pop();
+
+			auto iter = timers_.find(id);
+			if (iter != timers_.end())
+			{
+				TimerHandler const handler = std::move(iter->second);
+				timers_.erase(iter);
+				handler();
+			}
+		}
+	}
+
+	void NetEventLoop::RunPosted()
+	{
+		std::vector<std::function<void()>> posted;
+		{
+			std::lock_guard<std::mutex> lock(posted_mutex_);
+			posted.swap(posted_);
+		}
+
+		for (auto const & func : posted)
+		{
+			func();
+		}
+	}
+
+	void NetEventLoop::Wake()
+	{
+#if defined(KLAYGE_PLATFORM_LINUX) || defined(KLAYGE_PLATFORM_ANDROID)
+		uint64_t const one = 1;
+		ssize_t const ret = write(wake_fd_, &one, sizeof(one));
+		KFL_UNUSED(ret);
+#else
+		char const one = 1;
+		wake_socket_.SendTo(&one, sizeof(one), wake_addr_);
+#endif
+	}
+}
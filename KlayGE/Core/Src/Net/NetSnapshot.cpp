@@ -0,0 +1,398 @@
+/**
+ * @file NetSnapshot.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+
+#include <cstring>
+
+#include <KlayGE/NetMsg.hpp>
+#include <KlayGE/NetSnapshot.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	// [sequence, 2 bytes][has baseline, 1 byte][baseline, 2 bytes if it has one]
+	// [number of removed entities][ID deltas]
+	// [number of changed entities][for each: ID delta, state size, mode, data]
+	// Counts, ID deltas and sizes are varints.
+	uint8_t const MODE_FULL = 0;
+	uint8_t const MODE_XOR = 1;
+
+	// A literal run in the XOR coding ends at this many zeros, shorter gaps cost less to copy than to encode
+	uint32_t const MIN_ZERO_RUN = 3;
+
+	void WriteVarint(std::vector<uint8_t>& out, uint32_t value)
+	{
+		while (value >= 0x80)
+		{
+			out.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	bool ReadVarint(std::span<uint8_t const> data, uint32_t& offset, uint32_t& value)
+	{
+		value = 0;
+		for (uint32_t shift = 0; shift < 35; shift += 7)
+		{
+			if (offset >= static_cast<uint32_t>(data.size()))
+			{
+				return false;
+			}
+
+			uint8_t const byte = data[offset];
+			++ offset;
+			value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void WriteUInt16(std::vector<uint8_t>& out, uint16_t value)
+	{
+		uint8_t bytes[sizeof(value)];
+		std::memcpy(bytes, &value, sizeof(value));
+		out.insert(out.end(), bytes, bytes + sizeof(bytes));
+	}
+
+	bool ReadUInt16(std::span<uint8_t const> data, uint32_t& offset, uint16_t& value)
+	{
+		if (offset + sizeof(value) > static_cast<size_t>(data.size()))
+		{
+			return false;
+		}
+
+		std::memcpy(&value, &data[offset], sizeof(value));
+		offset += sizeof(value);
+		return true;
+	}
+
+	// Pairs of [zero run][literal length][literal bytes], covering the whole state
+	void EncodeXor(std::vector<uint8_t> const & state, std::vector<uint8_t> const & base, std::vector<uint8_t>& out)
+	{
+		uint32_t const size = static_cast<uint32_t>(state.size());
+		uint32_t pos = 0;
+		while (pos < size)
+		{
+			uint32_t zeros = 0;
+			while ((pos + zeros < size) && (state[pos + zeros] == base[pos + zeros]))
+			{
+				++ zeros;
+			}
+			pos += zeros;
+
+			uint32_t literal = 0;
+			uint32_t run = 0;
+			while ((pos + literal + run < size) && (run < MIN_ZERO_RUN))
+			{
+				if (state[pos + literal + run] == base[pos + literal + run])
+				{
+					++ run;
+				}
+				else
+				{
+					literal += run + 1;
+					run = 0;
+				}
+			}
+
+			WriteVarint(out, zeros);
+			WriteVarint(out, literal);
+			for (uint32_t i = 0; i < literal; ++ i)
+			{
+				out.push_back(state[pos + i] ^ base[pos + i]);
+			}
+			pos += literal;
+		}
+	}
+
+	bool DecodeXor(std::span<uint8_t const> data, uint32_t& offset, std::vector<uint8_t>& state)
+	{
+		uint32_t const size = static_cast<uint32_t>(state.size());
+		uint32_t pos = 0;
+		while (pos < size)
+		{
+			uint32_t zeros;
+			uint32_t literal;
+			if (!ReadVarint(data, offset, zeros) || !ReadVarint(data, offset, literal)
+				|| (zeros > size - pos) || (literal > size - pos - zeros)
+				|| (offset + literal > static_cast<uint32_t>(data.size())))
+			{
+				return false;
+			}
+
+			pos += zeros;
+			for (uint32_t i = 0; i < literal; ++ i)
+			{
+				state[pos + i] ^= data[offset + i];
+			}
+			pos += literal;
+			offset += literal;
+		}
+		return true;
+	}
+}
+
+namespace KlayGE
+{
+	NetSnapshotEncoder::NetSnapshotEncoder()
+		: history_(HISTORY_SIZE), history_valid_(HISTORY_SIZE, false)
+	{
+	}
+
+	uint16_t NetSnapshotEncoder::Encode(NetSnapshot::EntityMap const & entities, std::vector<uint8_t>& out)
+	{
+		uint16_t const sequence = next_sequence_;
+		++ next_sequence_;
+
+		NetSnapshot::EntityMap const * base = nullptr;
+		if (has_acked_)
+		{
+			uint32_t const slot = acked_sequence_ % HISTORY_SIZE;
+			if (history_valid_[slot] && (history_[slot].sequence == acked_sequence_)
+				&& (SequenceDiff(sequence, acked_sequence_) < static_cast<int32_t>(HISTORY_SIZE)))
+			{
+				base = &history_[slot].entities;
+			}
+		}
+
+		out.clear();
+		WriteUInt16(out, sequence);
+		out.push_back(base ? 1 : 0);
+		if (base)
+		{
+			WriteUInt16(out, acked_sequence_);
+
+			std::vector<uint32_t> removed;
+			for (auto const & entity : *base)
+			{
+				if (entities.find(entity.first) == entities.end())
+				{
+					removed.push_back(entity.first);
+				}
+			}
+
+			WriteVarint(out, static_cast<uint32_t>(removed.size()));
+			uint32_t prev_id = 0;
+			for (auto const id : removed)
+			{
+				WriteVarint(out, id - prev_id);
+				prev_id = id;
+			}
+		}
+
+		std::vector<uint8_t> xor_data;
+		std::vector<uint8_t> changes;
+		uint32_t num_changed = 0;
+		uint32_t prev_id = 0;
+		for (auto const & entity : entities)
+		{
+			std::vector<uint8_t> const & state = entity.second;
+
+			std::vector<uint8_t> const * base_state = nullptr;
+			if (base)
+			{
+				auto iter = base->find(entity.first);
+				if (iter != base->end())
+				{
+					if (iter->second == state)
+					{
+						continue;
+					}
+					if (iter->second.size() == state.size())
+					{
+						base_state = &iter->second;
+					}
+				}
+			}
+
+			WriteVarint(changes, entity.first - prev_id);
+			prev_id = entity.first;
+			WriteVarint(changes, static_cast<uint32_t>(state.size()));
+
+			xor_data.clear();
+			if (base_state)
+			{
+				EncodeXor(state, *base_state, xor_data);
+			}
+			if (base_state && (xor_data.size() < state.size()))
+			{
+				changes.push_back(MODE_XOR);
+				changes.insert(changes.end(), xor_data.begin(), xor_data.end());
+			}
+			else
+			{
+				changes.push_back(MODE_FULL);
+				changes.insert(changes.end(), state.begin(), state.end());
+			}
+
+			++ num_changed;
+		}
+
+		WriteVarint(out, num_changed);
+		out.insert(out.end(), changes.begin(), changes.end());
+
+		uint32_t const slot = sequence % HISTORY_SIZE;
+		history_[slot].sequence = sequence;
+		history_[slot].entities = entities;
+		history_valid_[slot] = true;
+
+		return sequence;
+	}
+
+	void NetSnapshotEncoder::Ack(uint16_t sequence)
+	{
+		if (!has_acked_ || SequenceGreater(sequence, acked_sequence_))
+		{
+			has_acked_ = true;
+			acked_sequence_ = sequence;
+		}
+	}
+
+
+	NetSnapshotDecoder::NetSnapshotDecoder()
+		: history_(NetSnapshotEncoder::HISTORY_SIZE), history_valid_(NetSnapshotEncoder::HISTORY_SIZE, false)
+	{
+	}
+
+	bool NetSnapshotDecoder::Decode(std::span<uint8_t const> data, NetSnapshot& snapshot)
+	{
+		uint32_t const history_size = NetSnapshotEncoder::HISTORY_SIZE;
+
+		uint32_t offset = 0;
+		uint16_t sequence;
+		if (!ReadUInt16(data, offset, sequence) || (offset >= static_cast<uint32_t>(data.size())))
+		{
+			return false;
+		}
+		if (has_latest_ && !SequenceGreater(sequence, latest_sequence_))
+		{
+			return false;
+		}
+
+		bool const has_base = (data[offset] != 0);
+		++ offset;
+
+		NetSnapshot::EntityMap entities;
+		if (has_base)
+		{
+			uint16_t base_sequence;
+			if (!ReadUInt16(data, offset, base_sequence))
+			{
+				return false;
+			}
+
+			uint32_t const slot = base_sequence % history_size;
+			if (!history_valid_[slot] || (history_[slot].sequence != base_sequence))
+			{
+				return false;
+			}
+			entities = history_[slot].entities;
+
+			uint32_t num_removed;
+			if (!ReadVarint(data, offset, num_removed))
+			{
+				return false;
+			}
+			uint32_t id = 0;
+			for (uint32_t i = 0; i < num_removed; ++ i)
+			{
+				uint32_t delta;
+				if (!ReadVarint(data, offset, delta))
+				{
+					return false;
+				}
+				id += delta;
+				entities.erase(id);
+			}
+		}
+
+		uint32_t num_changed;
+		if (!ReadVarint(data, offset, num_changed))
+		{
+			return false;
+		}
+		uint32_t id = 0;
+		for (uint32_t i = 0; i < num_changed; ++ i)
+		{
+			uint32_t delta;
+			uint32_t size;
+			if (!ReadVarint(data, offset, delta) || !ReadVarint(data, offset, size)
+				|| (offset >= static_cast<uint32_t>(data.size())))
+			{
+				return false;
+			}
+			id += delta;
+
+			uint8_t const mode = data[offset];
+			++ offset;
+
+			std::vector<uint8_t>& state = entities[id];
+			if (MODE_XOR == mode)
+			{
+				if ((state.size() != size) || !DecodeXor(data, offset, state))
+				{
+					return false;
+				}
+			}
+			else
+			{
+				if ((mode != MODE_FULL) || (size > static_cast<uint32_t>(data.size()) - offset))
+				{
+					return false;
+				}
+				state.assign(data.begin() + offset, data.begin() + offset + size);
+				offset += size;
+			}
+		}
+
+		if (offset != static_cast<uint32_t>(data.size()))
+		{
+			return false;
+		}
+
+		has_latest_ = true;
+		latest_sequence_ = sequence;
+
+		uint32_t const slot = sequence % history_size;
+		history_[slot].sequence = sequence;
+		history_[slot].entities = entities;
+		history_valid_[slot] = true;
+
+		snapshot.sequence = sequence;
+		snapshot.entities.swap(entities);
+		return true;
+	}
+}
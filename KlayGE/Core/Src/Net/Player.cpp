@@ -17,7 +17,6 @@
 #include <KlayGE/Lobby.hpp>
 
 #include <algorithm>
-#include <ctime>
 #include <cstring>
 
 #include <KlayGE/NetMsg.hpp>
@@ -38,6 +37,10 @@ namespace
 	private:
 		KlayGE::Player* player_;
 	};
+
+	std::chrono::milliseconds constexpr NOP_INTERVAL(10000);
+	std::chrono::milliseconds constexpr RETRANSMIT_MIN_INTERVAL(100);
+	std::chrono::milliseconds constexpr RETRANSMIT_MAX_INTERVAL(2000);
 }
 
 namespace KlayGE
@@ -45,6 +48,8 @@ namespace KlayGE
 	// 캯
 	/////////////////////////////////////////////////////////////////////////////////
 	Player::Player()
+		: playerID_(0), receiveLoop_(false),
+			nopTimer_(0), retransmitTimer_(0), retransmitInterval_(RETRANSMIT_MIN_INTERVAL)
 	{
 	}
 
@@ -59,56 +64,90 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void Player::ReceiveFunc()
 	{
-		static time_t lastTime = std::time(nullptr);
+		loop_.Run();
+
+		loop_.CancelTimer(nopTimer_);
+		loop_.CancelTimer(retransmitTimer_);
+		nopTimer_ = 0;
+		retransmitTimer_ = 0;
+		loop_.RemoveSocket(socket_);
+	}
 
-		for (;;)
+	void Player::OnReceive(std::span<uint8_t const> data)
+	{
+		if (data.empty())
 		{
-			if (std::time(nullptr) - lastTime >= 10 * 1000)
+			return;
+		}
+
+		if (data.size() >= 5)
+		{
+			uint32_t ID;
+			std::memcpy(&ID, &data[1], sizeof(ID));
+
+			// ɾѷ͵Ϣ
+			bool acked = false;
+			for (auto iter = sendQueue_.begin(); iter != sendQueue_.end();)
 			{
-				char msg(MSG_NOP);
-				socket_.Send(&msg, sizeof(msg));
-				lastTime = std::time(nullptr);
+				std::vector<char>& msg = *iter;
+
+				uint32_t sendID;
+				std::memcpy(&sendID, &msg[1], sizeof(sendID));
+				if (sendID == ID)
+				{
+					iter = sendQueue_.erase(iter);
+					acked = true;
+				}
+				else
+				{
+					++ iter;
+				}
 			}
 
-			if (!sendQueue_.empty())
+			if (acked)
 			{
-				// ͶϢ
-				for (auto const & msg : sendQueue_)
+				retransmitInterval_ = RETRANSMIT_MIN_INTERVAL;
+				if (sendQueue_.empty() && (retransmitTimer_ != 0))
 				{
-					socket_.Send(&msg[0], static_cast<int>(msg.size()));
+					loop_.CancelTimer(retransmitTimer_);
+					retransmitTimer_ = 0;
 				}
 			}
+		}
+
+		if (MSG_QUIT == static_cast<char>(data[0]))
+		{
+			loop_.Stop();
+		}
+	}
 
-			char revBuf[Max_Buffer];
-			memset(revBuf, 0, sizeof(revBuf));
-			if (socket_.Receive(revBuf, sizeof(revBuf)) != -1)
+	void Player::ScheduleNop()
+	{
+		nopTimer_ = loop_.AddTimer(NOP_INTERVAL, [this]()
 			{
-				uint32_t ID;
-				std::memcpy(&ID, &revBuf[1], 4);
+				char msg(MSG_NOP);
+				loop_.Send(socket_, &msg, sizeof(msg));
+				this->ScheduleNop();
+			});
+	}
 
-				// ɾѷ͵Ϣ
-				for (auto iter = sendQueue_.begin(); iter != sendQueue_.end();)
+	void Player::ScheduleRetransmit()
+	{
+		retransmitTimer_ = loop_.AddTimer(retransmitInterval_, [this]()
+			{
+				retransmitTimer_ = 0;
+				if (!sendQueue_.empty())
 				{
-					std::vector<char>& msg = *iter;
-
-					uint32_t sendID;
-					std::memcpy(&sendID, &msg[1], 4);
-					if (sendID == ID)
-					{
-						iter = sendQueue_.erase(iter);
-					}
-					else
+					// ͶϢ
+					for (auto const & msg : sendQueue_)
 					{
-						++ iter;
+						loop_.Send(socket_, &msg[0], static_cast<int>(msg.size()));
 					}
-				}
 
-				if (MSG_QUIT == revBuf[0])
-				{
-					break;
+					retransmitInterval_ = std::min(retransmitInterval_ * 2, RETRANSMIT_MAX_INTERVAL);
+					this->ScheduleRetransmit();
 				}
-			}
-		}
+			});
 	}
 
 	// 
@@ -129,11 +168,21 @@ namespace KlayGE
 
 		socket_.Send(buf, sizeof(buf));
 
-		socket_.Receive(&playerID_, sizeof(playerID_));
-		if (0 == playerID_)
+		char ret[2];
+		if ((socket_.Receive(ret, sizeof(ret)) != sizeof(ret)) || (ret[0] != MSG_JOIN) || (0 == ret[1]))
 		{
 			return false;
 		}
+		playerID_ = ret[1];
+
+		loop_.AddSocket(socket_, [this](Socket& socket, std::span<uint8_t const> data, sockaddr_in const & from)
+			{
+				KFL_UNUSED(socket);
+				KFL_UNUSED(from);
+
+				this->OnReceive(data);
+			});
+		this->ScheduleNop();
 
 		receiveLoop_ = true;
 		receiveThread_ = Context::Instance().ThreadPool()(ReceiveThreadFunc(this));
@@ -151,6 +200,7 @@ namespace KlayGE
 			socket_.Send(&msg, sizeof(msg));
 
 			receiveLoop_ = false;
+			loop_.Stop();
 			receiveThread_();
 		}
 	}
@@ -172,7 +222,7 @@ namespace KlayGE
 		char msg(MSG_GETLOBBYINFO);
 		socket_.Send(&msg, sizeof(msg));
 
-		char buf[18];
+		char buf[19];
 		socket_.Receive(buf, sizeof(buf));
 		if (MSG_GETLOBBYINFO == buf[0])
 		{
@@ -216,4 +266,23 @@ namespace KlayGE
 	{
 		return socket_.Send(buf, size);
 	}
+
+	// ɿֱͣյȷ
+	/////////////////////////////////////////////////////////////////////////////////
+	void Player::SendReliable(void const * buf, int size)
+	{
+		BOOST_ASSERT(size >= 5);
+
+		char const * p = static_cast<char const *>(buf);
+		std::vector<char> msg(p, p + size);
+		loop_.Post([this, msg]()
+			{
+				loop_.Send(socket_, &msg[0], static_cast<int>(msg.size()));
+				sendQueue_.push_back(msg);
+				if (0 == retransmitTimer_)
+				{
+					this->ScheduleRetransmit();
+				}
+			});
+	}
 }
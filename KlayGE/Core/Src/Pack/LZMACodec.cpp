@@ -32,6 +32,8 @@
 #include <KFL/ErrorHandling.hpp>
 #include <KlayGE/ResLoader.hpp>
 #include <KFL/DllLoader.hpp>
+#include <KFL/TaskScheduler.hpp>
+#include <KlayGE/Context.hpp>
 
 #include <cstring>
 #include <mutex>
@@ -113,6 +115,60 @@ namespace
 		static std::unique_ptr<LZMALoader> instance_;
 	};
 	std::unique_ptr<LZMALoader> LZMALoader::instance_;
+
+	// A block framed stream is a LZMABlockFrameHeader, num_blocks uint64_t end offsets of the compressed blocks counting
+	//  from the end of the index, and the blocks. Each block is a single LZMA stream with its own props. A single stream
+	//  starts with the props byte, which is 0x5D for the settings Encode uses, so it never looks like the fourcc.
+	uint32_t const LZMA_BLOCK_FRAME_FOURCC = MakeFourCC<'K', 'L', 'Z', 'B'>::value;
+
+	struct LZMABlockFrameHeader
+	{
+		uint32_t fourcc;
+		uint32_t block_size;
+		uint32_t num_blocks;
+		uint32_t reserved;
+		uint64_t original_len;
+	};
+	static_assert(sizeof(LZMABlockFrameHeader) == 24, "LZMABlockFrameHeader must be 24 bytes");
+
+	// The header comes from the data being decoded, so everything sized by it is checked first
+	LZMABlockFrameHeader ReadBlockFrameHeader(std::span<uint8_t const> input)
+	{
+		LZMABlockFrameHeader header;
+		Verify(input.size() >= static_cast<std::ptrdiff_t>(sizeof(header)));
+		std::memcpy(&header, input.data(), sizeof(header));
+		header.fourcc = LE2Native(header.fourcc);
+		header.block_size = LE2Native(header.block_size);
+		header.num_blocks = LE2Native(header.num_blocks);
+		header.original_len = LE2Native(header.original_len);
+
+		Verify(header.block_size > 0);
+		uint64_t const num_blocks = header.num_blocks;
+		Verify((num_blocks * header.block_size >= header.original_len)
+			&& ((num_blocks == 0) || ((num_blocks - 1) * header.block_size < header.original_len)));
+		Verify(header.num_blocks <= (input.size() - sizeof(header)) / sizeof(uint64_t));
+		return header;
+	}
+
+	// Returns the compressed data of a block
+	std::span<uint8_t const> BlockData(std::span<uint8_t const> input, LZMABlockFrameHeader const & header, uint32_t block_index)
+	{
+		uint8_t const * index = input.data() + sizeof(header);
+		uint8_t const * blocks = index + header.num_blocks * sizeof(uint64_t);
+
+		uint64_t begin = 0;
+		if (block_index > 0)
+		{
+			std::memcpy(&begin, index + (block_index - 1) * sizeof(uint64_t), sizeof(begin));
+			begin = LE2Native(begin);
+		}
+		uint64_t end;
+		std::memcpy(&end, index + block_index * sizeof(uint64_t), sizeof(end));
+		end = LE2Native(end);
+
+		Verify((begin < end) && (end <= static_cast<uint64_t>(input.data() + input.size() - blocks)));
+		return MakeSpan(blocks + begin, static_cast<size_t>(end - begin));
+	}
 }
 
 namespace KlayGE
@@ -193,22 +249,135 @@ namespace KlayGE
 
 	void LZMACodec::Decode(std::vector<uint8_t>& output, std::span<uint8_t const> input, uint64_t original_len)
 	{
-		output.resize(static_cast<uint32_t>(original_len));
+		output.resize(static_cast<size_t>(original_len));
 		this->Decode(&output[0], input, original_len);
 	}
 
 	void LZMACodec::Decode(void* output, std::span<uint8_t const> input, uint64_t original_len)
 	{
-		uint8_t const * p = static_cast<uint8_t const *>(input.data());
+		if (IsBlockFramed(input))
+		{
+			this->DecodeBlocks(output, input, original_len);
+			return;
+		}
 
-		auto in_data = MakeUniquePtr<uint8_t[]>(static_cast<size_t>(input.size()));
-		std::memcpy(in_data.get(), p, static_cast<std::streamsize>(input.size()));
+		Verify(input.size() >= LZMA_PROPS_SIZE);
+
+		uint8_t const * p = static_cast<uint8_t const *>(input.data());
 
 		SizeT s_out_len = static_cast<SizeT>(original_len);
 
 		SizeT s_src_len = static_cast<SizeT>(input.size() - LZMA_PROPS_SIZE);
-		int res = LZMALoader::Instance().LzmaUncompress(static_cast<Byte*>(output), &s_out_len, &in_data[LZMA_PROPS_SIZE], &s_src_len,
-			&in_data[0], LZMA_PROPS_SIZE);
+		int res = LZMALoader::Instance().LzmaUncompress(static_cast<Byte*>(output), &s_out_len, p + LZMA_PROPS_SIZE, &s_src_len,
+			p, LZMA_PROPS_SIZE);
 		Verify(0 == res);
+		Verify(s_out_len == original_len);
+	}
+
+	void LZMACodec::EncodeBlocks(std::vector<uint8_t>& output, std::span<uint8_t const> input, uint32_t block_size)
+	{
+		BOOST_ASSERT(block_size > 0);
+
+		uint64_t const original_len = static_cast<uint64_t>(input.size());
+		uint32_t const num_blocks = static_cast<uint32_t>((original_len + block_size - 1) / block_size);
+
+		// Make sure the library is loaded before the workers need it
+		LZMALoader::Instance();
+
+		std::vector<std::vector<uint8_t>> blocks(num_blocks);
+		Context::Instance().TaskSchedulerInstance().ParallelFor(0, num_blocks, 1,
+			[this, &blocks, input, block_size, original_len](uint32_t sub_begin, uint32_t sub_end)
+			{
+				for (uint32_t i = sub_begin; i < sub_end; ++ i)
+				{
+					uint64_t const offset = static_cast<uint64_t>(i) * block_size;
+					uint64_t const size = std::min<uint64_t>(block_size, original_len - offset);
+					this->Encode(blocks[i], input.subspan(static_cast<std::ptrdiff_t>(offset), static_cast<std::ptrdiff_t>(size)));
+				}
+			});
+
+		size_t const index_size = sizeof(LZMABlockFrameHeader) + num_blocks * sizeof(uint64_t);
+		size_t total_size = index_size;
+		for (auto const & block : blocks)
+		{
+			total_size += block.size();
+		}
+		output.resize(total_size);
+
+		LZMABlockFrameHeader header;
+		header.fourcc = Native2LE(LZMA_BLOCK_FRAME_FOURCC);
+		header.block_size = Native2LE(block_size);
+		header.num_blocks = Native2LE(num_blocks);
+		header.reserved = 0;
+		header.original_len = Native2LE(original_len);
+		std::memcpy(&output[0], &header, sizeof(header));
+
+		uint8_t* index = &output[sizeof(header)];
+		uint8_t* dst = &output[index_size];
+		uint64_t end = 0;
+		for (uint32_t i = 0; i < num_blocks; ++ i)
+		{
+			std::memcpy(dst + end, blocks[i].data(), blocks[i].size());
+
+			end += blocks[i].size();
+			uint64_t const end_le = Native2LE(end);
+			std::memcpy(index + i * sizeof(uint64_t), &end_le, sizeof(end_le));
+		}
+	}
+
+	bool LZMACodec::IsBlockFramed(std::span<uint8_t const> input)
+	{
+		if (input.size() < static_cast<std::ptrdiff_t>(sizeof(LZMABlockFrameHeader)))
+		{
+			return false;
+		}
+
+		uint32_t fourcc;
+		std::memcpy(&fourcc, input.data(), sizeof(fourcc));
+		return LE2Native(fourcc) == LZMA_BLOCK_FRAME_FOURCC;
+	}
+
+	uint32_t LZMACodec::NumBlocks(std::span<uint8_t const> input)
+	{
+		return IsBlockFramed(input) ? ReadBlockFrameHeader(input).num_blocks : 1;
+	}
+
+	uint32_t LZMACodec::BlockSize(std::span<uint8_t const> input)
+	{
+		BOOST_ASSERT(IsBlockFramed(input));
+		return ReadBlockFrameHeader(input).block_size;
+	}
+
+	void LZMACodec::DecodeBlock(std::vector<uint8_t>& output, std::span<uint8_t const> input, uint32_t block_index)
+	{
+		BOOST_ASSERT(IsBlockFramed(input));
+
+		auto const header = ReadBlockFrameHeader(input);
+		Verify(block_index < header.num_blocks);
+
+		uint64_t const offset = static_cast<uint64_t>(block_index) * header.block_size;
+		uint64_t const size = std::min<uint64_t>(header.block_size, header.original_len - offset);
+		output.resize(static_cast<size_t>(size));
+		this->Decode(output.data(), BlockData(input, header, block_index), size);
+	}
+
+	void LZMACodec::DecodeBlocks(void* output, std::span<uint8_t const> input, uint64_t original_len)
+	{
+		auto const header = ReadBlockFrameHeader(input);
+		Verify(header.original_len == original_len);
+
+		LZMALoader::Instance();
+
+		uint8_t* dst = static_cast<uint8_t*>(output);
+		Context::Instance().TaskSchedulerInstance().ParallelFor(0, header.num_blocks, 1,
+			[this, dst, input, &header](uint32_t sub_begin, uint32_t sub_end)
+			{
+				for (uint32_t i = sub_begin; i < sub_end; ++ i)
+				{
+					uint64_t const offset = static_cast<uint64_t>(i) * header.block_size;
+					uint64_t const size = std::min<uint64_t>(header.block_size, header.original_len - offset);
+					this->Decode(dst + offset, BlockData(input, header, i), size);
+				}
+			});
 	}
 }
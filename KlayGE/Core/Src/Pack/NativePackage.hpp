@@ -0,0 +1,78 @@
+/**
+ * @file NativePackage.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef KLAYGE_CORE_NATIVE_PACKAGE_HPP
+#define KLAYGE_CORE_NATIVE_PACKAGE_HPP
+
+#pragma once
+
+#include <KFL/Util.hpp>
+
+namespace KlayGE
+{
+	// A native package (.kpk) is a NativePackageHeader, followed by the entry payloads, followed by the table of contents.
+	//  The table is num_entries NativePackageEntry sorted by lower case path, then all the paths, '/' separated and not
+	//  null terminated. Every payload starts on a NATIVE_PACKAGE_ALIGNMENT boundary, so stored entries can be used
+	//  straight from a memory mapped file. Everything is little endian.
+	uint32_t const NATIVE_PACKAGE_VERSION = 1;
+	uint32_t const NATIVE_PACKAGE_ALIGNMENT = 4096;
+	uint32_t const NATIVE_PACKAGE_FOURCC = MakeFourCC<'K', 'P', 'A', 'K'>::value;
+
+	enum NativePackageCodec : uint8_t
+	{
+		NPC_Stored = 0,
+		NPC_LZMA
+	};
+
+	struct NativePackageHeader
+	{
+		uint32_t fourcc;
+		uint32_t ver;
+		uint32_t num_entries;
+		uint32_t paths_size;
+		uint64_t toc_offset;
+	};
+	static_assert(sizeof(NativePackageHeader) == 24, "NativePackageHeader must be 24 bytes");
+
+	struct NativePackageEntry
+	{
+		uint64_t offset;
+		uint64_t size;
+		uint64_t original_size;
+		uint64_t mtime;
+		uint32_t path_offset;
+		uint16_t path_size;
+		uint8_t codec;
+		uint8_t reserved;
+	};
+	static_assert(sizeof(NativePackageEntry) == 40, "NativePackageEntry must be 40 bytes");
+}
+
+#endif		// KLAYGE_CORE_NATIVE_PACKAGE_HPP
@@ -31,6 +31,7 @@
 #include <KlayGE/KlayGE.hpp>
 #define INITGUID
 #include <KFL/com_ptr.hpp>
+#include <KFL/CustomizedStreamBuf.hpp>
 #include <KFL/ErrorHandling.hpp>
 #include <KFL/ResIdentifier.hpp>
 #include <KFL/StringUtil.hpp>
@@ -41,7 +42,8 @@
 #include <KFL/DllLoader.hpp>
 
 #include <algorithm>
-#include <sstream>
+#include <istream>
+#include <ostream>
 #include <string>
 
 #include <boost/assert.hpp>
@@ -51,7 +53,9 @@
 #include "Streams.hpp"
 #include "ArchiveExtractCallback.hpp"
 #include "ArchiveOpenCallback.hpp"
+#include "NativePackage.hpp"
 
+#include <KlayGE/LZMACodec.hpp>
 #include <KlayGE/Package.hpp>
 
 #ifndef WINAPI
@@ -112,6 +116,49 @@ namespace
 		}
 	}
 
+	// Item is extractable if it isn't an anti-item, and isn't a part of a split file
+	HRESULT IsArchiveItemExtractable(IInArchive* archive, uint32_t index, bool& result)
+	{
+		PROPVARIANT prop;
+		prop.vt = VT_EMPTY;
+		TIFHR(archive->GetProperty(index, kpidIsAnti, &prop));
+		if ((VT_BOOL == prop.vt) && (VARIANT_FALSE == prop.boolVal))
+		{
+			prop.vt = VT_EMPTY;
+			TIFHR(archive->GetProperty(index, kpidPosition, &prop));
+			result = (prop.vt == VT_EMPTY) || ((prop.vt == VT_UI8) && (prop.uhVal.QuadPart == 0));
+		}
+		else
+		{
+			result = false;
+		}
+		return S_OK;
+	}
+
+	HRESULT GetArchiveItemMTime(IInArchive* archive, uint32_t index, uint64_t default_mtime, uint64_t& result)
+	{
+		PROPVARIANT prop;
+		prop.vt = VT_EMPTY;
+		TIFHR(archive->GetProperty(index, kpidMTime, &prop));
+		if (prop.vt == VT_FILETIME)
+		{
+			result = (static_cast<uint64_t>(prop.filetime.dwHighDateTime) << 32) + prop.filetime.dwLowDateTime;
+			result -= 116444736000000000ULL;
+		}
+		else
+		{
+			result = default_mtime;
+		}
+		return S_OK;
+	}
+
+	// The memory is kept alive by its owner, a decoded item shared with the cache or a mapped package
+	ResIdentifierPtr MakeMemResIdentifier(std::string_view res_name, uint64_t mtime, void const * data, size_t size,
+		std::shared_ptr<void const> const & owner)
+	{
+		return MakeSharedPtr<ResIdentifier>(res_name, mtime, std::span<uint8_t const>(static_cast<uint8_t const *>(data), size), owner);
+	}
+
 	class SevenZipLoader
 	{
 	public:
@@ -154,98 +201,309 @@ namespace KlayGE
 	{
 		BOOST_ASSERT(archive_is);
 
+		uint32_t fourcc = 0;
+		archive_is_->seekg(0, std::ios_base::beg);
+		archive_is_->read(&fourcc, sizeof(fourcc));
+		archive_is_->clear();
+		archive_is_->seekg(0, std::ios_base::beg);
+
+		if (LE2Native(fourcc) == NATIVE_PACKAGE_FOURCC)
+		{
+			this->OpenNative();
+		}
+		else
+		{
+			this->Open7z();
+		}
+	}
+
+	void Package::Open7z()
+	{
 		com_ptr<IInArchive> archive;
 		TIFHR(SevenZipLoader::Instance().CreateObject(&CLSID_CFormat7z, &IID_IInArchive, archive.put_void()));
 
-		com_ptr<IInStream> file(new InStream(archive_is), false);
-		com_ptr<IArchiveOpenCallback> ocb(new ArchiveOpenCallback(password), false);
+		com_ptr<IInStream> file(new InStream(archive_is_), false);
+		com_ptr<IArchiveOpenCallback> ocb(new ArchiveOpenCallback(password_), false);
 		TIFHR(archive->Open(file.get(), 0, ocb.get()));
 
-		TIFHR(archive->GetNumberOfItems(&num_items_));
+		uint32_t num_items;
+		TIFHR(archive->GetNumberOfItems(&num_items));
+
+		// The first item of a path wins, as it did when items were searched one by one
+		items_.reserve(num_items);
+		std::string file_path;
+		for (uint32_t i = 0; i < num_items; ++ i)
+		{
+			bool is_folder = true;
+			TIFHR(IsArchiveItemFolder(archive.get(), i, is_folder));
+			if (!is_folder)
+			{
+				TIFHR(GetArchiveItemPath(archive.get(), i, file_path));
+				std::replace(file_path.begin(), file_path.end(), '\\', '/');
+				StringUtil::ToLower(file_path);
+				items_.emplace(file_path, ItemInfo{ i, 0 });
+			}
+		}
+		for (auto iter = items_.begin(); iter != items_.end();)
+		{
+			bool extractable = false;
+			TIFHR(IsArchiveItemExtractable(archive.get(), iter->second.index, extractable));
+			if (extractable)
+			{
+				TIFHR(GetArchiveItemMTime(archive.get(), iter->second.index, archive_is_->Timestamp(), iter->second.mtime));
+				++ iter;
+			}
+			else
+			{
+				iter = items_.erase(iter);
+			}
+		}
 
 		archive_ = std::shared_ptr<IInArchive>(archive.detach(), std::mem_fn(&IInArchive::Release));
 	}
 
+	void Package::OpenNative()
+	{
+		native_ = true;
+
+		NativePackageHeader header;
+		archive_is_->read(&header, sizeof(header));
+		Verify(!archive_is_->operator!());
+		Verify(LE2Native(header.ver) == NATIVE_PACKAGE_VERSION);
+		uint32_t const num_entries = LE2Native(header.num_entries);
+		uint32_t const paths_size = LE2Native(header.paths_size);
+		uint64_t const toc_offset = LE2Native(header.toc_offset);
+
+		archive_is_->seekg(0, std::ios_base::end);
+		int64_t const file_size = archive_is_->tellg();
+		Verify(file_size >= 0);
+
+		// Everything is checked before sizing anything by it, a broken file must not cause huge allocations
+		Verify((toc_offset >= sizeof(header)) && (toc_offset <= static_cast<uint64_t>(file_size)));
+		uint64_t const toc_size = static_cast<uint64_t>(file_size) - toc_offset;
+		Verify(num_entries <= toc_size / sizeof(NativePackageEntry));
+		Verify(paths_size <= toc_size - num_entries * sizeof(NativePackageEntry));
+
+		std::vector<NativePackageEntry> entries(num_entries);
+		std::string paths(paths_size, '\0');
+		archive_is_->seekg(static_cast<int64_t>(toc_offset), std::ios_base::beg);
+		archive_is_->read(entries.data(), entries.size() * sizeof(entries[0]));
+		archive_is_->read(&paths[0], paths.size());
+		Verify(!archive_is_->operator!());
+
+		native_entries_.resize(num_entries);
+		items_.reserve(num_entries);
+		std::string file_path;
+		for (uint32_t i = 0; i < num_entries; ++ i)
+		{
+			NativePackageEntry const & entry = entries[i];
+
+			NativeEntry& native_entry = native_entries_[i];
+			native_entry.offset = LE2Native(entry.offset);
+			native_entry.size = LE2Native(entry.size);
+			native_entry.original_size = LE2Native(entry.original_size);
+			native_entry.codec = entry.codec;
+			Verify((native_entry.offset >= sizeof(header)) && (native_entry.offset <= toc_offset)
+				&& (native_entry.size <= toc_offset - native_entry.offset));
+			Verify((native_entry.codec == NPC_Stored) || (native_entry.codec == NPC_LZMA));
+
+			uint32_t const path_offset = LE2Native(entry.path_offset);
+			uint16_t const path_size = LE2Native(entry.path_size);
+			Verify((path_offset <= paths.size()) && (path_size <= paths.size() - path_offset));
+			file_path = paths.substr(path_offset, path_size);
+			StringUtil::ToLower(file_path);
+			items_.emplace(file_path, ItemInfo{ i, LE2Native(entry.mtime) });
+		}
+
+		// Plain files are mapped by ResLoader. Streams that aren't contiguous are read through seekg/read instead.
+		if (archive_is_->Contiguous())
+		{
+			archive_data_ = archive_is_->Data();
+		}
+	}
+
 	bool Package::Locate(std::string_view extract_file_path)
 	{
-		uint32_t real_index = this->Find(extract_file_path);
-		return (real_index != 0xFFFFFFFF);
+		return this->Find(extract_file_path) != nullptr;
 	}
 
 	ResIdentifierPtr Package::Extract(std::string_view extract_file_path, std::string_view res_name)
 	{
-		uint32_t real_index = this->Find(extract_file_path);
-		if (real_index != 0xFFFFFFFF)
+		ItemInfo const * item = this->Find(extract_file_path);
+		if (item == nullptr)
 		{
-			auto decoded_file = MakeSharedPtr<std::stringstream>();
-			com_ptr<IOutStream> out_stream(new OutStream(decoded_file), false);
-			com_ptr<IArchiveExtractCallback> ecb(new ArchiveExtractCallback(password_, out_stream.get()), false);
-			TIFHR(archive_->Extract(&real_index, 1, false, ecb.get()));
+			return ResIdentifierPtr();
+		}
+		if (native_)
+		{
+			return this->ExtractNative(*item, res_name);
+		}
 
-			PROPVARIANT prop;
-			prop.vt = VT_EMPTY;
-			TIFHR(archive_->GetProperty(real_index, kpidMTime, &prop));
-			uint64_t mtime;
-			if (prop.vt == VT_FILETIME)
-			{
-				mtime = (static_cast<uint64_t>(prop.filetime.dwHighDateTime) << 32)
-					+ prop.filetime.dwLowDateTime;
-				mtime -= 116444736000000000ULL;
-			}
-			else
+		auto data = this->FetchFromCache(item->index);
+		if (!data)
+		{
+			std::lock_guard<std::mutex> lock(archive_mutex_);
+
+			// Another thread could have decoded it while this one was waiting
+			data = this->FetchFromCache(item->index);
+			if (!data)
 			{
-				mtime = archive_is_->Timestamp();
-			}
+				auto decoded = MakeSharedPtr<std::string>();
+				{
+					StringOutputStreamBuf decoded_buff(*decoded);
+					auto decoded_file = MakeSharedPtr<std::ostream>(&decoded_buff);
+					com_ptr<IOutStream> out_stream(new OutStream(decoded_file), false);
+					com_ptr<IArchiveExtractCallback> ecb(new ArchiveExtractCallback(password_, out_stream.get()), false);
+					uint32_t index = item->index;
+					TIFHR(archive_->Extract(&index, 1, false, ecb.get()));
+				}
 
-			return MakeSharedPtr<ResIdentifier>(res_name, mtime, decoded_file);
+				data = decoded;
+				this->AddToCache(item->index, data);
+			}
 		}
-		return ResIdentifierPtr();
+
+		return MakeMemResIdentifier(res_name, item->mtime, data->data(), data->size(), data);
 	}
 
-	uint32_t Package::Find(std::string_view extract_file_path)
+	ResIdentifierPtr Package::ExtractNative(ItemInfo const & item, std::string_view res_name)
 	{
-		uint32_t real_index = 0xFFFFFFFF;
+		NativeEntry const & entry = native_entries_[item.index];
 
-		for (uint32_t i = 0; i < num_items_; ++ i)
+		if ((entry.codec == NPC_Stored) && !archive_data_.empty())
 		{
-			bool is_folder = true;
-			TIFHR(IsArchiveItemFolder(archive_.get(), i, is_folder));
-			if (!is_folder)
+			auto const view = this->MappedView(entry);
+			return MakeMemResIdentifier(res_name, item.mtime, view.data(), view.size(), archive_is_);
+		}
+
+		auto data = this->FetchFromCache(item.index);
+		if (!data)
+		{
+			std::vector<uint8_t> read_buff;
+			std::span<uint8_t const> src;
+			if (!archive_data_.empty())
 			{
-				std::string file_path;
-				TIFHR(GetArchiveItemPath(archive_.get(), i, file_path));
-				std::replace(file_path.begin(), file_path.end(), '\\', '/');
-				if (!StringUtil::CaseInsensitiveLexicographicalCompare(extract_file_path, file_path) &&
-					!StringUtil::CaseInsensitiveLexicographicalCompare(file_path, extract_file_path))
+				src = this->MappedView(entry);
+			}
+			else
+			{
+				read_buff.resize(static_cast<size_t>(entry.size));
+
+				std::lock_guard<std::mutex> lock(archive_mutex_);
+				archive_is_->seekg(static_cast<int64_t>(entry.offset), std::ios_base::beg);
+				archive_is_->read(read_buff.data(), read_buff.size());
+				src = MakeSpan(read_buff);
+			}
+
+			// Unlike 7z, entries decode independently, so several threads can decode at the same time
+			auto decoded = MakeSharedPtr<std::string>();
+			switch (entry.codec)
+			{
+			case NPC_Stored:
+				decoded->assign(reinterpret_cast<char const *>(src.data()), src.size());
+				break;
+
+			case NPC_LZMA:
+				decoded->resize(static_cast<size_t>(entry.original_size));
+				if (!decoded->empty())
 				{
-					real_index = i;
-					break;
+					LZMACodec().Decode(&(*decoded)[0], src, entry.original_size);
 				}
+				break;
+
+			default:
+				KFL_UNREACHABLE("Invalid package codec");
 			}
+
+			data = decoded;
+			this->AddToCache(item.index, data);
 		}
-		if (real_index != 0xFFFFFFFF)
+
+		return MakeMemResIdentifier(res_name, item.mtime, data->data(), data->size(), data);
+	}
+
+	std::span<uint8_t const> Package::MappedView(std::string_view extract_file_path) const
+	{
+		if (native_ && !archive_data_.empty())
 		{
-			PROPVARIANT prop;
-			prop.vt = VT_EMPTY;
-			TIFHR(archive_->GetProperty(real_index, kpidIsAnti, &prop));
-			if ((VT_BOOL == prop.vt) && (VARIANT_FALSE == prop.boolVal))
+			ItemInfo const * item = this->Find(extract_file_path);
+			if (item != nullptr)
 			{
-				prop.vt = VT_EMPTY;
-				TIFHR(archive_->GetProperty(real_index, kpidPosition, &prop));
-				if (prop.vt != VT_EMPTY)
+				NativeEntry const & entry = native_entries_[item->index];
+				if (entry.codec == NPC_Stored)
 				{
-					if ((prop.vt != VT_UI8) || (prop.uhVal.QuadPart != 0))
-					{
-						real_index = 0xFFFFFFFF;
-					}
+					return this->MappedView(entry);
 				}
 			}
-			else
-			{
-				real_index = 0xFFFFFFFF;
-			}
 		}
+		return std::span<uint8_t const>();
+	}
+
+	std::span<uint8_t const> Package::MappedView(NativeEntry const & entry) const
+	{
+		BOOST_ASSERT(entry.offset + entry.size <= archive_data_.size());
+		return archive_data_.subspan(static_cast<size_t>(entry.offset), static_cast<size_t>(entry.size));
+	}
+
+	void Package::CacheBudget(size_t bytes)
+	{
+		std::lock_guard<std::mutex> lock(cache_mutex_);
+		cache_budget_ = bytes;
+		this->TrimCache(cache_budget_);
+	}
+
+	size_t Package::CacheBudget() const
+	{
+		std::lock_guard<std::mutex> lock(cache_mutex_);
+		return cache_budget_;
+	}
+
+	Package::ItemInfo const * Package::Find(std::string_view extract_file_path) const
+	{
+		std::string key(extract_file_path);
+		StringUtil::ToLower(key);
+		auto iter = items_.find(key);
+		return (iter != items_.end()) ? &iter->second : nullptr;
+	}
+
+	std::shared_ptr<std::string const> Package::FetchFromCache(uint32_t index)
+	{
+		std::lock_guard<std::mutex> lock(cache_mutex_);
 
-		return real_index;
+		auto iter = cache_items_.find(index);
+		if (iter == cache_items_.end())
+		{
+			return std::shared_ptr<std::string const>();
+		}
+
+		cache_lru_.splice(cache_lru_.begin(), cache_lru_, iter->second);
+		return iter->second->data;
+	}
+
+	void Package::AddToCache(uint32_t index, std::shared_ptr<std::string const> const & data)
+	{
+		std::lock_guard<std::mutex> lock(cache_mutex_);
+
+		if ((cache_budget_ == 0) || (data->size() > cache_budget_) || (cache_items_.find(index) != cache_items_.end()))
+		{
+			return;
+		}
+
+		cache_lru_.push_front(CachedItem{ index, data });
+		cache_items_.emplace(index, cache_lru_.begin());
+		cache_size_ += data->size();
+		this->TrimCache(cache_budget_);
+	}
+
+	// cache_mutex_ must be held
+	void Package::TrimCache(size_t budget)
+	{
+		while (cache_size_ > budget)
+		{
+			auto const & oldest = cache_lru_.back();
+			cache_size_ -= oldest.data->size();
+			cache_items_.erase(oldest.index);
+			cache_lru_.pop_back();
+		}
 	}
 }
@@ -0,0 +1,177 @@
+/**
+ * @file PackageWriter.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/ErrorHandling.hpp>
+#include <KFL/StringUtil.hpp>
+#include <KFL/Util.hpp>
+#include <KlayGE/LZMACodec.hpp>
+
+#include <algorithm>
+#include <ostream>
+
+#include <boost/assert.hpp>
+
+#include "NativePackage.hpp"
+
+#include <KlayGE/Package.hpp>
+
+namespace KlayGE
+{
+	PackageWriter::PackageWriter(std::ostream& os)
+		: os_(os)
+	{
+		start_pos_ = static_cast<uint64_t>(os_.tellp());
+
+		// Filled in by Finish
+		NativePackageHeader header{};
+		os_.write(reinterpret_cast<char const *>(&header), sizeof(header));
+		pos_ = sizeof(header);
+	}
+
+	void PackageWriter::AddFile(std::string_view path_in_package, std::span<uint8_t const> data, uint64_t mtime, Codec codec)
+	{
+		BOOST_ASSERT(!finished_);
+		BOOST_ASSERT(!path_in_package.empty() && (path_in_package.size() <= 0xFFFF));
+
+		size_t const data_size = static_cast<size_t>(data.size());
+		if (data_size == 0)
+		{
+			codec = Codec::Stored;
+		}
+
+		std::vector<uint8_t> encoded;
+		if (codec != Codec::Stored)
+		{
+			LZMACodec lzma;
+			if (data_size > (1UL << 20))
+			{
+				lzma.EncodeBlocks(encoded, data);
+			}
+			else
+			{
+				lzma.Encode(encoded, data);
+			}
+
+			if ((codec == Codec::Auto) && (encoded.size() > data_size - data_size / 8))
+			{
+				encoded.clear();
+				codec = Codec::Stored;
+			}
+			else
+			{
+				codec = Codec::LZMA;
+			}
+		}
+
+		std::span<uint8_t const> const payload = (codec == Codec::Stored) ? data : std::span<uint8_t const>(encoded.data(), encoded.size());
+
+		this->Pad();
+
+		EntryInfo entry;
+		entry.path = std::string(path_in_package);
+		std::replace(entry.path.begin(), entry.path.end(), '\\', '/');
+		entry.offset = pos_;
+		entry.size = payload.size();
+		entry.original_size = data_size;
+		entry.mtime = mtime;
+		entry.codec = (codec == Codec::Stored) ? NPC_Stored : NPC_LZMA;
+		entries_.push_back(std::move(entry));
+
+		os_.write(reinterpret_cast<char const *>(payload.data()), payload.size());
+		pos_ += payload.size();
+	}
+
+	void PackageWriter::Finish()
+	{
+		BOOST_ASSERT(!finished_);
+		finished_ = true;
+
+		std::vector<std::string> lower_paths(entries_.size());
+		std::vector<uint32_t> order(entries_.size());
+		for (uint32_t i = 0; i < entries_.size(); ++ i)
+		{
+			lower_paths[i] = entries_[i].path;
+			StringUtil::ToLower(lower_paths[i]);
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(),
+			[&lower_paths](uint32_t lhs, uint32_t rhs)
+			{
+				return lower_paths[lhs] < lower_paths[rhs];
+			});
+
+		std::vector<NativePackageEntry> toc(entries_.size());
+		std::string paths;
+		for (uint32_t i = 0; i < order.size(); ++ i)
+		{
+			EntryInfo const & entry = entries_[order[i]];
+
+			NativePackageEntry& toc_entry = toc[i];
+			toc_entry.offset = Native2LE(entry.offset);
+			toc_entry.size = Native2LE(entry.size);
+			toc_entry.original_size = Native2LE(entry.original_size);
+			toc_entry.mtime = Native2LE(entry.mtime);
+			toc_entry.path_offset = Native2LE(static_cast<uint32_t>(paths.size()));
+			toc_entry.path_size = Native2LE(static_cast<uint16_t>(entry.path.size()));
+			toc_entry.codec = entry.codec;
+			toc_entry.reserved = 0;
+
+			paths += entry.path;
+		}
+
+		this->Pad();
+		uint64_t const toc_offset = pos_;
+		os_.write(reinterpret_cast<char const *>(toc.data()), toc.size() * sizeof(toc[0]));
+		os_.write(paths.data(), paths.size());
+		pos_ += toc.size() * sizeof(toc[0]) + paths.size();
+
+		NativePackageHeader header;
+		header.fourcc = Native2LE(NATIVE_PACKAGE_FOURCC);
+		header.ver = Native2LE(NATIVE_PACKAGE_VERSION);
+		header.num_entries = Native2LE(static_cast<uint32_t>(toc.size()));
+		header.paths_size = Native2LE(static_cast<uint32_t>(paths.size()));
+		header.toc_offset = Native2LE(toc_offset);
+
+		os_.seekp(start_pos_, std::ios_base::beg);
+		os_.write(reinterpret_cast<char const *>(&header), sizeof(header));
+		os_.seekp(start_pos_ + pos_, std::ios_base::beg);
+
+		Verify(!os_.fail());
+	}
+
+	void PackageWriter::Pad()
+	{
+		uint64_t const aligned_pos = (pos_ + NATIVE_PACKAGE_ALIGNMENT - 1) & ~static_cast<uint64_t>(NATIVE_PACKAGE_ALIGNMENT - 1);
+		static char const zeros[NATIVE_PACKAGE_ALIGNMENT] = {};
+		os_.write(zeros, aligned_pos - pos_);
+		pos_ = aligned_pos;
+	}
+}
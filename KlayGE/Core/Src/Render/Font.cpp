@@ -774,6 +774,14 @@ namespace
 			return true;
 		}
 
+		uint64_t Key() const override
+		{
+			size_t seed = static_cast<size_t>(this->Type());
+			HashRange(seed, font_desc_.res_name.begin(), font_desc_.res_name.end());
+			HashCombine(seed, font_desc_.flag);
+			return seed;
+		}
+
 		bool Match(ResLoadingDesc const & rhs) const override
 		{
 			if (this->Type() == rhs.Type())
@@ -41,9 +41,9 @@ namespace KlayGE
 	GraphicsBuffer::~GraphicsBuffer() noexcept = default;
 
 
-	SoftwareGraphicsBuffer::SoftwareGraphicsBuffer(uint32_t size_in_byte, bool ref_only)
+	SoftwareGraphicsBuffer::SoftwareGraphicsBuffer(uint32_t size_in_byte, bool ref_only, std::shared_ptr<void const> ref_owner)
 		: GraphicsBuffer(BU_Dynamic, EAH_CPU_Read | EAH_CPU_Write, size_in_byte, 0),
-			ref_only_(ref_only)
+			ref_only_(ref_only), ref_owner_(std::move(ref_owner))
 	{
 	}
 
@@ -85,6 +85,7 @@ namespace KlayGE
 	{
 		subres_data_ = nullptr;
 		data_block_.clear();
+		ref_owner_.reset();
 	}
 
 	bool SoftwareGraphicsBuffer::HWResourceReady() const
@@ -124,6 +124,13 @@ namespace KlayGE
 			return true;
 		}
 
+		uint64_t Key() const override
+		{
+			size_t seed = static_cast<size_t>(this->Type());
+			HashRange(seed, imposter_desc_.res_name.begin(), imposter_desc_.res_name.end());
+			return seed;
+		}
+
 		bool Match(ResLoadingDesc const & rhs) const override
 		{
 			if (this->Type() == rhs.Type())
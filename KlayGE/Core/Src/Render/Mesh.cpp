@@ -37,6 +37,7 @@
 #include <KlayGE/RenderMaterial.hpp>
 #include <KlayGE/DevHelper.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/CustomizedStreamBuf.hpp>
 #include <KlayGE/DeferredRenderingLayer.hpp>
 #include <KlayGE/SceneManager.hpp>
 
@@ -44,6 +45,14 @@
 #include <fstream>
 #include <sstream>
 #include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+#if defined(KLAYGE_AVX_SUPPORT)
+#include <immintrin.h>
+#elif defined(KLAYGE_SSE_SUPPORT)
+#include <xmmintrin.h>
+#endif
 
 #include <KlayGE/Mesh.hpp>
 
@@ -51,7 +60,94 @@ namespace
 {
 	using namespace KlayGE;
 
-	uint32_t const MODEL_BIN_VERSION = 19;
+	uint32_t const MODEL_BIN_VERSION = 20;
+
+	// Since version 20, a .model_bin is a ModelBinHeader, followed by a table of ModelBinChunkEntry, followed by the chunk
+	//  payloads. Every payload starts on a MODEL_BIN_CHUNK_ALIGNMENT boundary. The META chunk has everything except the
+	//  geometry. Each vertex stream is in its own VERT chunk, in stream order, and the indices are in the INDX chunk. Stored
+	//  geometry chunks are used in place, straight from a memory mapped file.
+	uint32_t const MODEL_BIN_CHUNK_ALIGNMENT = 64;
+
+	enum ModelBinChunkCodec : uint32_t
+	{
+		MBCC_Stored = 0,
+		MBCC_LZMA
+	};
+
+	struct ModelBinHeader
+	{
+		uint32_t fourcc;
+		uint32_t ver;
+		uint32_t num_chunks;
+		uint32_t reserved;
+	};
+	static_assert(sizeof(ModelBinHeader) == 16, "ModelBinHeader must be 16 bytes");
+
+	struct ModelBinChunkEntry
+	{
+		uint32_t id;
+		uint32_t codec;
+		uint64_t offset;
+		uint64_t size;
+		uint64_t original_size;
+	};
+	static_assert(sizeof(ModelBinChunkEntry) == 32, "ModelBinChunkEntry must be 32 bytes");
+
+	uint32_t const MODEL_BIN_META_CHUNK = MakeFourCC<'M', 'E', 'T', 'A'>::value;
+	uint32_t const MODEL_BIN_VERTEX_CHUNK = MakeFourCC<'V', 'E', 'R', 'T'>::value;
+	uint32_t const MODEL_BIN_INDEX_CHUNK = MakeFourCC<'I', 'N', 'D', 'X'>::value;
+
+	// Checks the header and the chunk table against the file size. Chunk payloads are checked when they are parsed.
+	bool IsValidModelBin(std::span<uint8_t const> file_data)
+	{
+		uint64_t const file_size = file_data.size();
+
+		ModelBinHeader header;
+		if (file_size < sizeof(header))
+		{
+			return false;
+		}
+		std::memcpy(&header, file_data.data(), sizeof(header));
+		if ((LE2Native(header.fourcc) != MakeFourCC<'K', 'L', 'M', ' '>::value) || (LE2Native(header.ver) != MODEL_BIN_VERSION))
+		{
+			return false;
+		}
+
+		uint32_t const num_chunks = LE2Native(header.num_chunks);
+		uint64_t const toc_end = sizeof(header) + static_cast<uint64_t>(num_chunks) * sizeof(ModelBinChunkEntry);
+		if (toc_end > file_size)
+		{
+			return false;
+		}
+
+		uint32_t num_meta_chunks = 0;
+		for (uint32_t chunk_index = 0; chunk_index < num_chunks; ++ chunk_index)
+		{
+			ModelBinChunkEntry entry;
+			std::memcpy(&entry, file_data.data() + sizeof(header) + chunk_index * sizeof(entry), sizeof(entry));
+			uint64_t const offset = LE2Native(entry.offset);
+			uint64_t const size = LE2Native(entry.size);
+			uint32_t const codec = LE2Native(entry.codec);
+			if ((offset < toc_end) || (offset > file_size) || (size > file_size - offset))
+			{
+				return false;
+			}
+			if ((codec != MBCC_Stored) && (codec != MBCC_LZMA))
+			{
+				return false;
+			}
+			if ((codec == MBCC_Stored) && (LE2Native(entry.original_size) != size))
+			{
+				return false;
+			}
+			if (LE2Native(entry.id) == MODEL_BIN_META_CHUNK)
+			{
+				++ num_meta_chunks;
+			}
+		}
+
+		return num_meta_chunks == 1;
+	}
 
 	class RenderModelLoadingDesc : public ResLoadingDesc
 	{
@@ -116,6 +212,17 @@ namespace
 			}
 
 			model_desc_.sw_model = LoadSoftwareModel(model_desc_.res_name);
+			if (model_desc_.sw_model->IsSkinned())
+			{
+				auto const & kfs = checked_cast<SkinnedModel&>(*model_desc_.sw_model).GetKeyFrameSets();
+				if (kfs)
+				{
+					for (auto& kf : *kfs)
+					{
+						kf.Compress();
+					}
+				}
+			}
 
 			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 			RenderDeviceCaps const & caps = rf.RenderEngineInstance().DeviceCaps();
@@ -136,6 +243,15 @@ namespace
 			return true;
 		}
 
+		uint64_t Key() const override
+		{
+			size_t seed = static_cast<size_t>(this->Type());
+			HashRange(seed, model_desc_.res_name.begin(), model_desc_.res_name.end());
+			HashCombine(seed, model_desc_.access_hint);
+			HashCombine(seed, model_desc_.node_attrib);
+			return seed;
+		}
+
 		bool Match(ResLoadingDesc const & rhs) const override
 		{
 			KFL_UNUSED(rhs);
@@ -341,6 +457,307 @@ namespace
 		ModelDesc model_desc_;
 		std::mutex main_thread_stage_mutex_;
 	};
+
+	uint32_t constexpr NUM_KEY_CHANNELS = 9;
+
+	// Blends key0 toward key1 by factor, for lanes [0, num). Channels 0-3 are the real part, 4-7 the dual part, and 8 the
+	//  scale. The result overwrites key0. The SIMD paths and the scalar tail do the same operations, but the compiler
+	//  may contract either into FMAs, so a joint's result depends on where it lands in a batch up to rounding.
+	void BlendKeys(float* const * key0, float const * const * key1, float const * factor, uint32_t num)
+	{
+		uint32_t i = 0;
+
+#if defined(KLAYGE_AVX_SUPPORT)
+		for (; i + 8 <= num; i += 8)
+		{
+			__m256 const zero = _mm256_setzero_ps();
+			__m256 const sign_mask = _mm256_set1_ps(-0.0f);
+			__m256 const t = _mm256_loadu_ps(factor + i);
+			__m256 const s = _mm256_sub_ps(_mm256_set1_ps(1), t);
+
+			__m256 dot = zero;
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				dot = _mm256_add_ps(dot, _mm256_mul_ps(_mm256_loadu_ps(key0[c] + i), _mm256_loadu_ps(key1[c] + i)));
+			}
+			__m256 const t1 = _mm256_xor_ps(t, _mm256_and_ps(_mm256_cmp_ps(dot, zero, _CMP_LT_OQ), sign_mask));
+
+			__m256 v[8];
+			for (uint32_t c = 0; c < 8; ++ c)
+			{
+				v[c] = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(key0[c] + i), s), _mm256_mul_ps(_mm256_loadu_ps(key1[c] + i), t1));
+			}
+
+			__m256 len_sq = zero;
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				len_sq = _mm256_add_ps(len_sq, _mm256_mul_ps(v[c], v[c]));
+			}
+			__m256 const inv_len = _mm256_div_ps(_mm256_set1_ps(1), _mm256_sqrt_ps(len_sq));
+			for (uint32_t c = 0; c < 8; ++ c)
+			{
+				v[c] = _mm256_mul_ps(v[c], inv_len);
+			}
+
+			__m256 proj = zero;
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				proj = _mm256_add_ps(proj, _mm256_mul_ps(v[c], v[c + 4]));
+			}
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				v[c + 4] = _mm256_sub_ps(v[c + 4], _mm256_mul_ps(v[c], proj));
+			}
+
+			for (uint32_t c = 0; c < 8; ++ c)
+			{
+				_mm256_storeu_ps(key0[c] + i, v[c]);
+			}
+			_mm256_storeu_ps(key0[8] + i,
+				_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(key0[8] + i), s), _mm256_mul_ps(_mm256_loadu_ps(key1[8] + i), t)));
+		}
+#elif defined(KLAYGE_SSE_SUPPORT)
+		for (; i + 4 <= num; i += 4)
+		{
+			__m128 const zero = _mm_setzero_ps();
+			__m128 const sign_mask = _mm_set1_ps(-0.0f);
+			__m128 const t = _mm_loadu_ps(factor + i);
+			__m128 const s = _mm_sub_ps(_mm_set1_ps(1), t);
+
+			__m128 dot = zero;
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				dot = _mm_add_ps(dot, _mm_mul_ps(_mm_loadu_ps(key0[c] + i), _mm_loadu_ps(key1[c] + i)));
+			}
+			__m128 const t1 = _mm_xor_ps(t, _mm_and_ps(_mm_cmplt_ps(dot, zero), sign_mask));
+
+			__m128 v[8];
+			for (uint32_t c = 0; c < 8; ++ c)
+			{
+				v[c] = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(key0[c] + i), s), _mm_mul_ps(_mm_loadu_ps(key1[c] + i), t1));
+			}
+
+			__m128 len_sq = zero;
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				len_sq = _mm_add_ps(len_sq, _mm_mul_ps(v[c], v[c]));
+			}
+			__m128 const inv_len = _mm_div_ps(_mm_set1_ps(1), _mm_sqrt_ps(len_sq));
+			for (uint32_t c = 0; c < 8; ++ c)
+			{
+				v[c] = _mm_mul_ps(v[c], inv_len);
+			}
+
+			__m128 proj = zero;
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				proj = _mm_add_ps(proj, _mm_mul_ps(v[c], v[c + 4]));
+			}
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				v[c + 4] = _mm_sub_ps(v[c + 4], _mm_mul_ps(v[c], proj));
+			}
+
+			for (uint32_t c = 0; c < 8; ++ c)
+			{
+				_mm_storeu_ps(key0[c] + i, v[c]);
+			}
+			_mm_storeu_ps(key0[8] + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(key0[8] + i), s), _mm_mul_ps(_mm_loadu_ps(key1[8] + i), t)));
+		}
+#endif
+
+		for (; i < num; ++ i)
+		{
+			float const t = factor[i];
+			float const s = 1 - t;
+
+			float dot = 0;
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				dot += key0[c][i] * key1[c][i];
+			}
+			float const t1 = (dot < 0) ? -t : t;
+
+			float v[8];
+			for (uint32_t c = 0; c < 8; ++ c)
+			{
+				v[c] = key0[c][i] * s + key1[c][i] * t1;
+			}
+
+			float len_sq = 0;
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				len_sq += v[c] * v[c];
+			}
+			float const inv_len = 1 / std::sqrt(len_sq);
+			for (uint32_t c = 0; c < 8; ++ c)
+			{
+				v[c] *= inv_len;
+			}
+
+			float proj = 0;
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				proj += v[c] * v[c + 4];
+			}
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				v[c + 4] -= v[c] * proj;
+			}
+
+			for (uint32_t c = 0; c < 8; ++ c)
+			{
+				key0[c][i] = v[c];
+			}
+			key0[8][i] = key0[8][i] * s + key1[8][i] * t;
+		}
+	}
+
+	// SoA scratch for sampling num joints. It has the channels of the keys before the frame, the channels of the keys after
+	//  it, and the blend factors. Sampling leaves the result in key0.
+	struct SoAKeys
+	{
+		float* key0[NUM_KEY_CHANNELS];
+		float* key1[NUM_KEY_CHANNELS];
+		float* factor;
+
+		SoAKeys(std::vector<float>& soa, uint32_t num)
+		{
+			soa.resize((NUM_KEY_CHANNELS * 2 + 1) * num);
+			for (uint32_t c = 0; c < NUM_KEY_CHANNELS; ++ c)
+			{
+				key0[c] = soa.data() + c * num;
+				key1[c] = soa.data() + (NUM_KEY_CHANNELS + c) * num;
+			}
+			factor = soa.data() + NUM_KEY_CHANNELS * 2 * num;
+		}
+	};
+
+	void SampleKeys(std::span<KeyFrameSet const> key_frame_sets, float frame, std::span<uint32_t> cursors, SoAKeys const & soa)
+	{
+		uint32_t const num = static_cast<uint32_t>(key_frame_sets.size());
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			KeyFrameSet const & kf = key_frame_sets[i];
+			auto const keys = kf.FindKeys(frame, cursors[i]);
+			auto const k0 = kf.Key(std::get<0>(keys));
+			auto const k1 = kf.Key(std::get<1>(keys));
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				soa.key0[c][i] = std::get<0>(k0)[c];
+				soa.key0[c + 4][i] = std::get<1>(k0)[c];
+				soa.key1[c][i] = std::get<0>(k1)[c];
+				soa.key1[c + 4][i] = std::get<1>(k1)[c];
+			}
+			soa.key0[8][i] = std::get<2>(k0);
+			soa.key1[8][i] = std::get<2>(k1);
+			soa.factor[i] = std::get<2>(keys);
+		}
+
+		BlendKeys(soa.key0, soa.key1, soa.factor, num);
+	}
+
+	void ScatterKeys(SoAKeys const & soa, std::span<Quaternion> reals, std::span<Quaternion> duals, std::span<float> scales)
+	{
+		for (uint32_t i = 0; i < static_cast<uint32_t>(reals.size()); ++ i)
+		{
+			reals[i] = Quaternion(soa.key0[0][i], soa.key0[1][i], soa.key0[2][i], soa.key0[3][i]);
+			duals[i] = Quaternion(soa.key0[4][i], soa.key0[5][i], soa.key0[6][i], soa.key0[7][i]);
+			scales[i] = soa.key0[8][i];
+		}
+	}
+
+	float constexpr SMALLEST_THREE_RANGE = 0.70710678f;
+	uint32_t constexpr ROTATION_COMPONENT_MAX = (1UL << 15) - 1;
+	float constexpr ROTATION_CONSTANT_EPSILON = 1.0f / ROTATION_COMPONENT_MAX;
+	float constexpr TRACK_CONSTANT_EPSILON = 1e-6f;
+	// The three packed components are off by half a step at most, and the rebuilt one by three times that, so the
+	//  quaternion is off by less than 4 half steps, and the angle by less than twice that
+	float constexpr MAX_ROTATION_QUANTIZATION_ERROR = 8 * SMALLEST_THREE_RANGE / ROTATION_COMPONENT_MAX;
+	// Wider translation ranges than this allows are kept in floats
+	float constexpr MAX_TRANSLATION_QUANTIZATION_ERROR = 2.5e-4f;
+
+	// Drops the largest component of a unit quaternion, and packs the other three in 15 bits each. They are within
+	//  [-1/sqrt(2), 1/sqrt(2)]. 2 bits keep which one was dropped, and 1 bit the sign of w.
+	void PackRotation(Quaternion const & rot, uint16_t* packed)
+	{
+		uint32_t largest = 0;
+		for (uint32_t i = 1; i < 4; ++ i)
+		{
+			if (std::abs(rot[i]) > std::abs(rot[largest]))
+			{
+				largest = i;
+			}
+		}
+		float const sign = (rot[largest] < 0) ? -1.0f : 1.0f;
+
+		uint64_t bits = (static_cast<uint64_t>(MathLib::SignBit(rot.w()) < 0) << 47) | (static_cast<uint64_t>(largest) << 45);
+		uint32_t j = 0;
+		for (uint32_t i = 0; i < 4; ++ i)
+		{
+			if (i != largest)
+			{
+				float const v = MathLib::clamp(rot[i] * sign / SMALLEST_THREE_RANGE, -1.0f, 1.0f);
+				uint64_t const q = static_cast<uint64_t>((v * 0.5f + 0.5f) * ROTATION_COMPONENT_MAX + 0.5f);
+				bits |= q << (30 - j * 15);
+				++ j;
+			}
+		}
+
+		packed[0] = static_cast<uint16_t>(bits);
+		packed[1] = static_cast<uint16_t>(bits >> 16);
+		packed[2] = static_cast<uint16_t>(bits >> 32);
+	}
+
+	Quaternion UnpackRotation(uint16_t const * packed)
+	{
+		uint64_t const bits = packed[0] | (static_cast<uint64_t>(packed[1]) << 16) | (static_cast<uint64_t>(packed[2]) << 32);
+		uint32_t const largest = static_cast<uint32_t>(bits >> 45) & 3;
+
+		Quaternion rot;
+		float sum_sq = 0;
+		uint32_t j = 0;
+		for (uint32_t i = 0; i < 4; ++ i)
+		{
+			if (i != largest)
+			{
+				uint32_t const q = static_cast<uint32_t>(bits >> (30 - j * 15)) & ROTATION_COMPONENT_MAX;
+				float const v = (static_cast<float>(q) / ROTATION_COMPONENT_MAX * 2 - 1) * SMALLEST_THREE_RANGE;
+				rot[i] = v;
+				sum_sq += v * v;
+				++ j;
+			}
+		}
+		rot[largest] = std::sqrt(std::max(1 - sum_sq, 0.0f));
+
+		bool const negative_w = ((bits >> 47) & 1) != 0;
+		if (negative_w != (MathLib::SignBit(rot.w()) < 0))
+		{
+			rot = -rot;
+		}
+		return rot;
+	}
+
+	uint16_t QuantizeTrackValue(float v, float min, float extent)
+	{
+		return (extent > 0) ? static_cast<uint16_t>(MathLib::clamp((v - min) / extent, 0.0f, 1.0f) * 65535 + 0.5f) : 0;
+	}
+
+	float DequantizeTrackValue(uint16_t v, float min, float extent)
+	{
+		return min + v * (extent / 65535);
+	}
+
+	bool IsConstantTrack(float min, float max)
+	{
+		return max - min <= TRACK_CONSTANT_EPSILON * std::max({std::abs(min), std::abs(max), 1.0f});
+	}
+
+	// Rounding to the nearest of the 16-bit steps is off by half a step at most in each component
+	float TranslationQuantizationError(float3 const & extent)
+	{
+		return MathLib::length(extent) / (65535 * 2);
+	}
 }
 
 namespace KlayGE
@@ -630,24 +1047,259 @@ namespace KlayGE
 		std::tuple<Quaternion, Quaternion, float> ret;
 		if (frame_id.size() == 1)
 		{
-			ret = std::make_tuple(bind_real[0], bind_dual[0], bind_scale[0]);
+			ret = this->Key(0);
+		}
+		else
+		{
+			uint32_t cursor = 0;
+			auto const keys = this->FindKeys(frame, cursor);
+			float const factor = std::get<2>(keys);
+			auto const key0 = this->Key(std::get<0>(keys));
+			auto const key1 = this->Key(std::get<1>(keys));
+			auto dq = MathLib::sclerp(std::get<0>(key0), std::get<1>(key0), std::get<0>(key1), std::get<1>(key1), factor);
+			ret = std::make_tuple(dq.first, dq.second, MathLib::lerp(std::get<2>(key0), std::get<2>(key1), factor));
+		}
+		return ret;
+	}
+
+	std::tuple<uint32_t, uint32_t, float> KeyFrameSet::FindKeys(float frame, uint32_t& cursor) const
+	{
+		uint32_t const num_keys = static_cast<uint32_t>(frame_id.size());
+		if (num_keys == 1)
+		{
+			cursor = 0;
+			return std::make_tuple(0U, 0U, 0.0f);
+		}
+
+		frame = std::fmod(frame, static_cast<float>(frame_id.back() + 1));
+
+		auto covers = [this, num_keys, frame](uint32_t index)
+			{
+				return (frame_id[index] <= frame) && ((index + 1 == num_keys) || (frame < frame_id[index + 1]));
+			};
+
+		uint32_t index0 = std::min(cursor, num_keys - 1);
+		if (!covers(index0))
+		{
+			if ((index0 + 1 < num_keys) && covers(index0 + 1))
+			{
+				++ index0;
+			}
+			else
+			{
+				auto iter = std::upper_bound(frame_id.begin(), frame_id.end(), frame);
+				index0 = std::max(static_cast<uint32_t>(iter - frame_id.begin()), 1U) - 1;
+			}
+		}
+		cursor = index0;
+
+		// The last key blends toward the first one, which comes again one frame after the last
+		uint32_t index1;
+		float frame1;
+		if (index0 + 1 < num_keys)
+		{
+			index1 = index0 + 1;
+			frame1 = static_cast<float>(frame_id[index1]);
 		}
 		else
 		{
-			frame = std::fmod(frame, static_cast<float>(frame_id.back() + 1));
+			index1 = 0;
+			frame1 = static_cast<float>(frame_id.back() + 1);
+		}
+		float const frame0 = static_cast<float>(frame_id[index0]);
+		return std::make_tuple(index0, index1, (frame - frame0) / (frame1 - frame0));
+	}
+
+	void SampleKeyFrameSets(std::span<KeyFrameSet const> key_frame_sets, float frame, std::span<uint32_t> cursors,
+		std::span<Quaternion> reals, std::span<Quaternion> duals, std::span<float> scales)
+	{
+		uint32_t const num = static_cast<uint32_t>(key_frame_sets.size());
+		BOOST_ASSERT(cursors.size() == key_frame_sets.size());
+		BOOST_ASSERT(reals.size() == key_frame_sets.size());
+		BOOST_ASSERT(duals.size() == key_frame_sets.size());
+		BOOST_ASSERT(scales.size() == key_frame_sets.size());
+
+		// Keys are gathered into SoA, one channel after another, so the blend runs on full SIMD registers
+		static thread_local std::vector<float> soa_buffer;
+		SoAKeys const soa(soa_buffer, num);
+		SampleKeys(key_frame_sets, frame, cursors, soa);
+		ScatterKeys(soa, reals, duals, scales);
+	}
+
+	void KeyFrameSet::Compress()
+	{
+		// A single key is smaller as it is
+		if ((frame_id.size() <= 1) || this->Compressed())
+		{
+			return;
+		}
+
+		uint32_t const num_keys = static_cast<uint32_t>(frame_id.size());
+		BOOST_ASSERT((bind_real.size() == num_keys) && (bind_dual.size() == num_keys) && (bind_scale.size() == num_keys));
+
+		std::vector<float3> translations(num_keys);
+		bool constant_rotation = true;
+		float3 trans_max;
+		float scale_max;
+		for (uint32_t k = 0; k < num_keys; ++ k)
+		{
+			translations[k] = MathLib::udq_to_trans(bind_real[k], bind_dual[k]);
+			if (k == 0)
+			{
+				packed.translation_min = trans_max = translations[k];
+				packed.scale_min = scale_max = bind_scale[k];
+			}
+			else
+			{
+				packed.translation_min = MathLib::minimize(packed.translation_min, translations[k]);
+				trans_max = MathLib::maximize(trans_max, translations[k]);
+				packed.scale_min = std::min(packed.scale_min, bind_scale[k]);
+				scale_max = std::max(scale_max, bind_scale[k]);
+			}
+
+			// q and -q are the same rotation
+			float const sign = (MathLib::dot(bind_real[k], bind_real[0]) < 0) ? -1.0f : 1.0f;
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				if (std::abs(bind_real[k][c] * sign - bind_real[0][c]) > ROTATION_CONSTANT_EPSILON)
+				{
+					constant_rotation = false;
+				}
+			}
+		}
+
+		packed.first_rotation = bind_real[0];
+		packed.rotations.clear();
+		if (!constant_rotation)
+		{
+			packed.rotations.resize(num_keys * 3);
+			for (uint32_t k = 0; k < num_keys; ++ k)
+			{
+				PackRotation(bind_real[k], &packed.rotations[k * 3]);
+			}
+		}
+
+		packed.translations.clear();
+		packed.wide_translations.clear();
+		if (IsConstantTrack(packed.translation_min.x(), trans_max.x()) && IsConstantTrack(packed.translation_min.y(), trans_max.y())
+			&& IsConstantTrack(packed.translation_min.z(), trans_max.z()))
+		{
+			packed.translation_min = translations[0];
+			packed.translation_extent = float3(0, 0, 0);
+		}
+		else
+		{
+			packed.translation_extent = trans_max - packed.translation_min;
+			if (TranslationQuantizationError(packed.translation_extent) <= MAX_TRANSLATION_QUANTIZATION_ERROR)
+			{
+				packed.translations.resize(num_keys * 3);
+				for (uint32_t k = 0; k < num_keys; ++ k)
+				{
+					for (uint32_t c = 0; c < 3; ++ c)
+					{
+						packed.translations[k * 3 + c] =
+							QuantizeTrackValue(translations[k][c], packed.translation_min[c], packed.translation_extent[c]);
+					}
+				}
+			}
+			else
+			{
+				packed.wide_translations = std::move(translations);
+			}
+		}
+
+		packed.scales.clear();
+		if (IsConstantTrack(packed.scale_min, scale_max))
+		{
+			packed.scale_min = bind_scale[0];
+			packed.scale_extent = 0;
+		}
+		else
+		{
+			packed.scale_extent = scale_max - packed.scale_min;
+			packed.scales.resize(num_keys);
+			for (uint32_t k = 0; k < num_keys; ++ k)
+			{
+				packed.scales[k] = QuantizeTrackValue(bind_scale[k], packed.scale_min, packed.scale_extent);
+			}
+		}
+
+		std::vector<Quaternion>().swap(bind_real);
+		std::vector<Quaternion>().swap(bind_dual);
+		std::vector<float>().swap(bind_scale);
+	}
+
+	void KeyFrameSet::Decompress()
+	{
+		if (!this->Compressed())
+		{
+			return;
+		}
+
+		uint32_t const num_keys = static_cast<uint32_t>(frame_id.size());
+		std::vector<Quaternion> reals(num_keys);
+		std::vector<Quaternion> duals(num_keys);
+		std::vector<float> scales(num_keys);
+		for (uint32_t k = 0; k < num_keys; ++ k)
+		{
+			std::tie(reals[k], duals[k], scales[k]) = this->Key(k);
+		}
+
+		bind_real.swap(reals);
+		bind_dual.swap(duals);
+		bind_scale.swap(scales);
+		packed = PackedKeys();
+	}
+
+	std::tuple<Quaternion, Quaternion, float> KeyFrameSet::Key(uint32_t index) const
+	{
+		if (!this->Compressed())
+		{
+			return std::make_tuple(bind_real[index], bind_dual[index], bind_scale[index]);
+		}
+
+		Quaternion const real = packed.rotations.empty() ? packed.first_rotation : UnpackRotation(&packed.rotations[index * 3]);
+
+		float3 trans = packed.translation_min;
+		if (!packed.translations.empty())
+		{
+			for (uint32_t c = 0; c < 3; ++ c)
+			{
+				trans[c] = DequantizeTrackValue(packed.translations[index * 3 + c], packed.translation_min[c],
+					packed.translation_extent[c]);
+			}
+		}
+		else if (!packed.wide_translations.empty())
+		{
+			trans = packed.wide_translations[index];
+		}
 
-			auto iter = std::upper_bound(frame_id.begin(), frame_id.end(), frame);
-			int index = static_cast<int>(iter - frame_id.begin());
+		float const scale = packed.scales.empty() ? packed.scale_min
+			: DequantizeTrackValue(packed.scales[index], packed.scale_min, packed.scale_extent);
 
-			int index0 = index - 1;
-			int index1 = index % frame_id.size();
-			int frame0 = frame_id[index0];
-			int frame1 = frame_id[index1];
-			float factor = (frame - frame0) / (frame1 - frame0);
-			auto dq = MathLib::sclerp(bind_real[index0], bind_dual[index0], bind_real[index1], bind_dual[index1], factor);
-			ret = std::make_tuple(dq.first, dq.second, MathLib::lerp(bind_scale[index0], bind_scale[index1], factor));
+		return std::make_tuple(real, MathLib::quat_trans_to_udq(real, trans), scale);
+	}
+
+	size_t KeyFrameSet::NumBytes() const
+	{
+		size_t num_bytes = frame_id.size() * sizeof(frame_id[0]) + bind_real.size() * sizeof(bind_real[0])
+			+ bind_dual.size() * sizeof(bind_dual[0]) + bind_scale.size() * sizeof(bind_scale[0])
+			+ (packed.rotations.size() + packed.translations.size() + packed.scales.size()) * sizeof(uint16_t)
+			+ packed.wide_translations.size() * sizeof(packed.wide_translations[0]);
+		if (this->Compressed())
+		{
+			num_bytes += sizeof(packed.first_rotation) + sizeof(packed.translation_min) + sizeof(packed.translation_extent)
+				+ sizeof(packed.scale_min) + sizeof(packed.scale_extent);
 		}
-		return ret;
+		return num_bytes;
+	}
+
+	std::tuple<float, float, float> KeyFrameSet::MaxQuantizationError(float3 const & translation_extent, float scale_extent)
+	{
+		// Translations over a narrower range err less, and a wider one isn't quantized at all
+		return std::make_tuple(MAX_ROTATION_QUANTIZATION_ERROR,
+			std::min(TranslationQuantizationError(translation_extent), MAX_TRANSLATION_QUANTIZATION_ERROR),
+			scale_extent / (65535 * 2));
 	}
 
 	AABBox AABBKeyFrameSet::Frame(float frame) const
@@ -710,6 +1362,66 @@ namespace KlayGE
 	}
 
 
+	// The poses recently built from a key frame set. Models cloned from the same source share one, so instances playing the
+	//  same clip in step build each frame once.
+	class SkinnedPoseCache
+	{
+		static uint32_t constexpr MAX_NUM_POSES = 4;
+
+		struct Pose
+		{
+			float frame;
+			std::vector<Quaternion> reals;
+			std::vector<Quaternion> duals;
+			std::vector<float> scales;
+		};
+
+	public:
+		bool Fetch(float frame, std::vector<Quaternion>& reals, std::vector<Quaternion>& duals, std::vector<float>& scales) const
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (auto const & pose : poses_)
+			{
+				if ((pose.frame == frame) && (pose.reals.size() == reals.size()))
+				{
+					reals = pose.reals;
+					duals = pose.duals;
+					scales = pose.scales;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void Store(float frame, std::vector<Quaternion> const & reals, std::vector<Quaternion> const & duals,
+			std::vector<float> const & scales)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			Pose* pose;
+			if (poses_.size() < MAX_NUM_POSES)
+			{
+				poses_.emplace_back();
+				pose = &poses_.back();
+			}
+			else
+			{
+				pose = &poses_[next_];
+				next_ = (next_ + 1) % MAX_NUM_POSES;
+			}
+
+			pose->frame = frame;
+			pose->reals = reals;
+			pose->duals = duals;
+			pose->scales = scales;
+		}
+
+	private:
+		mutable std::mutex mutex_;
+		std::vector<Pose> poses_;
+		uint32_t next_ = 0;
+	};
+
+
 	SkinnedModel::SkinnedModel(SceneNodePtr const & root_node)
 		: RenderModel(root_node),
 			last_frame_(0),
@@ -724,78 +1436,202 @@ namespace KlayGE
 
 	void SkinnedModel::BuildBones(float frame)
 	{
-		for (size_t i = 0; i < joints_.size(); ++ i)
+		if (joint_parents_.size() != joints_.size())
 		{
-			auto& joint = *joints_[i];
-			KeyFrameSet const & kf = (*key_frame_sets_)[i];
+			this->UpdateJointHierarchy();
+		}
 
-			std::tuple<Quaternion, Quaternion, float> key_dq = kf.Frame(frame);
+		size_t const num_joints = joints_.size();
+		pose_reals_.resize(num_joints);
+		pose_duals_.resize(num_joints);
+		pose_scales_.resize(num_joints);
 
-			bool is_root = false;
-			auto* parent_node = joint.BoundSceneNode()->Parent();
-			if (parent_node)
+		if (!animation_layers_.empty())
+		{
+			this->SampleAnimationLayers();
+			this->ComposeJoints();
+		}
+		else if (!pose_cache_ || !pose_cache_->Fetch(frame, pose_reals_, pose_duals_, pose_scales_))
+		{
+			key_frame_cursors_.resize(num_joints, 0);
+			SampleKeyFrameSets(MakeSpan(*key_frame_sets_), frame, MakeSpan(key_frame_cursors_), MakeSpan(pose_reals_),
+				MakeSpan(pose_duals_), MakeSpan(pose_scales_));
+			this->ComposeJoints();
+
+			if (pose_cache_)
+			{
+				pose_cache_->Store(frame, pose_reals_, pose_duals_, pose_scales_);
+			}
+		}
+
+		for (size_t i = 0; i < num_joints; ++ i)
+		{
+			joints_[i]->BindParams(pose_reals_[i], pose_duals_[i], pose_scales_[i]);
+		}
+
+		this->UpdateBinds();
+	}
+
+	void SkinnedModel::SampleAnimationLayers()
+	{
+		uint32_t const num_joints = static_cast<uint32_t>(joints_.size());
+		auto const key_frame_sets = MakeSpan(*key_frame_sets_);
+
+		SoAKeys const pose(pose_soa_, num_joints);
+		SoAKeys const layer_pose(layer_soa_, num_joints);
+		for (size_t l = 0; l < animation_layers_.size(); ++ l)
+		{
+			auto& state = animation_layers_[l];
+			auto const & layer = state.layer;
+			BOOST_ASSERT(layer.joint_mask.empty() || (layer.joint_mask.size() == num_joints));
+
+			uint32_t start_frame = 0;
+			uint32_t end_frame = num_frames_;
+			if (animations_)
+			{
+				start_frame = (*animations_)[layer.animation].start_frame;
+				end_frame = (*animations_)[layer.animation].end_frame;
+			}
+			float frame = layer.frame;
+			if (end_frame > start_frame)
 			{
-				auto* parent_joint = parent_node->FirstComponentOfType<JointComponent>();
-				if (parent_joint == nullptr)
+				frame = std::fmod(frame, static_cast<float>(end_frame - start_frame));
+				if (frame < 0)
 				{
-					is_root = true;
+					frame += end_frame - start_frame;
 				}
 			}
+			frame += start_frame;
 
-			if (is_root)
+			state.key_frame_cursors.resize(num_joints, 0);
+			if (l == 0)
 			{
-				joint.BindParams(std::get<0>(key_dq), std::get<1>(key_dq), std::get<2>(key_dq));
+				SampleKeys(key_frame_sets, frame, MakeSpan(state.key_frame_cursors), pose);
 			}
 			else
 			{
-				auto const& parent = *parent_node->FirstComponentOfType<JointComponent>();
+				SampleKeys(key_frame_sets, frame, MakeSpan(state.key_frame_cursors), layer_pose);
 
-				if (MathLib::dot(std::get<0>(key_dq), parent.BindReal()) < 0)
+				for (uint32_t i = 0; i < num_joints; ++ i)
 				{
-					std::get<0>(key_dq) = -std::get<0>(key_dq);
-					std::get<1>(key_dq) = -std::get<1>(key_dq);
+					pose.factor[i] = layer.joint_mask.empty() ? layer.weight : layer.weight * layer.joint_mask[i];
 				}
+				BlendKeys(pose.key0, layer_pose.key0, pose.factor, num_joints);
+			}
+		}
+
+		ScatterKeys(pose, MakeSpan(pose_reals_), MakeSpan(pose_duals_), MakeSpan(pose_scales_));
+	}
+
+	void SkinnedModel::UpdateJointHierarchy()
+	{
+		uint32_t const num_joints = static_cast<uint32_t>(joints_.size());
+
+		std::unordered_map<JointComponent const *, int32_t> joint_indices;
+		for (uint32_t i = 0; i < num_joints; ++ i)
+		{
+			joint_indices.emplace(joints_[i].get(), static_cast<int32_t>(i));
+		}
 
-				if ((MathLib::SignBit(std::get<2>(key_dq)) > 0) && (MathLib::SignBit(parent.BindScale()) > 0))
+		joint_parents_.assign(num_joints, -1);
+		for (uint32_t i = 0; i < num_joints; ++ i)
+		{
+			auto* node = joints_[i]->BoundSceneNode();
+			auto* parent_node = node ? node->Parent() : nullptr;
+			if (parent_node)
+			{
+				auto iter = joint_indices.find(parent_node->FirstComponentOfType<JointComponent>());
+				if (iter != joint_indices.end())
 				{
-					joint.BindParams(MathLib::mul_real(std::get<0>(key_dq), parent.BindReal()),
-						MathLib::mul_dual(
-							std::get<0>(key_dq), std::get<1>(key_dq) * parent.BindScale(), parent.BindReal(), parent.BindDual()),
-						std::get<2>(key_dq) * parent.BindScale());
+					joint_parents_[i] = iter->second;
 				}
-				else
-				{
-					float const key_scale = std::get<2>(key_dq);
-					float4x4 tmp_mat = MathLib::scaling(MathLib::abs(key_scale), MathLib::abs(key_scale), key_scale)
-						* MathLib::to_matrix(std::get<0>(key_dq))
-						* MathLib::translation(MathLib::udq_to_trans(std::get<0>(key_dq), std::get<1>(key_dq)))
-						* MathLib::scaling(MathLib::abs(parent.BindScale()), MathLib::abs(parent.BindScale()), parent.BindScale())
-						* MathLib::to_matrix(parent.BindReal())
-						* MathLib::translation(MathLib::udq_to_trans(parent.BindReal(), parent.BindDual()));
-
-					float flip = 1;
-					if (MathLib::dot(MathLib::cross(float3(tmp_mat(0, 0), tmp_mat(0, 1), tmp_mat(0, 2)),
-						float3(tmp_mat(1, 0), tmp_mat(1, 1), tmp_mat(1, 2))),
-						float3(tmp_mat(2, 0), tmp_mat(2, 1), tmp_mat(2, 2))) < 0)
-					{
-						tmp_mat(2, 0) = -tmp_mat(2, 0);
-						tmp_mat(2, 1) = -tmp_mat(2, 1);
-						tmp_mat(2, 2) = -tmp_mat(2, 2);
+			}
+		}
 
-						flip = -1;
-					}
+		std::vector<uint32_t> depths(num_joints);
+		for (uint32_t i = 0; i < num_joints; ++ i)
+		{
+			uint32_t depth = 0;
+			for (int32_t p = joint_parents_[i]; (p >= 0) && (depth < num_joints); p = joint_parents_[p])
+			{
+				++ depth;
+			}
+			depths[i] = depth;
+		}
+
+		joint_eval_order_.resize(num_joints);
+		for (uint32_t i = 0; i < num_joints; ++ i)
+		{
+			joint_eval_order_[i] = i;
+		}
+		std::stable_sort(joint_eval_order_.begin(), joint_eval_order_.end(),
+			[&depths](uint32_t lhs, uint32_t rhs)
+			{
+				return depths[lhs] < depths[rhs];
+			});
+	}
+
+	void SkinnedModel::ComposeJoints()
+	{
+		for (uint32_t const i : joint_eval_order_)
+		{
+			int32_t const parent = joint_parents_[i];
+			if (parent < 0)
+			{
+				continue;
+			}
+
+			Quaternion key_real = pose_reals_[i];
+			Quaternion key_dual = pose_duals_[i];
+			float const key_scale = pose_scales_[i];
+
+			Quaternion const parent_real = pose_reals_[parent];
+			Quaternion const parent_dual = pose_duals_[parent];
+			float const parent_scale = pose_scales_[parent];
+
+			if (MathLib::dot(key_real, parent_real) < 0)
+			{
+				key_real = -key_real;
+				key_dual = -key_dual;
+			}
+
+			if ((MathLib::SignBit(key_scale) > 0) && (MathLib::SignBit(parent_scale) > 0))
+			{
+				pose_reals_[i] = MathLib::mul_real(key_real, parent_real);
+				pose_duals_[i] = MathLib::mul_dual(key_real, key_dual * parent_scale, parent_real, parent_dual);
+				pose_scales_[i] = key_scale * parent_scale;
+			}
+			else
+			{
+				float4x4 tmp_mat = MathLib::scaling(MathLib::abs(key_scale), MathLib::abs(key_scale), key_scale)
+					* MathLib::to_matrix(key_real)
+					* MathLib::translation(MathLib::udq_to_trans(key_real, key_dual))
+					* MathLib::scaling(MathLib::abs(parent_scale), MathLib::abs(parent_scale), parent_scale)
+					* MathLib::to_matrix(parent_real)
+					* MathLib::translation(MathLib::udq_to_trans(parent_real, parent_dual));
 
-					float3 scale;
-					Quaternion rot;
-					float3 trans;
-					MathLib::decompose(scale, rot, trans, tmp_mat);
+				float flip = 1;
+				if (MathLib::dot(MathLib::cross(float3(tmp_mat(0, 0), tmp_mat(0, 1), tmp_mat(0, 2)),
+					float3(tmp_mat(1, 0), tmp_mat(1, 1), tmp_mat(1, 2))),
+					float3(tmp_mat(2, 0), tmp_mat(2, 1), tmp_mat(2, 2))) < 0)
+				{
+					tmp_mat(2, 0) = -tmp_mat(2, 0);
+					tmp_mat(2, 1) = -tmp_mat(2, 1);
+					tmp_mat(2, 2) = -tmp_mat(2, 2);
 
-					joint.BindParams(rot, MathLib::quat_trans_to_udq(rot, trans), flip * scale.x());
+					flip = -1;
 				}
+
+				float3 scale;
+				Quaternion rot;
+				float3 trans;
+				MathLib::decompose(scale, rot, trans, tmp_mat);
+
+				pose_reals_[i] = rot;
+				pose_duals_[i] = MathLib::quat_trans_to_udq(rot, trans);
+				pose_scales_[i] = flip * scale.x();
 			}
 		}
-
-		this->UpdateBinds();
 	}
 
 	void SkinnedModel::UpdateBinds()
@@ -865,6 +1701,60 @@ namespace KlayGE
 		this->SetToEffect();
 	}
 
+	void SkinnedModel::AttachKeyFrameSets(std::shared_ptr<std::vector<KeyFrameSet>> const & kf)
+	{
+		if (key_frame_sets_ != kf)
+		{
+			key_frame_sets_ = kf;
+			key_frame_cursors_.clear();
+			pose_cache_ = kf ? MakeSharedPtr<SkinnedPoseCache>() : nullptr;
+		}
+	}
+
+	uint32_t SkinnedModel::AddAnimationLayer(uint32_t animation, float weight, std::vector<float> joint_mask)
+	{
+		BOOST_ASSERT(animation < this->NumAnimations());
+
+		AnimationLayerState state;
+		state.layer.animation = animation;
+		state.layer.frame = 0;
+		state.layer.weight = weight;
+		state.layer.joint_mask = std::move(joint_mask);
+		animation_layers_.push_back(std::move(state));
+
+		return static_cast<uint32_t>(animation_layers_.size() - 1);
+	}
+
+	void SkinnedModel::ClearAnimationLayers()
+	{
+		animation_layers_.clear();
+	}
+
+	void SkinnedModel::UpdateAnimationLayers()
+	{
+		this->BuildBones(last_frame_);
+	}
+
+	std::vector<float> SkinnedModel::JointSubtreeMask(uint32_t root_joint)
+	{
+		if (joint_parents_.size() != joints_.size())
+		{
+			this->UpdateJointHierarchy();
+		}
+
+		std::vector<float> mask(joints_.size(), 0.0f);
+		mask[root_joint] = 1;
+		for (uint32_t const i : joint_eval_order_)
+		{
+			int32_t const parent = joint_parents_[i];
+			if ((parent >= 0) && (mask[parent] > 0))
+			{
+				mask[i] = 1;
+			}
+		}
+		return mask;
+	}
+
 	float SkinnedModel::GetFrame() const
 	{
 		return last_frame_;
@@ -971,6 +1861,7 @@ namespace KlayGE
 			}
 			skinned_model.AssignJoints(joints.begin(), joints.end());
 			skinned_model.AttachKeyFrameSets(src_skinned_model.GetKeyFrameSets());
+			skinned_model.pose_cache_ = src_skinned_model.pose_cache_;
 
 			auto& root_node = *skinned_model.RootNode();
 			for (uint32_t i = 0; i < root_node.NumComponents(); ++i)
@@ -1075,56 +1966,64 @@ namespace KlayGE
 		char const * JIT_EXT_NAME = ".model_bin";
 
 		std::string runtime_name(model_name);
-		if (std::filesystem::path(runtime_name).extension() != JIT_EXT_NAME)
+		std::string metadata_name;
+		bool const from_source = (std::filesystem::path(runtime_name).extension() != JIT_EXT_NAME);
+		if (from_source)
 		{
-			std::string const metadata_name = runtime_name + ".kmeta";
+			metadata_name = runtime_name + ".kmeta";
 			runtime_name += JIT_EXT_NAME;
+		}
+
+		// Plain files come mapped, and stored items in packages come straight from the package. Stored chunks keep the
+		//  resource alive.
+		ResIdentifierPtr file_owner;
+		if (!ResLoader::Instance().Locate(runtime_name).empty())
+		{
+			file_owner = ResLoader::Instance().Open(runtime_name);
+		}
 
-			bool jit = false;
-			if (ResLoader::Instance().Locate(runtime_name).empty())
+		// A .model_bin given by name is checked the same way, but can only be rebuilt when the source is known
+		bool jit = !file_owner || !IsValidModelBin(file_owner->Data());
+		if (!jit && from_source)
+		{
+			uint64_t const runtime_file_timestamp = file_owner->Timestamp();
+			uint64_t const input_file_timestamp = ResLoader::Instance().Timestamp(model_name);
+			uint64_t const metadata_timestamp = ResLoader::Instance().Timestamp(metadata_name);
+			if (((input_file_timestamp > 0) && (runtime_file_timestamp < input_file_timestamp))
+				|| ((metadata_timestamp > 0) && (runtime_file_timestamp < metadata_timestamp)))
 			{
 				jit = true;
 			}
-			else
-			{
-				ResIdentifierPtr runtime_file = ResLoader::Instance().Open(runtime_name);
-				uint32_t fourcc;
-				runtime_file->read(&fourcc, sizeof(fourcc));
-				fourcc = LE2Native(fourcc);
-				uint32_t ver;
-				runtime_file->read(&ver, sizeof(ver));
-				ver = LE2Native(ver);
-				if ((fourcc != MakeFourCC<'K', 'L', 'M', ' '>::value) || (ver != MODEL_BIN_VERSION))
-				{
-					jit = true;
-				}
-				else
-				{
-					uint64_t const runtime_file_timestamp = runtime_file->Timestamp();
-					uint64_t const input_file_timestamp = ResLoader::Instance().Timestamp(model_name);
-					uint64_t const metadata_timestamp = ResLoader::Instance().Timestamp(metadata_name);
-					if (((input_file_timestamp > 0) && (runtime_file_timestamp < input_file_timestamp))
-						|| ((metadata_timestamp > 0) && (runtime_file_timestamp < metadata_timestamp)))
-					{
-						jit = true;
-					}
-				}
-			}
+		}
 
-			if (jit)
-			{
+		if (jit)
+		{
 #if KLAYGE_IS_DEV_PLATFORM
+			if (from_source)
+			{
 				RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 				RenderDeviceCaps const & caps = rf.RenderEngineInstance().DeviceCaps();
 
 				return Context::Instance().DevHelperInstance().ConvertModel(model_name, metadata_name, runtime_name, &caps);
-#else
-				LogError() << "Could NOT locate " << runtime_name << std::endl;
-				return RenderModelPtr();
+			}
 #endif
+			if (file_owner)
+			{
+				LogError() << runtime_name << " is out of date or NOT a valid model" << std::endl;
 			}
+			else
+			{
+				LogError() << "Could NOT locate " << runtime_name << std::endl;
+			}
+			return RenderModelPtr();
 		}
 
+		auto const invalid_model = [&runtime_name]()
+		{
+			LogError() << runtime_name << " is NOT a valid model" << std::endl;
+			return RenderModelPtr();
+		};
+
 		struct NodeInfo
 		{
 			SceneNodePtr node;
@@ -1132,11 +2031,17 @@ namespace KlayGE
 			int16_t joint_index;
 		};
 
+		struct Chunk
+		{
+			std::span<uint8_t const> data;
+			std::shared_ptr<void const> owner;
+		};
+
 		std::vector<RenderMaterialPtr> mtls;
 		std::vector<VertexElement> merged_ves;
 		char all_is_index_16_bit;
-		std::vector<std::vector<uint8_t>> merged_buff;
-		std::vector<uint8_t> merged_indices;
+		std::vector<Chunk> merged_buff;
+		Chunk merged_indices;
 		std::vector<std::string> mesh_names;
 		std::vector<int32_t> mtl_ids;
 		std::vector<uint32_t> mesh_lods;
@@ -1154,30 +2059,62 @@ namespace KlayGE
 		uint32_t frame_rate = 0;
 		std::vector<std::shared_ptr<AABBKeyFrameSet>> frame_pos_bbs;
 
-		ResIdentifierPtr runtime_file = ResLoader::Instance().Open(runtime_name);
+		std::span<uint8_t const> const file_data = file_owner->Data();
 
-		uint32_t fourcc;
-		runtime_file->read(&fourcc, sizeof(fourcc));
-		fourcc = LE2Native(fourcc);
-		BOOST_ASSERT((fourcc == MakeFourCC<'K', 'L', 'M', ' '>::value));
+		ModelBinHeader header;
+		std::memcpy(&header, file_data.data(), sizeof(header));
+		uint32_t const num_chunks = LE2Native(header.num_chunks);
 
-		uint32_t ver;
-		runtime_file->read(&ver, sizeof(ver));
-		ver = LE2Native(ver);
-		BOOST_ASSERT(MODEL_BIN_VERSION == ver);
+		LZMACodec lzma;
+		Chunk meta;
+		for (uint32_t chunk_index = 0; chunk_index < num_chunks; ++ chunk_index)
+		{
+			ModelBinChunkEntry entry;
+			std::memcpy(&entry, file_data.data() + sizeof(header) + chunk_index * sizeof(entry), sizeof(entry));
+			entry.id = LE2Native(entry.id);
+			entry.codec = LE2Native(entry.codec);
+			entry.offset = LE2Native(entry.offset);
+			entry.size = LE2Native(entry.size);
+			entry.original_size = LE2Native(entry.original_size);
+
+			Chunk chunk;
+			auto const stored = file_data.subspan(static_cast<std::ptrdiff_t>(entry.offset), static_cast<std::ptrdiff_t>(entry.size));
+			if (entry.codec == MBCC_LZMA)
+			{
+				auto decoded_chunk = MakeSharedPtr<std::vector<uint8_t>>();
+				lzma.Decode(*decoded_chunk, stored, entry.original_size);
+				chunk.data = MakeSpan(*decoded_chunk);
+				chunk.owner = decoded_chunk;
+			}
+			else
+			{
+				chunk.data = stored;
+				chunk.owner = file_owner;
+			}
 
-		std::shared_ptr<std::stringstream> ss = MakeSharedPtr<std::stringstream>();
+			switch (entry.id)
+			{
+			case MODEL_BIN_META_CHUNK:
+				meta = std::move(chunk);
+				break;
 
-		uint64_t original_len, len;
-		runtime_file->read(&original_len, sizeof(original_len));
-		original_len = LE2Native(original_len);
-		runtime_file->read(&len, sizeof(len));
-		len = LE2Native(len);
+			case MODEL_BIN_VERTEX_CHUNK:
+				merged_buff.push_back(std::move(chunk));
+				break;
 
-		LZMACodec lzma;
-		lzma.Decode(*ss, runtime_file, len, original_len);
+			case MODEL_BIN_INDEX_CHUNK:
+				merged_indices = std::move(chunk);
+				break;
 
-		ResIdentifierPtr decoded = MakeSharedPtr<ResIdentifier>(runtime_file->ResName(), runtime_file->Timestamp(), ss);
+			default:
+				// Unknown chunks are skipped, so newer writers can add optional ones
+				break;
+			}
+		}
+
+		auto meta_buff = MakeSharedPtr<MemInputStreamBuf>(meta.data.data(), static_cast<std::streamsize>(meta.data.size()));
+		ResIdentifierPtr decoded = MakeSharedPtr<ResIdentifier>(runtime_name, 0, MakeSharedPtr<std::istream>(meta_buff.get()),
+			meta_buff);
 
 		uint32_t num_mtls;
 		decoded->read(&num_mtls, sizeof(num_mtls));
@@ -1198,6 +2135,14 @@ namespace KlayGE
 		decoded->read(&num_animations, sizeof(num_animations));
 		num_animations = LE2Native(num_animations);
 
+		// Every record takes at least one byte, so larger counts can only come from a corrupted file
+		uint64_t const meta_size = meta.data.size();
+		if ((num_nodes == 0) || (num_mtls > meta_size) || (num_meshes > meta_size) || (num_nodes > meta_size)
+			|| (num_joints > meta_size) || (num_kfs > meta_size) || (num_animations > meta_size))
+		{
+			return invalid_model();
+		}
+
 		mtls.resize(num_mtls);
 		for (uint32_t mtl_index = 0; mtl_index < num_mtls; ++ mtl_index)
 		{
@@ -1303,6 +2248,10 @@ namespace KlayGE
 		uint32_t num_merged_ves;
 		decoded->read(&num_merged_ves, sizeof(num_merged_ves));
 		num_merged_ves = LE2Native(num_merged_ves);
+		if (num_merged_ves != merged_buff.size())
+		{
+			return invalid_model();
+		}
 		merged_ves.resize(num_merged_ves);
 		for (size_t i = 0; i < merged_ves.size(); ++ i)
 		{
@@ -1322,14 +2271,17 @@ namespace KlayGE
 
 		int const index_elem_size = all_is_index_16_bit ? 2 : 4;
 
-		merged_buff.resize(merged_ves.size());
 		for (size_t i = 0; i < merged_buff.size(); ++ i)
 		{
-			merged_buff[i].resize(all_num_vertices * merged_ves[i].element_size());
-			decoded->read(&merged_buff[i][0], merged_buff[i].size() * sizeof(merged_buff[i][0]));
+			if (merged_buff[i].data.size() != static_cast<uint64_t>(all_num_vertices) * merged_ves[i].element_size())
+			{
+				return invalid_model();
+			}
+		}
+		if (merged_indices.data.size() != static_cast<uint64_t>(all_num_indices) * index_elem_size)
+		{
+			return invalid_model();
 		}
-		merged_indices.resize(all_num_indices * index_elem_size);
-		decoded->read(&merged_indices[0], merged_indices.size() * sizeof(merged_indices[0]));
 
 		mesh_names.resize(num_meshes);
 		mtl_ids.resize(num_meshes);
@@ -1405,6 +2357,10 @@ namespace KlayGE
 
 			if (parent_index >= 0)
 			{
+				if (parent_index >= &node - nodes.data())
+				{
+					return invalid_model();
+				}
 				nodes[parent_index].node->AddChild(node.node);
 			}
 
@@ -1587,6 +2543,25 @@ namespace KlayGE
 			}
 		}
 
+		if (!*decoded)
+		{
+			return invalid_model();
+		}
+		for (auto const& node : nodes)
+		{
+			for (auto const mesh_index : node.mesh_indices)
+			{
+				if (mesh_index >= num_meshes)
+				{
+					return invalid_model();
+				}
+			}
+			if (node.joint_index >= static_cast<int32_t>(num_joints))
+			{
+				return invalid_model();
+			}
+		}
+
 		bool const skinned = kfs && !kfs->empty();
 
 		RenderModelPtr model;
@@ -1605,16 +2580,19 @@ namespace KlayGE
 			model->GetMaterial(mtl_index) = mtls[mtl_index];
 		}
 
+		// The software buffers reference the chunks directly, no copy is made
 		std::vector<GraphicsBufferPtr> merged_vbs(merged_buff.size());
 		for (size_t i = 0; i < merged_buff.size(); ++ i)
 		{
-			auto vb = MakeSharedPtr<SoftwareGraphicsBuffer>(static_cast<uint32_t>(merged_buff[i].size()), false);
-			vb->CreateHWResource(merged_buff[i].data());
+			auto vb = MakeSharedPtr<SoftwareGraphicsBuffer>(static_cast<uint32_t>(merged_buff[i].data.size()), true,
+				merged_buff[i].owner);
+			vb->CreateHWResource(merged_buff[i].data.data());
 
 			merged_vbs[i] = vb;
 		}
-		auto merged_ib = MakeSharedPtr<SoftwareGraphicsBuffer>(static_cast<uint32_t>(merged_indices.size()), false);
-		merged_ib->CreateHWResource(merged_indices.data());
+		auto merged_ib = MakeSharedPtr<SoftwareGraphicsBuffer>(static_cast<uint32_t>(merged_indices.data.size()), true,
+			merged_indices.owner);
+		merged_ib->CreateHWResource(merged_indices.data.data());
 
 		uint32_t mesh_lod_index = 0;
 		std::vector<StaticMeshPtr> meshes(num_meshes);
@@ -1777,9 +2755,7 @@ namespace KlayGE
 		std::vector<AABBox> const & pos_bbs, std::vector<AABBox> const & tc_bbs,
 		std::vector<uint32_t> const & mesh_num_vertices, std::vector<uint32_t> const & mesh_base_vertices,
 		std::vector<uint32_t> const & mesh_num_indices, std::vector<uint32_t> const & mesh_start_indices,
-		std::vector<VertexElement> const & merged_ves,
-		std::vector<std::vector<uint8_t>> const & merged_vertices, std::vector<uint8_t> const & merged_indices,
-		char is_index_16_bit, std::ostream& os)
+		std::vector<VertexElement> const & merged_ves, char is_index_16_bit, std::ostream& os)
 	{
 		uint32_t num_merged_ves = Native2LE(static_cast<uint32_t>(merged_ves.size()));
 		os.write(reinterpret_cast<char*>(&num_merged_ves), sizeof(num_merged_ves));
@@ -1797,12 +2773,6 @@ namespace KlayGE
 		os.write(reinterpret_cast<char*>(&num_indices), sizeof(num_indices));
 		os.write(&is_index_16_bit, sizeof(is_index_16_bit));
 
-		for (size_t i = 0; i < merged_vertices.size(); ++ i)
-		{
-			os.write(reinterpret_cast<char const *>(&merged_vertices[i][0]), merged_vertices[i].size() * sizeof(merged_vertices[i][0]));
-		}
-		os.write(reinterpret_cast<char const *>(&merged_indices[0]), merged_indices.size() * sizeof(merged_indices[0]));
-
 		uint32_t mesh_lod_index = 0;
 		for (uint32_t mesh_index = 0; mesh_index < mesh_names.size(); ++ mesh_index)
 		{
@@ -1991,9 +2961,10 @@ namespace KlayGE
 
 			for (size_t j = 0; j < kfs[i].frame_id.size(); ++ j)
 			{
-				Quaternion bind_real = kfs[i].bind_real[j];
-				Quaternion bind_dual = kfs[i].bind_dual[j];
-				float bind_scale = kfs[i].bind_scale[j];
+				Quaternion bind_real;
+				Quaternion bind_dual;
+				float bind_scale;
+				std::tie(bind_real, bind_dual, bind_scale) = kfs[i].Key(static_cast<uint32_t>(j));
 
 				uint32_t frame_id = Native2LE(kfs[i].frame_id[j]);
 				os.write(reinterpret_cast<char*>(&frame_id), sizeof(frame_id));
@@ -2063,7 +3034,7 @@ namespace KlayGE
 		std::vector<SceneNode const *> const & nodes, std::vector<Renderable const *> const & renderables,
 		std::vector<JointComponent const*> const & joints, std::shared_ptr<std::vector<Animation>> const & animations,
 		std::shared_ptr<std::vector<KeyFrameSet>> const & kfs, uint32_t num_frames, uint32_t frame_rate,
-		std::vector<std::shared_ptr<AABBKeyFrameSet>> const & frame_pos_bbs)
+		std::vector<std::shared_ptr<AABBKeyFrameSet>> const & frame_pos_bbs, bool compress_geometry)
 	{
 		std::ostringstream ss;
 
@@ -2096,7 +3067,7 @@ namespace KlayGE
 		{
 			WriteMeshesChunk(mesh_names, mtl_ids, mesh_lods, pos_bbs, tc_bbs,
 				mesh_num_vertices, mesh_base_vertices, mesh_num_indices, mesh_base_indices,
-				merged_ves, merged_buffs, merged_indices, all_is_index_16_bit, ss);
+				merged_ves, all_is_index_16_bit, ss);
 		}
 
 		if (!nodes.empty())
@@ -2118,31 +3089,89 @@ namespace KlayGE
 			WriteAnimationsChunk(*animations, ss);
 		}
 
+		struct Chunk
+		{
+			uint32_t id;
+			uint32_t codec;
+			std::span<uint8_t const> original;
+			std::vector<uint8_t> compressed;
+		};
+
+		auto const & ss_str = ss.str();
+
+		std::vector<Chunk> chunks;
+		chunks.push_back({MODEL_BIN_META_CHUNK, MBCC_LZMA, MakeSpan(reinterpret_cast<uint8_t const *>(ss_str.data()), ss_str.size())});
+		uint32_t const geometry_codec = compress_geometry ? MBCC_LZMA : MBCC_Stored;
+		for (auto const & buff : merged_buffs)
+		{
+			chunks.push_back({MODEL_BIN_VERTEX_CHUNK, geometry_codec, MakeSpan(buff)});
+		}
+		if (!mesh_names.empty())
+		{
+			chunks.push_back({MODEL_BIN_INDEX_CHUNK, geometry_codec, MakeSpan(merged_indices)});
+		}
+
+		LZMACodec lzma;
+		for (auto& chunk : chunks)
+		{
+			if (chunk.codec == MBCC_LZMA)
+			{
+				lzma.EncodeBlocks(chunk.compressed, chunk.original);
+			}
+		}
+
 		std::ofstream ofs(jit_name.c_str(), std::ios_base::binary);
 		BOOST_ASSERT(ofs);
-		uint32_t fourcc = Native2LE(MakeFourCC<'K', 'L', 'M', ' '>::value);
-		ofs.write(reinterpret_cast<char*>(&fourcc), sizeof(fourcc));
 
-		uint32_t ver = Native2LE(MODEL_BIN_VERSION);
-		ofs.write(reinterpret_cast<char*>(&ver), sizeof(ver));
+		ModelBinHeader header;
+		header.fourcc = Native2LE(MakeFourCC<'K', 'L', 'M', ' '>::value);
+		header.ver = Native2LE(MODEL_BIN_VERSION);
+		header.num_chunks = Native2LE(static_cast<uint32_t>(chunks.size()));
+		header.reserved = 0;
+		ofs.write(reinterpret_cast<char*>(&header), sizeof(header));
 
-		auto const & ss_str = ss.str();
-		uint64_t original_len = Native2LE(static_cast<uint64_t>(ss_str.size()));
-		ofs.write(reinterpret_cast<char*>(&original_len), sizeof(original_len));
+		uint64_t offset = sizeof(header) + chunks.size() * sizeof(ModelBinChunkEntry);
+		std::vector<uint64_t> offsets(chunks.size());
+		for (size_t i = 0; i < chunks.size(); ++ i)
+		{
+			auto const & chunk = chunks[i];
+			uint64_t const size = (chunk.codec == MBCC_LZMA) ? chunk.compressed.size() : chunk.original.size();
 
-		std::ofstream::pos_type p = ofs.tellp();
-		uint64_t len = 0;
-		ofs.write(reinterpret_cast<char*>(&len), sizeof(len));
+			offset = (offset + MODEL_BIN_CHUNK_ALIGNMENT - 1) & ~static_cast<uint64_t>(MODEL_BIN_CHUNK_ALIGNMENT - 1);
+			offsets[i] = offset;
 
-		LZMACodec lzma;
-		len = lzma.Encode(ofs, MakeSpan(reinterpret_cast<uint8_t const *>(ss_str.c_str()), ss_str.size()));
+			ModelBinChunkEntry entry;
+			entry.id = Native2LE(chunk.id);
+			entry.codec = Native2LE(chunk.codec);
+			entry.offset = Native2LE(offset);
+			entry.size = Native2LE(size);
+			entry.original_size = Native2LE(static_cast<uint64_t>(chunk.original.size()));
+			ofs.write(reinterpret_cast<char*>(&entry), sizeof(entry));
+
+			offset += size;
+		}
 
-		ofs.seekp(p, std::ios_base::beg);
-		len = Native2LE(len);
-		ofs.write(reinterpret_cast<char*>(&len), sizeof(len));
+		char const padding[MODEL_BIN_CHUNK_ALIGNMENT] = {};
+		uint64_t pos = sizeof(header) + chunks.size() * sizeof(ModelBinChunkEntry);
+		for (size_t i = 0; i < chunks.size(); ++ i)
+		{
+			auto const & chunk = chunks[i];
+
+			ofs.write(padding, static_cast<std::streamsize>(offsets[i] - pos));
+			if (chunk.codec == MBCC_LZMA)
+			{
+				ofs.write(reinterpret_cast<char const *>(chunk.compressed.data()), static_cast<std::streamsize>(chunk.compressed.size()));
+				pos = offsets[i] + chunk.compressed.size();
+			}
+			else
+			{
+				ofs.write(reinterpret_cast<char const *>(chunk.original.data()), static_cast<std::streamsize>(chunk.original.size()));
+				pos = offsets[i] + chunk.original.size();
+			}
+		}
 	}
 
-	void SaveModel(RenderModel const & model, std::string_view model_name)
+	void SaveModel(RenderModel const & model, std::string_view model_name, bool compress_geometry)
 	{
 		std::filesystem::path output_path(model_name.begin(), model_name.end());
 		auto const output_ext = output_path.extension().string();
@@ -2316,7 +3345,7 @@ namespace KlayGE
 			mesh_names, mtl_ids, mesh_lods, pos_bbs, tc_bbs,
 			mesh_num_vertices, mesh_base_vertices, mesh_num_indices, mesh_base_indices,
 			nodes, renderables,
-			joints, animations, kfs, num_frame, frame_rate, frame_pos_bbs);
+			joints, animations, kfs, num_frame, frame_rate, frame_pos_bbs, compress_geometry);
 
 #if KLAYGE_IS_DEV_PLATFORM
 		if (need_conversion)
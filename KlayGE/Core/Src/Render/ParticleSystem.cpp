@@ -41,10 +41,12 @@
 #include <KlayGE/RenderableHelper.hpp>
 #include <KlayGE/App3D.hpp>
 #include <KlayGE/Camera.hpp>
+#include <KlayGE/SceneManager.hpp>
 #include <KlayGE/ResLoader.hpp>
 #include <KFL/XMLDom.hpp>
 #include <KlayGE/DeferredRenderingLayer.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/Detail/SIMDLanes.hpp>
 
 #include <fstream>
 #include <string>
@@ -56,6 +58,141 @@ namespace
 	using namespace KlayGE;
 
 	uint32_t const NUM_PARTICLES = 4096;
+	uint32_t constexpr NUM_PARTICLES_PER_UPDATE_TASK = 4096;
+
+	// Same as the scalar search in PolylineParticleUpdater::Update, the first point with x >= pos closes the segment.
+	//  Going backward lets the first one win without a per-lane loop.
+	template <typename L>
+	typename L::Type EvalPolyline(std::vector<float2> const & curve, typename L::Type pos)
+	{
+		typename L::Type ret = L::Set1(curve.back().y());
+		for (size_t k = curve.size() - 1; k > 0; -- k)
+		{
+			float2 const & prev = curve[k - 1];
+			float2 const & curr = curve[k];
+
+			auto const s = L::Div(L::Sub(pos, L::Set1(prev.x())), L::Set1(curr.x() - prev.x()));
+			auto const value = L::Add(L::Set1(prev.y()), L::Mul(L::Set1(curr.y() - prev.y()), s));
+			ret = L::Select(L::GreaterEqual(L::Set1(curr.x()), pos), value, ret);
+		}
+		return ret;
+	}
+
+	// Sorts far to near on depth quantized to 16 bits over [min_depth, max_depth]. It's two 8-bit counting passes, and
+	//  equal keys keep their order.
+	void RadixSortByDepth(std::vector<std::pair<uint32_t, float>>& particles, std::vector<std::pair<uint32_t, float>>& scratch,
+		float min_depth, float max_depth)
+	{
+		float const scale = (max_depth > min_depth) ? 65535 / (max_depth - min_depth) : 0.0f;
+		auto const depth_key = [max_depth, scale](float depth)
+			{
+				return static_cast<uint32_t>((max_depth - depth) * scale + 0.5f);
+			};
+
+		scratch.resize(particles.size());
+		for (uint32_t shift = 0; shift < 16; shift += 8)
+		{
+			std::array<uint32_t, 256> offsets;
+			offsets.fill(0);
+			for (auto const & par : particles)
+			{
+				++ offsets[(depth_key(par.second) >> shift) & 0xFF];
+			}
+
+			uint32_t sum = 0;
+			for (auto& offset : offsets)
+			{
+				uint32_t const count = offset;
+				offset = sum;
+				sum += count;
+			}
+
+			for (auto const & par : particles)
+			{
+				scratch[offsets[(depth_key(par.second) >> shift) & 0xFF]++] = par;
+			}
+			particles.swap(scratch);
+		}
+	}
+
+	struct PolylineUpdateParams
+	{
+		std::vector<float2> const * size_over_life;
+		std::vector<float2> const * mass_over_life;
+		std::vector<float2> const * opacity_over_life;
+
+		float3 force;
+		float gravity;
+		float media_density;
+		float elapse_time;
+	};
+
+	template <typename L>
+	uint32_t UpdatePolylineParticles(ParticleStorage& pars, uint32_t begin, uint32_t end, PolylineUpdateParams const & params)
+	{
+		typedef typename L::Type V;
+
+		V const zero = L::Zero();
+		V const one = L::Set1(1.0f);
+		V const elapse_time = L::Set1(params.elapse_time);
+		V const force_x = L::Set1(params.force.x());
+		V const force_y = L::Set1(params.force.y());
+		V const force_z = L::Set1(params.force.z());
+		V const gravity = L::Set1(params.gravity);
+		V const buoyancy_scale = L::Set1(4.0f / 3 * PI);
+		V const media_density = L::Set1(params.media_density);
+		V const spin_step = L::Set1(0.001f);
+
+		uint32_t i = begin;
+		for (; i + L::WIDTH <= end; i += L::WIDTH)
+		{
+			V const life = L::Load(&pars.life[i]);
+			auto const alive = L::Greater(life, zero);
+			if (L::MoveMask(alive) == 0)
+			{
+				continue;
+			}
+
+			V const init_life = L::Load(&pars.init_life[i]);
+			V const pos = L::Div(L::Sub(init_life, life), init_life);
+
+			V const cur_size = EvalPolyline<L>(*params.size_over_life, pos);
+			V const cur_mass = EvalPolyline<L>(*params.mass_over_life, pos);
+			V const cur_alpha = EvalPolyline<L>(*params.opacity_over_life, pos);
+
+			V const buoyancy = L::Mul(L::Mul(L::Mul(buoyancy_scale, L::Mul(L::Mul(cur_size, cur_size), cur_size)), media_density),
+				gravity);
+			V const inv_mass = L::Div(one, cur_mass);
+			V const accel_x = L::Sub(L::Mul(L::Add(force_x, zero), inv_mass), zero);
+			V const accel_y = L::Sub(L::Mul(L::Add(force_y, buoyancy), inv_mass), gravity);
+			V const accel_z = L::Sub(L::Mul(L::Add(force_z, zero), inv_mass), zero);
+
+			V const vel_x = L::Load(&pars.vel_x[i]);
+			V const vel_y = L::Load(&pars.vel_y[i]);
+			V const vel_z = L::Load(&pars.vel_z[i]);
+			V const new_vel_x = L::Add(vel_x, L::Mul(accel_x, elapse_time));
+			V const new_vel_y = L::Add(vel_y, L::Mul(accel_y, elapse_time));
+			V const new_vel_z = L::Add(vel_z, L::Mul(accel_z, elapse_time));
+			L::Store(&pars.vel_x[i], L::Select(alive, new_vel_x, vel_x));
+			L::Store(&pars.vel_y[i], L::Select(alive, new_vel_y, vel_y));
+			L::Store(&pars.vel_z[i], L::Select(alive, new_vel_z, vel_z));
+
+			V const pos_x = L::Load(&pars.pos_x[i]);
+			V const pos_y = L::Load(&pars.pos_y[i]);
+			V const pos_z = L::Load(&pars.pos_z[i]);
+			L::Store(&pars.pos_x[i], L::Select(alive, L::Add(pos_x, L::Mul(new_vel_x, elapse_time)), pos_x));
+			L::Store(&pars.pos_y[i], L::Select(alive, L::Add(pos_y, L::Mul(new_vel_y, elapse_time)), pos_y));
+			L::Store(&pars.pos_z[i], L::Select(alive, L::Add(pos_z, L::Mul(new_vel_z, elapse_time)), pos_z));
+
+			L::Store(&pars.life[i], L::Select(alive, L::Sub(life, elapse_time), life));
+			V const spin = L::Load(&pars.spin[i]);
+			L::Store(&pars.spin[i], L::Select(alive, L::Add(spin, spin_step), spin));
+			L::Store(&pars.size[i], L::Select(alive, cur_size, L::Load(&pars.size[i])));
+			L::Store(&pars.alpha[i], L::Select(alive, cur_alpha, L::Load(&pars.alpha[i])));
+		}
+
+		return i;
+	}
 
 	class ParticleSystemLoadingDesc : public ResLoadingDesc
 	{
@@ -341,6 +478,13 @@ namespace
 			return true;
 		}
 
+		uint64_t Key() const override
+		{
+			size_t seed = static_cast<size_t>(this->Type());
+			HashRange(seed, ps_desc_.res_name.begin(), ps_desc_.res_name.end());
+			return seed;
+		}
+
 		bool Match(ResLoadingDesc const & rhs) const override
 		{
 			if (this->Type() == rhs.Type())
@@ -549,6 +693,54 @@ namespace
 
 namespace KlayGE
 {
+	void ParticleStorage::Resize(uint32_t num_particles)
+	{
+		pos_x.resize(num_particles);
+		pos_y.resize(num_particles);
+		pos_z.resize(num_particles);
+		vel_x.resize(num_particles);
+		vel_y.resize(num_particles);
+		vel_z.resize(num_particles);
+		life.resize(num_particles);
+		spin.resize(num_particles);
+		size.resize(num_particles);
+		alpha.resize(num_particles);
+		init_life.resize(num_particles);
+	}
+
+	Particle ParticleStorage::Get(uint32_t index) const
+	{
+		BOOST_ASSERT(index < this->NumParticles());
+
+		Particle par;
+		par.pos = float3(pos_x[index], pos_y[index], pos_z[index]);
+		par.vel = float3(vel_x[index], vel_y[index], vel_z[index]);
+		par.life = life[index];
+		par.spin = spin[index];
+		par.size = size[index];
+		par.alpha = alpha[index];
+		par.init_life = init_life[index];
+		return par;
+	}
+
+	void ParticleStorage::Set(uint32_t index, Particle const & par)
+	{
+		BOOST_ASSERT(index < this->NumParticles());
+
+		pos_x[index] = par.pos.x();
+		pos_y[index] = par.pos.y();
+		pos_z[index] = par.pos.z();
+		vel_x[index] = par.vel.x();
+		vel_y[index] = par.vel.y();
+		vel_z[index] = par.vel.z();
+		life[index] = par.life;
+		spin[index] = par.spin;
+		size[index] = par.size;
+		alpha[index] = par.alpha;
+		init_life[index] = par.init_life;
+	}
+
+
 	ParticleEmitter::ParticleEmitter(ParticleSystemPtr const& ps)
 			: ps_(ps),
 				model_mat_(float4x4::Identity()),
@@ -592,6 +784,19 @@ namespace KlayGE
 
 	ParticleUpdater::~ParticleUpdater() noexcept = default;
 
+	void ParticleUpdater::Update(ParticleStorage& particles, uint32_t begin, uint32_t end, float elapse_time)
+	{
+		for (uint32_t i = begin; i < end; ++ i)
+		{
+			if (particles.life[i] > 0)
+			{
+				Particle par = particles.Get(i);
+				this->Update(par, elapse_time);
+				particles.Set(i, par);
+			}
+		}
+	}
+
 	void ParticleUpdater::DoClone(ParticleUpdaterPtr const & rhs)
 	{
 		rhs->ps_ = ps_;
@@ -600,10 +805,10 @@ namespace KlayGE
 
 	ParticleSystem::ParticleSystem(uint32_t max_num_particles, bool sort_particles)
 		: root_node_(MakeSharedPtr<SceneNode>(L"ParticleSystemRootNode", SceneNode::SOA_Moveable | SceneNode::SOA_NotCastShadow)),
-			particles_(max_num_particles),
 			gravity_(0.5f), force_(0, 0, 0), media_density_(0.0f),
 			sort_particles_(sort_particles)
 	{
+		particles_.Resize(max_num_particles);
 		this->ClearParticles();
 
 		RenderFactory& rf = Context::Instance().RenderFactoryInstance();
@@ -611,6 +816,12 @@ namespace KlayGE
 		render_particles_ = MakeSharedPtr<RenderParticles>(gs_support_);
 		root_node_->AddComponent(MakeSharedPtr<RenderableComponent>(render_particles_));
 
+		for (auto& buffer : instance_buffers_)
+		{
+			buffer = rf.MakeVertexBuffer(BU_Dynamic, EAH_GPU_Read | EAH_CPU_Write,
+				max_num_particles * sizeof(ParticleInstance), nullptr);
+		}
+
 		root_node_->OnMainThreadUpdate().Connect([this](SceneNode& node, float app_time, float elapsed_time)
 			{
 				KFL_UNUSED(node);
@@ -621,7 +832,13 @@ namespace KlayGE
 				auto const& caps = rf.RenderEngineInstance().DeviceCaps();
 				if (!caps.arbitrary_multithread_rendering_support)
 				{
-					std::lock_guard<std::mutex> lock(actived_particles_mutex_);
+					// The scene's update mutex is held here, so no new simulation task can start once this one is done.
+					//  The gather then runs without actived_particles_mutex_. Its ParallelFor waits by running other
+					//  tasks, and one of them could be a simulation task taking that mutex.
+					if (update_task_)
+					{
+						Context::Instance().TaskSchedulerInstance().Wait(update_task_);
+					}
 					this->UpdateParticleBufferNoLock();
 				}
 			});
@@ -630,19 +847,39 @@ namespace KlayGE
 				KFL_UNUSED(node);
 				KFL_UNUSED(app_time);
 
-				std::lock_guard<std::mutex> lock(actived_particles_mutex_);
-
-				this->UpdateParticlesNoLock(elapsed_time);
-
-				auto& rf = Context::Instance().RenderFactoryInstance();
-				auto const& caps = rf.RenderEngineInstance().DeviceCaps();
-				if (caps.arbitrary_multithread_rendering_support)
+				// The scene update visits the nodes one by one. Handing the simulation to a task lets the next particle
+				//  system start right away, on another worker. The scene manager joins it before releasing the update
+				//  mutex, since it reads the camera and sets the bound.
+				auto& ts = Context::Instance().TaskSchedulerInstance();
+				if (update_task_)
 				{
-					this->UpdateParticleBufferNoLock();
+					ts.Wait(update_task_);
 				}
+				update_task_ = ts.Submit([this, elapsed_time]()
+					{
+						std::lock_guard<std::mutex> lock(actived_particles_mutex_);
+
+						this->UpdateParticlesNoLock(elapsed_time);
+
+						auto& rf = Context::Instance().RenderFactoryInstance();
+						auto const& caps = rf.RenderEngineInstance().DeviceCaps();
+						if (caps.arbitrary_multithread_rendering_support)
+						{
+							this->UpdateParticleBufferNoLock();
+						}
+					});
+				Context::Instance().SceneManagerInstance().AddSubThreadUpdateTask(update_task_);
 			});
 	}
 
+	ParticleSystem::~ParticleSystem()
+	{
+		if (update_task_ && !update_task_->Finished())
+		{
+			Context::Instance().TaskSchedulerInstance().Wait(update_task_);
+		}
+	}
+
 	ParticleSystemPtr ParticleSystem::Clone()
 	{
 		ParticleSystemPtr ret = MakeSharedPtr<ParticleSystem>(NUM_PARTICLES);
@@ -753,51 +990,45 @@ namespace KlayGE
 
 	void ParticleSystem::ClearParticles()
 	{
-		for (auto& particle : particles_)
-		{
-			particle.life = 0;
-		}
+		std::fill(particles_.life.begin(), particles_.life.end(), 0.0f);
 	}
 
 	void ParticleSystem::UpdateParticlesNoLock(float elapsed_time)
 	{
-		auto emitter_iter = emitters_.begin();
-		uint32_t new_particle = (*emitter_iter)->Update(elapsed_time);
-
-		auto& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
-		auto const& camera = *re.DefaultFrameBuffer()->Viewport()->Camera();
-		float4x4 const& view_mat = camera.ViewMatrix();
-
-		actived_particles_.clear();
-
-		float3 min_bb(+1e10f, +1e10f, +1e10f);
-		float3 max_bb(-1e10f, -1e10f, -1e10f);
-
 		for (auto const & updater : updaters_)
 		{
 			updater->SnapParams();
 		}
 
-		for (uint32_t i = 0; i < particles_.size(); ++ i)
-		{
-			Particle& particle = particles_[i];
+		uint32_t const num_particles = particles_.NumParticles();
 
-			if (particle.life > 0)
+		// Particles don't depend on each other, so the alive ones are advanced in parallel chunks
+		Context::Instance().TaskSchedulerInstance().ParallelFor(0, num_particles, NUM_PARTICLES_PER_UPDATE_TASK,
+			[this, elapsed_time](uint32_t begin, uint32_t end)
 			{
 				for (auto const & updater : updaters_)
 				{
-					updater->Update(particle, elapsed_time);
+					updater->Update(particles_, begin, end, elapsed_time);
 				}
-			}
-			else
+			});
+
+		// Emitters draw from their own random sequences, so emitting stays on this thread. New particles get a zero time
+		//  step update to pick up their size and opacity.
+		auto emitter_iter = emitters_.begin();
+		uint32_t new_particle = (*emitter_iter)->Update(elapsed_time);
+		for (uint32_t i = 0; i < num_particles; ++ i)
+		{
+			if (particles_.life[i] <= 0)
 			{
 				if (new_particle > 0)
 				{
+					Particle particle = particles_.Get(i);
 					(*emitter_iter)->Emit(particle);
 					for (auto const & updater : updaters_)
 					{
 						updater->Update(particle, 0);
 					}
+					particles_.Set(i, particle);
 					-- new_particle;
 				}
 				else
@@ -812,45 +1043,117 @@ namespace KlayGE
 					}
 				}
 			}
+		}
 
-			if (particle.life > 0)
-			{
-				float3 const & pos = particle.pos;
+		this->UpdateActiveParticlesNoLock();
+	}
 
-				float depth_es;
-				if (sort_particles_)
-				{
-					float4 const pos4(pos.x(), pos.y(), pos.z(), 1);
-					float4 const z_row = view_mat.Col(2);
-					float4 const w_row = view_mat.Col(3);
+	void ParticleSystem::UpdateActiveParticlesNoLock()
+	{
+		auto& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+		auto const& camera = *re.DefaultFrameBuffer()->Viewport()->Camera();
+		float4 const z_col = camera.ViewMatrix().Col(2);
+		float4 const w_col = camera.ViewMatrix().Col(3);
 
-					depth_es = MathLib::dot(pos4, z_row) / MathLib::dot(pos4, w_row);
-				}
-				else
+		// Count per chunk first, so every chunk can then write its alive particles to its own part of the list
+		struct ChunkInfo
+		{
+			uint32_t num_active;
+			uint32_t offset;
+			float3 min_bb;
+			float3 max_bb;
+			float min_depth;
+			float max_depth;
+		};
+
+		uint32_t const num_particles = particles_.NumParticles();
+		uint32_t const num_chunks = (num_particles + NUM_PARTICLES_PER_UPDATE_TASK - 1) / NUM_PARTICLES_PER_UPDATE_TASK;
+		std::vector<ChunkInfo> chunks(num_chunks);
+
+		auto& ts = Context::Instance().TaskSchedulerInstance();
+		ts.ParallelFor(0, num_particles, NUM_PARTICLES_PER_UPDATE_TASK,
+			[this, &chunks](uint32_t begin, uint32_t end)
+			{
+				ChunkInfo& chunk = chunks[begin / NUM_PARTICLES_PER_UPDATE_TASK];
+				chunk.num_active = 0;
+				chunk.min_bb = float3(+1e10f, +1e10f, +1e10f);
+				chunk.max_bb = float3(-1e10f, -1e10f, -1e10f);
+				for (uint32_t i = begin; i < end; ++ i)
 				{
-					depth_es = 0;
+					if (particles_.life[i] > 0)
+					{
+						float3 const pos(particles_.pos_x[i], particles_.pos_y[i], particles_.pos_z[i]);
+						chunk.min_bb = MathLib::minimize(chunk.min_bb, pos);
+						chunk.max_bb = MathLib::maximize(chunk.max_bb, pos);
+						++ chunk.num_active;
+					}
 				}
+			});
 
-				actived_particles_.emplace_back(i, depth_es);
-
-				min_bb = MathLib::minimize(min_bb, pos);
-				max_bb = MathLib::maximize(min_bb, pos);
-			}
+		uint32_t num_active = 0;
+		float3 min_bb(+1e10f, +1e10f, +1e10f);
+		float3 max_bb(-1e10f, -1e10f, -1e10f);
+		for (auto& chunk : chunks)
+		{
+			chunk.offset = num_active;
+			num_active += chunk.num_active;
+			min_bb = MathLib::minimize(min_bb, chunk.min_bb);
+			max_bb = MathLib::maximize(max_bb, chunk.max_bb);
 		}
 
-		if (!actived_particles_.empty())
+		actived_particles_.resize(num_active);
+		if (num_active == 0)
 		{
-			if (sort_particles_)
+			return;
+		}
+
+		bool const sort_particles = sort_particles_;
+		ts.ParallelFor(0, num_particles, NUM_PARTICLES_PER_UPDATE_TASK,
+			[this, &chunks, &z_col, &w_col, sort_particles](uint32_t begin, uint32_t end)
 			{
-				std::sort(actived_particles_.begin(), actived_particles_.end(),
-					[](std::pair<uint32_t, float> const & lhs, std::pair<uint32_t, float> const & rhs)
+				ChunkInfo& chunk = chunks[begin / NUM_PARTICLES_PER_UPDATE_TASK];
+				chunk.min_depth = +1e10f;
+				chunk.max_depth = -1e10f;
+
+				auto* out = &actived_particles_[chunk.offset];
+				for (uint32_t i = begin; i < end; ++ i)
+				{
+					if (particles_.life[i] > 0)
 					{
-						return lhs.second > rhs.second;
-					});
+						float depth_es;
+						if (sort_particles)
+						{
+							float4 const pos4(particles_.pos_x[i], particles_.pos_y[i], particles_.pos_z[i], 1);
+							depth_es = MathLib::dot(pos4, z_col) / MathLib::dot(pos4, w_col);
+							chunk.min_depth = std::min(chunk.min_depth, depth_es);
+							chunk.max_depth = std::max(chunk.max_depth, depth_es);
+						}
+						else
+						{
+							depth_es = 0;
+						}
+
+						out->first = i;
+						out->second = depth_es;
+						++ out;
+					}
+				}
+			});
+
+		if (sort_particles_)
+		{
+			float min_depth = +1e10f;
+			float max_depth = -1e10f;
+			for (auto const & chunk : chunks)
+			{
+				min_depth = std::min(min_depth, chunk.min_depth);
+				max_depth = std::max(max_depth, chunk.max_depth);
 			}
 
-			checked_cast<RenderParticles&>(*render_particles_).PosBound(AABBox(min_bb, max_bb));
+			RadixSortByDepth(actived_particles_, sort_scratch_, min_depth, max_depth);
 		}
+
+		checked_cast<RenderParticles&>(*render_particles_).PosBound(AABBox(min_bb, max_bb));
 	}
 
 	void ParticleSystem::UpdateParticleBufferNoLock()
@@ -859,60 +1162,44 @@ namespace KlayGE
 		{
 			RenderLayout& rl = render_particles_->GetRenderLayout();
 
-			GraphicsBufferPtr instance_gb;
-			if (gs_support_)
-			{
-				instance_gb = rl.GetVertexStream(0);
-			}
-			else
-			{
-				instance_gb = rl.InstanceStream();
-			}
+			GraphicsBufferPtr const & instance_gb = instance_buffers_[curr_instance_buffer_];
+			curr_instance_buffer_ = (curr_instance_buffer_ + 1) % NUM_INSTANCE_BUFFERS;
 
 			uint32_t const num_active_particles = static_cast<uint32_t>(actived_particles_.size());
-			uint32_t const new_instance_size = num_active_particles * sizeof(ParticleInstance);
-			if (!instance_gb || (instance_gb->Size() < new_instance_size))
-			{
-				RenderFactory& rf = Context::Instance().RenderFactoryInstance();
-				instance_gb = rf.MakeVertexBuffer(BU_Dynamic, EAH_GPU_Read | EAH_CPU_Write,
-					new_instance_size, nullptr);
-
-				if (gs_support_)
-				{
-					rl.SetVertexStream(0, instance_gb);
-				}
-				else
-				{
-					rl.InstanceStream(instance_gb);
-				}
-			}
-
 			if (gs_support_)
 			{
+				rl.SetVertexStream(0, instance_gb);
 				rl.NumVertices(num_active_particles);
 			}
 			else
 			{
+				rl.InstanceStream(instance_gb);
 				for (uint32_t i = 0; i < rl.NumVertexStreams(); ++ i)
 				{
 					rl.VertexStreamFrequencyDivider(i, RenderLayout::ST_Geometry, num_active_particles);
 				}
 			}
 
-			{
-				GraphicsBuffer::Mapper mapper(*instance_gb, BA_Write_Only);
-				ParticleInstance* instance_data = mapper.Pointer<ParticleInstance>();
-				for (uint32_t i = 0; i < num_active_particles; ++ i, ++ instance_data)
+			// Gathered straight from the particle arrays into the mapped buffer, in draw order. It can't be written by
+			//  the simulation itself, the order is only known after the sort, and without arbitrary multithread
+			//  rendering the buffer can only be mapped on the main thread.
+			GraphicsBuffer::Mapper mapper(*instance_gb, BA_Write_Only);
+			ParticleInstance* instance_data = mapper.Pointer<ParticleInstance>();
+			Context::Instance().TaskSchedulerInstance().ParallelFor(0, num_active_particles, NUM_PARTICLES_PER_UPDATE_TASK,
+				[this, instance_data](uint32_t begin, uint32_t end)
 				{
-					Particle const & par = particles_[actived_particles_[i].first];
-					instance_data->pos = par.pos;
-					instance_data->life = par.life;
-					instance_data->spin = par.spin;
-					instance_data->size = par.size;
-					instance_data->life_factor = (par.init_life - par.life) / par.init_life;
-					instance_data->alpha = par.alpha;
-				}
-			}
+					for (uint32_t i = begin; i < end; ++ i)
+					{
+						uint32_t const index = actived_particles_[i].first;
+						ParticleInstance& instance = instance_data[i];
+						instance.pos = float3(particles_.pos_x[index], particles_.pos_y[index], particles_.pos_z[index]);
+						instance.life = particles_.life[index];
+						instance.spin = particles_.spin[index];
+						instance.size = particles_.size[index];
+						instance.life_factor = (particles_.init_life[index] - particles_.life[index]) / particles_.init_life[index];
+						instance.alpha = particles_.alpha[index];
+					}
+				});
 		}
 	}
 
@@ -1217,6 +1504,33 @@ namespace KlayGE
 		par.alpha = cur_alpha;
 	}
 
+	void PolylineParticleUpdater::Update(ParticleStorage& particles, uint32_t begin, uint32_t end, float elapse_time)
+	{
+		BOOST_ASSERT(!this_frame_size_over_life_.empty());
+		BOOST_ASSERT(!this_frame_mass_over_life_.empty());
+		BOOST_ASSERT(!this_frame_opacity_over_life_.empty());
+
+		ParticleSystemPtr ps = ps_.lock();
+
+		PolylineUpdateParams params;
+		params.size_over_life = &this_frame_size_over_life_;
+		params.mass_over_life = &this_frame_mass_over_life_;
+		params.opacity_over_life = &this_frame_opacity_over_life_;
+		params.force = ps->Force();
+		params.gravity = ps->Gravity();
+		params.media_density = ps->MediaDensity();
+		params.elapse_time = elapse_time;
+
+		uint32_t i = begin;
+#if defined(SIMD_MATH_AVX)
+		i = UpdatePolylineParticles<detail::SIMDLanes8>(particles, i, end, params);
+#endif
+#if defined(SIMD_MATH_SSE)
+		i = UpdatePolylineParticles<detail::SIMDLanes4>(particles, i, end, params);
+#endif
+		UpdatePolylineParticles<detail::SIMDLanes1>(particles, i, end, params);
+	}
+
 	void PolylineParticleUpdater::SnapParams()
 	{
 		std::lock_guard<std::mutex> lock(update_mutex_);
@@ -190,6 +190,14 @@ namespace
 			return true;
 		}
 
+		uint64_t Key() const override
+		{
+			size_t seed = static_cast<size_t>(this->Type());
+			HashRange(seed, pp_desc_.res_name.begin(), pp_desc_.res_name.end());
+			HashRange(seed, pp_desc_.pp_name.begin(), pp_desc_.pp_name.end());
+			return seed;
+		}
+
 		bool Match(ResLoadingDesc const & rhs) const override
 		{
 			if (this->Type() == rhs.Type())
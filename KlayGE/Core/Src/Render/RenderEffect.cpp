@@ -65,6 +65,7 @@
 #include <fstream>
 #include <iterator>
 #include <string>
+#include <tuple>
 #ifdef KLAYGE_CXX17_LIBRARY_CHARCONV_SUPPORT
 #include <charconv>
 #endif
@@ -4107,6 +4108,15 @@ namespace
 		checked_cast<RenderVariableIOable const&>(var).StreamOut(os);
 	}
 #endif
+
+	size_t ShaderDescHash(ShaderDesc const & sd)
+	{
+		size_t seed = 0;
+		HashRange(seed, sd.profile.begin(), sd.profile.end());
+		HashRange(seed, sd.func_name.begin(), sd.func_name.end());
+		HashCombine(seed, sd.macros_hash);
+		return seed;
+	}
 }
 
 namespace KlayGE
@@ -4179,6 +4189,16 @@ namespace KlayGE
 			return true;
 		}
 
+		uint64_t Key() const override
+		{
+			size_t seed = static_cast<size_t>(this->Type());
+			for (auto const & name : effect_desc_.res_name)
+			{
+				HashRange(seed, name.begin(), name.end());
+			}
+			return seed;
+		}
+
 		bool Match(ResLoadingDesc const & rhs) const override
 		{
 			if (this->Type() == rhs.Type())
@@ -5102,11 +5122,39 @@ namespace KlayGE
 	{
 		if (need_compile_)
 		{
-			uint32_t tech_index = 0;
-			for (auto const& tech : techniques_)
+			// Every stage of every pass is a job. Each stage object only writes to itself, so they can be compiled in
+			//  parallel. The domain shaders read tessellation parameters from the compiled hull shaders, so they're
+			//  compiled afterwards. The .kfx is written in technique/pass order, the result doesn't depend on the
+			//  number of threads.
+			std::vector<std::tuple<uint32_t, uint32_t, ShaderStage>> jobs;
+			std::vector<std::tuple<uint32_t, uint32_t, ShaderStage>> domain_jobs;
+			for (uint32_t tech_index = 0; tech_index < techniques_.size(); ++ tech_index)
+			{
+				for (uint32_t pass_index = 0; pass_index < techniques_[tech_index]->NumPasses(); ++ pass_index)
+				{
+					for (uint32_t stage_index = 0; stage_index < NumShaderStages; ++ stage_index)
+					{
+						ShaderStage const stage = static_cast<ShaderStage>(stage_index);
+						auto& target_jobs = (ShaderStage::Domain == stage) ? domain_jobs : jobs;
+						target_jobs.emplace_back(tech_index, pass_index, stage);
+					}
+				}
+			}
+
+			auto& scheduler = Context::Instance().TaskSchedulerInstance();
+			for (auto const * stage_jobs : { &jobs, &domain_jobs })
 			{
-				tech->CompileShaders(effect, tech_index);
-				++tech_index;
+				scheduler.ParallelFor(0, static_cast<uint32_t>(stage_jobs->size()), 1,
+					[this, &effect, stage_jobs](uint32_t begin, uint32_t end)
+					{
+						for (uint32_t i = begin; i < end; ++ i)
+						{
+							auto const & job = (*stage_jobs)[i];
+							uint32_t const tech_index = std::get<0>(job);
+							uint32_t const pass_index = std::get<1>(job);
+							techniques_[tech_index]->Pass(pass_index).CompileShader(effect, tech_index, pass_index, std::get<2>(job));
+						}
+					});
 			}
 
 			std::ofstream ofs(kfx_name_.c_str(), std::ios_base::binary | std::ios_base::out);
@@ -5444,16 +5492,29 @@ namespace KlayGE
 
 	uint32_t RenderEffectTemplate::AddShaderDesc(ShaderDesc const & sd)
 	{
-		for (uint32_t i = 0; i < shader_descs_.size(); ++ i)
+		if (shader_desc_index_.size() != shader_descs_.size())
 		{
-			if (shader_descs_[i] == sd)
+			// shader_descs_ was reset or streamed in
+			shader_desc_index_.clear();
+			for (uint32_t i = 0; i < shader_descs_.size(); ++ i)
 			{
-				return i;
+				shader_desc_index_.emplace(ShaderDescHash(shader_descs_[i]), i);
+			}
+		}
+
+		size_t const hash = ShaderDescHash(sd);
+		auto const range = shader_desc_index_.equal_range(hash);
+		for (auto iter = range.first; iter != range.second; ++ iter)
+		{
+			if (shader_descs_[iter->second] == sd)
+			{
+				return iter->second;
 			}
 		}
 
 		uint32_t id = static_cast<uint32_t>(shader_descs_.size());
 		shader_descs_.push_back(sd);
+		shader_desc_index_.emplace(hash, id);
 		return id;
 	}
 
@@ -6045,15 +6106,6 @@ namespace KlayGE
 		}
 	}
 
-	void RenderTechnique::CompileShaders(RenderEffect& effect, uint32_t tech_index)
-	{
-		uint32_t pass_index = 0;
-		for (auto& pass : passes_)
-		{
-			pass->CompileShaders(effect, tech_index, pass_index);
-			++pass_index;
-		}
-	}
 #endif
 
 	void RenderTechnique::CreateHwShaders(RenderEffect& effect, uint32_t tech_index)
@@ -6752,20 +6804,17 @@ namespace KlayGE
 		}
 	}
 
-	void RenderPass::CompileShaders(RenderEffect& effect, uint32_t tech_index, uint32_t pass_index)
+	void RenderPass::CompileShader(RenderEffect const& effect, uint32_t tech_index, uint32_t pass_index, ShaderStage stage) const
 	{
-		auto const & shader_obj = this->GetShaderObject(effect);
-		for (uint32_t stage_index = 0; stage_index < NumShaderStages; ++stage_index)
+		uint32_t const stage_index = static_cast<uint32_t>(stage);
+		ShaderDesc const& sd = effect.GetShaderDesc(shader_desc_ids_[stage_index]);
+		if (!sd.func_name.empty())
 		{
-			ShaderDesc const& sd = effect.GetShaderDesc(shader_desc_ids_[stage_index]);
-			if (!sd.func_name.empty())
+			// Stage objects shared with other passes are only compiled by the pass that created them
+			if (sd.tech_pass_type == (tech_index << 16) + (pass_index << 8) + stage_index)
 			{
-				ShaderStage const stage = static_cast<ShaderStage>(stage_index);
-				if (sd.tech_pass_type == (tech_index << 16) + (pass_index << 8) + stage_index)
-				{
-					auto const & tech = *effect.TechniqueByIndex(tech_index);
-					shader_obj->Stage(stage)->CompileShader(effect, tech, *this, shader_desc_ids_);
-				}
+				auto const & tech = *effect.TechniqueByIndex(tech_index);
+				this->GetShaderObject(effect)->Stage(stage)->CompileShader(effect, tech, *this, shader_desc_ids_);
 			}
 		}
 	}
@@ -0,0 +1,364 @@
+/**
+ * @file ShaderCache.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+
+#if KLAYGE_IS_DEV_PLATFORM
+
+#include <KFL/CXX17/filesystem.hpp>
+#include <KFL/Hash.hpp>
+#include <KFL/Util.hpp>
+#include <KlayGE/ResLoader.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <tuple>
+
+#include <KlayGE/ShaderCache.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	uint32_t constexpr SHADER_CACHE_VERSION = 2;
+	uint64_t constexpr DEFAULT_MAX_SIZE = 512ULL * 1024 * 1024;
+
+	// Trimming goes a bit below the limit, so an overflowing cache isn't trimmed again on every insert
+	uint32_t constexpr TRIM_TARGET_PERCENT = 90;
+
+	struct ShaderCacheEntryHeader
+	{
+		uint32_t fourcc;
+		uint32_t version;
+		uint64_t digest_hi;
+		uint64_t digest_lo;
+		uint64_t code_size;
+	};
+	static_assert(sizeof(ShaderCacheEntryHeader) == 32);
+
+	// FNV-1a 128-bit parameters. The prime is 2^88 + 2^8 + 0x3B.
+	uint64_t constexpr FNV128_OFFSET_HI = 0x6C62272E07BB0142ULL;
+	uint64_t constexpr FNV128_OFFSET_LO = 0x62B821756295C58DULL;
+	uint64_t constexpr FNV128_PRIME_HI = 1ULL << 24;
+	uint64_t constexpr FNV128_PRIME_LO = 0x13B;
+
+	uint32_t constexpr ENTRY_FOURCC = MakeFourCC<'K', 'S', 'C', 'E'>::value;
+}
+
+namespace KlayGE
+{
+	ShaderCacheDigest::ShaderCacheDigest()
+		: hi_(FNV128_OFFSET_HI), lo_(FNV128_OFFSET_LO)
+	{
+	}
+
+	void ShaderCacheDigest::Append(void const * data, size_t size)
+	{
+		uint8_t const * p = static_cast<uint8_t const *>(data);
+		for (size_t i = 0; i < size; ++ i)
+		{
+			lo_ ^= p[i];
+
+			// 128-bit multiply by the prime, modulo 2^128. The low word of the prime is 9 bits, so the low product is
+			//  done in 32-bit halves without overflowing.
+			uint64_t const lo_lo = (lo_ & 0xFFFFFFFFU) * FNV128_PRIME_LO;
+			uint64_t const lo_hi = (lo_ >> 32) * FNV128_PRIME_LO;
+			uint64_t const new_lo = lo_lo + (lo_hi << 32);
+			uint64_t const carry = (new_lo < lo_lo) ? 1 : 0;
+			hi_ = (lo_hi >> 32) + carry + hi_ * FNV128_PRIME_LO + lo_ * FNV128_PRIME_HI;
+			lo_ = new_lo;
+		}
+	}
+
+	void ShaderCacheDigest::Append(std::string_view str)
+	{
+		uint64_t const size = str.size();
+		this->Append(&size, sizeof(size));
+		this->Append(str.data(), str.size());
+	}
+
+
+	ShaderCache::ShaderCache()
+		: max_size_(DEFAULT_MAX_SIZE)
+	{
+	}
+
+	ShaderCache& ShaderCache::Instance()
+	{
+		static ShaderCache cache;
+		return cache;
+	}
+
+	void ShaderCache::Enabled(bool enabled)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		enabled_ = enabled;
+	}
+
+	bool ShaderCache::Enabled() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return enabled_;
+	}
+
+	void ShaderCache::Folder(std::string_view folder)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		folder_ = std::string(folder);
+		if (!folder_.empty() && (folder_.back() != '/') && (folder_.back() != '\\'))
+		{
+			folder_ += '/';
+		}
+		scanned_ = false;
+		curr_size_ = 0;
+	}
+
+	std::string ShaderCache::Folder() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (folder_.empty())
+		{
+			return ResLoader::Instance().LocalFolder() + "ShaderCache/";
+		}
+		return folder_;
+	}
+
+	void ShaderCache::MaxSize(uint64_t bytes)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		max_size_ = bytes;
+	}
+
+	uint64_t ShaderCache::MaxSize() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return max_size_;
+	}
+
+	bool ShaderCache::Find(ShaderCacheDigest const & digest, std::vector<uint8_t>& code)
+	{
+		if (!this->Enabled())
+		{
+			return false;
+		}
+
+		std::string const path = this->EntryPath(digest);
+
+		bool found = false;
+		{
+			std::ifstream file(path, std::ios_base::binary);
+			if (file)
+			{
+				ShaderCacheEntryHeader header;
+				file.read(reinterpret_cast<char*>(&header), sizeof(header));
+				if (file && (header.fourcc == ENTRY_FOURCC) && (header.version == SHADER_CACHE_VERSION)
+					&& (header.digest_hi == digest.High()) && (header.digest_lo == digest.Low()))
+				{
+					code.resize(static_cast<size_t>(header.code_size));
+					file.read(reinterpret_cast<char*>(code.data()), code.size());
+					found = (static_cast<uint64_t>(file.gcount()) == header.code_size);
+				}
+			}
+		}
+
+		if (found)
+		{
+			// The modification time is the LRU stamp for trimming
+			std::error_code ec;
+			std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+
+			++ num_hits_;
+		}
+		else
+		{
+			code.clear();
+			++ num_misses_;
+		}
+		return found;
+	}
+
+	void ShaderCache::Insert(ShaderCacheDigest const & digest, std::span<uint8_t const> code)
+	{
+		if (!this->Enabled() || code.empty())
+		{
+			return;
+		}
+
+		std::string const folder = this->Folder();
+		std::string const path = this->EntryPath(digest);
+
+		std::error_code ec;
+		std::filesystem::create_directories(folder, ec);
+
+		// Several threads or processes could compile the same shader at the same time. Each one writes to its own temp
+		//  file, then renames it into place, so readers never see a partially written entry.
+		static std::atomic<uint32_t> temp_index(0);
+		std::string const temp_path = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()))
+			+ "_" + std::to_string(temp_index.fetch_add(1, std::memory_order_relaxed)) + ".tmp";
+		{
+			std::ofstream file(temp_path, std::ios_base::binary);
+			if (!file)
+			{
+				return;
+			}
+
+			ShaderCacheEntryHeader header;
+			header.fourcc = ENTRY_FOURCC;
+			header.version = SHADER_CACHE_VERSION;
+			header.digest_hi = digest.High();
+			header.digest_lo = digest.Low();
+			header.code_size = code.size();
+			file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+			file.write(reinterpret_cast<char const *>(code.data()), code.size());
+			if (!file)
+			{
+				file.close();
+				std::filesystem::remove(temp_path, ec);
+				return;
+			}
+		}
+		std::filesystem::rename(temp_path, path, ec);
+		if (ec)
+		{
+			std::filesystem::remove(temp_path, ec);
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!scanned_)
+		{
+			this->ScanNoLock();
+		}
+		else
+		{
+			curr_size_ += sizeof(ShaderCacheEntryHeader) + code.size();
+		}
+		if (curr_size_ > max_size_)
+		{
+			this->TrimNoLock();
+		}
+	}
+
+	void ShaderCache::Trim()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		this->TrimNoLock();
+	}
+
+	uint64_t ShaderCache::NumHits() const
+	{
+		return num_hits_;
+	}
+
+	uint64_t ShaderCache::NumMisses() const
+	{
+		return num_misses_;
+	}
+
+	std::string ShaderCache::EntryPath(ShaderCacheDigest const & digest) const
+	{
+		char name[33];
+		for (int i = 0; i < 16; ++ i)
+		{
+			name[i] = "0123456789abcdef"[(digest.High() >> ((15 - i) * 4)) & 0xF];
+			name[i + 16] = "0123456789abcdef"[(digest.Low() >> ((15 - i) * 4)) & 0xF];
+		}
+		name[32] = '\0';
+
+		return this->Folder() + name + ".kse";
+	}
+
+	void ShaderCache::ScanNoLock()
+	{
+		curr_size_ = 0;
+
+		std::string const folder = folder_.empty() ? ResLoader::Instance().LocalFolder() + "ShaderCache/" : folder_;
+		std::error_code ec;
+		for (std::filesystem::directory_iterator iter(folder, ec), end; !ec && (iter != end); iter.increment(ec))
+		{
+			if (iter->path().extension() == ".kse")
+			{
+				curr_size_ += iter->file_size(ec);
+			}
+		}
+
+		scanned_ = true;
+	}
+
+	void ShaderCache::TrimNoLock()
+	{
+		// Other processes could be sharing the folder, so work on what's actually there instead of our own count
+		std::string const folder = folder_.empty() ? ResLoader::Instance().LocalFolder() + "ShaderCache/" : folder_;
+
+		std::vector<std::tuple<std::filesystem::file_time_type, uint64_t, std::filesystem::path>> entries;
+		uint64_t total_size = 0;
+		std::error_code ec;
+		for (std::filesystem::directory_iterator iter(folder, ec), end; !ec && (iter != end); iter.increment(ec))
+		{
+			if (iter->path().extension() == ".kse")
+			{
+				std::error_code entry_ec;
+				uint64_t const size = iter->file_size(entry_ec);
+				auto const time = iter->last_write_time(entry_ec);
+				if (!entry_ec)
+				{
+					entries.emplace_back(time, size, iter->path());
+					total_size += size;
+				}
+			}
+		}
+
+		uint64_t const target_size = max_size_ / 100 * TRIM_TARGET_PERCENT;
+		if (total_size > target_size)
+		{
+			std::sort(entries.begin(), entries.end(),
+				[](auto const & lhs, auto const & rhs) { return std::get<0>(lhs) < std::get<0>(rhs); });
+			for (auto const & entry : entries)
+			{
+				if (total_size <= target_size)
+				{
+					break;
+				}
+
+				if (std::filesystem::remove(std::get<2>(entry), ec))
+				{
+					total_size -= std::get<1>(entry);
+				}
+			}
+		}
+
+		curr_size_ = total_size;
+		scanned_ = true;
+	}
+}
+
+#endif
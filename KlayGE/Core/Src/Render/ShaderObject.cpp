@@ -40,13 +40,19 @@
 #include <KlayGE/ResLoader.hpp>
 #include <KFL/CustomizedStreamBuf.hpp>
 
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <sstream>
 #include <fstream>
 
 #include <KlayGE/ShaderObject.hpp>
+#include <KlayGE/ShaderCache.hpp>
 
 #if KLAYGE_IS_DEV_PLATFORM
 
@@ -63,6 +69,7 @@ typedef char const * LPCSTR;
 typedef long HRESULT;
 
 #define S_OK                                        0x00000000
+#define SUCCEEDED(hr)                               (static_cast<HRESULT>(hr) >= 0)
 
 #define D3DCOMPILE_DEBUG                            0x00000001
 #define D3DCOMPILE_SKIP_VALIDATION                  0x00000002
@@ -95,6 +102,260 @@ namespace
 {
 	using namespace KlayGE;
 
+	ShaderCacheDigest FileDigest(std::string const & path)
+	{
+		ShaderCacheDigest digest;
+		std::ifstream file(path, std::ios_base::binary);
+		std::vector<char> buff(64 * 1024);
+		while (file)
+		{
+			file.read(buff.data(), buff.size());
+			digest.Append(buff.data(), static_cast<size_t>(file.gcount()));
+		}
+		return digest;
+	}
+
+	bool IsIdentifierChar(char ch)
+	{
+		return ((ch >= 'a') && (ch <= 'z')) || ((ch >= 'A') && (ch <= 'Z')) || ((ch >= '0') && (ch <= '9')) || (ch == '_');
+	}
+
+	void CollectIdentifiers(std::string_view text, std::vector<std::string_view>& identifiers)
+	{
+		for (size_t i = 0; i < text.size();)
+		{
+			if (IsIdentifierChar(text[i]))
+			{
+				size_t const start = i;
+				while ((i < text.size()) && IsIdentifierChar(text[i]))
+				{
+					++ i;
+				}
+				if ((text[start] < '0') || (text[start] > '9'))
+				{
+					identifiers.push_back(text.substr(start, i - start));
+				}
+			}
+			else
+			{
+				++ i;
+			}
+		}
+	}
+
+	// The part of a preprocessed effect that an entry point can depend on: all top level declarations, and the function
+	//  definitions reachable from the entry point. Anything not recognized as a function definition is kept, so the result
+	//  only ever has too much, never too little.
+	std::string EntryPointSource(std::string_view source, std::string_view entry_point)
+	{
+		// #line differs between effects and doesn't change the code
+		std::string stripped;
+		stripped.reserve(source.size());
+		for (size_t line_start = 0; line_start < source.size();)
+		{
+			size_t line_end = source.find('\n', line_start);
+			line_end = (line_end == std::string_view::npos) ? source.size() : line_end + 1;
+			std::string_view const line = source.substr(line_start, line_end - line_start);
+			size_t const first = line.find_first_not_of(" \t");
+			if ((first == std::string_view::npos) || (line.substr(first, 5) != "#line"))
+			{
+				stripped += line;
+			}
+			line_start = line_end;
+		}
+		std::string_view const preprocessed = stripped;
+
+		struct TopLevelChunk
+		{
+			std::string_view text;
+			std::string_view func_name;
+			bool keep;
+		};
+		std::vector<TopLevelChunk> chunks;
+
+		size_t chunk_start = 0;
+		int brace_depth = 0;
+		int paren_depth = 0;
+		int bracket_depth = 0;
+		bool in_func = false;
+		size_t block_end = std::string_view::npos;
+		std::string_view func_name;
+		auto const end_chunk = [&](size_t end)
+		{
+			std::string_view const text = preprocessed.substr(chunk_start, end - chunk_start);
+			if (text.find_first_not_of(" \t\r\n") != std::string_view::npos)
+			{
+				chunks.push_back({text, func_name, func_name.empty()});
+			}
+			chunk_start = end;
+			in_func = false;
+			block_end = std::string_view::npos;
+			func_name = std::string_view();
+		};
+		for (size_t i = 0; i < preprocessed.size(); ++ i)
+		{
+			char const ch = preprocessed[i];
+			if ((ch == '#') && (brace_depth == 0)
+				&& (preprocessed.find_first_not_of(" \t\r\n", chunk_start) == i))
+			{
+				// Directives left by the preprocessor, such as #pragma pack_matrix, are declarations of their own
+				size_t line_end = preprocessed.find('\n', i);
+				line_end = (line_end == std::string_view::npos) ? preprocessed.size() : line_end + 1;
+				end_chunk(line_end);
+				i = line_end - 1;
+				continue;
+			}
+
+			switch (ch)
+			{
+			case '(':
+				++ paren_depth;
+				break;
+
+			case ')':
+				-- paren_depth;
+				break;
+
+			case '[':
+				++ bracket_depth;
+				break;
+
+			case ']':
+				-- bracket_depth;
+				break;
+
+			case '{':
+				if ((brace_depth == 0) && (paren_depth == 0))
+				{
+					// A function header ends with its parameter list, maybe followed by a semantic
+					size_t const header_start = (block_end != std::string_view::npos) ? block_end : chunk_start;
+					std::string_view header = preprocessed.substr(header_start, i - header_start);
+					header = header.substr(0, header.find_last_not_of(" \t\r\n") + 1);
+					size_t const colon = header.rfind(':');
+					if ((colon != std::string_view::npos) && (header.find(')', colon) == std::string_view::npos))
+					{
+						header = header.substr(0, header.find_last_not_of(" \t\r\n", colon - 1) + 1);
+					}
+					if (!header.empty() && (header.back() == ')'))
+					{
+						int bracket = 0;
+						for (size_t j = 0; j < header.size(); ++ j)
+						{
+							if (header[j] == '[')
+							{
+								++ bracket;
+							}
+							else if (header[j] == ']')
+							{
+								-- bracket;
+							}
+							else if ((header[j] == '(') && (bracket == 0))
+							{
+								size_t name_end = header.find_last_not_of(" \t\r\n", j - 1) + 1;
+								size_t name_start = name_end;
+								while ((name_start > 0) && IsIdentifierChar(header[name_start - 1]))
+								{
+									-- name_start;
+								}
+								std::string_view const name = header.substr(name_start, name_end - name_start);
+								size_t const type_end = (name_start > 0)
+									? header.find_last_not_of(" \t\r\n", name_start - 1) : std::string_view::npos;
+								// A return type precedes the name, unlike register() of a cbuffer
+								if (!name.empty() && (type_end != std::string_view::npos)
+									&& (IsIdentifierChar(header[type_end]) || (header[type_end] == '>')))
+								{
+									// Such as a cbuffer, which doesn't end with a semicolon
+									if (block_end != std::string_view::npos)
+									{
+										end_chunk(block_end);
+									}
+									func_name = name;
+									in_func = true;
+								}
+								break;
+							}
+						}
+					}
+				}
+				++ brace_depth;
+				break;
+
+			case '}':
+				-- brace_depth;
+				if (brace_depth == 0)
+				{
+					if (in_func)
+					{
+						end_chunk(i + 1);
+					}
+					else
+					{
+						block_end = i + 1;
+					}
+				}
+				break;
+
+			case ';':
+				if ((brace_depth == 0) && (paren_depth == 0) && (bracket_depth == 0))
+				{
+					end_chunk(i + 1);
+				}
+				break;
+
+			default:
+				break;
+			}
+		}
+		func_name = std::string_view();
+		end_chunk(preprocessed.size());
+
+		std::unordered_multimap<std::string_view, size_t> funcs;
+		std::vector<std::string_view> pending;
+		for (size_t i = 0; i < chunks.size(); ++ i)
+		{
+			if (chunks[i].keep)
+			{
+				CollectIdentifiers(chunks[i].text, pending);
+			}
+			else
+			{
+				funcs.emplace(chunks[i].func_name, i);
+			}
+		}
+		if (funcs.find(entry_point) == funcs.end())
+		{
+			return stripped;
+		}
+
+		pending.push_back(entry_point);
+		std::unordered_set<std::string_view> visited;
+		while (!pending.empty())
+		{
+			std::string_view const name = pending.back();
+			pending.pop_back();
+			if (visited.insert(name).second)
+			{
+				auto const range = funcs.equal_range(name);
+				for (auto iter = range.first; iter != range.second; ++ iter)
+				{
+					chunks[iter->second].keep = true;
+					CollectIdentifiers(chunks[iter->second].text, pending);
+				}
+			}
+		}
+
+		std::string ret;
+		for (auto const & chunk : chunks)
+		{
+			if (chunk.keep)
+			{
+				ret += chunk.text;
+				ret += '\n';
+			}
+		}
+		return ret;
+	}
+
 	class D3DCompilerLoader
 	{
 	public:
@@ -111,6 +372,13 @@ namespace
 			return initer;
 		}
 
+		// Digest of the compiler binary. Part of the shader cache digest, so code from another compiler version is never
+		//  picked up.
+		ShaderCacheDigest const & CompilerDigest() const
+		{
+			return compiler_digest_;
+		}
+
 		HRESULT D3DCompile(std::string const & src_data,
 			D3D_SHADER_MACRO const * defines, char const * entry_point,
 			char const * target, uint32_t flags1, uint32_t flags2,
@@ -142,9 +410,129 @@ namespace
 			}
 			return hr;
 #else
-			std::string mark = std::to_string(reinterpret_cast<uint64_t>(src_data.c_str()));
-			std::string compile_input_file = entry_point + mark + "Input.tmp";
-			std::string compile_output_file = entry_point + mark + "Output.tmp";
+			std::ostringstream args;
+			args << " " << entry_point << " " << target;
+			args << " " << flags1 << " " << flags2;
+			return this->CallWrapper("compile", entry_point, src_data, defines, args.str(), code, error_msgs);
+#endif
+		}
+
+		HRESULT D3DPreprocess(std::string const & src_data, D3D_SHADER_MACRO const * defines,
+			std::string& text, std::string& error_msgs) const
+		{
+#ifdef CALL_D3DCOMPILER_DIRECTLY
+			com_ptr<ID3DBlob> text_blob;
+			com_ptr<ID3DBlob> error_msgs_blob;
+			HRESULT hr = DynamicD3DPreprocess_(src_data.c_str(), static_cast<UINT>(src_data.size()),
+				nullptr, defines, nullptr, text_blob.put(), error_msgs_blob.put());
+			if (text_blob)
+			{
+				char const * p = static_cast<char const *>(text_blob->GetBufferPointer());
+				text.assign(p, p + text_blob->GetBufferSize());
+			}
+			else
+			{
+				text.clear();
+			}
+			if (error_msgs_blob)
+			{
+				char const * p = static_cast<char const *>(error_msgs_blob->GetBufferPointer());
+				error_msgs.assign(p, p + error_msgs_blob->GetBufferSize());
+			}
+			else
+			{
+				error_msgs.clear();
+			}
+			return hr;
+#else
+			std::vector<uint8_t> output;
+			HRESULT hr = this->CallWrapper("preprocess", "Preprocess", src_data, defines, "", output, error_msgs);
+			text.assign(output.begin(), output.end());
+			return hr;
+#endif
+		}
+
+		HRESULT D3DReflect(std::vector<uint8_t> const & shader_code, void** reflector)
+		{
+#ifdef CALL_D3DCOMPILER_DIRECTLY
+			static GUID const IID_ID3D11ShaderReflection_47
+				= { 0x8d536ca1, 0x0cca, 0x4956, { 0xa8, 0x37, 0x78, 0x69, 0x63, 0x75, 0x55, 0x84 } };
+
+			return DynamicD3DReflect_(&shader_code[0], static_cast<UINT>(shader_code.size()), IID_ID3D11ShaderReflection_47, reflector);
+#else
+			// TODO
+			KFL_UNUSED(shader_code);
+			KFL_UNUSED(reflector);
+			return S_OK;
+#endif
+		}
+
+		HRESULT D3DStripShader(std::vector<uint8_t> const & shader_code, uint32_t strip_flags, std::vector<uint8_t>& stripped_code)
+		{
+#ifdef CALL_D3DCOMPILER_DIRECTLY
+			com_ptr<ID3DBlob> stripped_blob;
+			HRESULT hr = DynamicD3DStripShader_(&shader_code[0], static_cast<UINT>(shader_code.size()), strip_flags, stripped_blob.put());
+
+			uint8_t const * p = static_cast<uint8_t const *>(stripped_blob->GetBufferPointer());
+			stripped_code.assign(p, p + stripped_blob->GetBufferSize());
+
+			return hr;
+#else
+			// TODO
+			KFL_UNUSED(shader_code);
+			KFL_UNUSED(strip_flags);
+			KFL_UNUSED(stripped_code);
+			return S_OK;
+#endif
+		}
+
+	private:
+		D3DCompilerLoader()
+		{
+#ifdef CALL_D3DCOMPILER_DIRECTLY
+			mod_d3dcompiler_ = ::LoadLibraryEx(TEXT("d3dcompiler_47.dll"), nullptr, 0);
+			KLAYGE_ASSUME(mod_d3dcompiler_ != nullptr);
+
+#if defined(KLAYGE_COMPILER_GCC) && (KLAYGE_COMPILER_VERSION >= 80)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wcast-function-type"
+#endif
+			DynamicD3DCompile_ = reinterpret_cast<D3DCompileFunc>(::GetProcAddress(mod_d3dcompiler_, "D3DCompile"));
+			DynamicD3DPreprocess_ = reinterpret_cast<D3DPreprocessFunc>(::GetProcAddress(mod_d3dcompiler_, "D3DPreprocess"));
+			DynamicD3DReflect_ = reinterpret_cast<D3DReflectFunc>(::GetProcAddress(mod_d3dcompiler_, "D3DReflect"));
+			DynamicD3DStripShader_ = reinterpret_cast<D3DStripShaderFunc>(::GetProcAddress(mod_d3dcompiler_, "D3DStripShader"));
+#if defined(KLAYGE_COMPILER_GCC) && (KLAYGE_COMPILER_VERSION >= 80)
+#pragma GCC diagnostic pop
+#endif
+
+			char dll_path[MAX_PATH];
+			DWORD const dll_path_len = ::GetModuleFileNameA(mod_d3dcompiler_, dll_path, sizeof(dll_path));
+			compiler_digest_ = FileDigest(std::string(dll_path, dll_path_len));
+#else
+			// The wrapper runs d3dcompiler_47.dll under wine
+			std::string d3dcompiler_wrapper_name = "D3DCompilerWrapper";
+#ifdef KLAYGE_DEBUG
+			d3dcompiler_wrapper_name += "_d";
+#endif
+			d3dcompiler_wrapper_name += ".exe.so";
+			compiler_digest_ = FileDigest(ResLoader::Instance().Locate(d3dcompiler_wrapper_name));
+			compiler_digest_.Append(KFL_STRINGIZE(WINE_PATH));
+#endif
+		}
+
+	private:
+#ifndef CALL_D3DCOMPILER_DIRECTLY
+		// Runs a command of D3DCompilerWrapper, which takes the source and the macros, and writes the result and the messages
+		HRESULT CallWrapper(char const * command, std::string const & name, std::string const & src_data,
+			D3D_SHADER_MACRO const * defines, std::string const & args,
+			std::vector<uint8_t>& output, std::string& error_msgs) const
+		{
+			// Shaders are compiled in parallel, every call needs its own temp files
+			static std::atomic<uint32_t> compile_index(0);
+			std::string mark = std::to_string(reinterpret_cast<uint64_t>(src_data.c_str())) + "_"
+				+ std::to_string(compile_index.fetch_add(1, std::memory_order_relaxed));
+			std::string compile_input_file = name + mark + "Input.tmp";
+			std::string compile_output_file = name + mark + "Output.tmp";
 
 			uint32_t buffer_size;
 			
@@ -180,24 +568,22 @@ namespace
 #ifdef KLAYGE_PLATFORM_WINDOWS
 			ss << d3dcompiler_wrapper_name << ".exe";
 #else
-			static bool first = true;
-			if (first)
-			{
-				ss << KFL_STRINGIZE(WINE_PATH) << "wineserver -p";
-				int err = system(ss.str().c_str());
-				KFL_UNUSED(err);
-				// We should hold on a persistant wineserver, or XCode will lost connection after wineserver instance close and wine may not be able to find '.exe.so' file
-				first = false;
-				ss.str(std::string());
-			}
+			static std::once_flag wineserver_flag;
+			std::call_once(wineserver_flag, []
+				{
+					std::ostringstream wineserver_ss;
+					wineserver_ss << KFL_STRINGIZE(WINE_PATH) << "wineserver -p";
+					int err = system(wineserver_ss.str().c_str());
+					KFL_UNUSED(err);
+					// We should hold on a persistant wineserver, or XCode will lost connection after wineserver instance close and wine may not be able to find '.exe.so' file
+				});
 			d3dcompiler_wrapper_name += ".exe.so";
 			std::string wrapper_path = ResLoader::Instance().Locate(d3dcompiler_wrapper_name);
 			ss << KFL_STRINGIZE(WINE_PATH) << "wine " << wrapper_path;
 #endif
-			ss << " compile";
+			ss << " " << command;
 			ss << " " << compile_input_file;
-			ss << " " << entry_point << " " << target;
-			ss << " " << flags1 << " " << flags2;
+			ss << args;
 			ss << " " << compile_output_file;
 			if (system(ss.str().c_str()) != 0)
 			{
@@ -212,12 +598,12 @@ namespace
 			ifs.read(reinterpret_cast<char*>(&buffer_size), sizeof(buffer_size));
 			if (buffer_size > 0)
 			{
-				code.resize(buffer_size);
-				ifs.read(reinterpret_cast<char*>(&code[0]), buffer_size);
+				output.resize(buffer_size);
+				ifs.read(reinterpret_cast<char*>(&output[0]), buffer_size);
 			}
 			else
 			{
-				code.clear();
+				output.clear();
 			}
 
 			ifs.read(reinterpret_cast<char*>(&buffer_size), sizeof(buffer_size));
@@ -237,77 +623,27 @@ namespace
 			remove(compile_output_file.c_str());
 
 			return hr;
-#endif
 		}
-
-		HRESULT D3DReflect(std::vector<uint8_t> const & shader_code, void** reflector)
-		{
-#ifdef CALL_D3DCOMPILER_DIRECTLY
-			static GUID const IID_ID3D11ShaderReflection_47
-				= { 0x8d536ca1, 0x0cca, 0x4956, { 0xa8, 0x37, 0x78, 0x69, 0x63, 0x75, 0x55, 0x84 } };
-
-			return DynamicD3DReflect_(&shader_code[0], static_cast<UINT>(shader_code.size()), IID_ID3D11ShaderReflection_47, reflector);
-#else
-			// TODO
-			KFL_UNUSED(shader_code);
-			KFL_UNUSED(reflector);
-			return S_OK;
 #endif
-		}
 
-		HRESULT D3DStripShader(std::vector<uint8_t> const & shader_code, uint32_t strip_flags, std::vector<uint8_t>& stripped_code)
-		{
-#ifdef CALL_D3DCOMPILER_DIRECTLY
-			com_ptr<ID3DBlob> stripped_blob;
-			HRESULT hr = DynamicD3DStripShader_(&shader_code[0], static_cast<UINT>(shader_code.size()), strip_flags, stripped_blob.put());
-
-			uint8_t const * p = static_cast<uint8_t const *>(stripped_blob->GetBufferPointer());
-			stripped_code.assign(p, p + stripped_blob->GetBufferSize());
-
-			return hr;
-#else
-			// TODO
-			KFL_UNUSED(shader_code);
-			KFL_UNUSED(strip_flags);
-			KFL_UNUSED(stripped_code);
-			return S_OK;
-#endif
-		}
-
-	private:
-		D3DCompilerLoader()
-		{
-#ifdef CALL_D3DCOMPILER_DIRECTLY
-			mod_d3dcompiler_ = ::LoadLibraryEx(TEXT("d3dcompiler_47.dll"), nullptr, 0);
-			KLAYGE_ASSUME(mod_d3dcompiler_ != nullptr);
-
-#if defined(KLAYGE_COMPILER_GCC) && (KLAYGE_COMPILER_VERSION >= 80)
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wcast-function-type"
-#endif
-			DynamicD3DCompile_ = reinterpret_cast<D3DCompileFunc>(::GetProcAddress(mod_d3dcompiler_, "D3DCompile"));
-			DynamicD3DReflect_ = reinterpret_cast<D3DReflectFunc>(::GetProcAddress(mod_d3dcompiler_, "D3DReflect"));
-			DynamicD3DStripShader_ = reinterpret_cast<D3DStripShaderFunc>(::GetProcAddress(mod_d3dcompiler_, "D3DStripShader"));
-#if defined(KLAYGE_COMPILER_GCC) && (KLAYGE_COMPILER_VERSION >= 80)
-#pragma GCC diagnostic pop
-#endif
-#endif
-		}
-
-	private:
 #ifdef CALL_D3DCOMPILER_DIRECTLY
 		typedef HRESULT (WINAPI *D3DCompileFunc)(LPCVOID pSrcData, SIZE_T SrcDataSize, LPCSTR pSourceName,
 			D3D_SHADER_MACRO const * pDefines, ID3DInclude* pInclude, LPCSTR pEntrypoint,
 			LPCSTR pTarget, UINT Flags1, UINT Flags2, ID3DBlob** ppCode, ID3DBlob** ppErrorMsgs);
+		typedef HRESULT (WINAPI *D3DPreprocessFunc)(LPCVOID pSrcData, SIZE_T SrcDataSize, LPCSTR pSourceName,
+			D3D_SHADER_MACRO const * pDefines, ID3DInclude* pInclude, ID3DBlob** ppCodeText, ID3DBlob** ppErrorMsgs);
 		typedef HRESULT (WINAPI *D3DReflectFunc)(LPCVOID pSrcData, SIZE_T SrcDataSize, REFIID pInterface, void** ppReflector);
 		typedef HRESULT (WINAPI *D3DStripShaderFunc)(LPCVOID pShaderBytecode, SIZE_T BytecodeLength, UINT uStripFlags,
 			ID3DBlob** ppStrippedBlob);
 
 		HMODULE mod_d3dcompiler_;
 		D3DCompileFunc DynamicD3DCompile_;
+		D3DPreprocessFunc DynamicD3DPreprocess_;
 		D3DReflectFunc DynamicD3DReflect_;
 		D3DStripShaderFunc DynamicD3DStripShader_;
 #endif
+
+		ShaderCacheDigest compiler_digest_;
 	};
 }
 
@@ -457,11 +793,60 @@ namespace KlayGE
 			macros.push_back(macro_end);
 		}
 
+#if KLAYGE_IS_DEV_PLATFORM
+		ShaderCacheDigest cache_digest;
+		{
+			ShaderCacheDigest const & compiler_digest = D3DCompilerLoader::Instance().CompilerDigest();
+			uint64_t const compiler_hi = compiler_digest.High();
+			uint64_t const compiler_lo = compiler_digest.Low();
+			cache_digest.Append(&compiler_hi, sizeof(compiler_hi));
+			cache_digest.Append(&compiler_lo, sizeof(compiler_lo));
+		}
+		{
+			// Keyed on what the entry point can see after preprocessing, so effects sharing the code share the entry
+			std::string preprocessed;
+			std::string preprocess_err_msg;
+			if (SUCCEEDED(D3DCompilerLoader::Instance().D3DPreprocess(hlsl_shader_text, &macros[0], preprocessed,
+				preprocess_err_msg)) && !preprocessed.empty())
+			{
+				cache_digest.Append(EntryPointSource(preprocessed, func_name));
+			}
+			else
+			{
+				cache_digest.Append(hlsl_shader_text);
+			}
+			if (flags & D3DCOMPILE_DEBUG)
+			{
+				// Debug info refers to lines of the whole effect
+				cache_digest.Append(hlsl_shader_text);
+			}
+		}
+		for (auto const & macro : macros)
+		{
+			if (macro.Name != nullptr)
+			{
+				cache_digest.Append(macro.Name);
+				cache_digest.Append(macro.Definition);
+			}
+		}
+		cache_digest.Append(func_name);
+		cache_digest.Append(shader_profile);
+		cache_digest.Append(&flags, sizeof(flags));
+
+		auto& shader_cache = ShaderCache::Instance();
+		if (shader_cache.Find(cache_digest, code))
+		{
+			return code;
+		}
+#endif
+
 		D3DCompilerLoader::Instance().D3DCompile(hlsl_shader_text, &macros[0],
 			func_name, shader_profile,
 			flags, 0, code, err_msg);
 		if (!err_msg.empty())
 		{
+			std::lock_guard<std::mutex> lock(CompileLogMutex());
+
 			LogError() << "Error when compiling " << func_name << ":" << std::endl;
 
 			std::map<int, std::vector<std::string>> err_lines;
@@ -552,6 +937,13 @@ namespace KlayGE
 			}
 		}
 
+#if KLAYGE_IS_DEV_PLATFORM
+		if (!code.empty())
+		{
+			shader_cache.Insert(cache_digest, code);
+		}
+#endif
+
 		return code;
 	}
 
@@ -560,6 +952,12 @@ namespace KlayGE
 		D3DCompilerLoader::Instance().D3DReflect(code, reflector);
 	}
 
+	std::mutex& ShaderStageObject::CompileLogMutex()
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+
 	std::vector<uint8_t> ShaderStageObject::StripDXBC(std::vector<uint8_t> const & code, uint32_t strip_flags)
 	{
 		std::vector<uint8_t> ret;
@@ -33,6 +33,7 @@
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/Texture.hpp>
 
+#include <algorithm>
 #include <vector>
 #include <cstring>
 
@@ -278,6 +279,38 @@ namespace KlayGE
 
 	TexCompression::~TexCompression() noexcept = default;
 
+	void TexCompression::EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method)
+	{
+		uint32_t const block_bytes = BlockBytes(compression_format_);
+		uint32_t const uncompressed_block_bytes = BlockWidth(compression_format_) * BlockHeight(compression_format_)
+			* NumFormatBytes(DecodedFormat(compression_format_));
+
+		uint8_t* dst = static_cast<uint8_t*>(output);
+		uint8_t const * src = static_cast<uint8_t const *>(input);
+		for (uint32_t i = 0; i < num_blocks; ++ i)
+		{
+			this->EncodeBlock(dst, src, method);
+			dst += block_bytes;
+			src += uncompressed_block_bytes;
+		}
+	}
+
+	void TexCompression::DecodeBlocks(void* output, void const * input, uint32_t num_blocks)
+	{
+		uint32_t const block_bytes = BlockBytes(compression_format_);
+		uint32_t const uncompressed_block_bytes = BlockWidth(compression_format_) * BlockHeight(compression_format_)
+			* NumFormatBytes(DecodedFormat(compression_format_));
+
+		uint8_t* dst = static_cast<uint8_t*>(output);
+		uint8_t const * src = static_cast<uint8_t const *>(input);
+		for (uint32_t i = 0; i < num_blocks; ++ i)
+		{
+			this->DecodeBlock(dst, src);
+			dst += uncompressed_block_bytes;
+			src += block_bytes;
+		}
+	}
+
 	void TexCompression::EncodeMem(uint32_t width, uint32_t height,
 		void* output, uint32_t out_row_pitch, uint32_t out_slice_pitch,
 		void const * input, uint32_t in_row_pitch, uint32_t in_slice_pitch,
@@ -289,39 +322,52 @@ namespace KlayGE
 		uint32_t const elem_size = NumFormatBytes(DecodedFormat(compression_format_));
 		uint32_t const block_width = BlockWidth(compression_format_);
 		uint32_t const block_height = BlockHeight(compression_format_);
-		uint32_t const block_bytes = BlockBytes(compression_format_);
+		uint32_t const uncompressed_block_bytes = block_width * block_height * elem_size;
+		uint32_t const num_blocks_per_row = (width + block_width - 1) / block_width;
+		uint32_t const num_block_rows = (height + block_height - 1) / block_height;
 
 		uint8_t const * src = static_cast<uint8_t const *>(input);
+		uint8_t* dst = static_cast<uint8_t*>(output);
 
-		std::vector<uint8_t> uncompressed(block_width * block_height * elem_size);
-		for (uint32_t y_base = 0; y_base < height; y_base += block_height)
-		{
-			uint8_t* dst = static_cast<uint8_t*>(output) + (y_base / block_height) * out_row_pitch;
-
-			for (uint32_t x_base = 0; x_base < width; x_base += block_width)
+		Context::Instance().TaskSchedulerInstance().ParallelFor(0, num_block_rows, 0,
+			[this, width, height, out_row_pitch, in_row_pitch, method, elem_size, block_width, block_height,
+				uncompressed_block_bytes, num_blocks_per_row, src, dst](uint32_t row_begin, uint32_t row_end)
 			{
-				for (uint32_t y = 0; y < block_height; ++ y)
+				auto worker_codec = this->CreateWorkerCodec();
+				TexCompression& codec = worker_codec ? *worker_codec : *this;
+
+				// A whole row of blocks is gathered, so they can go to the codec in one call
+				std::vector<uint8_t> uncompressed(num_blocks_per_row * uncompressed_block_bytes);
+				for (uint32_t block_row = row_begin; block_row < row_end; ++ block_row)
 				{
-					for (uint32_t x = 0; x < block_width; ++ x)
+					uint32_t const y_base = block_row * block_height;
+					for (uint32_t y = 0; y < block_height; ++ y)
 					{
-						if ((x_base + x < width) && (y_base + y < height))
+						uint8_t* block_line = &uncompressed[y * block_width * elem_size];
+						if (y_base + y < height)
 						{
-							memcpy(&uncompressed[(y * block_width + x) * elem_size],
-								&src[(y_base + y) * in_row_pitch + (x_base + x) * elem_size],
-								elem_size);
+							uint8_t const * src_line = src + (y_base + y) * in_row_pitch;
+							for (uint32_t x_base = 0; x_base < width; x_base += block_width)
+							{
+								uint32_t const block_w = std::min(block_width, width - x_base);
+								memcpy(block_line, src_line + x_base * elem_size, block_w * elem_size);
+								memset(block_line + block_w * elem_size, 0, (block_width - block_w) * elem_size);
+								block_line += uncompressed_block_bytes;
+							}
 						}
 						else
 						{
-							memset(&uncompressed[(y * block_width + x) * elem_size],
-								0, elem_size);
+							for (uint32_t i = 0; i < num_blocks_per_row; ++ i)
+							{
+								memset(block_line, 0, block_width * elem_size);
+								block_line += uncompressed_block_bytes;
+							}
 						}
 					}
-				}
 
-				this->EncodeBlock(dst, &uncompressed[0], method);
-				dst += block_bytes;
-			}
-		}
+					codec.EncodeBlocks(dst + block_row * out_row_pitch, uncompressed.data(), num_blocks_per_row, method);
+				}
+			});
 	}
 
 	void TexCompression::DecodeMem(uint32_t width, uint32_t height,
@@ -334,33 +380,40 @@ namespace KlayGE
 		uint32_t const elem_size = NumFormatBytes(DecodedFormat(compression_format_));
 		uint32_t const block_width = BlockWidth(compression_format_);
 		uint32_t const block_height = BlockHeight(compression_format_);
-		uint32_t const block_bytes = BlockBytes(compression_format_);
-
-		uint8_t * dst = static_cast<uint8_t*>(output);
+		uint32_t const uncompressed_block_bytes = block_width * block_height * elem_size;
+		uint32_t const num_blocks_per_row = (width + block_width - 1) / block_width;
+		uint32_t const num_block_rows = (height + block_height - 1) / block_height;
 
-		std::vector<uint8_t> uncompressed(block_width * block_height * elem_size);
-		for (uint32_t y_base = 0; y_base < height; y_base += block_height)
-		{
-			uint8_t const * src = static_cast<uint8_t const *>(input) + in_row_pitch * (y_base / block_height);
+		uint8_t const * src = static_cast<uint8_t const *>(input);
+		uint8_t* dst = static_cast<uint8_t*>(output);
 
-			uint32_t const block_h = std::min(block_height, height - y_base);
-			for (uint32_t x_base = 0; x_base < width; x_base += block_width)
+		Context::Instance().TaskSchedulerInstance().ParallelFor(0, num_block_rows, 0,
+			[this, width, height, out_row_pitch, in_row_pitch, elem_size, block_width, block_height,
+				uncompressed_block_bytes, num_blocks_per_row, src, dst](uint32_t row_begin, uint32_t row_end)
 			{
-				uint32_t const block_w = std::min(block_width, width - x_base);
+				auto worker_codec = this->CreateWorkerCodec();
+				TexCompression& codec = worker_codec ? *worker_codec : *this;
 
-				this->DecodeBlock(&uncompressed[0], src);
-				src += block_bytes;
-
-				for (uint32_t y = 0; y < block_h; ++ y)
+				std::vector<uint8_t> uncompressed(num_blocks_per_row * uncompressed_block_bytes);
+				for (uint32_t block_row = row_begin; block_row < row_end; ++ block_row)
 				{
-					for (uint32_t x = 0; x < block_w; ++ x)
+					codec.DecodeBlocks(uncompressed.data(), src + block_row * in_row_pitch, num_blocks_per_row);
+
+					uint32_t const y_base = block_row * block_height;
+					uint32_t const block_h = std::min(block_height, height - y_base);
+					for (uint32_t y = 0; y < block_h; ++ y)
 					{
-						memcpy(&dst[(y_base + y) * out_row_pitch + (x_base + x) * elem_size],
-							&uncompressed[(y * block_width + x) * elem_size], elem_size);
+						uint8_t const * block_line = &uncompressed[y * block_width * elem_size];
+						uint8_t* dst_line = dst + (y_base + y) * out_row_pitch;
+						for (uint32_t x_base = 0; x_base < width; x_base += block_width)
+						{
+							uint32_t const block_w = std::min(block_width, width - x_base);
+							memcpy(dst_line + x_base * elem_size, block_line, block_w * elem_size);
+							block_line += uncompressed_block_bytes;
+						}
 					}
 				}
-			}
-		}
+			});
 	}
 
 	void TexCompression::EncodeTex(TexturePtr const & out_tex, TexturePtr const & in_tex, TexCompressionMethod method)
@@ -417,6 +470,11 @@ namespace KlayGE
 		}
 	}
 
+	std::unique_ptr<TexCompression> TexCompression::CreateWorkerCodec() const
+	{
+		return nullptr;
+	}
+
 	
 	RGBACluster::RGBACluster(ARGBColor32 const * pixels, uint32_t num,
 			std::function<uint32_t(uint32_t, uint32_t, uint32_t)> const & get_partition)
@@ -36,14 +36,21 @@
 #include <KlayGE/Texture.hpp>
 #include <KFL/Half.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <iterator>
+#include <limits>
+#include <numeric>
 #include <random>
 #include <vector>
 #include <boost/assert.hpp>
 #ifdef KLAYGE_COMPILER_MSVC
 	#include <intrin.h>		// For _BitScanForward
 #endif
+#if defined(KLAYGE_SSE2_SUPPORT)
+	#include <emmintrin.h>
+#endif
 
 #include <KlayGE/TexCompressionBC.hpp>
 #include "../Base/TableGen/Tables.hpp"
@@ -332,6 +339,251 @@ namespace
 		}
 	}
 
+	// BC6H encodes the bits of half floats as integers, clamped to the largest finite value. Negative values are
+	//  kept only in the signed format.
+	int F16ToInt(half const & h, bool signed_fmt)
+	{
+		uint16_t const bits = *reinterpret_cast<uint16_t const *>(&h);
+		int const magnitude = std::min(bits & 0x7FFF, 0x7BFF);
+		if (bits & 0x8000)
+		{
+			return signed_fmt ? -magnitude : 0;
+		}
+		else
+		{
+			return magnitude;
+		}
+	}
+
+	uint8_t ChannelPrec(ARGBColor32 const & prec, uint32_t channel)
+	{
+		return (0 == channel) ? prec.r() : ((1 == channel) ? prec.g() : prec.b());
+	}
+
+	// Fits a line through the points along their principal axis, and returns its extent
+	void FitEndPointsPCA(float3 const * points, uint32_t num_points, float3& end_pt_0, float3& end_pt_1)
+	{
+		BOOST_ASSERT(num_points > 0);
+
+		float3 mean(0, 0, 0);
+		float3 min_pt = points[0];
+		float3 max_pt = points[0];
+		for (uint32_t i = 0; i < num_points; ++ i)
+		{
+			mean += points[i];
+			min_pt = MathLib::minimize(min_pt, points[i]);
+			max_pt = MathLib::maximize(max_pt, points[i]);
+		}
+		mean /= static_cast<float>(num_points);
+
+		float cov[6] = { 0, 0, 0, 0, 0, 0 };
+		for (uint32_t i = 0; i < num_points; ++ i)
+		{
+			float3 const d = points[i] - mean;
+			cov[0] += d.x() * d.x();
+			cov[1] += d.x() * d.y();
+			cov[2] += d.x() * d.z();
+			cov[3] += d.y() * d.y();
+			cov[4] += d.y() * d.z();
+			cov[5] += d.z() * d.z();
+		}
+
+		// Power iterations, starting from the diagonal of the bounding box
+		float3 axis = max_pt - min_pt;
+		for (uint32_t iter = 0; iter < 8; ++ iter)
+		{
+			float3 const new_axis(cov[0] * axis.x() + cov[1] * axis.y() + cov[2] * axis.z(),
+				cov[1] * axis.x() + cov[3] * axis.y() + cov[4] * axis.z(),
+				cov[2] * axis.x() + cov[4] * axis.y() + cov[5] * axis.z());
+			float const max_comp = std::max({ std::abs(new_axis.x()), std::abs(new_axis.y()), std::abs(new_axis.z()) });
+			if (max_comp < 1e-6f)
+			{
+				break;
+			}
+			axis = new_axis / max_comp;
+		}
+
+		float const axis_len_sq = MathLib::length_sq(axis);
+		if (axis_len_sq < 1e-6f)
+		{
+			end_pt_0 = end_pt_1 = mean;
+			return;
+		}
+
+		float t_min = std::numeric_limits<float>::max();
+		float t_max = -std::numeric_limits<float>::max();
+		for (uint32_t i = 0; i < num_points; ++ i)
+		{
+			float const t = MathLib::dot(points[i] - mean, axis) / axis_len_sq;
+			t_min = std::min(t_min, t);
+			t_max = std::max(t_max, t);
+		}
+		end_pt_0 = mean + axis * t_min;
+		end_pt_1 = mean + axis * t_max;
+	}
+
+	uint32_t const BC6_NUM_SHAPES = 32;
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+	float HorizontalMin(__m128 v)
+	{
+		v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+		v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+		return _mm_cvtss_f32(v);
+	}
+
+	float HorizontalMax(__m128 v)
+	{
+		v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+		v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+		return _mm_cvtss_f32(v);
+	}
+
+	float HorizontalSum(__m128 v)
+	{
+		v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+		v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+		return _mm_cvtss_f32(v);
+	}
+#endif
+
+	// A cheap error estimation of all the 2 region shapes. Each region is approximated by the diagonal of its bounding
+	//  box with 8 levels, which is enough to rank the shapes before the full compression of the best ones.
+	void EstimateBC6ShapeErrors(float const * r, float const * g, float const * b, float* errors)
+	{
+#if defined(KLAYGE_SSE2_SUPPORT)
+		__m128 const pr[] = { _mm_loadu_ps(&r[0]), _mm_loadu_ps(&r[4]), _mm_loadu_ps(&r[8]), _mm_loadu_ps(&r[12]) };
+		__m128 const pg[] = { _mm_loadu_ps(&g[0]), _mm_loadu_ps(&g[4]), _mm_loadu_ps(&g[8]), _mm_loadu_ps(&g[12]) };
+		__m128 const pb[] = { _mm_loadu_ps(&b[0]), _mm_loadu_ps(&b[4]), _mm_loadu_ps(&b[8]), _mm_loadu_ps(&b[12]) };
+		__m128 const* const channels[] = { pr, pg, pb };
+		__m128 const flt_max = _mm_set1_ps(std::numeric_limits<float>::max());
+		__m128 const neg_flt_max = _mm_set1_ps(-std::numeric_limits<float>::max());
+		__m128 const levels = _mm_set1_ps(7.0f);
+		__m128 const inv_levels = _mm_set1_ps(1.0f / 7);
+
+		for (uint32_t shape = 0; shape < BC6_NUM_SHAPES; ++ shape)
+		{
+			uint32_t const partition = BC67_PARTITION_TABLE[0][shape];
+
+			// All ones in the lanes of texels in region 1
+			__m128 in_region_1[4];
+			for (uint32_t v = 0; v < 4; ++ v)
+			{
+				uint32_t const bits = partition >> (v * 8);
+				in_region_1[v] = _mm_castsi128_ps(_mm_set_epi32(-static_cast<int>((bits >> 6) & 1),
+					-static_cast<int>((bits >> 4) & 1), -static_cast<int>((bits >> 2) & 1), -static_cast<int>(bits & 1)));
+			}
+
+			float min_pt[2][3];
+			float dir[2][3];
+			float inv_len_sq[2];
+			for (uint32_t region = 0; region < 2; ++ region)
+			{
+				__m128 mn[3] = { flt_max, flt_max, flt_max };
+				__m128 mx[3] = { neg_flt_max, neg_flt_max, neg_flt_max };
+				for (uint32_t v = 0; v < 4; ++ v)
+				{
+					__m128 const mask = (0 == region) ? _mm_xor_ps(in_region_1[v], _mm_castsi128_ps(_mm_set1_epi32(-1)))
+						: in_region_1[v];
+					for (uint32_t c = 0; c < 3; ++ c)
+					{
+						__m128 const p = channels[c][v];
+						mn[c] = _mm_min_ps(mn[c], _mm_or_ps(_mm_and_ps(mask, p), _mm_andnot_ps(mask, flt_max)));
+						mx[c] = _mm_max_ps(mx[c], _mm_or_ps(_mm_and_ps(mask, p), _mm_andnot_ps(mask, neg_flt_max)));
+					}
+				}
+
+				float len_sq = 0;
+				for (uint32_t c = 0; c < 3; ++ c)
+				{
+					min_pt[region][c] = HorizontalMin(mn[c]);
+					dir[region][c] = HorizontalMax(mx[c]) - min_pt[region][c];
+					len_sq += dir[region][c] * dir[region][c];
+				}
+				inv_len_sq[region] = (len_sq > 0) ? 1 / len_sq : 0;
+			}
+
+			__m128 err = _mm_setzero_ps();
+			for (uint32_t v = 0; v < 4; ++ v)
+			{
+				__m128 const mask = in_region_1[v];
+				__m128 base[3];
+				__m128 d[3];
+				for (uint32_t c = 0; c < 3; ++ c)
+				{
+					base[c] = _mm_or_ps(_mm_and_ps(mask, _mm_set1_ps(min_pt[1][c])), _mm_andnot_ps(mask, _mm_set1_ps(min_pt[0][c])));
+					d[c] = _mm_or_ps(_mm_and_ps(mask, _mm_set1_ps(dir[1][c])), _mm_andnot_ps(mask, _mm_set1_ps(dir[0][c])));
+				}
+				__m128 const inv_len = _mm_or_ps(_mm_and_ps(mask, _mm_set1_ps(inv_len_sq[1])),
+					_mm_andnot_ps(mask, _mm_set1_ps(inv_len_sq[0])));
+
+				__m128 const diff_r = _mm_sub_ps(pr[v], base[0]);
+				__m128 const diff_g = _mm_sub_ps(pg[v], base[1]);
+				__m128 const diff_b = _mm_sub_ps(pb[v], base[2]);
+				__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(diff_r, d[0]), _mm_mul_ps(diff_g, d[1])),
+					_mm_mul_ps(diff_b, d[2])), inv_len);
+				t = _mm_min_ps(_mm_max_ps(_mm_mul_ps(t, levels), _mm_setzero_ps()), levels);
+				t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtps_epi32(t)), inv_levels);
+
+				__m128 const er = _mm_sub_ps(diff_r, _mm_mul_ps(d[0], t));
+				__m128 const eg = _mm_sub_ps(diff_g, _mm_mul_ps(d[1], t));
+				__m128 const eb = _mm_sub_ps(diff_b, _mm_mul_ps(d[2], t));
+				err = _mm_add_ps(err, _mm_add_ps(_mm_add_ps(_mm_mul_ps(er, er), _mm_mul_ps(eg, eg)), _mm_mul_ps(eb, eb)));
+			}
+			errors[shape] = HorizontalSum(err);
+		}
+#else
+		float const * const channels[] = { r, g, b };
+		for (uint32_t shape = 0; shape < BC6_NUM_SHAPES; ++ shape)
+		{
+			float min_pt[2][3];
+			float dir[2][3];
+			float inv_len_sq[2];
+			for (uint32_t region = 0; region < 2; ++ region)
+			{
+				float len_sq = 0;
+				for (uint32_t c = 0; c < 3; ++ c)
+				{
+					float mn = std::numeric_limits<float>::max();
+					float mx = -std::numeric_limits<float>::max();
+					for (uint32_t i = 0; i < 16; ++ i)
+					{
+						if (GetPartition(2, shape, i) == region)
+						{
+							mn = std::min(mn, channels[c][i]);
+							mx = std::max(mx, channels[c][i]);
+						}
+					}
+					min_pt[region][c] = mn;
+					dir[region][c] = mx - mn;
+					len_sq += dir[region][c] * dir[region][c];
+				}
+				inv_len_sq[region] = (len_sq > 0) ? 1 / len_sq : 0;
+			}
+
+			float err = 0;
+			for (uint32_t i = 0; i < 16; ++ i)
+			{
+				uint32_t const region = GetPartition(2, shape, i);
+				float diff[3];
+				float t = 0;
+				for (uint32_t c = 0; c < 3; ++ c)
+				{
+					diff[c] = channels[c][i] - min_pt[region][c];
+					t += diff[c] * dir[region][c];
+				}
+				t = std::nearbyint(std::clamp(t * inv_len_sq[region] * 7, 0.0f, 7.0f)) / 7;
+				for (uint32_t c = 0; c < 3; ++ c)
+				{
+					float const e = diff[c] - dir[region][c] * t;
+					err += e * e;
+				}
+			}
+			errors[shape] = err;
+		}
+#endif
+	}
+
 	bool Bsf32(uint32_t& index, uint32_t v)
 	{
 #ifdef KLAYGE_COMPILER_MSVC
@@ -880,11 +1132,50 @@ namespace
 		}
 	}
 
-	int IntRand()
+	std::mt19937& IntRandGenerator()
 	{
 		static thread_local std::mt19937 gen;
+		return gen;
+	}
+
+	int IntRand()
+	{
 		std::uniform_int_distribution<int> random_dis(0, RAND_MAX);
-		return random_dis(gen);
+		return random_dis(IntRandGenerator());
+	}
+
+	// The codecs are final, so EncodeBlock and DecodeBlock are called without going through the vtable
+	template <typename Codec>
+	void EncodeBlocksImpl(Codec& codec, ElementFormat format, void* output, void const * input, uint32_t num_blocks,
+		TexCompressionMethod method)
+	{
+		uint32_t const block_bytes = BlockBytes(format);
+		uint32_t const uncompressed_block_bytes = BlockWidth(format) * BlockHeight(format) * NumFormatBytes(DecodedFormat(format));
+
+		uint8_t* dst = static_cast<uint8_t*>(output);
+		uint8_t const * src = static_cast<uint8_t const *>(input);
+		for (uint32_t i = 0; i < num_blocks; ++ i)
+		{
+			codec.Codec::EncodeBlock(dst, src, method);
+			dst += block_bytes;
+			src += uncompressed_block_bytes;
+		}
+	}
+
+	template <typename Codec>
+	void DecodeBlocksImpl(Codec& codec, ElementFormat format, void* output, void const * input, uint32_t num_blocks)
+	{
+		uint32_t const block_bytes = BlockBytes(format);
+		uint32_t const uncompressed_block_bytes = BlockWidth(format) * BlockHeight(format) * NumFormatBytes(DecodedFormat(format));
+
+		uint8_t* dst = static_cast<uint8_t*>(output);
+		uint8_t const * src = static_cast<uint8_t const *>(input);
+		for (uint32_t i = 0; i < num_blocks; ++ i)
+		{
+			codec.Codec::DecodeBlock(dst, src);
+			dst += uncompressed_block_bytes;
+			src += block_bytes;
+		}
 	}
 }
 
@@ -966,6 +1257,16 @@ namespace KlayGE
 		}
 	}
 
+	void TexCompressionBC1::EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method)
+	{
+		EncodeBlocksImpl(*this, compression_format_, output, input, num_blocks, method);
+	}
+
+	void TexCompressionBC1::DecodeBlocks(void* output, void const * input, uint32_t num_blocks)
+	{
+		DecodeBlocksImpl(*this, compression_format_, output, input, num_blocks);
+	}
+
 	ARGBColor32 TexCompressionBC1::RGB565To888(uint16_t rgb) const
 	{
 		return ARGBColor32(255, EXPAND5[(rgb >> 11) & 0x1F], EXPAND6[(rgb >> 5) & 0x3F],
@@ -1429,6 +1730,16 @@ namespace KlayGE
 		}
 	}
 
+	void TexCompressionBC2::EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method)
+	{
+		EncodeBlocksImpl(*this, compression_format_, output, input, num_blocks, method);
+	}
+
+	void TexCompressionBC2::DecodeBlocks(void* output, void const * input, uint32_t num_blocks)
+	{
+		DecodeBlocksImpl(*this, compression_format_, output, input, num_blocks);
+	}
+
 
 	TexCompressionBC3::TexCompressionBC3()
 	{
@@ -1475,6 +1786,16 @@ namespace KlayGE
 		}
 	}
 
+	void TexCompressionBC3::EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method)
+	{
+		EncodeBlocksImpl(*this, compression_format_, output, input, num_blocks, method);
+	}
+
+	void TexCompressionBC3::DecodeBlocks(void* output, void const * input, uint32_t num_blocks)
+	{
+		DecodeBlocksImpl(*this, compression_format_, output, input, num_blocks);
+	}
+
 
 	TexCompressionBC4::TexCompressionBC4()
 	{
@@ -1581,6 +1902,16 @@ namespace KlayGE
 		}
 	}
 
+	void TexCompressionBC4::EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method)
+	{
+		EncodeBlocksImpl(*this, compression_format_, output, input, num_blocks, method);
+	}
+
+	void TexCompressionBC4::DecodeBlocks(void* output, void const * input, uint32_t num_blocks)
+	{
+		DecodeBlocksImpl(*this, compression_format_, output, input, num_blocks);
+	}
+
 
 	TexCompressionBC5::TexCompressionBC5()
 	{
@@ -1626,6 +1957,16 @@ namespace KlayGE
 		}
 	}
 
+	void TexCompressionBC5::EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method)
+	{
+		EncodeBlocksImpl(*this, compression_format_, output, input, num_blocks, method);
+	}
+
+	void TexCompressionBC5::DecodeBlocks(void* output, void const * input, uint32_t num_blocks)
+	{
+		DecodeBlocksImpl(*this, compression_format_, output, input, num_blocks);
+	}
+
 
 	// BC6H Compression
 	TexCompressionBC6U::ModeDescriptor const TexCompressionBC6U::mode_desc_[14][82] =
@@ -1889,11 +2230,7 @@ namespace KlayGE
 
 	void TexCompressionBC6U::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
-		KFL_UNUSED(output);
-		KFL_UNUSED(input);
-		KFL_UNUSED(method);
-
-		// TODO
+		this->EncodeBC6Internal(output, input, method, false);
 	}
 
 	void TexCompressionBC6U::DecodeBlock(void* output, void const * input)
@@ -1901,6 +2238,96 @@ namespace KlayGE
 		this->DecodeBC6Internal(output, input, false);
 	}
 
+	void TexCompressionBC6U::EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method)
+	{
+		EncodeBlocksImpl(*this, compression_format_, output, input, num_blocks, method);
+	}
+
+	void TexCompressionBC6U::DecodeBlocks(void* output, void const * input, uint32_t num_blocks)
+	{
+		DecodeBlocksImpl(*this, compression_format_, output, input, num_blocks);
+	}
+
+	void TexCompressionBC6U::EncodeBC6Internal(void* output, void const * input, TexCompressionMethod method, bool signed_fmt)
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		Vector_T<half, 4> const * abgr = static_cast<Vector_T<half, 4> const *>(input);
+
+		// The decoder interpolates in the unquantized space, and scales the result by 31/64 (31/32 for signed)
+		float const unq_scale = signed_fmt ? 32.0f / 31 : 64.0f / 31;
+		std::array<float3, BC6_MAX_INDICES> pixels;
+		std::array<float3, BC6_MAX_INDICES> unq_pixels;
+		std::array<float, BC6_MAX_INDICES> unq_r;
+		std::array<float, BC6_MAX_INDICES> unq_g;
+		std::array<float, BC6_MAX_INDICES> unq_b;
+		for (uint32_t i = 0; i < BC6_MAX_INDICES; ++ i)
+		{
+			int3 const pixel(F16ToInt(abgr[i].x(), signed_fmt), F16ToInt(abgr[i].y(), signed_fmt),
+				F16ToInt(abgr[i].z(), signed_fmt));
+			pixels[i] = float3(Int2F16(pixel.x(), signed_fmt), Int2F16(pixel.y(), signed_fmt), Int2F16(pixel.z(), signed_fmt));
+			unq_pixels[i] = float3(static_cast<float>(pixel.x()), static_cast<float>(pixel.y()),
+				static_cast<float>(pixel.z())) * unq_scale;
+			unq_r[i] = unq_pixels[i].x();
+			unq_g[i] = unq_pixels[i].y();
+			unq_b[i] = unq_pixels[i].z();
+		}
+
+		uint32_t num_shapes;
+		uint32_t num_refinements;
+		switch (method)
+		{
+		case TCM_Speed:
+			num_shapes = 1;
+			num_refinements = 0;
+			break;
+
+		case TCM_Balanced:
+			num_shapes = 4;
+			num_refinements = 1;
+			break;
+
+		default:
+			num_shapes = BC6_NUM_SHAPES;
+			num_refinements = 2;
+			break;
+		}
+
+		std::array<uint32_t, BC6_NUM_SHAPES> shapes;
+		std::iota(shapes.begin(), shapes.end(), 0);
+		if (num_shapes < BC6_NUM_SHAPES)
+		{
+			std::array<float, BC6_NUM_SHAPES> shape_errors;
+			EstimateBC6ShapeErrors(unq_r.data(), unq_g.data(), unq_b.data(), shape_errors.data());
+			std::partial_sort(shapes.begin(), shapes.begin() + num_shapes, shapes.end(),
+				[&shape_errors](uint32_t lhs, uint32_t rhs)
+				{
+					return shape_errors[lhs] < shape_errors[rhs];
+				});
+		}
+
+		CompressParams best_params;
+		float best_error = std::numeric_limits<float>::max();
+		for (uint32_t mode_index = 0; (mode_index < std::size(mode_info_)) && (best_error > 0); ++ mode_index)
+		{
+			uint32_t const num_mode_shapes = (mode_info_[mode_index].partitions > 1) ? num_shapes : 1;
+			for (uint32_t s = 0; (s < num_mode_shapes) && (best_error > 0); ++ s)
+			{
+				CompressParams params;
+				float const error = this->TryCompress(mode_index, (mode_info_[mode_index].partitions > 1) ? shapes[s] : 0,
+					pixels.data(), unq_pixels.data(), signed_fmt, num_refinements, params);
+				if (error < best_error)
+				{
+					best_error = error;
+					best_params = params;
+				}
+			}
+		}
+
+		this->PackBC6Block(output, best_params);
+	}
+
 	void TexCompressionBC6U::DecodeBC6Internal(void* output, void const * input, bool signed_fmt)
 	{
 		BOOST_ASSERT(output);
@@ -2060,6 +2487,46 @@ namespace KlayGE
 		}
 	}
 
+	// The inverse of Unquantize, picks the nearest of the 2 candidates
+	int TexCompressionBC6U::Quantize(int unq, uint8_t bits_per_comp, bool signed_fmt)
+	{
+		if (signed_fmt)
+		{
+			unq = std::clamp(unq, -0x7FFF, 0x7FFF);
+			if (bits_per_comp >= 16)
+			{
+				return unq;
+			}
+
+			int const magnitude = std::abs(unq);
+			int const max_comp = (1 << (bits_per_comp - 1)) - 1;
+			int comp = std::min((magnitude << (bits_per_comp - 1)) >> 15, max_comp);
+			if ((comp < max_comp) && (std::abs(this->Unquantize(comp + 1, bits_per_comp, true) - magnitude)
+				< std::abs(this->Unquantize(comp, bits_per_comp, true) - magnitude)))
+			{
+				++ comp;
+			}
+			return (unq < 0) ? -comp : comp;
+		}
+		else
+		{
+			unq = std::clamp(unq, 0, 0xFFFF);
+			if (bits_per_comp >= 15)
+			{
+				return std::min(unq, (1 << bits_per_comp) - 1);
+			}
+
+			int const max_comp = (1 << bits_per_comp) - 1;
+			int comp = std::min((unq << bits_per_comp) >> 16, max_comp);
+			if ((comp < max_comp) && (std::abs(this->Unquantize(comp + 1, bits_per_comp, false) - unq)
+				< std::abs(this->Unquantize(comp, bits_per_comp, false) - unq)))
+			{
+				++ comp;
+			}
+			return comp;
+		}
+	}
+
 	int TexCompressionBC6U::Unquantize(int comp, uint8_t bits_per_comp, bool signed_fmt)
 	{
 		int unq = 0;
@@ -2132,6 +2599,303 @@ namespace KlayGE
 		}
 	}
 
+	// Exactly the values DecodeBC6Internal produces from a pair of end points
+	void TexCompressionBC6U::GeneratePalette(std::pair<int3, int3> const & end_pts, ModeInfo const & info, bool signed_fmt,
+		float3* palette)
+	{
+		ARGBColor32 const & prec = info.rgba_prec[0][0];
+		int3 const unq_0(this->Unquantize(end_pts.first.x(), prec.r(), signed_fmt),
+			this->Unquantize(end_pts.first.y(), prec.g(), signed_fmt),
+			this->Unquantize(end_pts.first.z(), prec.b(), signed_fmt));
+		int3 const unq_1(this->Unquantize(end_pts.second.x(), prec.r(), signed_fmt),
+			this->Unquantize(end_pts.second.y(), prec.g(), signed_fmt),
+			this->Unquantize(end_pts.second.z(), prec.b(), signed_fmt));
+
+		int const * weights = BC67_PREC_WEIGHTS[1 + (1 == info.partitions)];
+		uint32_t const num_indices = 1U << info.index_prec;
+		for (uint32_t i = 0; i < num_indices; ++ i)
+		{
+			for (uint32_t c = 0; c < 3; ++ c)
+			{
+				palette[i][c] = Int2F16(this->FinishUnquantize((unq_0[c] * (BC6_WEIGHT_MAX - weights[i])
+					+ unq_1[c] * weights[i] + BC6_WEIGHT_ROUND) >> BC6_WEIGHT_SHIFT, signed_fmt), signed_fmt);
+			}
+		}
+	}
+
+	float TexCompressionBC6U::TryCompress(uint32_t mode_index, uint32_t shape, float3 const * pixels,
+		float3 const * unq_pixels, bool signed_fmt, uint32_t num_refinements, CompressParams& params)
+	{
+		ModeInfo const & info = mode_info_[mode_index];
+		uint32_t const num_regions = info.partitions;
+		uint32_t const num_indices = 1U << info.index_prec;
+		int const * weights = BC67_PREC_WEIGHTS[1 + (1 == num_regions)];
+		int const max_val = (1 << (signed_fmt ? 15 : 16)) - 1;
+		int const min_val = signed_fmt ? -max_val : 0;
+
+		std::array<uint32_t, BC6_MAX_INDICES> regions;
+		std::array<uint32_t, BC6_MAX_REGIONS> anchors = { 0, 0 };
+		for (uint32_t i = 0; i < BC6_MAX_INDICES; ++ i)
+		{
+			regions[i] = GetPartition(num_regions, shape, i);
+			if (IsFixUpOffset(num_regions, shape, i))
+			{
+				anchors[regions[i]] = i;
+			}
+		}
+
+		std::array<std::pair<float3, float3>, BC6_MAX_REGIONS> fit_pts;
+		for (uint32_t r = 0; r < num_regions; ++ r)
+		{
+			std::array<float3, BC6_MAX_INDICES> points;
+			uint32_t num_points = 0;
+			for (uint32_t i = 0; i < BC6_MAX_INDICES; ++ i)
+			{
+				if (regions[i] == r)
+				{
+					points[num_points] = unq_pixels[i];
+					++ num_points;
+				}
+			}
+			FitEndPointsPCA(points.data(), num_points, fit_pts[r].first, fit_pts[r].second);
+		}
+
+		// The error is measured on the decoded values. The integers are logarithmic, and not continuous around 0 for
+		//  signed format.
+		auto pixel_error = [](float3 const & lhs, float3 const & rhs)
+		{
+			return MathLib::length_sq(lhs - rhs);
+		};
+
+		float best_error = std::numeric_limits<float>::max();
+		for (uint32_t iter = 0; iter <= num_refinements; ++ iter)
+		{
+			std::array<std::pair<int3, int3>, BC6_MAX_REGIONS> quant_pts;
+			std::array<std::array<float3, 16>, BC6_MAX_REGIONS> palettes;
+			for (uint32_t r = 0; r < num_regions; ++ r)
+			{
+				for (uint32_t c = 0; c < 3; ++ c)
+				{
+					uint8_t const prec = ChannelPrec(info.rgba_prec[0][0], c);
+					quant_pts[r].first[c] = this->Quantize(std::clamp(static_cast<int>(std::lround(fit_pts[r].first[c])),
+						min_val, max_val), prec, signed_fmt);
+					quant_pts[r].second[c] = this->Quantize(std::clamp(static_cast<int>(std::lround(fit_pts[r].second[c])),
+						min_val, max_val), prec, signed_fmt);
+				}
+
+				// The top bit of the anchor's index is implied 0. Swapping the end points flips all indices of the region.
+				this->GeneratePalette(quant_pts[r], info, signed_fmt, palettes[r].data());
+				uint32_t anchor_index = 0;
+				float anchor_error = std::numeric_limits<float>::max();
+				for (uint32_t j = 0; j < num_indices; ++ j)
+				{
+					float const error = pixel_error(palettes[r][j], pixels[anchors[r]]);
+					if (error < anchor_error)
+					{
+						anchor_error = error;
+						anchor_index = j;
+					}
+				}
+				if (anchor_index >= num_indices / 2)
+				{
+					std::swap(quant_pts[r].first, quant_pts[r].second);
+				}
+			}
+
+			CompressParams trial;
+			trial.mode_index = mode_index;
+			trial.shape = shape;
+			if (info.transformed)
+			{
+				// Others are stored as deltas from the first end point. The ones don't fit are clamped, so the
+				//  palettes below are the ones the decoder will see.
+				int3 const & base = quant_pts[0].first;
+				std::pair<int3, int3>* end_pts = trial.end_pts.data();
+				for (uint32_t r = 0; r < num_regions; ++ r)
+				{
+					for (uint32_t e = 0; e < 2; ++ e)
+					{
+						int3& quant_pt = (0 == e) ? quant_pts[r].first : quant_pts[r].second;
+						int3& stored_pt = (0 == e) ? end_pts[r].first : end_pts[r].second;
+						ARGBColor32 const & prec = info.rgba_prec[r][e];
+						for (uint32_t c = 0; c < 3; ++ c)
+						{
+							uint8_t const bits = ChannelPrec(prec, c);
+							if ((0 == r) && (0 == e))
+							{
+								stored_pt[c] = quant_pt[c] & ((1 << bits) - 1);
+							}
+							else
+							{
+								int const delta = std::clamp(quant_pt[c] - base[c], -(1 << (bits - 1)), (1 << (bits - 1)) - 1);
+								stored_pt[c] = delta & ((1 << bits) - 1);
+								quant_pt[c] = base[c] + delta;
+							}
+						}
+					}
+				}
+			}
+			else
+			{
+				for (uint32_t r = 0; r < num_regions; ++ r)
+				{
+					for (uint32_t c = 0; c < 3; ++ c)
+					{
+						int const mask = (1 << ChannelPrec(info.rgba_prec[0][0], c)) - 1;
+						trial.end_pts[r].first[c] = quant_pts[r].first[c] & mask;
+						trial.end_pts[r].second[c] = quant_pts[r].second[c] & mask;
+					}
+				}
+			}
+			for (uint32_t r = num_regions; r < BC6_MAX_REGIONS; ++ r)
+			{
+				trial.end_pts[r].first = trial.end_pts[r].second = int3(0, 0, 0);
+			}
+
+			for (uint32_t r = 0; r < num_regions; ++ r)
+			{
+				this->GeneratePalette(quant_pts[r], info, signed_fmt, palettes[r].data());
+			}
+
+			float total_error = 0;
+			for (uint32_t i = 0; i < BC6_MAX_INDICES; ++ i)
+			{
+				uint32_t const r = regions[i];
+				uint32_t const limit = (anchors[r] == i) ? num_indices / 2 : num_indices;
+				uint8_t best_index = 0;
+				float best_pixel_error = std::numeric_limits<float>::max();
+				for (uint32_t j = 0; j < limit; ++ j)
+				{
+					float const error = pixel_error(palettes[r][j], pixels[i]);
+					if (error < best_pixel_error)
+					{
+						best_pixel_error = error;
+						best_index = static_cast<uint8_t>(j);
+					}
+				}
+				trial.indices[i] = best_index;
+				total_error += best_pixel_error;
+			}
+
+			if (total_error < best_error)
+			{
+				best_error = total_error;
+				params = trial;
+			}
+			if ((0 == best_error) || (iter == num_refinements))
+			{
+				break;
+			}
+
+			// Least squares fit of the end points to the chosen indices, for the next iteration
+			for (uint32_t r = 0; r < num_regions; ++ r)
+			{
+				float aa = 0;
+				float ab = 0;
+				float bb = 0;
+				float3 ax(0, 0, 0);
+				float3 bx(0, 0, 0);
+				for (uint32_t i = 0; i < BC6_MAX_INDICES; ++ i)
+				{
+					if (regions[i] == r)
+					{
+						float const w = static_cast<float>(weights[trial.indices[i]]) / BC6_WEIGHT_MAX;
+						float const iw = 1 - w;
+						aa += iw * iw;
+						ab += iw * w;
+						bb += w * w;
+						ax += unq_pixels[i] * iw;
+						bx += unq_pixels[i] * w;
+					}
+				}
+
+				float const det = aa * bb - ab * ab;
+				if (std::abs(det) > 1e-6f)
+				{
+					float const inv_det = 1 / det;
+					fit_pts[r].first = (ax * bb - bx * ab) * inv_det;
+					fit_pts[r].second = (bx * aa - ax * ab) * inv_det;
+				}
+			}
+		}
+
+		return best_error;
+	}
+
+	void TexCompressionBC6U::PackBC6Block(void* output, CompressParams const & params) const
+	{
+		ModeInfo const & info = mode_info_[params.mode_index];
+		ModeDescriptor const * desc = mode_desc_[params.mode_index];
+		auto const & end_pts = params.end_pts;
+
+		memset(output, 0, 16);
+
+		size_t start_bit = 0;
+		size_t const header_bits = info.partitions > 1 ? 82 : 65;
+		while (start_bit < header_bits)
+		{
+			ModeDescriptor const & field = desc[start_bit];
+			uint32_t val;
+			switch (field.field)
+			{
+			case M:
+				val = info.mode;
+				break;
+			case D:
+				val = params.shape;
+				break;
+			case RW:
+				val = end_pts[0].first.x();
+				break;
+			case RX:
+				val = end_pts[0].second.x();
+				break;
+			case RY:
+				val = end_pts[1].first.x();
+				break;
+			case RZ:
+				val = end_pts[1].second.x();
+				break;
+			case GW:
+				val = end_pts[0].first.y();
+				break;
+			case GX:
+				val = end_pts[0].second.y();
+				break;
+			case GY:
+				val = end_pts[1].first.y();
+				break;
+			case GZ:
+				val = end_pts[1].second.y();
+				break;
+			case BW:
+				val = end_pts[0].first.z();
+				break;
+			case BX:
+				val = end_pts[0].second.z();
+				break;
+			case BY:
+				val = end_pts[1].first.z();
+				break;
+			case BZ:
+				val = end_pts[1].second.z();
+				break;
+
+			default:
+				val = 0;
+				break;
+			}
+			WriteBit(output, start_bit, static_cast<uint8_t>((val >> field.bit) & 1));
+		}
+
+		for (uint32_t i = 0; i < BC6_MAX_INDICES; ++ i)
+		{
+			size_t const num_bits = IsFixUpOffset(info.partitions, params.shape, i) ? info.index_prec - 1 : info.index_prec;
+			WriteBits(output, start_bit, num_bits, params.indices[i]);
+		}
+		BOOST_ASSERT(128 == start_bit);
+	}
+
 
 	TexCompressionBC6S::TexCompressionBC6S()
 	{
@@ -2140,11 +2904,7 @@ namespace KlayGE
 
 	void TexCompressionBC6S::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
-		KFL_UNUSED(output);
-		KFL_UNUSED(input);
-		KFL_UNUSED(method);
-
-		// TODO
+		bc6u_codec_.EncodeBC6Internal(output, input, method, true);
 	}
 
 	void TexCompressionBC6S::DecodeBlock(void* output, void const * input)
@@ -2152,6 +2912,16 @@ namespace KlayGE
 		bc6u_codec_.DecodeBC6Internal(output, input, true);
 	}
 
+	void TexCompressionBC6S::EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method)
+	{
+		EncodeBlocksImpl(*this, compression_format_, output, input, num_blocks, method);
+	}
+
+	void TexCompressionBC6S::DecodeBlocks(void* output, void const * input, uint32_t num_blocks)
+	{
+		DecodeBlocksImpl(*this, compression_format_, output, input, num_blocks);
+	}
+
 
 	// BC7 compression: mode partitions, partition_bits, p_bits, rotation_bits, index_mode_bits, index_prec, index_prec_2, rgba_prec, rgba_prec_with_p, p_bit_type
 	TexCompressionBC7::ModeInfo const TexCompressionBC7::mode_info_[] =
@@ -2187,6 +2957,9 @@ namespace KlayGE
 		
 		// Based on FasTC: Accelerated Texture Encoding (http://gamma.cs.unc.edu/FasTC/)
 
+		// Reseeded per block, so the output doesn't depend on thread scheduling
+		IntRandGenerator().seed();
+
 		ARGBColor32 const * argb = static_cast<ARGBColor32 const *>(input);
 
 		bool uniform_block = true;
@@ -2435,6 +3208,11 @@ namespace KlayGE
 		}
 	}
 
+	std::unique_ptr<TexCompression> TexCompressionBC7::CreateWorkerCodec() const
+	{
+		return MakeUniquePtr<TexCompressionBC7>();
+	}
+
 	void TexCompressionBC7::PackBC7UniformBlock(void* output, ARGBColor32 const & pixel)
 	{
 		size_t start_bit = 0;
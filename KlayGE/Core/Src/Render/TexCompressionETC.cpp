@@ -956,6 +956,11 @@ namespace KlayGE
 		}
 	}
 
+	std::unique_ptr<TexCompression> TexCompressionETC1::CreateWorkerCodec() const
+	{
+		return MakeUniquePtr<TexCompressionETC1>();
+	}
+
 	void TexCompressionETC1::DecodeETCIndividualModeInternal(ARGBColor32* argb, ETC1Block const & etc1) const
 	{
 		BOOST_ASSERT(argb);
@@ -1871,6 +1876,11 @@ namespace KlayGE
 		}
 	}
 
+	std::unique_ptr<TexCompression> TexCompressionETC2RGB8::CreateWorkerCodec() const
+	{
+		return MakeUniquePtr<TexCompressionETC2RGB8>();
+	}
+
 	void TexCompressionETC2RGB8::DecodeETCTModeInternal(ARGBColor32* argb, ETC2TModeBlock const & etc2, bool alpha)
 	{
 		BOOST_ASSERT(argb);
@@ -2085,4 +2095,9 @@ namespace KlayGE
 			etc1_codec_->DecodeETCDifferentialModeInternal(argb, etc2.etc1, !op);
 		}
 	}
+
+	std::unique_ptr<TexCompression> TexCompressionETC2RGB8A1::CreateWorkerCodec() const
+	{
+		return MakeUniquePtr<TexCompressionETC2RGB8A1>();
+	}
 }
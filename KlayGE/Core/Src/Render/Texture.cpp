@@ -1312,6 +1312,14 @@ namespace
 			return true;
 		}
 
+		uint64_t Key() const override
+		{
+			size_t seed = static_cast<size_t>(this->Type());
+			HashRange(seed, tex_desc_.res_name.begin(), tex_desc_.res_name.end());
+			HashCombine(seed, tex_desc_.access_hint);
+			return seed;
+		}
+
 		bool Match(ResLoadingDesc const & rhs) const override
 		{
 			if (this->Type() == rhs.Type())
@@ -2154,12 +2162,22 @@ namespace KlayGE
 		uint32_t array_size;
 		ElementFormat format;
 		std::vector<ElementInitData> init_data;
-		std::vector<uint8_t> data_block;
 
 		uint32_t row_pitch, slice_pitch;
 		ReadDdsFileHeader(tex_res, type, width, height, depth, num_mipmaps, array_size, format,
 			row_pitch, slice_pitch);
 
+		// Sub resources point straight into the resource, CreateHWResource takes its own copy
+		auto const data = tex_res->Data();
+		size_t offset = static_cast<size_t>(tex_res->tellg());
+		auto const sub_resource = [&data, &offset](uint64_t size)
+		{
+			Verify((offset <= data.size()) && (size <= data.size() - offset));
+			uint8_t const * ret = data.data() + offset;
+			offset += static_cast<size_t>(size);
+			return ret;
+		};
+
 		uint32_t const fmt_size = NumFormatBytes(format);
 		bool padding = false;
 		if (!IsCompressedFormat(format))
@@ -2171,13 +2189,11 @@ namespace KlayGE
 			}
 		}
 
-		std::vector<size_t> base;
 		switch (type)
 		{
 		case Texture::TT_1D:
 			{
 				init_data.resize(array_size * num_mipmaps);
-				base.resize(array_size * num_mipmaps);
 				for (uint32_t array_index = 0; array_index < array_size; ++ array_index)
 				{
 					uint32_t the_width = width;
@@ -2195,13 +2211,10 @@ namespace KlayGE
 							image_size = (padding ? ((the_width + 3) & ~3) : the_width) * fmt_size;
 						}
 
-						base[index] = data_block.size();
-						data_block.resize(base[index] + image_size);
 						init_data[index].row_pitch = image_size;
 						init_data[index].slice_pitch = image_size;
 
-						tex_res->read(&data_block[base[index]], static_cast<std::streamsize>(image_size));
-						BOOST_ASSERT(tex_res->gcount() == static_cast<int>(image_size));
+						init_data[index].data = sub_resource(image_size);
 
 						the_width = std::max<uint32_t>(the_width / 2, 1);
 					}
@@ -2212,7 +2225,6 @@ namespace KlayGE
 		case Texture::TT_2D:
 			{
 				init_data.resize(array_size * num_mipmaps);
-				base.resize(array_size * num_mipmaps);
 				for (uint32_t array_index = 0; array_index < array_size; ++ array_index)
 				{
 					uint32_t the_width = width;
@@ -2225,23 +2237,17 @@ namespace KlayGE
 							uint32_t const block_size = NumFormatBytes(format) * 4;
 							uint32_t image_size = ((the_width + 3) / 4) * ((the_height + 3) / 4) * block_size;
 
-							base[index] = data_block.size();
-							data_block.resize(base[index] + image_size);
 							init_data[index].row_pitch = (the_width + 3) / 4 * block_size;
 							init_data[index].slice_pitch = image_size;
 
-							tex_res->read(&data_block[base[index]], static_cast<std::streamsize>(image_size));
-							BOOST_ASSERT(tex_res->gcount() == static_cast<int>(image_size));
+							init_data[index].data = sub_resource(image_size);
 						}
 						else
 						{
 							init_data[index].row_pitch = (padding ? ((the_width + 3) & ~3) : the_width) * fmt_size;
 							init_data[index].slice_pitch = init_data[index].row_pitch * the_height;
-							base[index] = data_block.size();
-							data_block.resize(base[index] + init_data[index].slice_pitch);
 
-							tex_res->read(&data_block[base[index]], static_cast<std::streamsize>(init_data[index].slice_pitch));
-							BOOST_ASSERT(tex_res->gcount() == static_cast<int>(init_data[index].slice_pitch));
+							init_data[index].data = sub_resource(init_data[index].slice_pitch);
 						}
 
 						the_width = std::max<uint32_t>(the_width / 2, 1);
@@ -2254,7 +2260,6 @@ namespace KlayGE
 		case Texture::TT_3D:
 			{
 				init_data.resize(array_size * num_mipmaps);
-				base.resize(array_size * num_mipmaps);
 				for (uint32_t array_index = 0; array_index < array_size; ++ array_index)
 				{
 					uint32_t the_width = width;
@@ -2268,23 +2273,17 @@ namespace KlayGE
 							uint32_t const block_size = NumFormatBytes(format) * 4;
 							uint32_t image_size = ((the_width + 3) / 4) * ((the_height + 3) / 4) * the_depth * block_size;
 
-							base[index] = data_block.size();
-							data_block.resize(base[index] + image_size);
 							init_data[index].row_pitch = (the_width + 3) / 4 * block_size;
 							init_data[index].slice_pitch = ((the_width + 3) / 4) * ((the_height + 3) / 4) * block_size;
 
-							tex_res->read(&data_block[base[index]], static_cast<std::streamsize>(image_size));
-							BOOST_ASSERT(tex_res->gcount() == static_cast<int>(image_size));
+							init_data[index].data = sub_resource(image_size);
 						}
 						else
 						{
 							init_data[index].row_pitch = (padding ? ((the_width + 3) & ~3) : the_width) * fmt_size;
 							init_data[index].slice_pitch = init_data[index].row_pitch * the_height;
-							base[index] = data_block.size();
-							data_block.resize(base[index] + init_data[index].slice_pitch * the_depth);
 
-							tex_res->read(&data_block[base[index]], static_cast<std::streamsize>(init_data[index].slice_pitch * the_depth));
-							BOOST_ASSERT(tex_res->gcount() == static_cast<int>(init_data[index].slice_pitch * the_depth));
+							init_data[index].data = sub_resource(static_cast<uint64_t>(init_data[index].slice_pitch) * the_depth);
 						}
 
 						the_width = std::max<uint32_t>(the_width / 2, 1);
@@ -2298,7 +2297,6 @@ namespace KlayGE
 		case Texture::TT_Cube:
 			{
 				init_data.resize(array_size * 6 * num_mipmaps);
-				base.resize(array_size * 6 * num_mipmaps);
 				for (uint32_t array_index = 0; array_index < array_size; ++ array_index)
 				{
 					for (uint32_t face = Texture::CF_Positive_X; face <= Texture::CF_Negative_Z; ++ face)
@@ -2313,23 +2311,17 @@ namespace KlayGE
 								uint32_t const block_size = NumFormatBytes(format) * 4;
 								uint32_t image_size = ((the_width + 3) / 4) * ((the_height + 3) / 4) * block_size;
 
-								base[index] = data_block.size();
-								data_block.resize(base[index] + image_size);
 								init_data[index].row_pitch = (the_width + 3) / 4 * block_size;
 								init_data[index].slice_pitch = image_size;
 
-								tex_res->read(&data_block[base[index]], static_cast<std::streamsize>(image_size));
-								BOOST_ASSERT(tex_res->gcount() == static_cast<int>(image_size));
+								init_data[index].data = sub_resource(image_size);
 							}
 							else
 							{
 								init_data[index].row_pitch = (padding ? ((the_width + 3) & ~3) : the_width) * fmt_size;
 								init_data[index].slice_pitch = init_data[index].row_pitch * the_width;
-								base[index] = data_block.size();
-								data_block.resize(base[index] + init_data[index].slice_pitch);
 
-								tex_res->read(&data_block[base[index]], static_cast<std::streamsize>(init_data[index].slice_pitch));
-								BOOST_ASSERT(tex_res->gcount() == static_cast<int>(init_data[index].slice_pitch));
+								init_data[index].data = sub_resource(init_data[index].slice_pitch);
 							}
 
 							the_width = std::max<uint32_t>(the_width / 2, 1);
@@ -2341,11 +2333,6 @@ namespace KlayGE
 			break;
 		}
 
-		for (size_t i = 0; i < base.size(); ++ i)
-		{
-			init_data[i].data = &data_block[base[i]];
-		}
-
 		auto ret = MakeSharedPtr<SoftwareTexture>(type, width, height, depth,
 			num_mipmaps, array_size, format, false);
 		ret->CreateHWResource(init_data, nullptr);
@@ -2359,7 +2346,12 @@ namespace KlayGE
 
 	TexturePtr ASyncLoadTexture(std::string_view tex_name, uint32_t access_hint)
 	{
-		return ResLoader::Instance().ASyncQueryT<Texture>(MakeSharedPtr<TextureLoadingDesc>(tex_name, access_hint));
+		return ASyncLoadTexture(tex_name, access_hint, ResLoadingPriority::Normal);
+	}
+
+	TexturePtr ASyncLoadTexture(std::string_view tex_name, uint32_t access_hint, ResLoadingPriority priority)
+	{
+		return ResLoader::Instance().ASyncQueryT<Texture>(MakeSharedPtr<TextureLoadingDesc>(tex_name, access_hint), priority);
 	}
 
 	void SaveTexture(std::string const & tex_name, Texture::TextureType type,
@@ -56,16 +56,49 @@
 
 #include <map>
 #include <algorithm>
+#include <cstring>
 
 #include <KlayGE/SceneManager.hpp>
 
+namespace
+{
+	using namespace KlayGE;
+
+	uint32_t constexpr NUM_NODES_PER_CULLING_TASK = 1024;
+	size_t constexpr DEFAULT_VISIBLE_MARKS_CACHE_BUDGET = 8 * 1024 * 1024;
+	// Beyond this many frustum tests, dropping all entries is cheaper than finding the stale ones
+	size_t constexpr MAX_VISIBLE_MARKS_INVALIDATION_TESTS = 16 * 1024;
+	size_t constexpr NUM_VISIBLE_MARKS_CANDIDATES = 64;
+
+	// HashValue converts floats to integers, which loses the fraction
+	void HashFloats(size_t& seed, float const * values, size_t count)
+	{
+		for (size_t i = 0; i < count; ++ i)
+		{
+			uint32_t bits;
+			std::memcpy(&bits, &values[i], sizeof(bits));
+			HashCombine(seed, bits);
+		}
+	}
+
+	static_assert(RenderEngine::PredefinedCameraCBuffer::max_num_cameras <= 8, "Large enough marks are stored in 8 bits.");
+}
+
 namespace KlayGE
 {
+	size_t SceneManager::VisibleMarksEntry::NumBytes() const
+	{
+		return sizeof(*this) + frustums.size() * sizeof(frustums[0]) + marks.size() * sizeof(marks[0]);
+	}
+
 	// 캯
 	/////////////////////////////////////////////////////////////////////////////////
 	SceneManager::SceneManager()
 		: scene_root_(L"SceenRoot", SceneNode::SOA_Cullable),
 			overlay_root_(L"OverlayRoot", SceneNode::SOA_Cullable | SceneNode::SOA_Overlay),
+			visible_marks_cache_budget_(DEFAULT_VISIBLE_MARKS_CACHE_BUDGET), visible_marks_cache_size_(0),
+			num_visible_marks_cache_hits_(0), num_visible_marks_cache_misses_(0), num_visible_marks_cache_invalidations_(0),
+			scene_structure_changed_(true), next_visible_marks_candidate_(0),
 			small_obj_threshold_(0),
 			update_elapse_(1.0f / 60),
 			num_objects_rendered_(0), num_renderables_rendered_(0),
@@ -102,7 +135,11 @@ namespace KlayGE
 
 	void SceneManager::SmallObjectThreshold(float area)
 	{
-		small_obj_threshold_ = area;
+		if (small_obj_threshold_ != area)
+		{
+			small_obj_threshold_ = area;
+			this->ClearVisibleMarksCache();
+		}
 	}
 
 	void SceneManager::SceneUpdateElapse(float elapse)
@@ -110,6 +147,112 @@ namespace KlayGE
 		update_elapse_ = elapse;
 	}
 
+	void SceneManager::VisibleMarksCacheBudget(size_t bytes)
+	{
+		visible_marks_cache_budget_ = bytes;
+		while (visible_marks_cache_size_ > visible_marks_cache_budget_)
+		{
+			auto const & entry = visible_marks_lru_.back();
+			visible_marks_cache_size_ -= entry.NumBytes();
+			visible_marks_map_.erase(entry.key);
+			visible_marks_lru_.pop_back();
+		}
+	}
+
+	size_t SceneManager::VisibleMarksCacheBudget() const
+	{
+		return visible_marks_cache_budget_;
+	}
+
+	size_t SceneManager::VisibleMarksCacheSize() const
+	{
+		return visible_marks_cache_size_;
+	}
+
+	uint64_t SceneManager::NumVisibleMarksCacheHits() const
+	{
+		return num_visible_marks_cache_hits_;
+	}
+
+	uint64_t SceneManager::NumVisibleMarksCacheMisses() const
+	{
+		return num_visible_marks_cache_misses_;
+	}
+
+	uint64_t SceneManager::NumVisibleMarksCacheInvalidations() const
+	{
+		return num_visible_marks_cache_invalidations_;
+	}
+
+	void SceneManager::ResetVisibleMarksCacheStats()
+	{
+		num_visible_marks_cache_hits_ = 0;
+		num_visible_marks_cache_misses_ = 0;
+		num_visible_marks_cache_invalidations_ = 0;
+	}
+
+	void SceneManager::ClearVisibleMarksCache()
+	{
+		if (!visible_marks_lru_.empty())
+		{
+			visible_marks_map_.clear();
+			visible_marks_lru_.clear();
+			visible_marks_cache_size_ = 0;
+			++ num_visible_marks_cache_invalidations_;
+		}
+	}
+
+	void SceneManager::InvalidateVisibleMarksCache()
+	{
+		// Nodes added, removed or updated for the first time change the marks of every entry
+		if (scene_structure_changed_)
+		{
+			scene_structure_changed_ = false;
+			this->ClearVisibleMarksCache();
+		}
+
+		size_t num_frustums = 0;
+		for (auto const & entry : visible_marks_lru_)
+		{
+			num_frustums += entry.frustums.size();
+		}
+		if (changed_bounds_.size() * num_frustums > MAX_VISIBLE_MARKS_INVALIDATION_TESTS)
+		{
+			this->ClearVisibleMarksCache();
+		}
+
+		// A moved node outside all frustums of an entry, both before and after, is culled either way
+		for (auto iter = visible_marks_lru_.begin(); iter != visible_marks_lru_.end();)
+		{
+			bool stale = iter->has_omni_camera && !changed_bounds_.empty();
+			for (size_t i = 0; (i < changed_bounds_.size()) && !stale; ++ i)
+			{
+				for (auto const & frustum : iter->frustums)
+				{
+					if (frustum.Intersect(changed_bounds_[i]) != BoundOverlap::No)
+					{
+						stale = true;
+						break;
+					}
+				}
+			}
+
+			if (stale)
+			{
+				visible_marks_cache_size_ -= iter->NumBytes();
+				visible_marks_map_.erase(iter->key);
+				iter = visible_marks_lru_.erase(iter);
+				++ num_visible_marks_cache_invalidations_;
+			}
+			else
+			{
+				++ iter;
+			}
+		}
+
+		changed_bounds_.clear();
+	}
+
 	// ü
 	/////////////////////////////////////////////////////////////////////////////////
 	void SceneManager::ClipScene()
@@ -118,42 +261,44 @@ namespace KlayGE
 		auto const& viewport = *re.CurFrameBuffer()->Viewport();
 		uint32_t const num_cameras = viewport.NumCameras();
 
-		for (auto* sn : all_scene_nodes_)
+		this->CullSceneNodes(num_cameras);
+
+		for (size_t n = 0; n < all_scene_nodes_.size(); ++ n)
 		{
-			auto& node = *sn;
+			auto& node = *all_scene_nodes_[n];
 			node.FillVisibleMark(BoundOverlap::No);
 			if (node.Visible())
 			{
 				if (node.Updated())
 				{
 					uint32_t const attr = node.Attrib();
+					bool const cullable = (attr & SceneNode::SOA_Cullable) != 0;
 
 					for (uint32_t i = 0; i < num_cameras; ++i)
 					{
-						auto const& camera = *viewport.Camera(i);
-						float4x4 const& view_proj = camera_view_projs_[i];
+						bool const large_enough = (node_large_enough_marks_[n] & (1U << i)) != 0;
+
+						BoundOverlap visible;
+						if (node.Parent())
+						{
+							BoundOverlap const parent_bo = node.Parent()->VisibleMark(i);
+							visible = ((BoundOverlap::No == parent_bo) || (cullable && !large_enough)) ? BoundOverlap::No : parent_bo;
+						}
+						else
+						{
+							visible = BoundOverlap::Partial;
+						}
 
-						auto visible = this->VisibleTestFromParent(node, i);
 						if (BoundOverlap::Partial == visible)
 						{
-							if (attr & SceneNode::SOA_Cullable)
+							if (cullable)
 							{
-								visible = (small_obj_threshold_ <= 0) ||
-												  ((MathLib::ortho_area(camera.ForwardVec(), node.PosBoundWS()) > small_obj_threshold_) &&
-													  (MathLib::perspective_area(camera.EyePos(), view_proj, node.PosBoundWS()) >
-														  small_obj_threshold_))
-											  ? BoundOverlap::Yes
-											  : BoundOverlap::No;
+								visible = large_enough ? node_frustum_marks_[n][i] : BoundOverlap::No;
 							}
 							else
 							{
 								visible = BoundOverlap::Yes;
 							}
-
-							if (!camera.OmniDirectionalMode() && (attr & SceneNode::SOA_Cullable) && (BoundOverlap::Yes == visible))
-							{
-								visible = camera_frustums_[i]->Intersect(node.PosBoundWS());
-							}
 						}
 
 						node.VisibleMark(i, visible);
@@ -170,6 +315,71 @@ namespace KlayGE
 		}
 	}
 
+	void SceneManager::CullSceneNodes(uint32_t num_cameras)
+	{
+		auto& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+		auto const& viewport = *re.CurFrameBuffer()->Viewport();
+
+		uint32_t const num_nodes = static_cast<uint32_t>(all_scene_nodes_.size());
+		node_bounds_ws_.resize(num_nodes);
+		node_frustum_marks_.resize(num_nodes);
+		node_large_enough_marks_.resize(num_nodes);
+
+		Context::Instance().TaskSchedulerInstance().ParallelFor(0, num_nodes, NUM_NODES_PER_CULLING_TASK,
+			[this, num_cameras, &viewport](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t n = begin; n < end; ++ n)
+				{
+					node_bounds_ws_.Set(n, all_scene_nodes_[n]->PosBoundWS());
+				}
+
+				for (uint32_t i = 0; i < num_cameras; ++ i)
+				{
+					auto const & camera = *viewport.Camera(i);
+					if (camera.OmniDirectionalMode())
+					{
+						for (uint32_t n = begin; n < end; ++ n)
+						{
+							node_frustum_marks_[n][i] = BoundOverlap::Yes;
+						}
+					}
+					else
+					{
+						std::array<BoundOverlap, NUM_NODES_PER_CULLING_TASK> overlaps;
+						MathLib::intersect_aabbs_frustum(MakeSpan(overlaps.data(), end - begin), node_bounds_ws_,
+							*camera_frustums_[i], begin);
+						for (uint32_t n = begin; n < end; ++ n)
+						{
+							node_frustum_marks_[n][i] = overlaps[n - begin];
+						}
+					}
+				}
+
+				if (small_obj_threshold_ > 0)
+				{
+					for (uint32_t n = begin; n < end; ++ n)
+					{
+						AABBox const & aabb = all_scene_nodes_[n]->PosBoundWS();
+						uint8_t mark = 0;
+						for (uint32_t i = 0; i < num_cameras; ++ i)
+						{
+							auto const & camera = *viewport.Camera(i);
+							if ((MathLib::ortho_area(camera.ForwardVec(), aabb) > small_obj_threshold_)
+								&& (MathLib::perspective_area(camera.EyePos(), camera_view_projs_[i], aabb) > small_obj_threshold_))
+							{
+								mark |= 1U << i;
+							}
+						}
+						node_large_enough_marks_[n] = mark;
+					}
+				}
+				else
+				{
+					std::fill(node_large_enough_marks_.begin() + begin, node_large_enough_marks_.begin() + end, static_cast<uint8_t>(0xFF));
+				}
+			});
+	}
+
 	uint32_t SceneManager::NumFrameCameras() const
 	{
 		return static_cast<uint32_t>(frame_cameras_.size());
@@ -367,6 +577,11 @@ namespace KlayGE
 		overlay_root_.ClearChildren();
 	}
 
+	void SceneManager::OnSceneChanged()
+	{
+		scene_structure_changed_ = true;
+	}
+
 	// ³
 	/////////////////////////////////////////////////////////////////////////////////
 	void SceneManager::Update()
@@ -406,7 +621,8 @@ namespace KlayGE
 
 				return true;
 			});
-			scene_root_.UpdatePosBoundSubtree();
+			scene_root_.UpdatePosBoundSubtree(&changed_bounds_);
+			this->InvalidateVisibleMarksCache();
 
 			overlay_root_.ClearChildren();
 		}
@@ -493,6 +709,25 @@ namespace KlayGE
 				camera_frustums_[i] = &viewport.Camera(i)->ViewFrustum();
 			}
 
+			camera_view_projs_.resize(viewport.NumCameras());
+			for (uint32_t i = 0; i < viewport.NumCameras(); ++i)
+			{
+				camera_view_projs_[i] = viewport.Camera(i)->ViewProjMatrix();
+			}
+			auto drl = Context::Instance().DeferredRenderingLayerInstance();
+			if (drl)
+			{
+				int32_t cas_index = drl->CurrCascadeIndex();
+				if (cas_index >= 0)
+				{
+					float4x4 const& ccm = drl->GetCascadedShadowLayer().CascadeCropMatrix(cas_index);
+					for (uint32_t i = 0; i < viewport.NumCameras(); ++i)
+					{
+						camera_view_projs_[i] *= ccm;
+					}
+				}
+			}
+
 			std::vector<uint32_t> visible_list((scene_nodes.size() + 31) / 32, 0);
 			for (size_t i = 0; i < scene_nodes.size(); ++ i)
 			{
@@ -503,56 +738,102 @@ namespace KlayGE
 			}
 			size_t seed = 0;
 			HashRange(seed, visible_list.begin(), visible_list.end());
+			HashCombine(seed, scene_nodes.size());
 			for (uint32_t i = 0; i < viewport.NumCameras(); ++i)
 			{
 				auto const& camera = *viewport.Camera(i);
 				HashCombine(seed, camera.OmniDirectionalMode());
 				HashCombine(seed, &camera);
+				HashFloats(seed, camera_view_projs_[i].data(), camera_view_projs_[i].size());
 			}
 
+			uint32_t const num_nodes = static_cast<uint32_t>(scene_nodes.size());
 			auto vmiter = visible_marks_map_.find(seed);
+			if ((vmiter != visible_marks_map_.end())
+				&& ((vmiter->second->num_nodes != num_nodes) || (vmiter->second->num_cameras != num_cameras)))
+			{
+				// Hash collision
+				visible_marks_cache_size_ -= vmiter->second->NumBytes();
+				visible_marks_lru_.erase(vmiter->second);
+				visible_marks_map_.erase(vmiter);
+				vmiter = visible_marks_map_.end();
+			}
+
 			if (vmiter == visible_marks_map_.end())
 			{
-				camera_view_projs_.resize(viewport.NumCameras());
-				for (uint32_t i = 0; i < viewport.NumCameras(); ++i)
+				++ num_visible_marks_cache_misses_;
+
+				this->ClipScene();
+
+				VisibleMarksEntry entry;
+				entry.key = seed;
+				entry.num_nodes = num_nodes;
+				entry.num_cameras = num_cameras;
+				entry.has_omni_camera = false;
+				for (uint32_t i = 0; i < num_cameras; ++i)
 				{
-					camera_view_projs_[i] = viewport.Camera(i)->ViewProjMatrix();
+					if (viewport.Camera(i)->OmniDirectionalMode())
+					{
+						entry.has_omni_camera = true;
+					}
+					else
+					{
+						entry.frustums.push_back(*camera_frustums_[i]);
+					}
 				}
-				auto drl = Context::Instance().DeferredRenderingLayerInstance();
-				if (drl)
+				entry.marks.resize(num_nodes * num_cameras);
+				for (size_t i = 0; i < scene_nodes.size(); ++ i)
 				{
-					int32_t cas_index = drl->CurrCascadeIndex();
-					if (cas_index >= 0)
+					for (uint32_t j = 0; j < num_cameras; ++j)
 					{
-						float4x4 const& ccm = drl->GetCascadedShadowLayer().CascadeCropMatrix(cas_index);
-						for (uint32_t i = 0; i < viewport.NumCameras(); ++i)
-						{
-							camera_view_projs_[i] *= ccm;
-						}
+						entry.marks[i * num_cameras + j] = scene_nodes[i]->VisibleMark(j);
 					}
 				}
 
-				this->ClipScene();
-
-				auto visible_marks =
-					MakeUniquePtr<std::array<BoundOverlap, RenderEngine::PredefinedCameraCBuffer::max_num_cameras>[]>(scene_nodes.size());
-				for (size_t i = 0; i < scene_nodes.size(); ++ i)
+				// Only keys that missed before are cached, so a moving camera doesn't push out the entries of static ones
+				bool const seen = std::find(visible_marks_candidates_.begin(), visible_marks_candidates_.end(), seed)
+					!= visible_marks_candidates_.end();
+				if (!seen)
 				{
-					for (uint32_t j = 0; j < num_cameras; ++j)
+					if (visible_marks_candidates_.size() < NUM_VISIBLE_MARKS_CANDIDATES)
 					{
-						visible_marks[i][j] = scene_nodes[i]->VisibleMark(j);
+						visible_marks_candidates_.push_back(seed);
+					}
+					else
+					{
+						visible_marks_candidates_[next_visible_marks_candidate_] = seed;
+						next_visible_marks_candidate_ = (next_visible_marks_candidate_ + 1) % NUM_VISIBLE_MARKS_CANDIDATES;
 					}
 				}
 
-				visible_marks_map_.emplace(seed, std::move(visible_marks));
+				size_t const entry_size = entry.NumBytes();
+				if (seen && (entry_size <= visible_marks_cache_budget_))
+				{
+					while (visible_marks_cache_size_ + entry_size > visible_marks_cache_budget_)
+					{
+						auto const & lru_entry = visible_marks_lru_.back();
+						visible_marks_cache_size_ -= lru_entry.NumBytes();
+						visible_marks_map_.erase(lru_entry.key);
+						visible_marks_lru_.pop_back();
+					}
+
+					visible_marks_lru_.push_front(std::move(entry));
+					visible_marks_map_.emplace(seed, visible_marks_lru_.begin());
+					visible_marks_cache_size_ += entry_size;
+				}
 			}
 			else
 			{
+				++ num_visible_marks_cache_hits_;
+
+				visible_marks_lru_.splice(visible_marks_lru_.begin(), visible_marks_lru_, vmiter->second);
+
+				auto const & marks = vmiter->second->marks;
 				for (size_t i = 0; i < scene_nodes.size(); ++ i)
 				{
 					for (uint32_t j = 0; j < num_cameras; ++j)
 					{
-						scene_nodes[i]->VisibleMark(j, vmiter->second[i][j]);
+						scene_nodes[i]->VisibleMark(j, marks[i * num_cameras + j]);
 					}
 				}
 			}
@@ -724,8 +1005,6 @@ namespace KlayGE
 	{
 		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
 
-		visible_marks_map_.clear();
-
 		uint32_t urt;
 		App3DFramework& app = Context::Instance().AppInstance();
 		for (uint32_t pass = 0;; ++ pass)
@@ -762,6 +1041,11 @@ namespace KlayGE
 		num_dispatch_calls_ = re.NumDispatchesJustCalled();
 	}
 
+	void SceneManager::AddSubThreadUpdateTask(TaskPtr const & task)
+	{
+		sub_thread_update_tasks_.push_back(task);
+	}
+
 	void SceneManager::UpdateThreadFunc()
 	{
 		Timer timer;
@@ -785,6 +1069,9 @@ namespace KlayGE
 					};
 					scene_root_.Traverse(updater);
 					overlay_root_.Traverse(updater);
+
+					Context::Instance().TaskSchedulerInstance().Wait(sub_thread_update_tasks_);
+					sub_thread_update_tasks_.clear();
 				}
 
 				if (frame_time < update_elapse_)
@@ -629,11 +629,21 @@ namespace KlayGE
 		}
 	}
 
-	void SceneNode::UpdatePosBoundSubtree()
+	void SceneNode::UpdatePosBoundSubtree(std::vector<AABBox>* changed_bounds)
 	{
+		// Models finished loading or cloned into the scene update their bounds outside of the scene manager
+		if (this->DoUpdatePosBoundSubtree(changed_bounds) && (changed_bounds == nullptr))
+		{
+			this->EmitSceneChanged();
+		}
+	}
+
+	bool SceneNode::DoUpdatePosBoundSubtree(std::vector<AABBox>* changed_bounds)
+	{
+		bool updated = false;
 		for (auto const & child : children_)
 		{
-			child->UpdatePosBoundSubtree();
+			updated |= child->DoUpdatePosBoundSubtree(changed_bounds);
 		}
 
 		if (pos_aabb_dirty_)
@@ -665,11 +675,20 @@ namespace KlayGE
 					}
 				}
 
-				*pos_aabb_ws_ = MathLib::transform_aabb(*pos_aabb_os_, xform_to_world_);
+				AABBox const new_aabb_ws = MathLib::transform_aabb(*pos_aabb_os_, xform_to_world_);
+				if ((changed_bounds != nullptr) && !(new_aabb_ws == *pos_aabb_ws_))
+				{
+					changed_bounds->push_back(*pos_aabb_ws_);
+					changed_bounds->push_back(new_aabb_ws);
+				}
+				*pos_aabb_ws_ = new_aabb_ws;
 			}
 
 			pos_aabb_dirty_ = false;
+			updated = true;
 		}
+
+		return updated;
 	}
 
 	void SceneNode::EmitSceneChanged()
@@ -38,6 +38,7 @@
 #include <KlayGE/Mesh.hpp>
 
 #include <map>
+#include <string>
 #include <vector>
 
 #include <KlayGE/DevHelper/DevHelper.hpp>
@@ -50,9 +51,32 @@ namespace KlayGE
 {
 	class KLAYGE_DEV_HELPER_API MeshConverter final
 	{
+	public:
+		// How the key frames of a joint shrank, and the largest error against the source keys it cost
+		struct KeyFrameReport
+		{
+			std::string joint_name;
+			uint32_t num_source_keys;
+			uint32_t num_keys;
+			size_t source_bytes;
+			size_t compressed_bytes;
+			float max_rotation_error;		// In radians
+			float max_translation_error;
+			float max_scale_error;
+		};
+
 	public:
 		RenderModelPtr Load(std::string_view input_name, MeshMetadata const & metadata);
 		void Save(RenderModel& model, std::string_view output_name);
+
+		// One report per joint of the last loaded model. Empty if it's not skinned or loaded from a .model_bin.
+		std::vector<KeyFrameReport> const & KeyFrameReports() const
+		{
+			return key_frame_reports_;
+		}
+
+	private:
+		std::vector<KeyFrameReport> key_frame_reports_;
 	};
 }
 
@@ -29,12 +29,32 @@
 #include <KlayGE/SceneManager.hpp>
 #include <KFL/AABBox.hpp>
 
+#include <unordered_map>
 #include <vector>
 
 namespace KlayGE
 {
+	// Loose octree. Each object lives in the deepest cell that holds its center and is no smaller than it, so its bounds
+	//  stay inside the cell enlarged 2x. Objects whose bounds change are relocated incrementally instead of rebuilding
+	//  the whole tree, and moveable objects are in the tree as well.
 	class OCTree final : public SceneManager
 	{
+	public:
+		struct TreeStats
+		{
+			uint32_t num_rebuilds = 0;
+			uint32_t num_inserts = 0;
+			uint32_t num_removes = 0;
+			uint32_t num_relocates = 0;
+			uint32_t num_refits = 0;
+
+			// In seconds
+			double last_rebuild_time = 0;
+			double total_rebuild_time = 0;
+			double last_update_time = 0;
+			double total_update_time = 0;
+		};
+
 	public:
 		OCTree();
 
@@ -52,12 +72,23 @@ namespace KlayGE
 
 		void OnSceneChanged() override;
 
+		TreeStats const & Stats() const;
+		void ResetStats();
+
 	private:
 		void DoSuspend() override;
 		void DoResume() override;
 
-		void DivideNode(size_t index, uint32_t curr_depth);
+		void RebuildTree(bool grow);
+		void UpdateTree();
+		void RefitTree();
+		bool InsertObj(SceneNode* node, AABBox const & aabb);
+		void RemoveObj(SceneNode* node, int octree_node_index);
+		int FindOCTreeNode(AABBox const & aabb);
+		void CreateChildren(size_t index);
+		BoundOverlap CellVisible(AABBox const & aabb) const;
 		void NodeVisible(size_t index);
+		// The frustum tests of the objects in a cell run as one batch, like SceneManager::CullSceneNodes does for all nodes
 		void MarkNodeObjs(size_t index, bool force);
 
 		BoundOverlap BoundVisible(size_t index, AABBox const & aabb) const;
@@ -74,16 +105,40 @@ namespace KlayGE
 		{
 			AABBox bb;
 			int first_child_index;
+			uint32_t depth;
 			BoundOverlap visible;
 
+			// Union of the object bounds in the subtree, refitted when objects move
+			AABBox content_bb;
+			uint32_t num_objs_in_subtree;
+			BoundOverlap objs_visible;
+
 			std::vector<SceneNode*> node_ptrs;
 		};
 
+		struct obj_entry_t
+		{
+			AABBox bb;
+			int octree_node_index;
+			uint32_t update_stamp;
+		};
+
 		std::vector<octree_node_t> octree_;
+		std::unordered_map<SceneNode*, obj_entry_t> obj_entries_;
 
 		uint32_t max_tree_depth_;
 
 		bool rebuild_tree_;
+		bool scene_changed_;
+		bool refit_tree_;
+		uint32_t update_stamp_;
+		uint32_t last_update_frame_;
+
+		TreeStats stats_;
+
+		// Scratch for the batched frustum tests of one cell, camera major
+		AABBoxBatch cell_obj_bounds_;
+		std::vector<BoundOverlap> cell_obj_overlaps_;
 
 #ifdef KLAYGE_DRAW_NODES
 		RenderablePtr node_renderable_;
@@ -175,6 +175,18 @@ namespace
 		return MathLib::scaling(bind_scale, bind_scale, bind_scale) * MathLib::udq_to_matrix(bind_real, bind_dual);
 	}
 
+	// Rotation angle, translation distance, and scale difference between two keys
+	std::tuple<float, float, float> KeyFrameError(Quaternion const& real0, Quaternion const& dual0, float scale0,
+		Quaternion const& real1, Quaternion const& dual1, float scale1)
+	{
+		// asin of the vector part keeps precision on the small angles, where acos of w doesn't
+		Quaternion const diff = MathLib::inverse(real0) * real1;
+		float const sin_half_angle = std::min(MathLib::length(float3(diff.x(), diff.y(), diff.z())), 1.0f);
+		return std::make_tuple(2 * std::asin(sin_half_angle),
+			MathLib::length(MathLib::udq_to_trans(real0, dual0) - MathLib::udq_to_trans(real1, dual1)),
+			MathLib::abs(scale0 - scale1));
+	}
+
 	template <int N>
 	void ExtractFVector(std::string_view value_str, float* v)
 	{
@@ -216,10 +228,16 @@ namespace
 	public:
 		RenderModelPtr Load(std::string_view input_name, MeshMetadata const & metadata);
 
+		std::vector<MeshConverter::KeyFrameReport> const & KeyFrameReports() const
+		{
+			return key_frame_reports_;
+		}
+
 	private:
 		void RemoveUnusedJoints();
 		void RemoveUnusedMaterials();
-		void CompressKeyFrameSet(KeyFrameSet& kf);
+		void CompressKeyFrameSet(uint32_t joint_id, KeyFrameSet& kf);
+		void BuildKeyFrameReports();
 
 		// From assimp
 		void BuildNodeData(uint32_t num_lods, uint32_t lod, int16_t parent_id, aiNode const * node);
@@ -302,6 +320,7 @@ namespace
 		std::vector<Mesh> meshes_;
 		std::vector<NodeTransform> nodes_;
 		std::vector<JointInfo> joints_;
+		std::vector<MeshConverter::KeyFrameReport> key_frame_reports_;
 		bool has_normal_;
 		bool has_tangent_quat_;
 		bool has_texcoord_;
@@ -961,13 +980,17 @@ namespace
 					kf.bind_dual.push_back(frame.second.bind_dual[f]);
 					kf.bind_scale.push_back(frame.second.bind_scale[f]);
 				}
-
-				this->CompressKeyFrameSet(kf);
 			}
 
 			animation_frame_offset += anim.frame_num;
 		}
 
+		// Reduce once all animations are in, so the error is measured against the source keys only
+		for (uint32_t ji = 0; ji < kfs->size(); ++ ji)
+		{
+			this->CompressKeyFrameSet(ji, (*kfs)[ji]);
+		}
+
 		skinned_model.AttachKeyFrameSets(kfs);
 		skinned_model.AttachAnimations(animations);
 
@@ -3120,7 +3143,7 @@ namespace
 				kfs.bind_scale.push_back(bind_scale);
 			}
 
-			this->CompressKeyFrameSet(kfs);
+			this->CompressKeyFrameSet(joint_id, kfs);
 		}
 
 		skinned_model.AttachKeyFrameSets(kfss);
@@ -3417,6 +3440,10 @@ namespace
 				BOOST_ASSERT(joint_mapping[ji] <= ji);
 				joints_[joint_mapping[ji]] = joints_[ji];
 				kfs[joint_mapping[ji]] = kfs[ji];
+				if (ji < key_frame_reports_.size())
+				{
+					key_frame_reports_[joint_mapping[ji]] = key_frame_reports_[ji];
+				}
 			}
 			else
 			{
@@ -3425,6 +3452,7 @@ namespace
 		}
 		joints_.resize(new_joint_id);
 		kfs.resize(joints_.size());
+		key_frame_reports_.resize(std::min(key_frame_reports_.size(), joints_.size()));
 
 		for (auto& mesh : meshes_)
 		{
@@ -3474,55 +3502,176 @@ namespace
 		}
 	}
 
-	void MeshLoader::CompressKeyFrameSet(KeyFrameSet& kf)
+	// Drops the keys that interpolation reproduces within the tolerances, then measures what the runtime, which keeps the
+	//  keys compressed, will actually play. Every dropped key is checked against the keys kept around it, not against the
+	//  ones dropped before, so errors don't build up along a run. Interpolation goes through SampleKeyFrameSets, the same
+	//  blend skinned models play with. The quantization error is taken off the tolerances up front, because the kept keys
+	//  are only quantized afterwards.
+	void MeshLoader::CompressKeyFrameSet(uint32_t joint_id, KeyFrameSet& kf)
 	{
-		float const THRESHOLD = 1e-3f;
+		float const ROTATION_TOLERANCE = 1e-3f;
+		float const TRANSLATION_TOLERANCE = 1e-3f;
+		float const SCALE_TOLERANCE = 1e-3f;
+		uint32_t const MAX_SPAN = 256;
 
 		BOOST_ASSERT((kf.bind_real.size() == kf.bind_dual.size())
 			&& (kf.frame_id.size() == kf.bind_scale.size())
 			&& (kf.frame_id.size() == kf.bind_real.size()));
 
-		int base = 0;
-		while (base < static_cast<int>(kf.frame_id.size() - 2))
+		KeyFrameSet const source = kf;
+		uint32_t const num_source_keys = static_cast<uint32_t>(source.frame_id.size());
+
+		float reduction_rotation_tolerance = ROTATION_TOLERANCE;
+		float reduction_translation_tolerance = TRANSLATION_TOLERANCE;
+		float reduction_scale_tolerance = SCALE_TOLERANCE;
+		if (num_source_keys > 1)
 		{
-			int const frame0 = kf.frame_id[base + 0];
-			int const frame1 = kf.frame_id[base + 1];
-			int const frame2 = kf.frame_id[base + 2];
-			float const factor = static_cast<float>(frame1 - frame0) / (frame2 - frame0);
-			Quaternion interpolate_real;
-			Quaternion interpolate_dual;
-			std::tie(interpolate_real, interpolate_dual) = MathLib::sclerp(kf.bind_real[base + 0], kf.bind_dual[base + 0],
-				kf.bind_real[base + 2], kf.bind_dual[base + 2], factor);
-			float const scale = MathLib::lerp(kf.bind_scale[base + 0], kf.bind_scale[base + 2], factor);
+			float3 trans_min = MathLib::udq_to_trans(source.bind_real[0], source.bind_dual[0]);
+			float3 trans_max = trans_min;
+			float scale_min = source.bind_scale[0];
+			float scale_max = scale_min;
+			for (uint32_t k = 1; k < num_source_keys; ++ k)
+			{
+				float3 const trans = MathLib::udq_to_trans(source.bind_real[k], source.bind_dual[k]);
+				trans_min = MathLib::minimize(trans_min, trans);
+				trans_max = MathLib::maximize(trans_max, trans);
+				scale_min = std::min(scale_min, source.bind_scale[k]);
+				scale_max = std::max(scale_max, source.bind_scale[k]);
+			}
+
+			auto const quantization_error = KeyFrameSet::MaxQuantizationError(trans_max - trans_min, scale_max - scale_min);
+			reduction_rotation_tolerance -= std::get<0>(quantization_error);
+			reduction_translation_tolerance -= std::get<1>(quantization_error);
+			reduction_scale_tolerance -= std::get<2>(quantization_error);
+		}
 
-			if (MathLib::dot(kf.bind_real[base + 1], interpolate_real) < 0)
+		auto sample = [](KeyFrameSet const & kf, float frame, uint32_t& cursor)
 			{
-				interpolate_real = -interpolate_real;
-				interpolate_dual = -interpolate_dual;
+				std::tuple<Quaternion, Quaternion, float> pose;
+				SampleKeyFrameSets(MakeSpan(&kf, 1), frame, MakeSpan(&cursor, 1), MakeSpan(&std::get<0>(pose), 1),
+					MakeSpan(&std::get<1>(pose), 1), MakeSpan(&std::get<2>(pose), 1));
+				return pose;
+			};
+		auto fits = [&source, reduction_rotation_tolerance, reduction_translation_tolerance, reduction_scale_tolerance](
+			uint32_t key, std::tuple<Quaternion, Quaternion, float> const & pose)
+			{
+				auto const error = KeyFrameError(source.bind_real[key], source.bind_dual[key], source.bind_scale[key],
+					std::get<0>(pose), std::get<1>(pose), std::get<2>(pose));
+				return (std::get<0>(error) <= reduction_rotation_tolerance)
+					&& (std::get<1>(error) <= reduction_translation_tolerance) && (std::get<2>(error) <= reduction_scale_tolerance);
+			};
+
+		if (num_source_keys > 1)
+		{
+			std::vector<uint32_t> kept_keys(1, 0);
+
+			bool constant = true;
+			for (uint32_t k = 1; (k < num_source_keys) && constant; ++ k)
+			{
+				constant = fits(k, std::make_tuple(source.bind_real[0], source.bind_dual[0], source.bind_scale[0]));
 			}
 
-			Quaternion diff_real;
-			Quaternion diff_dual;
-			std::tie(diff_real, diff_dual) = MathLib::inverse(kf.bind_real[base + 1], kf.bind_dual[base + 1]);
-			diff_dual = MathLib::mul_dual(diff_real, diff_dual * scale, interpolate_real, interpolate_dual);
-			diff_real = MathLib::mul_real(diff_real, interpolate_real);
-			float diff_scale = scale * kf.bind_scale[base + 1];
+			if (!constant)
+			{
+				KeyFrameSet span;
+				span.frame_id.resize(2);
+				span.bind_real.resize(2);
+				span.bind_dual.resize(2);
+				span.bind_scale.resize(2);
+
+				uint32_t anchor = 0;
+				for (uint32_t end = 2; end < num_source_keys; ++ end)
+				{
+					uint32_t const ends[] = { anchor, end };
+					for (uint32_t i = 0; i < 2; ++ i)
+					{
+						span.frame_id[i] = source.frame_id[ends[i]];
+						span.bind_real[i] = source.bind_real[ends[i]];
+						span.bind_dual[i] = source.bind_dual[ends[i]];
+						span.bind_scale[i] = source.bind_scale[ends[i]];
+					}
+
+					bool span_fits = (end - anchor <= MAX_SPAN);
+					uint32_t cursor = 0;
+					for (uint32_t k = anchor + 1; (k < end) && span_fits; ++ k)
+					{
+						span_fits = fits(k, sample(span, static_cast<float>(source.frame_id[k]), cursor));
+					}
+
+					if (!span_fits)
+					{
+						anchor = end - 1;
+						kept_keys.push_back(anchor);
+					}
+				}
+				kept_keys.push_back(num_source_keys - 1);
+			}
 
-			if ((MathLib::abs(diff_real.x()) < THRESHOLD) && (MathLib::abs(diff_real.y()) < THRESHOLD)
-				&& (MathLib::abs(diff_real.z()) < THRESHOLD) && (MathLib::abs(diff_real.w() - 1) < THRESHOLD)
-				&& (MathLib::abs(diff_dual.x()) < THRESHOLD) && (MathLib::abs(diff_dual.y()) < THRESHOLD)
-				&& (MathLib::abs(diff_dual.z()) < THRESHOLD) && (MathLib::abs(diff_dual.w()) < THRESHOLD)
-				&& (MathLib::abs(diff_scale - 1) < THRESHOLD))
+			kf.frame_id.clear();
+			kf.bind_real.clear();
+			kf.bind_dual.clear();
+			kf.bind_scale.clear();
+			for (auto const k : kept_keys)
 			{
-				kf.frame_id.erase(kf.frame_id.begin() + base + 1);
-				kf.bind_real.erase(kf.bind_real.begin() + base + 1);
-				kf.bind_dual.erase(kf.bind_dual.begin() + base + 1);
-				kf.bind_scale.erase(kf.bind_scale.begin() + base + 1);
+				kf.frame_id.push_back(source.frame_id[k]);
+				kf.bind_real.push_back(source.bind_real[k]);
+				kf.bind_dual.push_back(source.bind_dual[k]);
+				kf.bind_scale.push_back(source.bind_scale[k]);
 			}
-			else
+		}
+
+		if (key_frame_reports_.size() <= joint_id)
+		{
+			key_frame_reports_.resize(joint_id + 1, MeshConverter::KeyFrameReport());
+		}
+		auto& report = key_frame_reports_[joint_id];
+		report.num_source_keys = num_source_keys;
+		report.source_bytes = source.NumBytes();
+		report.max_rotation_error = 0;
+		report.max_translation_error = 0;
+		report.max_scale_error = 0;
+
+		KeyFrameSet compressed = kf;
+		compressed.Compress();
+		uint32_t cursor = 0;
+		for (uint32_t k = 0; k < num_source_keys; ++ k)
+		{
+			auto const pose = sample(compressed, static_cast<float>(source.frame_id[k]), cursor);
+			auto const error = KeyFrameError(source.bind_real[k], source.bind_dual[k], source.bind_scale[k],
+				std::get<0>(pose), std::get<1>(pose), std::get<2>(pose));
+			report.max_rotation_error = std::max(report.max_rotation_error, std::get<0>(error));
+			report.max_translation_error = std::max(report.max_translation_error, std::get<1>(error));
+			report.max_scale_error = std::max(report.max_scale_error, std::get<2>(error));
+		}
+	}
+
+	void MeshLoader::BuildKeyFrameReports()
+	{
+		auto const & kfs = *checked_cast<SkinnedModel&>(*render_model_).GetKeyFrameSets();
+
+		bool const has_reports = !key_frame_reports_.empty();
+		key_frame_reports_.resize(joints_.size(), MeshConverter::KeyFrameReport());
+		for (uint32_t ji = 0; ji < joints_.size(); ++ ji)
+		{
+			auto& report = key_frame_reports_[ji];
+			auto const & kf = kfs[ji];
+
+			// Joints without source keys got their bind pose as the only key
+			if (!has_reports || (report.num_source_keys == 0))
 			{
-				++ base;
+				report.num_source_keys = static_cast<uint32_t>(kf.frame_id.size());
+				report.source_bytes = kf.NumBytes();
+				report.max_rotation_error = 0;
+				report.max_translation_error = 0;
+				report.max_scale_error = 0;
 			}
+
+			KeyFrameSet compressed = kf;
+			compressed.Compress();
+
+			report.joint_name = joints_[ji].name;
+			report.num_keys = static_cast<uint32_t>(kf.frame_id.size());
+			report.compressed_bytes = compressed.NumBytes();
 		}
 	}
 
@@ -3548,6 +3697,7 @@ namespace
 		meshes_.clear();
 		nodes_.clear();
 		joints_.clear();
+		key_frame_reports_.clear();
 		has_normal_ = false;
 		has_tangent_quat_ = false;
 		has_texcoord_ = false;
@@ -3972,6 +4122,11 @@ namespace
 		nodes_[0].node->UpdatePosBoundSubtree();
 		nodes_[0].node->TransformToParent(nodes_[0].node->TransformToParent() * global_transform);
 
+		if (skinned)
+		{
+			this->BuildKeyFrameReports();
+		}
+
 		if (!in_path)
 		{
 			ResLoader::Instance().DelPath(in_folder);
@@ -3990,7 +4145,9 @@ namespace KlayGE
 	RenderModelPtr MeshConverter::Load(std::string_view input_name, MeshMetadata const & metadata)
 	{
 		MeshLoader ml;
-		return ml.Load(input_name, metadata);
+		auto model = ml.Load(input_name, metadata);
+		key_frame_reports_ = ml.KeyFrameReports();
+		return model;
 	}
 
 	void MeshConverter::Save(RenderModel& model, std::string_view output_name)
@@ -575,6 +575,7 @@ namespace KlayGE
 					{
 						is_validate_ = false;
 
+						std::lock_guard<std::mutex> lock(CompileLogMutex());
 						LogError() << "Error(s) in conversion: " << tech.Name() << "/" << pass.Name() << "/" << sd.func_name << std::endl;
 						LogError() << ex.what() << std::endl;
 						LogError() << "Please send this information and your shader to webmaster at klayge.org. We'll fix this ASAP."
@@ -36,6 +36,7 @@
 #include <KlayGE/RenderEngine.hpp>
 #include <KlayGE/FrameBuffer.hpp>
 #include <KlayGE/DeferredRenderingLayer.hpp>
+#include <KFL/Timer.hpp>
 
 #include <algorithm>
 #include <boost/assert.hpp>
@@ -99,13 +100,19 @@ namespace
 namespace KlayGE
 {
 	OCTree::OCTree()
-		: max_tree_depth_(4), rebuild_tree_(false)
+		: max_tree_depth_(4), rebuild_tree_(true), scene_changed_(false), refit_tree_(false),
+			update_stamp_(0), last_update_frame_(0)
 	{
 	}
 
 	void OCTree::MaxTreeDepth(uint32_t max_tree_depth)
 	{
-		max_tree_depth_ = std::min<uint32_t>(max_tree_depth, 16UL);
+		max_tree_depth = std::min<uint32_t>(max_tree_depth, 16UL);
+		if (max_tree_depth_ != max_tree_depth)
+		{
+			max_tree_depth_ = max_tree_depth;
+			rebuild_tree_ = true;
+		}
 	}
 
 	uint32_t OCTree::MaxTreeDepth() const
@@ -113,34 +120,28 @@ namespace KlayGE
 		return max_tree_depth_;
 	}
 
+	OCTree::TreeStats const & OCTree::Stats() const
+	{
+		return stats_;
+	}
+
+	void OCTree::ResetStats()
+	{
+		stats_ = TreeStats();
+	}
+
 	void OCTree::ClipScene()
 	{
+		uint32_t const frame = Context::Instance().AppInstance().TotalNumFrames();
 		if (rebuild_tree_)
 		{
-			octree_.resize(1);
-			AABBox bb_root(float3(0, 0, 0), float3(0, 0, 0));
-			octree_[0].first_child_index = -1;
-			octree_[0].visible = BoundOverlap::No;
-			for (auto* sn : all_scene_nodes_)
-			{
-				auto const & node = *sn;
-				uint32_t const attr = node.Attrib();
-				if (node.Updated() && (attr & SceneNode::SOA_Cullable) && !(attr & SceneNode::SOA_Moveable))
-				{
-					bb_root |= node.PosBoundWS();
-					octree_[0].node_ptrs.push_back(sn);
-				}
-			}
-			float3 const & center = bb_root.Center();
-			float3 const & extent = bb_root.HalfSize();
-			float longest_dim = std::max(std::max(extent.x(), extent.y()), extent.z());
-			float3 new_extent(longest_dim, longest_dim, longest_dim);
-			octree_[0].bb = AABBox(center - new_extent, center + new_extent);
-
-			this->DivideNode(0, 1);
-
-			rebuild_tree_ = false;
+			this->RebuildTree(false);
 		}
+		else if (scene_changed_ || (frame != last_update_frame_))
+		{
+			this->UpdateTree();
+		}
+		last_update_frame_ = frame;
 
 #ifdef KLAYGE_DRAW_NODES
 		if (!node_renderable_)
@@ -227,26 +228,34 @@ namespace KlayGE
 		}
 		else
 		{
-			if (!octree_.empty())
-			{
-				this->MarkNodeObjs(0, false);
-			}
-
 			for (auto* sn : all_scene_nodes_)
 			{
 				auto& node = *sn;
 				uint32_t const attr = node.Attrib();
 				if (node.Visible() && (attr & SceneNode::SOA_Cullable) && (attr & SceneNode::SOA_Moveable))
 				{
-					for (uint32_t i = 0; i < num_cameras; ++i)
+					if (node.Updated())
+					{
+						// In the tree, marked by MarkNodeObjs if its cell is visible
+						node.FillVisibleMark(BoundOverlap::No);
+					}
+					else
 					{
-						if (node.VisibleMark(i) == BoundOverlap::Partial)
+						for (uint32_t i = 0; i < num_cameras; ++i)
 						{
-							node.VisibleMark(i, camera_frustums_[i]->Intersect(node.PosBoundWS()));
+							if (node.VisibleMark(i) == BoundOverlap::Partial)
+							{
+								node.VisibleMark(i, camera_frustums_[i]->Intersect(node.PosBoundWS()));
+							}
 						}
 					}
 				}
 			}
+
+			if (!octree_.empty())
+			{
+				this->MarkNodeObjs(0, false);
+			}
 		}
 
 #ifdef KLAYGE_DRAW_NODES
@@ -259,12 +268,15 @@ namespace KlayGE
 		SceneManager::ClearObject();
 
 		octree_.clear();
+		obj_entries_.clear();
 		rebuild_tree_ = true;
 	}
 
 	void OCTree::OnSceneChanged()
 	{
-		rebuild_tree_ = true;
+		SceneManager::OnSceneChanged();
+
+		scene_changed_ = true;
 	}
 
 	void OCTree::DoSuspend()
@@ -277,69 +289,269 @@ namespace KlayGE
 		// TODO
 	}
 
-	void OCTree::DivideNode(size_t index, uint32_t curr_depth)
+	void OCTree::RebuildTree(bool grow)
 	{
-		if (octree_[index].node_ptrs.size() > 1)
-		{
-			size_t const this_size = octree_.size();
-			AABBox const parent_bb = octree_[index].bb;
-			float3 const parent_center = parent_bb.Center();
-			octree_[index].first_child_index = static_cast<int>(this_size);
-			octree_[index].visible = BoundOverlap::No;
-
-			octree_.resize(this_size + 8);
-			for (auto* node : octree_[index].node_ptrs)
-			{
-				AABBox const & aabb = node->PosBoundWS();
-				int mark[6];
-				mark[0] = aabb.Min().x() >= parent_center.x() ? 1 : 0;
-				mark[1] = aabb.Min().y() >= parent_center.y() ? 2 : 0;
-				mark[2] = aabb.Min().z() >= parent_center.z() ? 4 : 0;
-				mark[3] = aabb.Max().x() >= parent_center.x() ? 1 : 0;
-				mark[4] = aabb.Max().y() >= parent_center.y() ? 2 : 0;
-				mark[5] = aabb.Max().z() >= parent_center.z() ? 4 : 0;
-				for (int j = 0; j < 8; ++ j)
+		Timer timer;
+
+		octree_.resize(1);
+		octree_[0].first_child_index = -1;
+		octree_[0].depth = 1;
+		octree_[0].visible = BoundOverlap::No;
+		octree_[0].objs_visible = BoundOverlap::No;
+		octree_[0].node_ptrs.clear();
+		obj_entries_.clear();
+
+		AABBox bb_root(float3(0, 0, 0), float3(0, 0, 0));
+		for (auto* sn : all_scene_nodes_)
+		{
+			auto const & node = *sn;
+			if (node.Updated() && (node.Attrib() & SceneNode::SOA_Cullable))
+			{
+				bb_root |= node.PosBoundWS();
+			}
+		}
+		float3 const & center = bb_root.Center();
+		float3 const & extent = bb_root.HalfSize();
+		float longest_dim = std::max(std::max(extent.x(), extent.y()), extent.z());
+		if (grow)
+		{
+			// Leave room for the objects that went out of the old root, so they don't trigger a rebuild again right away
+			longest_dim *= 2;
+		}
+		float3 new_extent(longest_dim, longest_dim, longest_dim);
+		octree_[0].bb = AABBox(center - new_extent, center + new_extent);
+
+		++ update_stamp_;
+		for (auto* sn : all_scene_nodes_)
+		{
+			auto const & node = *sn;
+			if (node.Updated() && (node.Attrib() & SceneNode::SOA_Cullable))
+			{
+				bool const inserted = this->InsertObj(sn, node.PosBoundWS());
+				BOOST_ASSERT(inserted);
+				KFL_UNUSED(inserted);
+			}
+		}
+		this->RefitTree();
+
+		rebuild_tree_ = false;
+		scene_changed_ = false;
+
+		++ stats_.num_rebuilds;
+		stats_.last_rebuild_time = timer.elapsed();
+		stats_.total_rebuild_time += stats_.last_rebuild_time;
+	}
+
+	void OCTree::UpdateTree()
+	{
+		Timer timer;
+
+		++ update_stamp_;
+
+		bool out_of_root = false;
+		for (auto* sn : all_scene_nodes_)
+		{
+			auto const & node = *sn;
+			if (node.Updated() && (node.Attrib() & SceneNode::SOA_Cullable))
+			{
+				AABBox const & aabb = node.PosBoundWS();
+				auto iter = obj_entries_.find(sn);
+				if (iter == obj_entries_.end())
 				{
-					if (j == ((j & 1) ? mark[3] : mark[0])
-						+ ((j & 2) ? mark[4] : mark[1])
-						+ ((j & 4) ? mark[5] : mark[2]))
+					if (!this->InsertObj(sn, aabb))
 					{
-						octree_[this_size + j].node_ptrs.push_back(node);
+						out_of_root = true;
+						break;
+					}
+				}
+				else
+				{
+					auto& entry = iter->second;
+					entry.update_stamp = update_stamp_;
+					if ((entry.bb.Min() != aabb.Min()) || (entry.bb.Max() != aabb.Max()))
+					{
+						int const new_index = this->FindOCTreeNode(aabb);
+						if (new_index < 0)
+						{
+							out_of_root = true;
+							break;
+						}
+
+						entry.bb = aabb;
+						if (new_index != entry.octree_node_index)
+						{
+							this->RemoveObj(sn, entry.octree_node_index);
+							entry.octree_node_index = new_index;
+							octree_[new_index].node_ptrs.push_back(sn);
+							++ stats_.num_relocates;
+						}
+						else
+						{
+							++ stats_.num_refits;
+						}
+						refit_tree_ = true;
 					}
 				}
 			}
+		}
+
+		if (out_of_root)
+		{
+			this->RebuildTree(true);
+			return;
+		}
 
-			for (size_t j = 0; j < 8; ++ j)
+		// Nodes not seen in this update are removed from the scene, or not ready to be culled any more. They are
+		//  only used as keys here, since they could be destroyed already.
+		for (auto iter = obj_entries_.begin(); iter != obj_entries_.end();)
+		{
+			if (iter->second.update_stamp != update_stamp_)
+			{
+				this->RemoveObj(iter->first, iter->second.octree_node_index);
+				iter = obj_entries_.erase(iter);
+				++ stats_.num_removes;
+				refit_tree_ = true;
+			}
+			else
 			{
-				octree_node_t& new_node = octree_[this_size + j];
-				new_node.first_child_index = -1;
-				new_node.bb = AABBox(float3((j & 1) ? parent_center.x() : parent_bb.Min().x(),
-						(j & 2) ? parent_center.y() : parent_bb.Min().y(),
-						(j & 4) ? parent_center.z() : parent_bb.Min().z()),
-					float3((j & 1) ? parent_bb.Max().x() : parent_center.x(),
-						(j & 2) ? parent_bb.Max().y() : parent_center.y(),
-						(j & 4) ? parent_bb.Max().z() : parent_center.z()));
+				++ iter;
+			}
+		}
+
+		if (refit_tree_)
+		{
+			this->RefitTree();
+		}
 
-				if (curr_depth < max_tree_depth_)
+		scene_changed_ = false;
+
+		stats_.last_update_time = timer.elapsed();
+		stats_.total_update_time += stats_.last_update_time;
+	}
+
+	void OCTree::RefitTree()
+	{
+		// Children are always allocated after their parent, so a backward pass sees them first
+		for (size_t i = octree_.size(); i > 0; -- i)
+		{
+			auto& octree_node = octree_[i - 1];
+			octree_node.num_objs_in_subtree = static_cast<uint32_t>(octree_node.node_ptrs.size());
+			octree_node.content_bb = AABBox(float3(+1e10f, +1e10f, +1e10f), float3(-1e10f, -1e10f, -1e10f));
+			for (auto* node : octree_node.node_ptrs)
+			{
+				octree_node.content_bb |= obj_entries_[node].bb;
+			}
+			if (octree_node.first_child_index != -1)
+			{
+				for (int j = 0; j < 8; ++ j)
 				{
-					this->DivideNode(this_size + j, curr_depth + 1);
+					auto const & child = octree_[octree_node.first_child_index + j];
+					if (child.num_objs_in_subtree > 0)
+					{
+						octree_node.num_objs_in_subtree += child.num_objs_in_subtree;
+						octree_node.content_bb |= child.content_bb;
+					}
 				}
 			}
+		}
 
-			octree_[index].node_ptrs.clear();
-			octree_[index].node_ptrs.shrink_to_fit();
+		refit_tree_ = false;
+	}
+
+	bool OCTree::InsertObj(SceneNode* node, AABBox const & aabb)
+	{
+		int const index = this->FindOCTreeNode(aabb);
+		if (index < 0)
+		{
+			return false;
 		}
+
+		octree_[index].node_ptrs.push_back(node);
+
+		auto& entry = obj_entries_[node];
+		entry.bb = aabb;
+		entry.octree_node_index = index;
+		entry.update_stamp = update_stamp_;
+
+		++ stats_.num_inserts;
+		refit_tree_ = true;
+
+		return true;
 	}
 
-	void OCTree::NodeVisible(size_t index)
+	void OCTree::RemoveObj(SceneNode* node, int octree_node_index)
 	{
-		BOOST_ASSERT(index < octree_.size());
+		auto& node_ptrs = octree_[octree_node_index].node_ptrs;
+		auto iter = std::find(node_ptrs.begin(), node_ptrs.end(), node);
+		BOOST_ASSERT(iter != node_ptrs.end());
+		*iter = node_ptrs.back();
+		node_ptrs.pop_back();
+	}
 
-		auto& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
-		auto const& viewport = *re.CurFrameBuffer()->Viewport();
-		uint32_t const num_cameras = viewport.NumCameras();
+	int OCTree::FindOCTreeNode(AABBox const & aabb)
+	{
+		BOOST_ASSERT(!octree_.empty());
 
-		auto& octree_node = octree_[index];
+		float3 const center = aabb.Center();
+		float3 const half_size = aabb.HalfSize();
+		float const obj_size = std::max(std::max(half_size.x(), half_size.y()), half_size.z());
+
+		if (!octree_[0].bb.VecInBound(center) || (obj_size > octree_[0].bb.HalfSize().x()))
+		{
+			return -1;
+		}
+
+		size_t index = 0;
+		while (octree_[index].depth < max_tree_depth_)
+		{
+			if (obj_size > octree_[index].bb.HalfSize().x() / 2)
+			{
+				break;
+			}
+
+			if (-1 == octree_[index].first_child_index)
+			{
+				this->CreateChildren(index);
+			}
+
+			float3 const cell_center = octree_[index].bb.Center();
+			int const j = (center.x() >= cell_center.x() ? 1 : 0)
+				+ (center.y() >= cell_center.y() ? 2 : 0)
+				+ (center.z() >= cell_center.z() ? 4 : 0);
+			index = octree_[index].first_child_index + j;
+		}
+
+		return static_cast<int>(index);
+	}
+
+	void OCTree::CreateChildren(size_t index)
+	{
+		size_t const this_size = octree_.size();
+		AABBox const parent_bb = octree_[index].bb;
+		float3 const parent_center = parent_bb.Center();
+		uint32_t const child_depth = octree_[index].depth + 1;
+		octree_[index].first_child_index = static_cast<int>(this_size);
+
+		octree_.resize(this_size + 8);
+		for (size_t j = 0; j < 8; ++ j)
+		{
+			octree_node_t& new_node = octree_[this_size + j];
+			new_node.first_child_index = -1;
+			new_node.depth = child_depth;
+			new_node.visible = BoundOverlap::No;
+			new_node.objs_visible = BoundOverlap::No;
+			new_node.num_objs_in_subtree = 0;
+			new_node.bb = AABBox(float3((j & 1) ? parent_center.x() : parent_bb.Min().x(),
+					(j & 2) ? parent_center.y() : parent_bb.Min().y(),
+					(j & 4) ? parent_center.z() : parent_bb.Min().z()),
+				float3((j & 1) ? parent_bb.Max().x() : parent_center.x(),
+					(j & 2) ? parent_bb.Max().y() : parent_center.y(),
+					(j & 4) ? parent_bb.Max().z() : parent_center.z()));
+		}
+	}
+
+	BoundOverlap OCTree::CellVisible(AABBox const & aabb) const
+	{
 		bool large_enough;
 		if (small_obj_threshold_ <= 0)
 		{
@@ -347,13 +559,17 @@ namespace KlayGE
 		}
 		else
 		{
+			auto& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+			auto const& viewport = *re.CurFrameBuffer()->Viewport();
+			uint32_t const num_cameras = viewport.NumCameras();
+
 			large_enough = false;
 			for (uint32_t i = 0; i < num_cameras; ++i)
 			{
 				auto const& camera = *viewport.Camera(i);
 				float4x4 const& view_proj = camera_view_projs_[i];
-				if (((MathLib::ortho_area(camera.ForwardVec(), octree_node.bb) > small_obj_threshold_)
-					&& (MathLib::perspective_area(camera.EyePos(), view_proj, octree_node.bb) > small_obj_threshold_)))
+				if (((MathLib::ortho_area(camera.ForwardVec(), aabb) > small_obj_threshold_)
+					&& (MathLib::perspective_area(camera.EyePos(), view_proj, aabb) > small_obj_threshold_)))
 				{
 					large_enough = true;
 					break;
@@ -361,24 +577,28 @@ namespace KlayGE
 			}
 		}
 
-		if (large_enough)
+		return large_enough ? SceneManager::AABBVisible(aabb) : BoundOverlap::No;
+	}
+
+	void OCTree::NodeVisible(size_t index)
+	{
+		BOOST_ASSERT(index < octree_.size());
+
+		auto& octree_node = octree_[index];
+
+		// The cell itself answers the bound queries, the contents decide which objects to test
+		octree_node.visible = this->CellVisible(octree_node.bb);
+		octree_node.objs_visible = (octree_node.num_objs_in_subtree > 0) ? this->CellVisible(octree_node.content_bb) : BoundOverlap::No;
+		if ((BoundOverlap::Partial == octree_node.visible) || (BoundOverlap::Partial == octree_node.objs_visible))
 		{
-			octree_node.visible = SceneManager::AABBVisible(octree_node.bb);
-			if (BoundOverlap::Partial == octree_node.visible)
+			if (octree_node.first_child_index != -1)
 			{
-				if (octree_node.first_child_index != -1)
+				for (int i = 0; i < 8; ++ i)
 				{
-					for (int i = 0; i < 8; ++ i)
-					{
-						this->NodeVisible(octree_node.first_child_index + i);
-					}
+					this->NodeVisible(octree_node.first_child_index + i);
 				}
 			}
 		}
-		else
-		{
-			octree_node.visible = BoundOverlap::No;
-		}
 
 #ifdef KLAYGE_DRAW_NODES
 		if ((vis != BoundOverlap::No) && (-1 == node.first_child_index))
@@ -398,10 +618,25 @@ namespace KlayGE
 		uint32_t const num_cameras = viewport.NumCameras();
 
 		auto const & octree_node = octree_[index];
-		if ((octree_node.visible != BoundOverlap::No) || force)
+		if ((octree_node.objs_visible != BoundOverlap::No) || force)
 		{
-			for (auto* node : octree_node.node_ptrs)
+			// Tested up front for all objects in the cell. Whether a result is used depends on the marks of the parents.
+			size_t const num_objs = octree_node.node_ptrs.size();
+			cell_obj_bounds_.resize(num_objs);
+			for (size_t n = 0; n < num_objs; ++ n)
+			{
+				cell_obj_bounds_.Set(n, octree_node.node_ptrs[n]->PosBoundWS());
+			}
+			cell_obj_overlaps_.resize(num_objs * num_cameras);
+			for (uint32_t i = 0; i < num_cameras; ++i)
 			{
+				MathLib::intersect_aabbs_frustum(MakeSpan(cell_obj_overlaps_.data() + i * num_objs, num_objs), cell_obj_bounds_,
+					*camera_frustums_[i]);
+			}
+
+			for (size_t n = 0; n < num_objs; ++ n)
+			{
+				auto* node = octree_node.node_ptrs[n];
 				if (node->Visible())
 				{
 					if (node->Updated())
@@ -415,7 +650,7 @@ namespace KlayGE
 								{
 									if (node->Parent())
 									{
-										visible = camera_frustums_[i]->Intersect(node->PosBoundWS());
+										visible = cell_obj_overlaps_[i * num_objs + n];
 									}
 									else
 									{
@@ -427,8 +662,9 @@ namespace KlayGE
 							}
 						}
 					}
-					else
+					else if (!(node->Attrib() & SceneNode::SOA_Moveable))
 					{
+						// Moveable ones that aren't updated are marked in ClipScene
 						for (uint32_t i = 0; i < num_cameras; ++i)
 						{
 							node->VisibleMark(i, BoundOverlap::Yes);
@@ -461,7 +697,7 @@ namespace KlayGE
 			{
 				for (int i = 0; i < 8; ++ i)
 				{
-					this->MarkNodeObjs(octree_node.first_child_index + i, (BoundOverlap::Yes == octree_node.visible) || force);
+					this->MarkNodeObjs(octree_node.first_child_index + i, (BoundOverlap::Yes == octree_node.objs_visible) || force);
 				}
 			}
 		}
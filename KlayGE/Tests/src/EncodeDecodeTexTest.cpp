@@ -5,7 +5,10 @@
 #include <KlayGE/Texture.hpp>
 #include <KlayGE/ResLoader.hpp>
 #include <KFL/Half.hpp>
+#include <KFL/Timer.hpp>
 
+#include <algorithm>
+#include <iterator>
 #include <vector>
 #include <string>
 #include <iostream>
@@ -229,6 +232,112 @@ void TestEncodeDecodeTex(std::string_view input_name, std::string_view tc_name,
 	EXPECT_LT(mse, threshold);
 }
 
+// EncodeMem and DecodeMem spread the blocks over threads. They must give the same result as one block at a time.
+void TestEncodeDecodeMem(std::string_view input_name, ElementFormat bc_fmt)
+{
+	ResLoader::Instance().AddPath("../../Tests/media/EncodeDecodeTex");
+
+	auto make_codec = [bc_fmt]() -> std::unique_ptr<TexCompression>
+	{
+		switch (bc_fmt)
+		{
+		case EF_BC1:
+			return MakeUniquePtr<TexCompressionBC1>();
+
+		case EF_BC3:
+			return MakeUniquePtr<TexCompressionBC3>();
+
+		case EF_BC6:
+			return MakeUniquePtr<TexCompressionBC6U>();
+
+		case EF_BC7:
+			return MakeUniquePtr<TexCompressionBC7>();
+
+		case EF_ETC1:
+			return MakeUniquePtr<TexCompressionETC1>();
+
+		default:
+			KFL_UNREACHABLE("Unsupported compression format");
+		}
+	};
+
+	TexturePtr in_tex = LoadSoftwareTexture(input_name);
+	uint32_t const width = in_tex->Width(0);
+	uint32_t const height = in_tex->Height(0);
+	auto const & init_data = checked_cast<SoftwareTexture&>(*in_tex).SubresourceData();
+	uint8_t const * input = static_cast<uint8_t const *>(init_data[0].data);
+	uint32_t const in_pitch = init_data[0].row_pitch;
+
+	uint32_t const pixel_size = NumFormatBytes(DecodedFormat(bc_fmt));
+	uint32_t const block_width = BlockWidth(bc_fmt);
+	uint32_t const block_height = BlockHeight(bc_fmt);
+	uint32_t const block_bytes = BlockBytes(bc_fmt);
+	uint32_t const num_blocks_x = (width + block_width - 1) / block_width;
+	uint32_t const num_blocks_y = (height + block_height - 1) / block_height;
+	uint32_t const bc_pitch = num_blocks_x * block_bytes;
+
+	std::vector<uint8_t> expected_blocks(num_blocks_y * bc_pitch);
+	std::vector<uint8_t> expected_argb(width * height * pixel_size);
+	{
+		auto codec = make_codec();
+		std::vector<uint8_t> uncompressed(block_width * block_height * pixel_size);
+		for (uint32_t y_base = 0; y_base < height; y_base += block_height)
+		{
+			for (uint32_t x_base = 0; x_base < width; x_base += block_width)
+			{
+				for (uint32_t y = 0; y < block_height; ++ y)
+				{
+					for (uint32_t x = 0; x < block_width; ++ x)
+					{
+						if ((x_base + x < width) && (y_base + y < height))
+						{
+							memcpy(&uncompressed[(y * block_width + x) * pixel_size],
+								&input[(y_base + y) * in_pitch + (x_base + x) * pixel_size], pixel_size);
+						}
+						else
+						{
+							memset(&uncompressed[(y * block_width + x) * pixel_size], 0, pixel_size);
+						}
+					}
+				}
+
+				uint8_t* block = &expected_blocks[(y_base / block_height) * bc_pitch + (x_base / block_width) * block_bytes];
+				codec->EncodeBlock(block, &uncompressed[0], TCM_Balanced);
+
+				codec->DecodeBlock(&uncompressed[0], block);
+				for (uint32_t y = 0; (y < block_height) && (y_base + y < height); ++ y)
+				{
+					for (uint32_t x = 0; (x < block_width) && (x_base + x < width); ++ x)
+					{
+						memcpy(&expected_argb[((y_base + y) * width + (x_base + x)) * pixel_size],
+							&uncompressed[(y * block_width + x) * pixel_size], pixel_size);
+					}
+				}
+			}
+		}
+	}
+
+	auto codec = make_codec();
+	double const mpixels = width * height / 1e6;
+
+	std::vector<uint8_t> bc_blocks(expected_blocks.size());
+	Timer timer;
+	codec->EncodeMem(width, height, &bc_blocks[0], bc_pitch, static_cast<uint32_t>(bc_blocks.size()),
+		input, in_pitch, in_pitch * height, TCM_Balanced);
+	double const encode_time = timer.elapsed();
+	EXPECT_TRUE(bc_blocks == expected_blocks);
+
+	std::vector<uint8_t> restored_argb(expected_argb.size());
+	timer.restart();
+	codec->DecodeMem(width, height, &restored_argb[0], width * pixel_size, static_cast<uint32_t>(restored_argb.size()),
+		&bc_blocks[0], bc_pitch, static_cast<uint32_t>(bc_blocks.size()));
+	double const decode_time = timer.elapsed();
+	EXPECT_TRUE(restored_argb == expected_argb);
+
+	cout << input_name << ": encoding " << mpixels / encode_time << " MPixels/s, decoding "
+		<< mpixels / decode_time << " MPixels/s" << endl;
+}
+
 TEST(EncodeDecodeTexTest, DecodeBC1)
 {
 	TestEncodeDecodeTex("Lenna.dds", "Lenna_bc1.dds", EF_BC1, 4.7f);
@@ -279,6 +388,16 @@ TEST(EncodeDecodeTexTest, EncodeDecodeBC3)
 	TestEncodeDecodeTex("leaf_v3_green_tex.dds", "", EF_BC3, 8.9f);
 }
 
+TEST(EncodeDecodeTexTest, EncodeDecodeBC6U)
+{
+	TestEncodeDecodeTex("memorial.dds", "", EF_BC6, 0.15f);
+}
+
+TEST(EncodeDecodeTexTest, EncodeDecodeBC6S)
+{
+	TestEncodeDecodeTex("uffizi_probe.dds", "", EF_SIGNED_BC6, 0.15f);
+}
+
 TEST(EncodeDecodeTexTest, EncodeDecodeBC7XRGB)
 {
 	TestEncodeDecodeTex("Lenna.dds", "", EF_BC7, 1.8f);
@@ -293,3 +412,57 @@ TEST(EncodeDecodeTexTest, EncodeDecodeETC1)
 {
 	TestEncodeDecodeTex("Lenna.dds", "", EF_ETC1, 4.8f);
 }
+
+TEST(EncodeDecodeTexTest, EncodeDecodeMemBC1)
+{
+	TestEncodeDecodeMem("Lenna.dds", EF_BC1);
+}
+
+TEST(EncodeDecodeTexTest, EncodeDecodeMemBC3)
+{
+	TestEncodeDecodeMem("leaf_v3_green_tex.dds", EF_BC3);
+}
+
+TEST(EncodeDecodeTexTest, EncodeDecodeMemBC6U)
+{
+	TestEncodeDecodeMem("memorial.dds", EF_BC6);
+}
+
+TEST(EncodeDecodeTexTest, EncodeDecodeMemBC7)
+{
+	TestEncodeDecodeMem("Lenna.dds", EF_BC7);
+}
+
+TEST(EncodeDecodeTexTest, EncodeDecodeMemETC1)
+{
+	TestEncodeDecodeMem("Lenna.dds", EF_ETC1);
+}
+
+TEST(EncodeDecodeTexTest, EncodeBC7Reproducible)
+{
+	uint32_t argb[16];
+	uint32_t noise = 12345;
+	for (auto& texel : argb)
+	{
+		noise = noise * 1664525 + 1013904223;
+		texel = noise;
+	}
+
+	TexCompressionBC7 codec;
+	uint8_t first[16];
+	codec.EncodeBlock(first, argb, TCM_Quality);
+
+	// Neither what was encoded before nor the codec instance changes the result
+	uint8_t other[16];
+	std::reverse(std::begin(argb), std::end(argb));
+	codec.EncodeBlock(other, argb, TCM_Quality);
+	std::reverse(std::begin(argb), std::end(argb));
+
+	uint8_t second[16];
+	codec.EncodeBlock(second, argb, TCM_Quality);
+	EXPECT_EQ(memcmp(first, second, sizeof(first)), 0);
+
+	TexCompressionBC7 another_codec;
+	another_codec.EncodeBlock(second, argb, TCM_Quality);
+	EXPECT_EQ(memcmp(first, second, sizeof(first)), 0);
+}
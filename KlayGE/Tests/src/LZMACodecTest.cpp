@@ -0,0 +1,129 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KlayGE/LZMACodec.hpp>
+#include <KlayGE/ResLoader.hpp>
+#include <KFL/Timer.hpp>
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+std::vector<uint8_t> ReadWholeAsset(std::string_view name)
+{
+	auto res = ResLoader::Instance().Open(name);
+	EXPECT_TRUE(res);
+
+	res->seekg(0, std::ios_base::end);
+	std::vector<uint8_t> data(static_cast<size_t>(res->tellg()));
+	res->seekg(0, std::ios_base::beg);
+	res->read(data.data(), data.size());
+	return data;
+}
+
+// Compresses an asset as a single stream and as blocks, checks both decode back, and prints the throughput of each.
+void TestLZMACodec(std::string_view input_name)
+{
+	ResLoader::Instance().AddPath("../../Tests/media/MeshConverter");
+	ResLoader::Instance().AddPath("../../Tests/media/TexConverter");
+
+	auto const input = ReadWholeAsset(input_name);
+	double const mbytes = input.size() / 1e6;
+
+	LZMACodec lzma;
+
+	std::vector<uint8_t> single;
+	Timer timer;
+	lzma.Encode(single, MakeSpan(input));
+	double const single_encode_time = timer.elapsed();
+	EXPECT_FALSE(LZMACodec::IsBlockFramed(single));
+
+	std::vector<uint8_t> restored;
+	timer.restart();
+	lzma.Decode(restored, single, input.size());
+	double const single_decode_time = timer.elapsed();
+	EXPECT_TRUE(restored == input);
+
+	uint32_t const block_size = 64 * 1024;
+	std::vector<uint8_t> blocks;
+	timer.restart();
+	lzma.EncodeBlocks(blocks, MakeSpan(input), block_size);
+	double const blocks_encode_time = timer.elapsed();
+	EXPECT_TRUE(LZMACodec::IsBlockFramed(blocks));
+	EXPECT_EQ(LZMACodec::NumBlocks(blocks), (input.size() + block_size - 1) / block_size);
+	EXPECT_EQ(LZMACodec::BlockSize(blocks), block_size);
+
+	restored.clear();
+	timer.restart();
+	lzma.Decode(restored, blocks, input.size());
+	double const blocks_decode_time = timer.elapsed();
+	EXPECT_TRUE(restored == input);
+
+	uint32_t const last_block = LZMACodec::NumBlocks(blocks) - 1;
+	for (uint32_t block_index : { 0U, last_block / 2, last_block })
+	{
+		std::vector<uint8_t> block;
+		lzma.DecodeBlock(block, blocks, block_index);
+		size_t const offset = block_index * block_size;
+		ASSERT_EQ(block.size(), std::min<size_t>(block_size, input.size() - offset));
+		EXPECT_TRUE(std::equal(block.begin(), block.end(), input.begin() + offset));
+	}
+
+	cout << input_name << " (" << mbytes << " MB): single stream ratio " << single.size() / static_cast<double>(input.size())
+		<< ", encoding " << mbytes / single_encode_time << " MB/s, decoding " << mbytes / single_decode_time << " MB/s" << endl;
+	cout << input_name << " (" << mbytes << " MB): blocks ratio " << blocks.size() / static_cast<double>(input.size())
+		<< ", encoding " << mbytes / blocks_encode_time << " MB/s, decoding " << mbytes / blocks_decode_time << " MB/s" << endl;
+}
+
+TEST(LZMACodecTest, Mesh)
+{
+	TestLZMACodec("tree2a_lod0.obj");
+}
+
+TEST(LZMACodecTest, Texture)
+{
+	TestLZMACodec("lion_mip.dds");
+}
+
+TEST(LZMACodecTest, CorruptedBlocks)
+{
+	std::vector<uint8_t> input(200000);
+	for (size_t i = 0; i < input.size(); ++ i)
+	{
+		input[i] = static_cast<uint8_t>((i * 7) ^ (i >> 5));
+	}
+
+	uint32_t const block_size = 64 * 1024;
+	LZMACodec lzma;
+	std::vector<uint8_t> blocks;
+	lzma.EncodeBlocks(blocks, MakeSpan(input), block_size);
+
+	auto decode_patched = [&lzma, &blocks, &input](size_t offset, uint64_t value, size_t size)
+	{
+		std::vector<uint8_t> patched = blocks;
+		std::memcpy(&patched[offset], &value, size);
+		std::vector<uint8_t> restored;
+		lzma.Decode(restored, patched, input.size());
+		for (uint32_t i = 0; i < 4; ++ i)
+		{
+			lzma.DecodeBlock(restored, patched, i);
+		}
+	};
+
+	EXPECT_NO_THROW(decode_patched(0, blocks[0], 1));
+	// Header: block_size, num_blocks, original_len
+	EXPECT_ANY_THROW(decode_patched(4, 0, 4));
+	EXPECT_ANY_THROW(decode_patched(4, block_size / 2, 4));
+	EXPECT_ANY_THROW(decode_patched(8, 0x10000000, 4));
+	EXPECT_ANY_THROW(decode_patched(16, input.size() * 2, 8));
+	// End offsets of the blocks
+	EXPECT_ANY_THROW(decode_patched(24, 0, 8));
+	EXPECT_ANY_THROW(decode_patched(32, 1, 8));
+	EXPECT_ANY_THROW(decode_patched(48, blocks.size(), 8));
+	// Truncated
+	blocks.resize(blocks.size() - 1);
+	EXPECT_ANY_THROW(decode_patched(0, blocks[0], 1));
+}
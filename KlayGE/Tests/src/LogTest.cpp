@@ -0,0 +1,164 @@
+/**
+ * @file LogTest.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+
+#include <KFL/Log.hpp>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Captures everything written to std::clog while alive
+	class ClogCapture
+	{
+	public:
+		ClogCapture()
+		{
+			LogFlush();
+			old_buff_ = std::clog.rdbuf(captured_.rdbuf());
+		}
+
+		~ClogCapture()
+		{
+			LogFlush();
+			std::clog.rdbuf(old_buff_);
+		}
+
+		std::string Text()
+		{
+			LogFlush();
+			return captured_.str();
+		}
+
+		// Only what is known to be written out already
+		std::string UnflushedText() const
+		{
+			return captured_.str();
+		}
+
+	private:
+		std::ostringstream captured_;
+		std::streambuf* old_buff_;
+	};
+
+	uint32_t CountLines(std::string const & text, std::string const & pattern)
+	{
+		uint32_t count = 0;
+		std::istringstream iss(text);
+		std::string line;
+		while (std::getline(iss, line))
+		{
+			if (line.find(pattern) != std::string::npos)
+			{
+				++ count;
+			}
+		}
+		return count;
+	}
+}
+
+TEST(LogTest, ConcurrentRecords)
+{
+	ClogCapture capture;
+
+	uint32_t constexpr NUM_THREADS = 8;
+	uint32_t constexpr NUM_RECORDS = 2000;
+
+	std::vector<std::thread> threads;
+	for (uint32_t t = 0; t < NUM_THREADS; ++ t)
+	{
+		threads.emplace_back([t]
+			{
+				for (uint32_t i = 0; i < NUM_RECORDS; ++ i)
+				{
+					LogInfo("LogTest") << "thread " << t << " record " << i << " end" << std::endl;
+				}
+			});
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	std::string const text = capture.Text();
+	EXPECT_EQ(CountLines(text, "(INFO) KlayGE/LogTest: thread "), NUM_THREADS * NUM_RECORDS);
+	EXPECT_EQ(CountLines(text, " end"), NUM_THREADS * NUM_RECORDS);
+}
+
+TEST(LogTest, Filtering)
+{
+	ClogCapture capture;
+
+	LogMinSeverity(LogSeverity::Warn);
+	LogInfo() << "LogTest dropped by severity" << std::endl;
+	LogWarn() << "LogTest kept" << std::endl;
+	LogMinSeverity(LogSeverity::Info);
+
+	LogCategoryEnabled("LogTestMuted", false);
+	LogError("LogTestMuted") << "LogTest dropped by category" << std::endl;
+	LogCategoryEnabled("LogTestMuted", true);
+	LogError("LogTestMuted") << "LogTest unmuted" << std::endl;
+
+	std::string const text = capture.Text();
+	EXPECT_EQ(text.find("dropped"), std::string::npos);
+	EXPECT_NE(text.find("(WARN) KlayGE: LogTest kept\n"), std::string::npos);
+	EXPECT_NE(text.find("(ERROR) KlayGE/LogTestMuted: LogTest unmuted\n"), std::string::npos);
+}
+
+TEST(LogTest, ErrorWrittenOutAtOnce)
+{
+	ClogCapture capture;
+
+	LogError("LogTest") << "LogTest error" << std::endl;
+	EXPECT_NE(capture.UnflushedText().find("(ERROR) KlayGE/LogTest: LogTest error\n"), std::string::npos);
+}
+
+TEST(LogTest, JsonLines)
+{
+	ClogCapture capture;
+
+	LogOutputFormat(LogFormat::JsonLines);
+	LogWarn("LogTest") << "quote \" backslash \\ tab \t" << std::endl;
+	LogOutputFormat(LogFormat::Text);
+
+	std::string const text = capture.Text();
+	EXPECT_NE(text.find("\"severity\":\"warn\",\"category\":\"LogTest\",\"msg\":\"quote \\\" backslash \\\\ tab \\t\"}\n"),
+		std::string::npos);
+}
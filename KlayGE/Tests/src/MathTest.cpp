@@ -1,11 +1,13 @@
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/Math.hpp>
+#include <KFL/BoundBatch.hpp>
 
 #include "KlayGETests.hpp"
 
 #include <vector>
 #include <string>
 #include <iostream>
+#include <random>
 
 using namespace std;
 using namespace KlayGE;
@@ -30,3 +32,163 @@ TEST(MathTest, NormalizeFloat4)
 	v = MathLib::normalize(v);
 	EXPECT_LT(MathLib::abs(MathLib::length(v) - 1.0f), 1e-5f);
 }
+
+namespace
+{
+	AABBoxBatch RandomAABBoxes(std::ranlux24_base& gen, size_t num)
+	{
+		std::uniform_real_distribution<float> center_dis(-50, 50);
+		std::uniform_real_distribution<float> extent_dis(0, 5);
+
+		AABBoxBatch ret;
+		for (size_t i = 0; i < num; ++ i)
+		{
+			float3 const center(center_dis(gen), center_dis(gen), center_dis(gen));
+			float3 const extent(extent_dis(gen), extent_dis(gen), extent_dis(gen));
+			ret.push_back(AABBox(center - extent, center + extent));
+		}
+		return ret;
+	}
+
+	Frustum TestFrustum()
+	{
+		float4x4 const view = MathLib::look_at_lh(float3(3, 5, -40), float3(0, 0, 0), float3(0, 1, 0));
+		float4x4 const proj = MathLib::perspective_fov_lh(PI / 4, 4.0f / 3, 1.0f, 80.0f);
+		float4x4 const view_proj = view * proj;
+
+		Frustum frustum;
+		frustum.ClipMatrix(view_proj, MathLib::inverse(view_proj));
+		return frustum;
+	}
+
+	// The batch and single versions only agree up to rounding, so a mismatch is fine when a plane test is that close
+	float constexpr PLANE_TOLERANCE = 1e-3f;
+
+	bool NearFrustumPlane(AABBox const & aabb, Frustum const & frustum)
+	{
+		for (uint32_t i = 0; i < 6; ++ i)
+		{
+			Plane const & plane = frustum.FrustumPlane(i);
+			for (uint32_t j = 0; j < 8; ++ j)
+			{
+				if (MathLib::abs(MathLib::dot_coord(plane, aabb.Corner(j))) <= PLANE_TOLERANCE)
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	bool NearFrustumPlane(Sphere const & sphere, Frustum const & frustum)
+	{
+		for (uint32_t i = 0; i < 6; ++ i)
+		{
+			float const d = MathLib::dot_coord(frustum.FrustumPlane(i), sphere.Center());
+			if ((MathLib::abs(d + sphere.Radius()) <= PLANE_TOLERANCE)
+				|| (MathLib::abs(d - sphere.Radius()) <= PLANE_TOLERANCE))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+TEST(MathTest, TransformAABBoxBatch)
+{
+	std::ranlux24_base gen;
+
+	// 8-wide, 4-wide and scalar tails all get covered
+	AABBoxBatch const aabbs = RandomAABBoxes(gen, 1003);
+
+	float4x4 const mats[] =
+	{
+		MathLib::scaling(2.0f, 0.5f, 3.0f) * MathLib::rotation_y(0.7f) * MathLib::translation(1.0f, -2.0f, 3.0f),
+		MathLib::look_at_lh(float3(3, 5, -40), float3(0, 0, 0), float3(0, 1, 0))
+			* MathLib::perspective_fov_lh(PI / 4, 4.0f / 3, 1.0f, 80.0f),
+		float4x4::Zero()
+	};
+	for (auto const & mat : mats)
+	{
+		AABBoxBatch transformed;
+		MathLib::transform_aabbs(transformed, aabbs, mat);
+		ASSERT_EQ(transformed.size(), aabbs.size());
+
+		// Not bit-exact, the compiler may contract either path into FMAs
+		auto const tolerance = [](float expected) { return 1e-4f * (1 + MathLib::abs(expected)); };
+		for (size_t i = 0; i < aabbs.size(); ++ i)
+		{
+			AABBox const expected = MathLib::transform_aabb(aabbs.Get(i), mat);
+			EXPECT_NEAR(transformed.min_x[i], expected.Min().x(), tolerance(expected.Min().x()));
+			EXPECT_NEAR(transformed.min_y[i], expected.Min().y(), tolerance(expected.Min().y()));
+			EXPECT_NEAR(transformed.min_z[i], expected.Min().z(), tolerance(expected.Min().z()));
+			EXPECT_NEAR(transformed.max_x[i], expected.Max().x(), tolerance(expected.Max().x()));
+			EXPECT_NEAR(transformed.max_y[i], expected.Max().y(), tolerance(expected.Max().y()));
+			EXPECT_NEAR(transformed.max_z[i], expected.Max().z(), tolerance(expected.Max().z()));
+		}
+	}
+}
+
+TEST(MathTest, IntersectAABBoxBatchFrustum)
+{
+	std::ranlux24_base gen;
+
+	Frustum const frustum = TestFrustum();
+	AABBoxBatch const aabbs = RandomAABBoxes(gen, 1005);
+
+	std::vector<BoundOverlap> overlaps(aabbs.size());
+	MathLib::intersect_aabbs_frustum(overlaps, aabbs, frustum);
+
+	uint32_t counts[3] = { 0, 0, 0 };
+	for (size_t i = 0; i < aabbs.size(); ++ i)
+	{
+		AABBox const aabb = aabbs.Get(i);
+		if (overlaps[i] != MathLib::intersect_aabb_frustum(aabb, frustum))
+		{
+			EXPECT_TRUE(NearFrustumPlane(aabb, frustum));
+		}
+		++ counts[static_cast<uint32_t>(overlaps[i])];
+	}
+
+	// Make sure all outcomes are exercised
+	EXPECT_GT(counts[static_cast<uint32_t>(BoundOverlap::No)], 0U);
+	EXPECT_GT(counts[static_cast<uint32_t>(BoundOverlap::Partial)], 0U);
+	EXPECT_GT(counts[static_cast<uint32_t>(BoundOverlap::Yes)], 0U);
+
+	// A sub-range that starts and ends off the SIMD width
+	size_t const first = 13;
+	std::vector<BoundOverlap> sub_overlaps(501);
+	MathLib::intersect_aabbs_frustum(sub_overlaps, aabbs, frustum, first);
+	for (size_t i = 0; i < sub_overlaps.size(); ++ i)
+	{
+		EXPECT_EQ(sub_overlaps[i], overlaps[first + i]);
+	}
+}
+
+TEST(MathTest, IntersectSphereBatchFrustum)
+{
+	std::ranlux24_base gen;
+	std::uniform_real_distribution<float> center_dis(-50, 50);
+	std::uniform_real_distribution<float> radius_dis(0, 20);
+
+	Frustum const frustum = TestFrustum();
+
+	SphereBatch spheres;
+	for (size_t i = 0; i < 1006; ++ i)
+	{
+		spheres.push_back(Sphere(float3(center_dis(gen), center_dis(gen), center_dis(gen)), radius_dis(gen)));
+	}
+
+	std::vector<BoundOverlap> overlaps(spheres.size());
+	MathLib::intersect_spheres_frustum(overlaps, spheres, frustum);
+
+	for (size_t i = 0; i < spheres.size(); ++ i)
+	{
+		Sphere const sphere = spheres.Get(i);
+		if (overlaps[i] != MathLib::intersect_sphere_frustum(sphere, frustum))
+		{
+			EXPECT_TRUE(NearFrustumPlane(sphere, frustum));
+		}
+	}
+}
@@ -0,0 +1,743 @@
+/**
+ * @file NetTest.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+
+#include <KlayGE/Lobby.hpp>
+#include <KlayGE/NetConnection.hpp>
+#include <KlayGE/NetEventLoop.hpp>
+#include <KlayGE/NetMsg.hpp>
+#include <KlayGE/NetSnapshot.hpp>
+#include <KlayGE/Player.hpp>
+#include <KlayGE/Socket.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	char const MSG_ECHO = 0x40;
+
+	// Echoes the 8 bytes after the message type
+	class EchoProcessor : public Processor
+	{
+	public:
+		void OnJoin(uint32_t /*ID*/) const override
+		{
+			++ num_joins;
+		}
+		void OnQuit(uint32_t /*ID*/) const override
+		{
+			++ num_quits;
+		}
+		void OnDefault(void* revBuf, int /*maxSize*/, void* sendBuf, int& numSend, sockaddr_in& /*from*/) const override
+		{
+			std::memcpy(static_cast<char*>(sendBuf) + 1, static_cast<char const *>(revBuf) + 1, 8);
+			numSend = 8;
+			++ num_echos;
+		}
+
+		mutable std::atomic<uint32_t> num_joins{0};
+		mutable std::atomic<uint32_t> num_quits{0};
+		mutable std::atomic<uint32_t> num_echos{0};
+	};
+
+	uint16_t FreePort()
+	{
+		Socket socket;
+		socket.Create(SOCK_DGRAM);
+		socket.Bind(TransAddr("127.0.0.1", 0));
+
+		sockaddr_in addr;
+		socklen_t len(sizeof(addr));
+		socket.SockName(addr, len);
+		return ntohs(addr.sin_port);
+	}
+
+	// Runs a lobby on its own thread, and returns once it answers
+	class LobbyRunner
+	{
+	public:
+		LobbyRunner()
+			: port_(FreePort())
+		{
+			thread_ = std::thread([this]
+				{
+					lobby_.Create("NetTest", 8, port_, processor_);
+				});
+
+			Socket probe;
+			probe.Create(SOCK_DGRAM);
+			probe.Connect(this->Addr());
+			probe.TimeOut(100);
+			for (uint32_t i = 0; i < 50; ++ i)
+			{
+				char msg(MSG_GETLOBBYINFO);
+				probe.Send(&msg, sizeof(msg));
+
+				// Fails right away with a refused connection if the lobby isn't bound yet
+				char buf[Max_Buffer];
+				if (probe.Receive(buf, sizeof(buf)) > 0)
+				{
+					break;
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+		}
+
+		~LobbyRunner()
+		{
+			lobby_.Close();
+			thread_.join();
+		}
+
+		sockaddr_in Addr() const
+		{
+			return TransAddr("127.0.0.1", port_);
+		}
+
+		EchoProcessor const & Counters() const
+		{
+			return processor_;
+		}
+
+	private:
+		uint16_t port_;
+		EchoProcessor processor_;
+		Lobby lobby_;
+		std::thread thread_;
+	};
+
+	uint64_t NowInNanoseconds()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			NetEventLoop::Clock::now().time_since_epoch()).count();
+	}
+
+	// One direction of a simulated network, with loss and a random latency that reorders packets
+	class LossyLink
+	{
+	public:
+		LossyLink(uint32_t seed, double loss, uint32_t min_latency_ms = 10, uint32_t max_latency_ms = 60)
+			: gen_(seed), loss_(loss), min_latency_ms_(min_latency_ms), max_latency_ms_(max_latency_ms)
+		{
+		}
+
+		void Target(NetConnection& target)
+		{
+			target_ = &target;
+		}
+
+		void Loss(double loss)
+		{
+			loss_ = loss;
+		}
+
+		void Send(std::span<uint8_t const> packet, NetConnection::Clock::time_point now)
+		{
+			if (std::uniform_real_distribution<double>(0, 1)(gen_) < loss_)
+			{
+				return;
+			}
+
+			auto const latency = std::chrono::milliseconds(
+				std::uniform_int_distribution<uint32_t>(min_latency_ms_, max_latency_ms_)(gen_));
+			in_flight_.emplace(now + latency, std::vector<uint8_t>(packet.begin(), packet.end()));
+		}
+
+		void Deliver(NetConnection::Clock::time_point now)
+		{
+			while (!in_flight_.empty() && (in_flight_.begin()->first <= now))
+			{
+				std::vector<uint8_t> const packet = std::move(in_flight_.begin()->second);
+				in_flight_.erase(in_flight_.begin());
+				target_->OnPacket(packet, now);
+			}
+		}
+
+	private:
+		std::mt19937 gen_;
+		double loss_;
+		uint32_t min_latency_ms_;
+		uint32_t max_latency_ms_;
+		NetConnection* target_ = nullptr;
+		std::multimap<NetConnection::Clock::time_point, std::vector<uint8_t>> in_flight_;
+	};
+
+	std::vector<uint8_t> MakeMessage(uint32_t index, uint32_t size)
+	{
+		std::vector<uint8_t> msg(std::max(size, 4U));
+		std::memcpy(&msg[0], &index, sizeof(index));
+		for (uint32_t i = 4; i < msg.size(); ++ i)
+		{
+			msg[i] = static_cast<uint8_t>(index * 31 + i);
+		}
+		return msg;
+	}
+}
+
+TEST(NetTest, PlayerJoinQuit)
+{
+	LobbyRunner runner;
+
+	Player player;
+	player.Name("NetTest");
+	ASSERT_TRUE(player.Join(runner.Addr()));
+	EXPECT_EQ(runner.Counters().num_joins, 1U);
+
+	char msg[9];
+	msg[0] = MSG_ECHO;
+	uint64_t const id = 0x1234;
+	std::memcpy(&msg[1], &id, sizeof(id));
+	player.SendReliable(msg, sizeof(msg));
+
+	for (uint32_t i = 0; (i < 100) && (runner.Counters().num_echos == 0); ++ i)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	EXPECT_GE(runner.Counters().num_echos, 1U);
+
+	player.Quit();
+	for (uint32_t i = 0; (i < 100) && (runner.Counters().num_quits == 0); ++ i)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	EXPECT_EQ(runner.Counters().num_quits, 1U);
+}
+
+// Hundreds of clients on one loop keep a few echo requests each in flight against the lobby, over loopback
+TEST(NetTest, Benchmark)
+{
+	uint32_t const NUM_CLIENTS = 256;
+	uint32_t const WINDOW = 4;
+	auto const DURATION = std::chrono::seconds(2);
+	auto const STALL_TIME = std::chrono::milliseconds(100);
+
+	LobbyRunner runner;
+
+	struct Client
+	{
+		Socket socket;
+		uint32_t in_flight = 0;
+		NetEventLoop::Clock::time_point last_reply;
+	};
+
+	NetEventLoop loop;
+	std::vector<std::unique_ptr<Client>> clients(NUM_CLIENTS);
+	std::vector<uint32_t> latencies_us;
+	latencies_us.reserve(1024 * 1024);
+	uint64_t num_sent = 0;
+
+	auto send_echo = [&loop, &num_sent](Client& client)
+	{
+		char msg[9];
+		msg[0] = MSG_ECHO;
+		uint64_t const now = NowInNanoseconds();
+		std::memcpy(&msg[1], &now, sizeof(now));
+		loop.Send(client.socket, msg, sizeof(msg));
+		++ client.in_flight;
+		++ num_sent;
+	};
+
+	auto const start = NetEventLoop::Clock::now();
+	auto const end = start + DURATION;
+	for (auto& client : clients)
+	{
+		client = std::make_unique<Client>();
+		client->socket.Create(SOCK_DGRAM);
+		client->socket.Connect(runner.Addr());
+		client->last_reply = start;
+
+		Client* p = client.get();
+		loop.AddSocket(client->socket,
+			[p, &latencies_us, &send_echo, end](Socket& socket, std::span<uint8_t const> data, sockaddr_in const & from)
+			{
+				KFL_UNUSED(socket);
+				KFL_UNUSED(from);
+
+				if ((data.size() < 9) || (static_cast<char>(data[0]) != MSG_ECHO))
+				{
+					return;
+				}
+
+				uint64_t sent;
+				std::memcpy(&sent, &data[1], sizeof(sent));
+				latencies_us.push_back(static_cast<uint32_t>((NowInNanoseconds() - sent) / 1000));
+
+				p->last_reply = NetEventLoop::Clock::now();
+				if (p->in_flight > 0)
+				{
+					-- p->in_flight;
+				}
+				if (p->last_reply < end)
+				{
+					send_echo(*p);
+				}
+			});
+	}
+
+	// Fills the windows, and refills the ones whose datagrams were dropped
+	std::function<void()> refill = [&]()
+	{
+		auto const now = NetEventLoop::Clock::now();
+		for (auto& client : clients)
+		{
+			if ((client->in_flight > 0) && (now - client->last_reply > STALL_TIME))
+			{
+				client->in_flight = 0;
+			}
+			while (client->in_flight < WINDOW)
+			{
+				send_echo(*client);
+			}
+		}
+		if (now < end)
+		{
+			loop.AddTimer(std::chrono::milliseconds(20), refill);
+		}
+	};
+	loop.Post(refill);
+
+	while (NetEventLoop::Clock::now() < end + STALL_TIME)
+	{
+		loop.RunOnce(std::chrono::milliseconds(10));
+	}
+	double const seconds = std::chrono::duration<double>(NetEventLoop::Clock::now() - start).count();
+
+	for (auto& client : clients)
+	{
+		loop.RemoveSocket(client->socket);
+	}
+
+	ASSERT_FALSE(latencies_us.empty());
+	std::sort(latencies_us.begin(), latencies_us.end());
+	auto percentile = [&latencies_us](uint32_t p)
+	{
+		return latencies_us[std::min(latencies_us.size() * p / 100, latencies_us.size() - 1)];
+	};
+
+	std::cout << "NetEventLoop echo, " << NUM_CLIENTS << " clients with " << WINDOW << " in flight: "
+		<< static_cast<uint64_t>(latencies_us.size() / seconds) << " msgs/s, "
+		<< num_sent - latencies_us.size() << " of " << num_sent << " dropped, latency p50 " << percentile(50)
+		<< " us, p90 " << percentile(90) << " us, p99 " << percentile(99) << " us" << std::endl;
+
+	EXPECT_GT(latencies_us.size(), num_sent / 2);
+}
+
+TEST(NetTest, ConnectionChannelsUnderLoss)
+{
+	uint32_t const NUM_ORDERED = 300;
+	uint32_t const NUM_RELIABLE = 200;
+
+	NetConnection::Clock::time_point now;
+	LossyLink to_client(1, 0.2);
+	LossyLink to_server(2, 0.2);
+	NetConnection server([&](std::span<uint8_t const> packet) { to_client.Send(packet, now); });
+	NetConnection client([&](std::span<uint8_t const> packet) { to_server.Send(packet, now); });
+	to_client.Target(client);
+	to_server.Target(server);
+
+	for (auto* connection : { &server, &client })
+	{
+		connection->AddChannel(NetChannelType::Unreliable);
+		connection->AddChannel(NetChannelType::Reliable);
+		connection->AddChannel(NetChannelType::ReliableOrdered);
+	}
+
+	std::vector<uint32_t> ordered_received;
+	std::vector<uint32_t> reliable_counts(NUM_RELIABLE, 0);
+	uint32_t num_unreliable = 0;
+	bool corrupted = false;
+	client.OnReceive([&](uint32_t channel, std::span<uint8_t const> message)
+		{
+			uint32_t index;
+			std::memcpy(&index, message.data(), sizeof(index));
+			std::vector<uint8_t> const expected = MakeMessage(index, static_cast<uint32_t>(message.size()));
+			if (!std::equal(message.begin(), message.end(), expected.begin(), expected.end()))
+			{
+				corrupted = true;
+			}
+
+			switch (channel)
+			{
+			case 0:
+				++ num_unreliable;
+				break;
+
+			case 1:
+				++ reliable_counts[index];
+				break;
+
+			default:
+				ordered_received.push_back(index);
+				break;
+			}
+		});
+
+	// Some of the ordered messages span several fragments
+	std::mt19937 gen(3);
+	for (uint32_t i = 0; i < NUM_ORDERED; ++ i)
+	{
+		uint32_t const size = (i % 10 == 0) ? std::uniform_int_distribution<uint32_t>(2000, 20000)(gen)
+			: std::uniform_int_distribution<uint32_t>(4, 200)(gen);
+		std::vector<uint8_t> const msg = MakeMessage(i, size);
+		server.Send(2, msg.data(), static_cast<uint32_t>(msg.size()));
+	}
+	for (uint32_t i = 0; i < NUM_RELIABLE; ++ i)
+	{
+		std::vector<uint8_t> const msg = MakeMessage(i, 64);
+		server.Send(1, msg.data(), static_cast<uint32_t>(msg.size()));
+	}
+
+	for (uint32_t tick = 0; tick < 6000; ++ tick)
+	{
+		now += std::chrono::milliseconds(10);
+		to_client.Deliver(now);
+		to_server.Deliver(now);
+
+		if (tick < 500)
+		{
+			std::vector<uint8_t> const msg = MakeMessage(tick, 100);
+			server.Send(0, msg.data(), static_cast<uint32_t>(msg.size()));
+		}
+
+		server.Update(now);
+		client.Update(now);
+
+		if ((tick >= 500) && (ordered_received.size() == NUM_ORDERED) && (0 == server.NumPendingMessages()))
+		{
+			break;
+		}
+	}
+
+	EXPECT_FALSE(corrupted);
+	ASSERT_EQ(ordered_received.size(), NUM_ORDERED);
+	for (uint32_t i = 0; i < NUM_ORDERED; ++ i)
+	{
+		EXPECT_EQ(ordered_received[i], i);
+	}
+	for (uint32_t i = 0; i < NUM_RELIABLE; ++ i)
+	{
+		EXPECT_EQ(reliable_counts[i], 1U);
+	}
+	EXPECT_GT(num_unreliable, 0U);
+	EXPECT_LE(num_unreliable, 500U);
+	EXPECT_EQ(server.NumPendingMessages(), 0U);
+	EXPECT_GT(server.PacketsLost(), 0U);
+}
+
+// A round trip well above the initial resend timeout. Resends are expected, but nothing is lost.
+TEST(NetTest, ConnectionHighLatency)
+{
+	uint32_t const NUM_MESSAGES = 200;
+
+	NetConnection::Clock::time_point now;
+	LossyLink to_client(6, 0, 110, 130);
+	LossyLink to_server(7, 0, 110, 130);
+	NetConnection server([&](std::span<uint8_t const> packet) { to_client.Send(packet, now); });
+	NetConnection client([&](std::span<uint8_t const> packet) { to_server.Send(packet, now); });
+	to_client.Target(client);
+	to_server.Target(server);
+	server.AddChannel(NetChannelType::ReliableOrdered);
+	client.AddChannel(NetChannelType::ReliableOrdered);
+
+	std::vector<uint32_t> received;
+	client.OnReceive([&](uint32_t channel, std::span<uint8_t const> message)
+		{
+			KFL_UNUSED(channel);
+
+			uint32_t index;
+			std::memcpy(&index, message.data(), sizeof(index));
+			received.push_back(index);
+		});
+
+	uint32_t const initial_rate = server.SendRate();
+	for (uint32_t tick = 0; tick < 1000; ++ tick)
+	{
+		now += std::chrono::milliseconds(10);
+		to_client.Deliver(now);
+		to_server.Deliver(now);
+
+		if (tick < NUM_MESSAGES)
+		{
+			std::vector<uint8_t> const msg = MakeMessage(tick, 200);
+			server.Send(0, msg.data(), static_cast<uint32_t>(msg.size()));
+		}
+
+		server.Update(now);
+		client.Update(now);
+	}
+
+	ASSERT_EQ(received.size(), NUM_MESSAGES);
+	for (uint32_t i = 0; i < NUM_MESSAGES; ++ i)
+	{
+		EXPECT_EQ(received[i], i);
+	}
+	EXPECT_EQ(server.NumPendingMessages(), 0U);
+	EXPECT_EQ(server.PacketsLost(), 0U);
+	EXPECT_GE(server.SendRate(), initial_rate);
+	auto const rtt_ms = std::chrono::duration_cast<std::chrono::milliseconds>(server.RoundTripTime()).count();
+	EXPECT_GT(rtt_ms, 200);
+	EXPECT_LT(rtt_ms, 280);
+}
+
+TEST(NetTest, ConnectionMessageTooLarge)
+{
+	NetConnection connection([](std::span<uint8_t const> packet) { KFL_UNUSED(packet); });
+	connection.AddChannel(NetChannelType::Unreliable);
+	connection.AddChannel(NetChannelType::Reliable);
+
+	std::vector<uint8_t> const msg(NetConnection::FRAGMENT_SIZE * NetConnection::MAX_FRAGMENTS + 1);
+	for (uint32_t channel = 0; channel < 2; ++ channel)
+	{
+		EXPECT_THROW(connection.Send(channel, msg.data(), static_cast<uint32_t>(msg.size())), std::system_error);
+		EXPECT_NO_THROW(connection.Send(channel, msg.data(), static_cast<uint32_t>(msg.size() - 1)));
+	}
+}
+
+// A peer starting many large messages at once can't make the receiver hold more than MAX_REASSEMBLY_SIZE
+TEST(NetTest, ConnectionReassemblyLimit)
+{
+	uint16_t last_ack = 0;
+	NetConnection connection([&last_ack](std::span<uint8_t const> packet)
+		{
+			std::memcpy(&last_ack, &packet[3], sizeof(last_ack));
+		});
+	uint32_t const channel = connection.AddChannel(NetChannelType::Reliable);
+	uint32_t num_received = 0;
+	connection.OnReceive([&num_received](uint32_t ch, std::span<uint8_t const> message)
+		{
+			KFL_UNUSED(ch);
+			EXPECT_EQ(message.size(), NetConnection::FRAGMENT_SIZE * NetConnection::MAX_FRAGMENTS);
+			++ num_received;
+		});
+
+	NetConnection::Clock::time_point now;
+	uint16_t sequence = 0;
+	std::vector<uint8_t> packet(9 + 7 + NetConnection::FRAGMENT_SIZE);
+	auto receive = [&](uint16_t id, uint8_t fragment)
+	{
+		++ sequence;
+		packet[0] = MSG_CONNECTION;
+		std::memcpy(&packet[1], &sequence, sizeof(sequence));
+		std::memset(&packet[3], 0, 6);
+		packet[9] = static_cast<uint8_t>(channel | 0x80);
+		std::memcpy(&packet[10], &id, sizeof(id));
+		uint16_t const size = NetConnection::FRAGMENT_SIZE;
+		std::memcpy(&packet[12], &size, sizeof(size));
+		packet[14] = fragment;
+		packet[15] = static_cast<uint8_t>(NetConnection::MAX_FRAGMENTS - 1);
+		connection.OnPacket(packet, now);
+
+		now += std::chrono::milliseconds(1);
+		connection.Update(now);
+	};
+
+	uint32_t const message_size = NetConnection::FRAGMENT_SIZE * NetConnection::MAX_FRAGMENTS;
+	uint32_t const max_messages = NetConnection::MAX_REASSEMBLY_SIZE / message_size;
+	for (uint16_t id = 0; id < 100; ++ id)
+	{
+		receive(id, 0);
+	}
+	EXPECT_EQ(last_ack, max_messages);
+
+	// Messages already started can always complete, which makes room for the next one
+	for (uint32_t fragment = 1; fragment < NetConnection::MAX_FRAGMENTS; ++ fragment)
+	{
+		receive(0, static_cast<uint8_t>(fragment));
+		EXPECT_EQ(last_ack, sequence);
+	}
+	EXPECT_EQ(num_received, 1U);
+
+	receive(static_cast<uint16_t>(max_messages), 0);
+	EXPECT_EQ(last_ack, sequence);
+	receive(static_cast<uint16_t>(max_messages + 1), 0);
+	EXPECT_NE(last_ack, sequence);
+}
+
+TEST(NetTest, SnapshotMalformed)
+{
+	// A full snapshot with one entity whose size wraps around when added to the offset
+	std::vector<uint8_t> const data = { 1, 0, 0, 1, 0, 0xF8, 0xFF, 0xFF, 0xFF, 0x0F, 0, 1, 2, 3 };
+	NetSnapshotDecoder decoder;
+	NetSnapshot snapshot;
+	EXPECT_FALSE(decoder.Decode(data, snapshot));
+}
+
+TEST(NetTest, SnapshotDelta)
+{
+	uint32_t const NUM_ENTITIES = 100;
+	uint32_t const STATE_SIZE = 32;
+
+	NetSnapshot::EntityMap entities;
+	for (uint32_t i = 0; i < NUM_ENTITIES; ++ i)
+	{
+		entities[i * 3] = MakeMessage(i, STATE_SIZE);
+	}
+
+	NetSnapshotEncoder encoder;
+	NetSnapshotDecoder decoder;
+
+	std::vector<uint8_t> full;
+	uint16_t const first = encoder.Encode(entities, full);
+	NetSnapshot snapshot;
+	ASSERT_TRUE(decoder.Decode(full, snapshot));
+	EXPECT_EQ(snapshot.sequence, first);
+	EXPECT_TRUE(snapshot.entities == entities);
+	encoder.Ack(first);
+
+	// A few entities move, one goes away and one appears
+	for (uint32_t i = 0; i < 5; ++ i)
+	{
+		entities[i * 30][8] ^= 0x5A;
+		entities[i * 30][9] += 1;
+	}
+	entities.erase(3);
+	entities[1000] = MakeMessage(1000, STATE_SIZE);
+
+	std::vector<uint8_t> delta;
+	encoder.Encode(entities, delta);
+	EXPECT_LT(delta.size() * 10, full.size());
+	ASSERT_TRUE(decoder.Decode(delta, snapshot));
+	EXPECT_TRUE(snapshot.entities == entities);
+
+	// Stale, and based on a snapshot this decoder never saw
+	EXPECT_FALSE(decoder.Decode(full, snapshot));
+	NetSnapshotDecoder other_decoder;
+	EXPECT_FALSE(other_decoder.Decode(delta, snapshot));
+
+	// Snapshots lost on the way don't matter, the baseline is the acknowledged one
+	std::vector<uint8_t> lost;
+	encoder.Encode(entities, lost);
+	entities[0][0] ^= 0xFF;
+	std::vector<uint8_t> next;
+	encoder.Encode(entities, next);
+	ASSERT_TRUE(decoder.Decode(next, snapshot));
+	EXPECT_TRUE(snapshot.entities == entities);
+}
+
+// Snapshots on an unreliable channel, acknowledged through the connection. The full ones span several fragments.
+TEST(NetTest, SnapshotOverConnection)
+{
+	uint32_t const NUM_ENTITIES = 100;
+	uint32_t const STATE_SIZE = 32;
+
+	NetConnection::Clock::time_point now;
+	LossyLink to_client(4, 0.1);
+	LossyLink to_server(5, 0.1);
+	NetConnection server([&](std::span<uint8_t const> packet) { to_client.Send(packet, now); });
+	NetConnection client([&](std::span<uint8_t const> packet) { to_server.Send(packet, now); });
+	to_client.Target(client);
+	to_server.Target(server);
+	server.AddChannel(NetChannelType::Unreliable);
+	client.AddChannel(NetChannelType::Unreliable);
+
+	NetSnapshotEncoder encoder;
+	std::map<uint16_t, uint16_t> message_snapshots;
+	server.OnAck([&](uint32_t channel, uint16_t id)
+		{
+			KFL_UNUSED(channel);
+
+			auto iter = message_snapshots.find(id);
+			if (iter != message_snapshots.end())
+			{
+				encoder.Ack(iter->second);
+				message_snapshots.erase(iter);
+			}
+		});
+
+	NetSnapshotDecoder decoder;
+	NetSnapshot latest;
+	client.OnReceive([&](uint32_t channel, std::span<uint8_t const> message)
+		{
+			KFL_UNUSED(channel);
+
+			NetSnapshot snapshot;
+			if (decoder.Decode(message, snapshot))
+			{
+				latest = std::move(snapshot);
+			}
+		});
+
+	NetSnapshot::EntityMap entities;
+	for (uint32_t i = 0; i < NUM_ENTITIES; ++ i)
+	{
+		entities[i] = MakeMessage(i, STATE_SIZE);
+	}
+
+	uint64_t total_size = 0;
+	uint32_t const NUM_TICKS = 300;
+	std::vector<uint8_t> data;
+	for (uint32_t tick = 0; tick < NUM_TICKS; ++ tick)
+	{
+		now += std::chrono::milliseconds(16);
+		to_client.Deliver(now);
+		to_server.Deliver(now);
+
+		entities[tick % NUM_ENTITIES][4] += 1;
+		uint16_t const sequence = encoder.Encode(entities, data);
+		total_size += data.size();
+		message_snapshots[server.Send(0, data.data(), static_cast<uint32_t>(data.size()))] = sequence;
+
+		server.Update(now);
+		client.Update(now);
+	}
+
+	// The last one gets through
+	to_client.Loss(0);
+	to_server.Loss(0);
+	server.Send(0, data.data(), static_cast<uint32_t>(data.size()));
+	for (uint32_t tick = 0; tick < 20; ++ tick)
+	{
+		now += std::chrono::milliseconds(16);
+		to_client.Deliver(now);
+		to_server.Deliver(now);
+		server.Update(now);
+		client.Update(now);
+	}
+
+	EXPECT_TRUE(latest.entities == entities);
+	EXPECT_LT(total_size, NUM_TICKS * NUM_ENTITIES * STATE_SIZE / 4);
+}
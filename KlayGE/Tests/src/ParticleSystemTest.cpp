@@ -0,0 +1,96 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KlayGE/ParticleSystem.hpp>
+
+#include <random>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	ParticleStorage MakeParticles(uint32_t num_particles)
+	{
+		std::mt19937 gen(0);
+		std::uniform_real_distribution<float> pos_dist(-10, 10);
+		std::uniform_real_distribution<float> life_dist(-1, 4);
+
+		ParticleStorage particles;
+		particles.Resize(num_particles);
+		for (uint32_t i = 0; i < num_particles; ++ i)
+		{
+			Particle par;
+			par.pos = float3(pos_dist(gen), pos_dist(gen), pos_dist(gen));
+			par.vel = float3(pos_dist(gen), pos_dist(gen), pos_dist(gen));
+			par.init_life = 4;
+			// Some of them are dead
+			par.life = life_dist(gen);
+			par.spin = pos_dist(gen);
+			par.size = 1;
+			par.alpha = 1;
+			particles.Set(i, par);
+		}
+		return particles;
+	}
+
+	void ExpectParticleEq(Particle const & lhs, Particle const & rhs)
+	{
+		EXPECT_EQ(lhs.pos.x(), rhs.pos.x());
+		EXPECT_EQ(lhs.pos.y(), rhs.pos.y());
+		EXPECT_EQ(lhs.pos.z(), rhs.pos.z());
+		EXPECT_EQ(lhs.vel.x(), rhs.vel.x());
+		EXPECT_EQ(lhs.vel.y(), rhs.vel.y());
+		EXPECT_EQ(lhs.vel.z(), rhs.vel.z());
+		EXPECT_EQ(lhs.life, rhs.life);
+		EXPECT_EQ(lhs.spin, rhs.spin);
+		EXPECT_EQ(lhs.size, rhs.size);
+		EXPECT_EQ(lhs.alpha, rhs.alpha);
+		EXPECT_EQ(lhs.init_life, rhs.init_life);
+	}
+}
+
+TEST(ParticleSystemTest, PolylineBatchUpdate)
+{
+	auto ps = MakeSharedPtr<ParticleSystem>(16);
+	ps->Force(float3(0.3f, -0.2f, 0.1f));
+	ps->MediaDensity(0.8f);
+
+	auto updater = checked_pointer_cast<PolylineParticleUpdater>(ps->MakeUpdater("polyline"));
+	updater->SizeOverLife({float2(0, 0.5f), float2(0.3f, 1.2f), float2(0.7f, 0.9f), float2(1, 0.1f)});
+	updater->MassOverLife({float2(0, 1), float2(1, 2)});
+	// Starts after 0, particles before the first point extrapolate from the first segment
+	updater->OpacityOverLife({float2(0.2f, 1), float2(0.5f, 0.5f), float2(0.9f, 0)});
+	updater->SnapParams();
+
+	// Not a multiple of any SIMD width
+	uint32_t const num_particles = 1003;
+	float const elapse_time = 0.016f;
+
+	ParticleStorage particles = MakeParticles(num_particles);
+	std::vector<Particle> expected(num_particles);
+	for (uint32_t i = 0; i < num_particles; ++ i)
+	{
+		expected[i] = particles.Get(i);
+	}
+
+	// A range that starts and ends off the SIMD width, the particles outside of it must stay
+	uint32_t const begin = 5;
+	uint32_t const end = num_particles - 6;
+	for (uint32_t i = begin; i < end; ++ i)
+	{
+		if (expected[i].life > 0)
+		{
+			updater->Update(expected[i], elapse_time);
+		}
+	}
+
+	updater->Update(particles, begin, end, elapse_time);
+
+	for (uint32_t i = 0; i < num_particles; ++ i)
+	{
+		ExpectParticleEq(particles.Get(i), expected[i]);
+	}
+}
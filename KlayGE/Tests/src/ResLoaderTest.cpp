@@ -1,6 +1,15 @@
 #include <KlayGE/KlayGE.hpp>
+#include <KFL/Hash.hpp>
+#include <KlayGE/Package.hpp>
 #include <KlayGE/ResLoader.hpp>
 
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
 #include "KlayGETests.hpp"
 
 using namespace KlayGE;
@@ -95,3 +104,266 @@ TEST(ResLoaderTest, MountUnmountInsideEncrypt7zPath)
 	ResLoader::Instance().Unmount("ResLoaderTestData", "../../Tests/media/ResLoader/TestPassword.7z|1234/ResLoader");
 	EXPECT_TRUE(ResLoader::Instance().Locate("ResLoaderTestData/Test.txt").empty());
 }
+
+TEST(ResLoaderTest, ConcurrentExtract7z)
+{
+	std::string const package_path = "../../Tests/media/ResLoader/Test.7z";
+	auto package_res = MakeSharedPtr<ResIdentifier>(package_path, 0,
+		MakeSharedPtr<std::ifstream>(package_path.c_str(), std::ios_base::binary));
+	Package package(package_res);
+
+	EXPECT_TRUE(package.Locate("Test.txt"));
+	EXPECT_TRUE(package.Locate("TEST.TXT"));
+	EXPECT_FALSE(package.Locate("NotExist.txt"));
+
+	// The first round decodes, the others come from the cache
+	std::atomic<uint32_t> num_matches(0);
+	std::vector<std::thread> threads;
+	for (uint32_t t = 0; t < 4; ++ t)
+	{
+		threads.emplace_back([&package, &num_matches, t]
+			{
+				for (uint32_t i = 0; i < 16; ++ i)
+				{
+					auto res = package.Extract(((i + t) & 1) ? "test.txt" : "Test.txt", "Test.txt");
+					if (res && (ReadWholeFile(res) == sanity_string))
+					{
+						++ num_matches;
+					}
+				}
+			});
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	EXPECT_EQ(num_matches, 4U * 16);
+
+	package.CacheBudget(0);
+	auto res = package.Extract("Test.txt", "Test.txt");
+	EXPECT_TRUE(res);
+	EXPECT_EQ(ReadWholeFile(res), sanity_string);
+}
+
+TEST(ResLoaderTest, NativePackage)
+{
+	std::string const package_path = "ResLoaderTest.kpk";
+
+	std::vector<uint8_t> large_data(300000);
+	for (size_t i = 0; i < large_data.size(); ++ i)
+	{
+		large_data[i] = static_cast<uint8_t>((i * 7) ^ (i >> 5));
+	}
+	{
+		std::ofstream ofs(package_path.c_str(), std::ios_base::binary);
+		PackageWriter writer(ofs);
+		auto const sanity_data = MakeSpan(reinterpret_cast<uint8_t const *>(sanity_string.data()), sanity_string.size());
+		writer.AddFile("ResLoader/Test.txt", sanity_data, 1, PackageWriter::Codec::Stored);
+		writer.AddFile("ResLoader\\Large.bin", large_data, 2, PackageWriter::Codec::LZMA);
+		writer.AddFile("Empty.bin", std::span<uint8_t const>(), 3);
+		writer.Finish();
+	}
+
+	{
+		auto package_res = ResLoader::Instance().Open(package_path);
+		EXPECT_TRUE(package_res->Contiguous());
+		Package package(package_res);
+
+		EXPECT_TRUE(package.Locate("resloader/test.txt"));
+		EXPECT_TRUE(package.Locate("ResLoader/Large.bin"));
+		EXPECT_FALSE(package.Locate("Test.txt"));
+
+		auto const view = package.MappedView("ResLoader/Test.txt");
+		EXPECT_EQ(std::string(reinterpret_cast<char const *>(view.data()), view.size()), sanity_string);
+		EXPECT_TRUE(package.MappedView("ResLoader/Large.bin").empty());
+
+		auto res = package.Extract("ResLoader/Test.txt", "Test.txt");
+		EXPECT_TRUE(res);
+		EXPECT_EQ(ReadWholeFile(res), sanity_string);
+		EXPECT_EQ(res->Timestamp(), 1U);
+
+		res = package.Extract("ResLoader/Large.bin", "Large.bin");
+		EXPECT_TRUE(res);
+		std::string const large_str = ReadWholeFile(res);
+		EXPECT_TRUE((large_str.size() == large_data.size()) && (std::memcmp(large_str.data(), large_data.data(), large_data.size()) == 0));
+
+		res = package.Extract("Empty.bin", "Empty.bin");
+		EXPECT_TRUE(res);
+		EXPECT_TRUE(ReadWholeFile(res).empty());
+	}
+
+	ResLoader::Instance().Mount("ResLoaderTestData", package_path + "/ResLoader");
+	auto res = ResLoader::Instance().Open("ResLoaderTestData/Test.txt");
+	EXPECT_TRUE(res);
+	EXPECT_EQ(ReadWholeFile(res), sanity_string);
+	ResLoader::Instance().Unmount("ResLoaderTestData", package_path + "/ResLoader");
+}
+
+TEST(ResLoaderTest, CorruptedNativePackage)
+{
+	std::ostringstream oss;
+	{
+		PackageWriter writer(oss);
+		auto const sanity_data = MakeSpan(reinterpret_cast<uint8_t const *>(sanity_string.data()), sanity_string.size());
+		writer.AddFile("ResLoader/Test.txt", sanity_data, 1, PackageWriter::Codec::Stored);
+		writer.Finish();
+	}
+	std::string const package = oss.str();
+
+	uint64_t toc_offset;
+	std::memcpy(&toc_offset, &package[16], sizeof(toc_offset));
+
+	auto open_patched = [&package](size_t offset, uint64_t value, size_t size)
+	{
+		std::string patched = package;
+		std::memcpy(&patched[offset], &value, size);
+		auto res = MakeSharedPtr<ResIdentifier>("Corrupted.kpk", 0, MakeSharedPtr<std::istringstream>(patched));
+		Package open(res);
+	};
+
+	EXPECT_NO_THROW(open_patched(0, package[0], 1));
+	// Header: num_entries, paths_size, toc_offset
+	EXPECT_ANY_THROW(open_patched(8, 0x10000000, 4));
+	EXPECT_ANY_THROW(open_patched(12, 0xFFFFFFFF, 4));
+	EXPECT_ANY_THROW(open_patched(16, package.size() + 1, 8));
+	EXPECT_ANY_THROW(open_patched(16, 0, 8));
+	// Entry: offset, size, path_offset, path_size
+	EXPECT_ANY_THROW(open_patched(static_cast<size_t>(toc_offset) + 0, toc_offset, 8));
+	EXPECT_ANY_THROW(open_patched(static_cast<size_t>(toc_offset) + 8, toc_offset, 8));
+	EXPECT_ANY_THROW(open_patched(static_cast<size_t>(toc_offset) + 32, 1, 4));
+	EXPECT_ANY_THROW(open_patched(static_cast<size_t>(toc_offset) + 36, 0xFFFF, 2));
+}
+
+TEST(ResLoaderTest, ContiguousResource)
+{
+	ResLoader::Instance().Mount("ResLoaderTestData", "../../Tests/media/ResLoader");
+	auto res = ResLoader::Instance().Open("ResLoaderTestData/Test.txt");
+	ResLoader::Instance().Unmount("ResLoaderTestData", "../../Tests/media/ResLoader");
+	EXPECT_TRUE(res);
+	EXPECT_TRUE(res->Contiguous());
+
+	auto const data = res->Data();
+	EXPECT_EQ(std::string(reinterpret_cast<char const *>(data.data()), data.size()), sanity_string);
+
+	char buff[8];
+	res->seekg(5, std::ios_base::beg);
+	res->read(buff, 2);
+	EXPECT_EQ(res->gcount(), 2);
+	EXPECT_EQ(std::string(buff, 2), "is");
+	EXPECT_EQ(res->tellg(), 7);
+
+	res->seekg(-3, std::ios_base::end);
+	res->read(buff, sizeof(buff));
+	EXPECT_EQ(res->gcount(), 3);
+	EXPECT_FALSE(*res);
+	res->clear();
+	EXPECT_TRUE(*res);
+
+	// A stream backed resource turns into a contiguous one, and keeps its position
+	auto stream_res = MakeSharedPtr<ResIdentifier>("Test.txt", 0, MakeSharedPtr<std::istringstream>(sanity_string));
+	EXPECT_FALSE(stream_res->Contiguous());
+	stream_res->seekg(10, std::ios_base::beg);
+	EXPECT_EQ(stream_res->Data().size(), static_cast<std::ptrdiff_t>(sanity_string.size()));
+	EXPECT_TRUE(stream_res->Contiguous());
+	EXPECT_EQ(stream_res->tellg(), 10);
+	EXPECT_EQ(ReadWholeFile(stream_res), sanity_string);
+}
+
+class TestLoadingDesc : public ResLoadingDesc
+{
+public:
+	TestLoadingDesc(std::string_view name, uint32_t flag)
+		: name_(name), flag_(flag)
+	{
+	}
+
+	uint64_t Type() const override
+	{
+		static uint64_t const type = CT_HASH("TestLoadingDesc");
+		return type;
+	}
+
+	bool StateLess() const override
+	{
+		return true;
+	}
+
+	void SubThreadStage() override
+	{
+	}
+
+	void MainThreadStage() override
+	{
+		res_ = MakeSharedPtr<std::string>(name_);
+	}
+
+	bool HasSubThreadStage() const override
+	{
+		return false;
+	}
+
+	uint64_t Key() const override
+	{
+		size_t seed = static_cast<size_t>(this->Type());
+		HashRange(seed, name_.begin(), name_.end());
+		HashCombine(seed, flag_);
+		return seed;
+	}
+
+	bool Match(ResLoadingDesc const & rhs) const override
+	{
+		if (this->Type() == rhs.Type())
+		{
+			TestLoadingDesc const & tld = static_cast<TestLoadingDesc const &>(rhs);
+			return (name_ == tld.name_) && (flag_ == tld.flag_);
+		}
+		return false;
+	}
+
+	void CopyDataFrom(ResLoadingDesc const & rhs) override
+	{
+		TestLoadingDesc const & tld = static_cast<TestLoadingDesc const &>(rhs);
+		name_ = tld.name_;
+		flag_ = tld.flag_;
+		res_ = tld.res_;
+	}
+
+	std::shared_ptr<void> CloneResourceFrom(std::shared_ptr<void> const & resource) override
+	{
+		return resource;
+	}
+
+	std::shared_ptr<void> Resource() const override
+	{
+		return res_;
+	}
+
+private:
+	std::string name_;
+	uint32_t flag_;
+	std::shared_ptr<std::string> res_;
+};
+
+TEST(ResLoaderTest, QueryLoadedResource)
+{
+	uint32_t const num_loaded = ResLoader::Instance().NumLoadedResources();
+
+	auto res0 = ResLoader::Instance().SyncQueryT<std::string>(MakeSharedPtr<TestLoadingDesc>("ResLoaderTestRes", 0));
+	auto res1 = ResLoader::Instance().SyncQueryT<std::string>(MakeSharedPtr<TestLoadingDesc>("ResLoaderTestRes", 0));
+	auto res2 = ResLoader::Instance().SyncQueryT<std::string>(MakeSharedPtr<TestLoadingDesc>("ResLoaderTestRes", 1));
+	EXPECT_EQ(res0, res1);
+	EXPECT_NE(res0, res2);
+	EXPECT_EQ(*res0, "ResLoaderTestRes");
+	EXPECT_EQ(ResLoader::Instance().NumLoadedResources(), num_loaded + 2);
+
+	res0.reset();
+	res1.reset();
+	res2.reset();
+
+	// Unreferenced resources are evicted lazily, one shard per Update()
+	for (uint32_t i = 0; i < 64; ++ i)
+	{
+		ResLoader::Instance().Update();
+	}
+	EXPECT_LE(ResLoader::Instance().NumLoadedResources(), num_loaded);
+}
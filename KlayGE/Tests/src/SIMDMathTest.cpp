@@ -1,12 +1,14 @@
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/Math.hpp>
 #include <KFL/SIMDMath.hpp>
+#include <KFL/Timer.hpp>
 
 #include "KlayGETests.hpp"
 
 #include <vector>
 #include <string>
 #include <iostream>
+#include <random>
 
 using namespace std;
 using namespace KlayGE;
@@ -31,3 +33,178 @@ TEST(SIMDMathTest, NormalizeVector4)
 	v = SIMDMathLib::NormalizeVector4(v);
 	EXPECT_LT(MathLib::abs(SIMDMathLib::GetX(SIMDMathLib::LengthVector4(v)) - 1.0f), 1e-3f);
 }
+
+namespace
+{
+	float4x4 RandomMatrix(std::ranlux24_base& gen)
+	{
+		std::uniform_real_distribution<float> dis(-2, 2);
+		float4x4 ret;
+		for (size_t i = 0; i < ret.size(); ++ i)
+		{
+			ret[i] = dis(gen);
+		}
+		return ret;
+	}
+
+	float4 RandomVector(std::ranlux24_base& gen)
+	{
+		std::uniform_real_distribution<float> dis(-2, 2);
+		return float4(dis(gen), dis(gen), dis(gen), dis(gen));
+	}
+
+	SIMDMatrixF4 ToSIMD(float4x4 const & mat)
+	{
+		return SIMDMatrixF4(mat(0, 0), mat(0, 1), mat(0, 2), mat(0, 3),
+			mat(1, 0), mat(1, 1), mat(1, 2), mat(1, 3),
+			mat(2, 0), mat(2, 1), mat(2, 2), mat(2, 3),
+			mat(3, 0), mat(3, 1), mat(3, 2), mat(3, 3));
+	}
+
+	SIMDVectorF4 ToSIMD(float4 const & v)
+	{
+		return SIMDMathLib::SetVector(v.x(), v.y(), v.z(), v.w());
+	}
+
+	void ExpectNear(SIMDVectorF4 const & simd, float4 const & scalar, float tolerance, size_t num_components = 4)
+	{
+		for (size_t i = 0; i < num_components; ++ i)
+		{
+			EXPECT_NEAR(SIMDMathLib::GetByIndex(simd, i), scalar[i], tolerance);
+		}
+	}
+
+	// Runs op over the inputs several times, and returns the nanoseconds per call.
+	template <typename T, typename Op>
+	double NanosecondsPerOp(std::vector<T> const & inputs, uint32_t num_passes, Op const & op)
+	{
+		Timer timer;
+		for (uint32_t pass = 0; pass < num_passes; ++ pass)
+		{
+			for (size_t i = 0; i < inputs.size(); ++ i)
+			{
+				op(inputs[i], i);
+			}
+		}
+		return timer.elapsed() * 1e9 / (static_cast<double>(inputs.size()) * num_passes);
+	}
+}
+
+TEST(SIMDMathTest, MatchesScalar)
+{
+	std::ranlux24_base gen;
+	for (uint32_t i = 0; i < 64; ++ i)
+	{
+		float4x4 const a = RandomMatrix(gen);
+		float4x4 const b = RandomMatrix(gen);
+		float4 const v = RandomVector(gen);
+		float4 const u = RandomVector(gen);
+
+		SIMDMatrixF4 const simd_a = ToSIMD(a);
+		SIMDMatrixF4 const simd_b = ToSIMD(b);
+		SIMDVectorF4 const simd_v = ToSIMD(v);
+		SIMDVectorF4 const simd_u = ToSIMD(u);
+
+		float4x4 const ab = MathLib::mul(a, b);
+		SIMDMatrixF4 const simd_ab = SIMDMathLib::Multiply(simd_a, simd_b);
+		float4x4 const at = MathLib::transpose(a);
+		SIMDMatrixF4 const simd_at = SIMDMathLib::Transpose(simd_a);
+		for (size_t r = 0; r < 4; ++ r)
+		{
+			ExpectNear(simd_ab.Row(r), ab.Row(r), 1e-4f);
+			ExpectNear(simd_at.Row(r), at.Row(r), 0);
+		}
+
+		ExpectNear(SIMDMathLib::TransformVector4(simd_v, simd_a), MathLib::transform(v, a), 1e-5f);
+
+		float3 const v3(v.x(), v.y(), v.z());
+		float3 const u3(u.x(), u.y(), u.z());
+		float3 const normal = MathLib::transform_normal(v3, a);
+		ExpectNear(SIMDMathLib::TransformNormalVector3(simd_v, simd_a), float4(normal.x(), normal.y(), normal.z(), 0), 1e-5f, 3);
+		float3 const cross = MathLib::cross(v3, u3);
+		ExpectNear(SIMDMathLib::CrossVector3(simd_v, simd_u), float4(cross.x(), cross.y(), cross.z(), 0), 1e-5f);
+		EXPECT_NEAR(SIMDMathLib::GetX(SIMDMathLib::DotVector3(simd_v, simd_u)), MathLib::dot(v3, u3), 1e-5f);
+		EXPECT_NEAR(SIMDMathLib::GetX(SIMDMathLib::DotVector4(simd_v, simd_u)), MathLib::dot(v, u), 1e-5f);
+
+		Quaternion const p = MathLib::normalize(Quaternion(v.x(), v.y(), v.z(), v.w()));
+		Quaternion const q = MathLib::normalize(Quaternion(u.x(), u.y(), u.z(), u.w()));
+		Quaternion const pq = MathLib::mul(p, q);
+		ExpectNear(SIMDMathLib::MultiplyQuat(ToSIMD(float4(&p[0])), ToSIMD(float4(&q[0]))), float4(&pq[0]), 1e-5f);
+	}
+}
+
+// Not a pass/fail test. Prints the cost of the hot SIMD ops next to the scalar MathLib ones, to catch a regression to
+//  out-of-line calls.
+TEST(SIMDMathTest, Benchmark)
+{
+	uint32_t const NUM_INPUTS = 1024;
+	uint32_t const NUM_PASSES = 1000;
+
+	std::ranlux24_base gen;
+	std::vector<float4x4> mats(NUM_INPUTS);
+	std::vector<float4> vecs(NUM_INPUTS);
+	std::vector<SIMDMatrixF4> simd_mats(NUM_INPUTS);
+	std::vector<SIMDVectorF4> simd_vecs(NUM_INPUTS);
+	for (uint32_t i = 0; i < NUM_INPUTS; ++ i)
+	{
+		mats[i] = RandomMatrix(gen);
+		vecs[i] = RandomVector(gen);
+		simd_mats[i] = ToSIMD(mats[i]);
+		simd_vecs[i] = ToSIMD(vecs[i]);
+	}
+
+	float4x4 mat_acc = float4x4::Identity();
+	SIMDMatrixF4 simd_mat_acc = SIMDMatrixF4::Identity();
+	double const scalar_mul = NanosecondsPerOp(mats, NUM_PASSES,
+		[&mat_acc](float4x4 const & mat, size_t i)
+		{
+			mat_acc = MathLib::mul(mat_acc, mat);
+			if ((i & 15) == 0)
+			{
+				mat_acc = float4x4::Identity();
+			}
+		});
+	double const simd_mul = NanosecondsPerOp(simd_mats, NUM_PASSES,
+		[&simd_mat_acc](SIMDMatrixF4 const & mat, size_t i)
+		{
+			simd_mat_acc = SIMDMathLib::Multiply(simd_mat_acc, mat);
+			if ((i & 15) == 0)
+			{
+				simd_mat_acc = SIMDMatrixF4::Identity();
+			}
+		});
+
+	float4 vec_acc(0, 0, 0, 0);
+	SIMDVectorF4 simd_vec_acc = SIMDVectorF4::Zero();
+	double const scalar_transform = NanosecondsPerOp(vecs, NUM_PASSES,
+		[&vec_acc, &mats](float4 const & v, size_t i)
+		{
+			vec_acc += MathLib::transform(v, mats[i]);
+		});
+	double const simd_transform = NanosecondsPerOp(simd_vecs, NUM_PASSES,
+		[&simd_vec_acc, &simd_mats](SIMDVectorF4 const & v, size_t i)
+		{
+			simd_vec_acc += SIMDMathLib::TransformVector4(v, simd_mats[i]);
+		});
+
+	double const scalar_normalize = NanosecondsPerOp(vecs, NUM_PASSES,
+		[&vec_acc](float4 const & v, size_t i)
+		{
+			KFL_UNUSED(i);
+			vec_acc += MathLib::normalize(v);
+		});
+	double const simd_normalize = NanosecondsPerOp(simd_vecs, NUM_PASSES,
+		[&simd_vec_acc](SIMDVectorF4 const & v, size_t i)
+		{
+			KFL_UNUSED(i);
+			simd_vec_acc += SIMDMathLib::NormalizeVector4(v);
+		});
+
+	// Keeps the results alive
+	EXPECT_FALSE(std::isnan(mat_acc(0, 0) + vec_acc.x()));
+	EXPECT_FALSE(std::isnan(simd_mat_acc(0, 0) + SIMDMathLib::GetX(simd_vec_acc)));
+
+	cout << "float4x4 multiply: scalar " << scalar_mul << " ns/op, SIMD " << simd_mul << " ns/op" << endl;
+	cout << "float4 transform: scalar " << scalar_transform << " ns/op, SIMD " << simd_transform << " ns/op" << endl;
+	cout << "float4 normalize: scalar " << scalar_normalize << " ns/op, SIMD " << simd_normalize << " ns/op" << endl;
+}
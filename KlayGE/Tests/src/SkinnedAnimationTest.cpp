@@ -0,0 +1,274 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KlayGE/Mesh.hpp>
+
+#include <random>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+// A looping clip. Every joint swings around an axis and back, moving a bit along the way.
+std::vector<KeyFrameSet> MakeKeyFrameSets(uint32_t num_joints, uint32_t num_keys)
+{
+	std::mt19937 gen(0);
+	std::uniform_real_distribution<float> dist(-1, 1);
+
+	std::vector<KeyFrameSet> kfs(num_joints);
+	for (uint32_t j = 0; j < num_joints; ++ j)
+	{
+		float3 const axis = MathLib::normalize(float3(dist(gen), dist(gen), dist(gen)) + float3(0, 0, 2));
+		float3 const offset(dist(gen), dist(gen), dist(gen));
+		float const amplitude = dist(gen);
+
+		uint32_t const keys = (j % 5 == 0) ? 1 : num_keys;
+		for (uint32_t k = 0; k < keys; ++ k)
+		{
+			float const phase = MathLib::sin(2 * PI * k / num_keys);
+			Quaternion const real = MathLib::rotation_axis(axis, amplitude * phase + j);
+			Quaternion const dual = MathLib::quat_trans_to_udq(real, offset * phase);
+
+			kfs[j].frame_id.push_back(k * 2);
+			kfs[j].bind_real.push_back(real);
+			kfs[j].bind_dual.push_back(dual);
+			kfs[j].bind_scale.push_back(1 + 0.01f * k);
+		}
+	}
+
+	return kfs;
+}
+
+TEST(SkinnedAnimationTest, SampleKeyFrameSets)
+{
+	uint32_t const NUM_JOINTS = 37;
+	uint32_t const NUM_KEYS = 16;
+	auto const kfs = MakeKeyFrameSets(NUM_JOINTS, NUM_KEYS);
+
+	std::vector<uint32_t> cursors(NUM_JOINTS, 0);
+	std::vector<Quaternion> reals(NUM_JOINTS);
+	std::vector<Quaternion> duals(NUM_JOINTS);
+	std::vector<float> scales(NUM_JOINTS);
+
+	// Forward playback over a loop and a half, then a jump back, so the cursors go through every search path
+	std::vector<float> frames;
+	for (float frame = 0; frame < NUM_KEYS * 3; frame += 0.3f)
+	{
+		frames.push_back(frame);
+	}
+	frames.push_back(5.5f);
+	frames.push_back(1.25f);
+
+	for (float const frame : frames)
+	{
+		SampleKeyFrameSets(MakeSpan(kfs), frame, MakeSpan(cursors), MakeSpan(reals), MakeSpan(duals), MakeSpan(scales));
+
+		for (uint32_t j = 0; j < NUM_JOINTS; ++ j)
+		{
+			auto const expected = kfs[j].Frame(frame);
+			Quaternion expected_real = std::get<0>(expected);
+			Quaternion expected_dual = std::get<1>(expected);
+			if (MathLib::dot(expected_real, reals[j]) < 0)
+			{
+				expected_real = -expected_real;
+				expected_dual = -expected_dual;
+			}
+
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				EXPECT_NEAR(reals[j][c], expected_real[c], 2e-3f);
+				EXPECT_NEAR(duals[j][c], expected_dual[c], 2e-2f);
+			}
+			EXPECT_NEAR(scales[j], std::get<2>(expected), 1e-5f);
+			EXPECT_NEAR(MathLib::dot(reals[j], duals[j]), 0, 1e-4f);
+		}
+	}
+}
+
+TEST(SkinnedAnimationTest, FindKeys)
+{
+	auto const kfs = MakeKeyFrameSets(1, 8);
+	KeyFrameSet const & kf = kfs[0];
+
+	uint32_t cursor = 5;
+	for (float frame = 0; frame < 32; frame += 0.7f)
+	{
+		auto const keys = kf.FindKeys(frame, cursor);
+
+		uint32_t fresh_cursor = 0;
+		auto const expected = kf.FindKeys(frame, fresh_cursor);
+		EXPECT_EQ(std::get<0>(keys), std::get<0>(expected));
+		EXPECT_EQ(std::get<1>(keys), std::get<1>(expected));
+		EXPECT_FLOAT_EQ(std::get<2>(keys), std::get<2>(expected));
+		EXPECT_EQ(cursor, std::get<0>(keys));
+
+		EXPECT_GE(std::get<2>(keys), 0);
+		EXPECT_LT(std::get<2>(keys), 1);
+	}
+}
+
+TEST(SkinnedAnimationTest, CompressKeyFrameSet)
+{
+	uint32_t const NUM_KEYS = 64;
+	auto const kfs = MakeKeyFrameSets(6, NUM_KEYS);
+
+	for (auto const & kf : kfs)
+	{
+		KeyFrameSet compressed = kf;
+		compressed.Compress();
+		if (kf.frame_id.size() == 1)
+		{
+			EXPECT_FALSE(compressed.Compressed());
+			continue;
+		}
+		EXPECT_TRUE(compressed.Compressed());
+		EXPECT_LT(compressed.NumBytes(), kf.NumBytes() / 2);
+
+		for (uint32_t k = 0; k < kf.frame_id.size(); ++ k)
+		{
+			auto const key = compressed.Key(k);
+			EXPECT_EQ(MathLib::SignBit(std::get<0>(key).w()), MathLib::SignBit(kf.bind_real[k].w()));
+			for (uint32_t c = 0; c < 4; ++ c)
+			{
+				EXPECT_NEAR(std::get<0>(key)[c], kf.bind_real[k][c], 1e-4f);
+				EXPECT_NEAR(std::get<1>(key)[c], kf.bind_dual[k][c], 1e-4f);
+			}
+			EXPECT_NEAR(std::get<2>(key), kf.bind_scale[k], 1e-5f);
+		}
+
+		KeyFrameSet decompressed = compressed;
+		decompressed.Decompress();
+		EXPECT_FALSE(decompressed.Compressed());
+		EXPECT_EQ(decompressed.bind_real.size(), kf.frame_id.size());
+	}
+
+	// Tracks that don't change keep no packed keys
+	KeyFrameSet still;
+	for (uint32_t k = 0; k < NUM_KEYS; ++ k)
+	{
+		Quaternion const real = MathLib::rotation_axis(float3(0, 1, 0), 0.5f);
+		still.frame_id.push_back(k);
+		still.bind_real.push_back(real);
+		still.bind_dual.push_back(MathLib::quat_trans_to_udq(real, float3(1, 2, 3)));
+		still.bind_scale.push_back(1);
+	}
+	still.Compress();
+	EXPECT_TRUE(still.packed.rotations.empty());
+	EXPECT_TRUE(still.packed.translations.empty());
+	EXPECT_TRUE(still.packed.scales.empty());
+	EXPECT_EQ(still.NumBytes(), NUM_KEYS * sizeof(uint32_t) + sizeof(Quaternion) + sizeof(float3) * 2 + sizeof(float) * 2);
+
+	// Translations stay within the quantization bound, and a range too wide for 16 bits is kept in floats
+	for (float const range : { 10.0f, 1000.0f })
+	{
+		KeyFrameSet moving;
+		for (uint32_t k = 0; k < NUM_KEYS; ++ k)
+		{
+			Quaternion const real = MathLib::rotation_axis(float3(0, 1, 0), 0.5f);
+			float const t = static_cast<float>(k) / (NUM_KEYS - 1);
+			moving.frame_id.push_back(k);
+			moving.bind_real.push_back(real);
+			moving.bind_dual.push_back(MathLib::quat_trans_to_udq(real, float3(t, -t, MathLib::sin(t * 9.0f)) * range));
+			moving.bind_scale.push_back(1);
+		}
+
+		KeyFrameSet compressed = moving;
+		compressed.Compress();
+		EXPECT_EQ(compressed.packed.translations.empty(), range > 100);
+		EXPECT_EQ(compressed.packed.wide_translations.empty(), range < 100);
+
+		float const max_error = std::get<1>(KeyFrameSet::MaxQuantizationError(float3(range, range, range * 2), 0));
+		for (uint32_t k = 0; k < NUM_KEYS; ++ k)
+		{
+			auto const key = compressed.Key(k);
+			float3 const trans = MathLib::udq_to_trans(std::get<0>(key), std::get<1>(key));
+			float3 const expected = MathLib::udq_to_trans(moving.bind_real[k], moving.bind_dual[k]);
+			EXPECT_LE(MathLib::length(trans - expected), max_error + 1e-5f * range);
+		}
+	}
+}
+
+TEST(SkinnedAnimationTest, AnimationLayers)
+{
+	uint32_t const NUM_JOINTS = 3;
+	uint32_t const NUM_FRAMES_PER_ANIMATION = 8;
+
+	// A chain of joints. The first animation turns every joint around y, the second one around x.
+	auto root_node = MakeSharedPtr<SceneNode>(L"root", 0);
+	auto model = MakeSharedPtr<SkinnedModel>(root_node);
+
+	std::vector<JointComponentPtr> joints;
+	auto parent_node = root_node;
+	for (uint32_t j = 0; j < NUM_JOINTS; ++ j)
+	{
+		auto joint = MakeSharedPtr<JointComponent>();
+		joint->BindParams(Quaternion::Identity(), Quaternion(0, 0, 0, 0), 1);
+		joint->InverseOriginParams(Quaternion::Identity(), Quaternion(0, 0, 0, 0), 1);
+
+		auto node = MakeSharedPtr<SceneNode>(joint, L"joint" + std::to_wstring(j), 0);
+		parent_node->AddChild(node);
+		parent_node = node;
+		joints.push_back(joint);
+	}
+	model->AssignJoints(joints.begin(), joints.end());
+
+	auto kfs = MakeSharedPtr<std::vector<KeyFrameSet>>(NUM_JOINTS);
+	for (uint32_t j = 0; j < NUM_JOINTS; ++ j)
+	{
+		for (uint32_t f = 0; f < NUM_FRAMES_PER_ANIMATION * 2; ++ f)
+		{
+			float3 const axis = (f < NUM_FRAMES_PER_ANIMATION) ? float3(0, 1, 0) : float3(1, 0, 0);
+			Quaternion const real = MathLib::rotation_axis(axis, 0.1f * (f % NUM_FRAMES_PER_ANIMATION));
+			(*kfs)[j].frame_id.push_back(f);
+			(*kfs)[j].bind_real.push_back(real);
+			(*kfs)[j].bind_dual.push_back(MathLib::quat_trans_to_udq(real, float3(0, 1, 0)));
+			(*kfs)[j].bind_scale.push_back(1);
+		}
+	}
+	model->AttachKeyFrameSets(kfs);
+
+	auto animations = MakeSharedPtr<std::vector<Animation>>(2);
+	(*animations)[0] = { "turn_y", 0, NUM_FRAMES_PER_ANIMATION };
+	(*animations)[1] = { "turn_x", NUM_FRAMES_PER_ANIMATION, NUM_FRAMES_PER_ANIMATION * 2 };
+	model->AttachAnimations(animations);
+	model->NumFrames(NUM_FRAMES_PER_ANIMATION * 2);
+
+	auto expect_root = [&model, &kfs](float frame)
+		{
+			Quaternion const expected = std::get<0>((*kfs)[0].Frame(frame));
+			EXPECT_NEAR(MathLib::abs(MathLib::dot(model->GetJoint(0)->BindReal(), expected)), 1, 1e-5f);
+		};
+
+	model->AddAnimationLayer(0);
+	uint32_t const upper = model->AddAnimationLayer(1, 0);
+	EXPECT_EQ(model->NumAnimationLayers(), 2U);
+
+	model->GetAnimationLayer(0).frame = 3.5f;
+	model->GetAnimationLayer(upper).frame = 2;
+	model->UpdateAnimationLayers();
+	expect_root(3.5f);
+
+	model->GetAnimationLayer(upper).weight = 1;
+	model->UpdateAnimationLayers();
+	expect_root(NUM_FRAMES_PER_ANIMATION + 2.0f);
+
+	// Frames wrap within the animation
+	model->GetAnimationLayer(upper).frame = NUM_FRAMES_PER_ANIMATION + 2.0f;
+	model->UpdateAnimationLayers();
+	expect_root(NUM_FRAMES_PER_ANIMATION + 2.0f);
+
+	std::vector<float> const mask = model->JointSubtreeMask(1);
+	ASSERT_EQ(mask.size(), NUM_JOINTS);
+	EXPECT_EQ(mask[0], 0);
+	EXPECT_EQ(mask[1], 1);
+	EXPECT_EQ(mask[2], 1);
+
+	// With the mask, the root stays on the base layer
+	model->GetAnimationLayer(upper).joint_mask = mask;
+	model->UpdateAnimationLayers();
+	expect_root(3.5f);
+
+	model->ClearAnimationLayers();
+	EXPECT_EQ(model->NumAnimationLayers(), 0U);
+}
@@ -0,0 +1,126 @@
+/**
+ * @file TaskSchedulerTest.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+
+#include <KFL/TaskScheduler.hpp>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+TEST(TaskSchedulerTest, ParallelFor)
+{
+	TaskScheduler ts;
+
+	std::vector<uint32_t> data(100000, 0);
+	ts.ParallelFor(0, static_cast<uint32_t>(data.size()), 0, [&data](uint32_t sub_begin, uint32_t sub_end)
+		{
+			for (uint32_t i = sub_begin; i < sub_end; ++ i)
+			{
+				data[i] = i * 2;
+			}
+		});
+
+	for (uint32_t i = 0; i < data.size(); ++ i)
+	{
+		EXPECT_EQ(data[i], i * 2);
+	}
+}
+
+TEST(TaskSchedulerTest, Dependencies)
+{
+	TaskScheduler ts(3);
+
+	std::atomic<int> stage(0);
+	auto a = ts.Submit([&stage] { stage = 1; });
+	TaskPtr const deps_b[] = { a };
+	auto b = ts.Submit([&stage] { EXPECT_EQ(stage, 1); stage = 2; }, deps_b);
+	TaskPtr const deps_c[] = { a, b };
+	auto c = ts.Submit([&stage] { EXPECT_EQ(stage, 2); stage = 3; }, deps_c);
+
+	ts.Wait(c);
+	EXPECT_EQ(stage, 3);
+	EXPECT_TRUE(a->Finished());
+	EXPECT_TRUE(b->Finished());
+}
+
+TEST(TaskSchedulerTest, NestedWait)
+{
+	TaskScheduler ts(2);
+
+	std::atomic<uint32_t> count(0);
+	std::vector<TaskPtr> tasks;
+	for (uint32_t i = 0; i < 64; ++ i)
+	{
+		tasks.push_back(ts.Submit([&ts, &count]
+			{
+				// Waiting inside a task helps with the queued work instead of blocking the worker
+				ts.ParallelFor(0, 100, 3, [&count](uint32_t sub_begin, uint32_t sub_end)
+					{
+						count += sub_end - sub_begin;
+					});
+			}));
+	}
+	ts.Wait(tasks);
+
+	EXPECT_EQ(count, 64U * 100U);
+}
+
+TEST(TaskSchedulerTest, Exceptions)
+{
+	TaskScheduler ts(2);
+
+	std::atomic<bool> dependent_ran(false);
+	auto a = ts.Submit([] { throw std::runtime_error("task"); });
+	TaskPtr const deps_b[] = { a };
+	auto b = ts.Submit([&dependent_ran] { dependent_ran = true; }, deps_b);
+
+	EXPECT_THROW(ts.Wait(a), std::runtime_error);
+	EXPECT_TRUE(a->Finished());
+	ts.Wait(b);
+	EXPECT_TRUE(dependent_ran);
+
+	std::atomic<uint32_t> count(0);
+	EXPECT_THROW(ts.ParallelFor(0, 100, 10, [&count](uint32_t sub_begin, uint32_t sub_end)
+		{
+			count += sub_end - sub_begin;
+			if (sub_begin == 50)
+			{
+				throw std::runtime_error("chunk");
+			}
+		}), std::runtime_error);
+	EXPECT_EQ(count, 100U);
+}
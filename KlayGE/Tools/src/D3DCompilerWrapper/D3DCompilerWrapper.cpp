@@ -83,6 +83,7 @@ public:
 	D3DCompiler()
 		: mod_d3dcompiler_(NULL),
 			DynamicD3DCompile_(NULL),
+			DynamicD3DPreprocess_(NULL),
 			DynamicD3DReflect_(NULL),
 			DynamicD3DStripShader_(NULL)
 	{
@@ -94,6 +95,7 @@ public:
 #pragma GCC diagnostic ignored "-Wcast-function-type"
 #endif
 			DynamicD3DCompile_ = reinterpret_cast<D3DCompileFunc>(GetProcAddress(mod_d3dcompiler_, "D3DCompile"));
+			DynamicD3DPreprocess_ = reinterpret_cast<D3DPreprocessFunc>(GetProcAddress(mod_d3dcompiler_, "D3DPreprocess"));
 			DynamicD3DReflect_ = reinterpret_cast<D3DReflectFunc>(GetProcAddress(mod_d3dcompiler_, "D3DReflect"));
 			DynamicD3DStripShader_ = reinterpret_cast<D3DStripShaderFunc>(GetProcAddress(mod_d3dcompiler_, "D3DStripShader"));
 #if defined(KLAYGE_COMPILER_GCC) && (__GNUC__ >= 8)
@@ -122,6 +124,12 @@ public:
 			pTarget, Flags1, Flags2, ppCode, ppErrorMsgs);
 	}
 
+	HRESULT D3DPreprocess(LPCVOID pSrcData, SIZE_T SrcDataSize, LPCSTR pSourceName,
+		D3D_SHADER_MACRO const * pDefines, ID3DInclude* pInclude, ID3DBlob** ppCodeText, ID3DBlob** ppErrorMsgs) const
+	{
+		return DynamicD3DPreprocess_(pSrcData, SrcDataSize, pSourceName, pDefines, pInclude, ppCodeText, ppErrorMsgs);
+	}
+
 	HRESULT D3DReflect(LPCVOID pSrcData, SIZE_T SrcDataSize, REFIID pInterface, void** ppReflector) const
 	{
 		return DynamicD3DReflect_(pSrcData, SrcDataSize, pInterface, ppReflector);
@@ -136,6 +144,8 @@ private:
 	typedef HRESULT(WINAPI *D3DCompileFunc)(LPCVOID pSrcData, SIZE_T SrcDataSize, LPCSTR pSourceName,
 		D3D_SHADER_MACRO const * pDefines, ID3DInclude* pInclude, LPCSTR pEntrypoint,
 		LPCSTR pTarget, UINT Flags1, UINT Flags2, ID3DBlob** ppCode, ID3DBlob** ppErrorMsgs);
+	typedef HRESULT(WINAPI *D3DPreprocessFunc)(LPCVOID pSrcData, SIZE_T SrcDataSize, LPCSTR pSourceName,
+		D3D_SHADER_MACRO const * pDefines, ID3DInclude* pInclude, ID3DBlob** ppCodeText, ID3DBlob** ppErrorMsgs);
 	typedef HRESULT(WINAPI *D3DReflectFunc)(LPCVOID pSrcData, SIZE_T SrcDataSize, REFIID pInterface, void** ppReflector);
 	typedef HRESULT(WINAPI *D3DStripShaderFunc)(LPCVOID pShaderBytecode, SIZE_T BytecodeLength, UINT uStripFlags, ID3DBlob** ppStrippedBlob);
 
@@ -143,6 +153,7 @@ private:
 	HMODULE mod_d3dcompiler_;
 
 	D3DCompileFunc DynamicD3DCompile_;
+	D3DPreprocessFunc DynamicD3DPreprocess_;
 	D3DReflectFunc DynamicD3DReflect_;
 	D3DStripShaderFunc DynamicD3DStripShader_;
 };
@@ -157,6 +168,7 @@ void PrintHelps()
 #endif
 	printf("Usage:\n");
 	printf("\t%s compile input_file entry_point target flags1 flags2 output_file\n", cmd);
+	printf("\t%s preprocess input_file output_file\n", cmd);
 	printf("\t%s reflect input_file output_file\n", cmd);
 	printf("\t%s strip input_file flags output_file\n", cmd);
 }
@@ -168,6 +180,87 @@ void WriteString(char const * str, FILE* fp)
 	fwrite(str, 1, len, fp);
 }
 
+// The input of compile and preprocess is the source size, the source, the number of macros, then each macro name and
+//  definition on a line
+char* ReadSourceAndMacros(char const * input_file, int& hlsl_size, D3D_SHADER_MACRO*& macros, int& num_macros)
+{
+	FILE* fp = fopen(input_file, "rb");
+	fread(&hlsl_size, sizeof(hlsl_size), 1, fp);
+	char* hlsl = new char[hlsl_size + 1];
+	fread(hlsl, sizeof(char), hlsl_size, fp);
+	hlsl[hlsl_size] = 0;
+
+	fread(&num_macros, sizeof(num_macros), 1, fp);
+	macros = new D3D_SHADER_MACRO[num_macros + 1];
+	char line_name[1024];
+	char line_definition[1024];
+	int idx = 0;
+	while (fgets(line_name, 1024, fp) && fgets(line_definition, 1024, fp))
+	{
+		char* t1 = new char[strlen(line_name) + 1];
+		strcpy(t1, line_name);
+		if ('\n' == t1[strlen(t1) - 1])
+		{
+			t1[strlen(t1) - 1] = '\0';
+		}
+		char* t2 = new char[strlen(line_definition) + 1];
+		strcpy(t2, line_definition);
+		if ('\n' == t2[strlen(t2) - 1])
+		{
+			t2[strlen(t2) - 1] = '\0';
+		}
+		macros[idx].Name = t1;
+		macros[idx].Definition = t2;
+		++ idx;
+	}
+	macros[idx].Name = NULL;
+	macros[idx].Definition = NULL;
+	fclose(fp);
+
+	return hlsl;
+}
+
+void FreeSourceAndMacros(char* hlsl, D3D_SHADER_MACRO* macros, int num_macros)
+{
+	for (int i = 0; i < num_macros; ++ i)
+	{
+		delete[] macros[i].Name;
+		delete[] macros[i].Definition;
+	}
+	delete[] macros;
+	delete[] hlsl;
+}
+
+// The output of compile and preprocess is the result, the size and content of the output, then of the messages
+void WriteBlobs(char const * output_file, int hr, ID3DBlob* output, ID3DBlob* err_msg)
+{
+	FILE* fp = fopen(output_file, "wb");
+	fwrite(&hr, sizeof(hr), 1, fp);
+	if (output != NULL)
+	{
+		int const size = static_cast<int>(output->GetBufferSize());
+		fwrite(&size, sizeof(size), 1, fp);
+		fwrite(output->GetBufferPointer(), sizeof(char), size, fp);
+	}
+	else
+	{
+		int const size = 0;
+		fwrite(&size, sizeof(size), 1, fp);
+	}
+	if (err_msg != NULL)
+	{
+		int const size = static_cast<int>(err_msg->GetBufferSize());
+		fwrite(&size, sizeof(size), 1, fp);
+		fwrite(err_msg->GetBufferPointer(), sizeof(char), err_msg->GetBufferSize(), fp);
+	}
+	else
+	{
+		int const size = 0;
+		fwrite(&size, sizeof(size), 1, fp);
+	}
+	fclose(fp);
+}
+
 // http://wine-wiki.org/index.php/WineLib#Calling_a_Native_Windows_dll_from_Linux
 int main(int argc, char* argv[])
 {
@@ -194,40 +287,10 @@ int main(int argc, char* argv[])
 		int flags2 = atoi(argv[6]);
 		char const * output_file = argv[7];
 
-		FILE* fp = fopen(input_file, "rb");
 		int hlsl_size;
-		fread(&hlsl_size, sizeof(hlsl_size), 1, fp);
-		char* hlsl = new char[hlsl_size + 1];
-		fread(hlsl, sizeof(char), hlsl_size, fp);
-		hlsl[hlsl_size] = 0;
-
+		D3D_SHADER_MACRO* macros;
 		int num_macros;
-		fread(&num_macros, sizeof(num_macros), 1, fp);
-		D3D_SHADER_MACRO* macros = new D3D_SHADER_MACRO[num_macros + 1];
-		char line_name[1024];
-		char line_definition[1024];
-		int idx = 0;
-		while (fgets(line_name, 1024, fp) && fgets(line_definition, 1024, fp))
-		{
-			char* t1 = new char[strlen(line_name) + 1];
-			strcpy(t1, line_name);
-			if ('\n' == t1[strlen(t1) - 1])
-			{
-				t1[strlen(t1) - 1] = '\0';
-			}
-			char* t2 = new char[strlen(line_definition) + 1];
-			strcpy(t2, line_definition);
-			if ('\n' == t2[strlen(t2) - 1])
-			{
-				t2[strlen(t2) - 1] = '\0';
-			}
-			macros[idx].Name = t1;
-			macros[idx].Definition = t2;
-			++ idx;
-		}
-		macros[idx].Name = NULL;
-		macros[idx].Definition = NULL;
-		fclose(fp);
+		char* hlsl = ReadSourceAndMacros(input_file, hlsl_size, macros, num_macros);
 
 		ID3DBlob* code = NULL;
 		ID3DBlob* err_msg = NULL;
@@ -237,39 +300,36 @@ int main(int argc, char* argv[])
 		{
 			printf("Compiling error: 0x%x\n", hr);
 		}
-		fp = fopen(output_file, "wb");
-		fwrite(&hr, sizeof(hr), 1, fp);
-		if (code != NULL)
-		{
-			int const size = static_cast<int>(code->GetBufferSize());
-			fwrite(&size, sizeof(size), 1, fp);
-			fwrite(code->GetBufferPointer(), sizeof(char), size, fp);
-		}
-		else
-		{
-			int const size = 0;
-			fwrite(&size, sizeof(size), 1, fp);
-		}
-		if (err_msg != NULL)
-		{
-			int const size = static_cast<int>(err_msg->GetBufferSize());
-			fwrite(&size, sizeof(size), 1, fp);
-			fwrite(err_msg->GetBufferPointer(), sizeof(char), err_msg->GetBufferSize(), fp);
-		}
-		else
+		WriteBlobs(output_file, hr, code, err_msg);
+
+		FreeSourceAndMacros(hlsl, macros, num_macros);
+	}
+	else if (0 == strcmp(argv[1], "preprocess"))
+	{
+		if (argc < 4)
 		{
-			int const size = 0;
-			fwrite(&size, sizeof(size), 1, fp);
+			PrintHelps();
+			return -1;
 		}
-		fclose(fp);
 
-		for (int i = 0; i < num_macros; ++ i)
+		char const * input_file = argv[2];
+		char const * output_file = argv[3];
+
+		int hlsl_size;
+		D3D_SHADER_MACRO* macros;
+		int num_macros;
+		char* hlsl = ReadSourceAndMacros(input_file, hlsl_size, macros, num_macros);
+
+		ID3DBlob* text = NULL;
+		ID3DBlob* err_msg = NULL;
+		int hr = d3d_compiler.D3DPreprocess(hlsl, hlsl_size, NULL, macros, NULL, &text, &err_msg);
+		if (FAILED(hr))
 		{
-			delete[] macros[i].Name;
-			delete[] macros[i].Definition;
+			printf("Preprocessing error: 0x%x\n", hr);
 		}
-		delete[] macros;
-		delete[] hlsl;
+		WriteBlobs(output_file, hr, text, err_msg);
+
+		FreeSourceAndMacros(hlsl, macros, num_macros);
 	}
 	else if (0 == strcmp(argv[1], "reflect"))
 	{
@@ -38,6 +38,7 @@
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/RenderEngine.hpp>
 #include <KlayGE/RenderEffect.hpp>
+#include <KlayGE/ShaderCache.hpp>
 
 #include <iostream>
 
@@ -49,50 +50,10 @@ using namespace KlayGE;
 
 uint32_t const KFX_VERSION = 0x0150;
 
-int main(int argc, char* argv[])
+void CompileFxml(std::string const & fxml_name, filesystem::path const & target_folder, bool force)
 {
-	if (argc < 2)
-	{
-		cout << "Usage: FXMLJIT d3d_12_1|d3d_12_0|d3d_11_1|d3d_11_0|gl_4_6|gl_4_5|gl_4_4|gl_4_3|gl_4_2|gl_4_1|gles_3_2|gles_3_1|gles_3_0 xxx.fxml [target folder]" << endl;
-		return 1;
-	}
-
-	std::string platform = argv[1];
-
-	StringUtil::ToLower(platform);
-
-	filesystem::path target_folder;
-	if (argc >= 4)
-	{
-		target_folder = argv[3];
-	}
-
-	Context::Instance().LoadCfg("KlayGE.cfg");
-	ContextCfg context_cfg = Context::Instance().Config();
-	context_cfg.render_factory_name = "NullRender";
-	context_cfg.graphics_cfg.hide_win = true;
-	context_cfg.graphics_cfg.hdr = false;
-	context_cfg.graphics_cfg.ppaa = false;
-	context_cfg.graphics_cfg.gamma = false;
-	context_cfg.graphics_cfg.color_grading = false;
-	Context::Instance().Config(context_cfg);
-
-	PlatformDefinition platform_def(platform + ".plat");
-
 	RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
-	int major_version = platform_def.major_version;
-	int minor_version = platform_def.minor_version;
-	bool frag_depth_support = platform_def.frag_depth_support;
-	re.SetCustomAttrib("PLATFORM", &platform_def.platform);
-	re.SetCustomAttrib("MAJOR_VERSION", &major_version);
-	re.SetCustomAttrib("MINOR_VERSION", &minor_version);
-	re.SetCustomAttrib("NATIVE_SHADER_FOURCC", &platform_def.native_shader_fourcc);
-	re.SetCustomAttrib("NATIVE_SHADER_VERSION", &platform_def.native_shader_version);
-	re.SetCustomAttrib("REQUIRES_FLIPPING", &platform_def.requires_flipping);
-	re.SetCustomAttrib("DEVICE_CAPS", &platform_def.device_caps);
-	re.SetCustomAttrib("FRAG_DEPTH_SUPPORT", &frag_depth_support);
 
-	std::string fxml_name(argv[2]);
 	filesystem::path fxml_path(fxml_name);
 	std::string const base_name = fxml_path.stem().string();
 	filesystem::path fxml_directory = fxml_path.parent_path();
@@ -101,7 +62,7 @@ int main(int argc, char* argv[])
 	filesystem::path kfx_name(base_name + ".kfx");
 	filesystem::path kfx_path = fxml_directory / kfx_name;
 	bool skip_jit = false;
-	if (filesystem::exists(fxml_path) && filesystem::exists(kfx_path))
+	if (!force && filesystem::exists(fxml_path) && filesystem::exists(kfx_path))
 	{
 		ResIdentifierPtr source = ResLoader::Instance().Open(fxml_name);
 		ResIdentifierPtr kfx_source = ResLoader::Instance().Open(kfx_path.string());
@@ -179,6 +140,75 @@ int main(int argc, char* argv[])
 	{
 		cout << "Couldn't find " << fxml_name << "." << endl;
 	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		cout << "Usage: FXMLJIT d3d_12_1|d3d_12_0|d3d_11_1|d3d_11_0|gl_4_6|gl_4_5|gl_4_4|gl_4_3|gl_4_2|gl_4_1|gles_3_2|gles_3_1|gles_3_0 xxx.fxml|fxml folder [target folder]" << endl;
+		cout << "Passing a folder compiles every fxml under it, to prewarm the shader cache." << endl;
+		return 1;
+	}
+
+	std::string platform = argv[1];
+
+	StringUtil::ToLower(platform);
+
+	filesystem::path target_folder;
+	if (argc >= 4)
+	{
+		target_folder = argv[3];
+	}
+
+	Context::Instance().LoadCfg("KlayGE.cfg");
+	ContextCfg context_cfg = Context::Instance().Config();
+	context_cfg.render_factory_name = "NullRender";
+	context_cfg.graphics_cfg.hide_win = true;
+	context_cfg.graphics_cfg.hdr = false;
+	context_cfg.graphics_cfg.ppaa = false;
+	context_cfg.graphics_cfg.gamma = false;
+	context_cfg.graphics_cfg.color_grading = false;
+	Context::Instance().Config(context_cfg);
+
+	PlatformDefinition platform_def(platform + ".plat");
+
+	RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+	int major_version = platform_def.major_version;
+	int minor_version = platform_def.minor_version;
+	bool frag_depth_support = platform_def.frag_depth_support;
+	re.SetCustomAttrib("PLATFORM", &platform_def.platform);
+	re.SetCustomAttrib("MAJOR_VERSION", &major_version);
+	re.SetCustomAttrib("MINOR_VERSION", &minor_version);
+	re.SetCustomAttrib("NATIVE_SHADER_FOURCC", &platform_def.native_shader_fourcc);
+	re.SetCustomAttrib("NATIVE_SHADER_VERSION", &platform_def.native_shader_version);
+	re.SetCustomAttrib("REQUIRES_FLIPPING", &platform_def.requires_flipping);
+	re.SetCustomAttrib("DEVICE_CAPS", &platform_def.device_caps);
+	re.SetCustomAttrib("FRAG_DEPTH_SUPPORT", &frag_depth_support);
+
+	filesystem::path const input_path(argv[2]);
+	if (filesystem::is_directory(input_path))
+	{
+		// Prewarm mode. Compiles every effect under the folder, which fills the shared shader cache for everything
+		//  that runs on this machine afterwards.
+		uint32_t num_effects = 0;
+		for (auto const & entry : filesystem::recursive_directory_iterator(input_path))
+		{
+			if (entry.is_regular_file() && (entry.path().extension() == ".fxml"))
+			{
+				CompileFxml(entry.path().string(), target_folder, true);
+				++ num_effects;
+			}
+		}
+
+		ShaderCache const & shader_cache = ShaderCache::Instance();
+		cout << num_effects << " effects compiled, " << shader_cache.NumHits() << " shaders were found in the cache, "
+			<< shader_cache.NumMisses() << " were compiled into " << shader_cache.Folder() << "." << endl;
+	}
+	else
+	{
+		CompileFxml(argv[2], target_folder, false);
+	}
 
 	Context::Destroy();
 
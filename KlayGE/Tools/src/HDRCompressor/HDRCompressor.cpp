@@ -427,6 +427,70 @@ namespace
 		cout << "MSE: " << mse << endl;
 		cout << "PSNR: " << psnr << endl;
 	}
+
+	void CompressHDRToBC6H(std::string const & in_file, std::string const & out_file)
+	{
+		TexturePtr in_tex = LoadSoftwareTexture(in_file);
+		auto const in_type = in_tex->Type();
+		auto const in_width = in_tex->Width(0);
+		auto const in_height = in_tex->Height(0);
+		auto const in_depth = in_tex->Depth(0);
+		auto const in_num_mipmaps = in_tex->NumMipMaps();
+		auto const in_array_size = in_tex->ArraySize();
+
+		if ((in_tex->Format() != EF_ABGR16F) && (in_tex->Format() != EF_ABGR32F))
+		{
+			cout << "Unsupported texture format" << endl;
+			return;
+		}
+
+		// The conversion to BC6H encodes every subresource
+		TexturePtr out_tex = MakeSharedPtr<SoftwareTexture>(in_type, in_width, in_height, in_depth,
+			in_num_mipmaps, in_array_size, EF_BC6, false);
+		out_tex->CreateHWResource({}, nullptr);
+		in_tex->CopyToTexture(*out_tex, TextureFilter::Point);
+		SaveTexture(out_tex, out_file);
+
+		TexturePtr org_tex = MakeSharedPtr<SoftwareTexture>(in_type, in_width, in_height, in_depth,
+			in_num_mipmaps, in_array_size, EF_ABGR32F, false);
+		org_tex->CreateHWResource({}, nullptr);
+		in_tex->CopyToTexture(*org_tex, TextureFilter::Point);
+
+		TexturePtr restored_tex = MakeSharedPtr<SoftwareTexture>(in_type, in_width, in_height, in_depth,
+			in_num_mipmaps, in_array_size, EF_ABGR32F, false);
+		restored_tex->CreateHWResource({}, nullptr);
+		out_tex->CopyToTexture(*restored_tex, TextureFilter::Point);
+
+		auto const & org_data = checked_cast<SoftwareTexture&>(*org_tex).SubresourceData();
+		auto const & restored_data = checked_cast<SoftwareTexture&>(*restored_tex).SubresourceData();
+
+		float mse = 0;
+		int n = 0;
+		for (size_t i = 0; i < org_data.size(); ++ i)
+		{
+			uint32_t const mip = static_cast<uint32_t>(i % in_num_mipmaps);
+			uint32_t const num_texels = in_tex->Width(mip) * in_tex->Height(mip) * in_tex->Depth(mip);
+
+			float const * org = static_cast<float const *>(org_data[i].data);
+			float const * restored = static_cast<float const *>(restored_data[i].data);
+			for (uint32_t j = 0; j < num_texels; ++ j)
+			{
+				float diff_r = org[j * 4 + 0] - restored[j * 4 + 0];
+				float diff_g = org[j * 4 + 1] - restored[j * 4 + 1];
+				float diff_b = org[j * 4 + 2] - restored[j * 4 + 2];
+
+				mse += diff_r * diff_r + diff_g * diff_g + diff_b * diff_b;
+			}
+
+			n += num_texels;
+		}
+
+		mse /= n;
+		float psnr = 10 * log10(65504.0f * 65504.0f / std::max(mse, 1e-6f));
+
+		cout << "MSE: " << mse << endl;
+		cout << "PSNR: " << psnr << endl;
+	}
 }
 
 int main(int argc, char* argv[])
@@ -436,13 +500,29 @@ int main(int argc, char* argv[])
 	if (argc < 2)
 	{
 		cout << "Usage: HDRCompressor xxx.dds [R16 | R16F] [BC5 | BC3]" << endl;
+		cout << "       HDRCompressor xxx.dds BC6H" << endl;
 		return 1;
 	}
 
+	filesystem::path output_path(argv[1]);
+
+	if ((argc >= 3) && (std::string(argv[2]) == "BC6H"))
+	{
+		std::string bc6h_file = output_path.stem().string() + "_bc6h" + output_path.extension().string();
+
+		CompressHDRToBC6H(argv[1], bc6h_file);
+
+		cout << "HDR texture is compressed into " << bc6h_file << endl;
+
+		Context::Destroy();
+
+		return 0;
+	}
+
 	ElementFormat y_format = EF_R16;
 	if (argc >= 3)
 	{
-		std::string format_str(argv[3]);
+		std::string format_str(argv[2]);
 		if ("R16F" == format_str)
 		{
 			y_format = EF_R16F;
@@ -459,7 +539,6 @@ int main(int argc, char* argv[])
 		}
 	}
 
-	filesystem::path output_path(argv[1]);
 	std::string y_file = output_path.stem().string() + "_y" + output_path.extension().string();
 	std::string c_file = output_path.stem().string() + "_c" + output_path.extension().string();
 
@@ -160,7 +160,7 @@ int main(int argc, char* argv[])
 	filesystem::path const output_path(output_name);
 	if (output_path.extension() == ".model_bin")
 	{
-		uint32_t const MODEL_BIN_VERSION = 19;
+		uint32_t const MODEL_BIN_VERSION = 20;
 
 		ResIdentifierPtr output_file = ResLoader::Instance().Open(output_name);
 		if (output_file)
@@ -229,6 +229,25 @@ int main(int argc, char* argv[])
 					cout << "LOD " << lod << ": " << num_vertices << " vertices, " << num_triangles << " triangles." << endl;
 				}
 
+				auto const & key_frame_reports = mesh_converter.KeyFrameReports();
+				if (!key_frame_reports.empty())
+				{
+					size_t source_bytes = 0;
+					size_t compressed_bytes = 0;
+					for (auto const & report : key_frame_reports)
+					{
+						cout << "Joint " << report.joint_name << ": " << report.num_source_keys << " -> " << report.num_keys
+							<< " keys, " << report.source_bytes << " -> " << report.compressed_bytes << " bytes, max error "
+							<< MathLib::rad2deg(report.max_rotation_error) << " degrees, " << report.max_translation_error
+							<< " in translation, " << report.max_scale_error << " in scale." << endl;
+
+						source_bytes += report.source_bytes;
+						compressed_bytes += report.compressed_bytes;
+					}
+
+					cout << "Key frames: " << source_bytes << " -> " << compressed_bytes << " bytes." << endl;
+				}
+
 				cout << "Mesh has been saved to " << output_name << "." << endl;
 			}
 		}
@@ -0,0 +1,196 @@
+/**
+ * @file PackageBuilder.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/CXX17/filesystem.hpp>
+#include <KFL/StringUtil.hpp>
+#include <KlayGE/Package.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+#ifndef KLAYGE_DEBUG
+#define CXXOPTS_NO_RTTI
+#endif
+#include <cxxopts.hpp>
+
+#include <KlayGE/ToolCommon.hpp>
+
+using namespace std;
+using namespace KlayGE;
+
+int main(int argc, char* argv[])
+{
+	std::string input_folder;
+	std::string output_name;
+	std::vector<std::regex> stored_filters;
+	PackageWriter::Codec codec = PackageWriter::Codec::Auto;
+	bool quiet = false;
+
+	cxxopts::Options options("PackageBuilder", "KlayGE Package Builder");
+	options.add_options()
+		("H,help", "Produce help message.")
+		("I,input-folder", "Folder to pack.", cxxopts::value<std::string>())
+		("O,output-path", "Output package path.", cxxopts::value<std::string>())
+		("S,stored", "(Optional) Files to keep uncompressed, so they can be memory mapped. Wildcards, separated by , or ;.",
+			cxxopts::value<std::string>())
+		("L,lzma", "(Optional) Compress all other files, even if it doesn't save much.",
+			cxxopts::value<bool>()->implicit_value("true"))
+		("q,quiet", "Quiet mode.", cxxopts::value<bool>()->implicit_value("true"))
+		("v,version", "Version.");
+
+	int const argc_backup = argc;
+	auto vm = options.parse(argc, argv);
+
+	if ((argc_backup <= 1) || (vm.count("help") > 0))
+	{
+		cout << options.help() << endl;
+		return 1;
+	}
+	if (vm.count("version") > 0)
+	{
+		cout << "KlayGE Package Builder, Version 1.0.0" << endl;
+		return 1;
+	}
+	if (vm.count("input-folder") > 0)
+	{
+		input_folder = vm["input-folder"].as<std::string>();
+	}
+	else
+	{
+		cout << "Need input folder." << endl;
+		cout << options.help() << endl;
+		return 1;
+	}
+	if (vm.count("output-path") > 0)
+	{
+		output_name = vm["output-path"].as<std::string>();
+	}
+	else
+	{
+		output_name = filesystem::path(input_folder).filename().string() + ".kpk";
+	}
+	if (vm.count("stored") > 0)
+	{
+		std::string const stored_str = vm["stored"].as<std::string>();
+
+		std::vector<std::string_view> tokens = StringUtil::Split(stored_str, StringUtil::IsAnyOf(",;"));
+		for (auto& arg : tokens)
+		{
+			arg = StringUtil::Trim(arg);
+			if (!arg.empty())
+			{
+				stored_filters.emplace_back(DosWildcardToRegex(arg), std::regex_constants::icase);
+			}
+		}
+	}
+	if ((vm.count("lzma") > 0) && vm["lzma"].as<bool>())
+	{
+		codec = PackageWriter::Codec::LZMA;
+	}
+	if (vm.count("quiet") > 0)
+	{
+		quiet = vm["quiet"].as<bool>();
+	}
+
+	filesystem::path const input_path(input_folder);
+	if (!filesystem::is_directory(input_path))
+	{
+		cout << "Could NOT find folder " << input_folder << '.' << endl;
+		return 1;
+	}
+
+	std::ofstream ofs(output_name.c_str(), std::ios_base::binary);
+	if (!ofs)
+	{
+		cout << "Could NOT create " << output_name << '.' << endl;
+		return 1;
+	}
+
+	uint32_t num_files = 0;
+	{
+		PackageWriter writer(ofs);
+
+		std::vector<uint8_t> data;
+		filesystem::recursive_directory_iterator end_itr;
+		for (filesystem::recursive_directory_iterator i(input_path); i != end_itr; ++ i)
+		{
+			if (!filesystem::is_regular_file(i->status()))
+			{
+				continue;
+			}
+
+			filesystem::path const & file_path = i->path();
+			std::string const path_in_package = filesystem::relative(file_path, input_path).generic_string();
+
+			PackageWriter::Codec file_codec = codec;
+			std::string const file_name = file_path.filename().string();
+			for (auto const & filter : stored_filters)
+			{
+				if (std::regex_match(file_name, filter))
+				{
+					file_codec = PackageWriter::Codec::Stored;
+					break;
+				}
+			}
+
+			{
+				std::ifstream ifs(file_path.string().c_str(), std::ios_base::binary);
+				ifs.seekg(0, std::ios_base::end);
+				data.resize(static_cast<size_t>(ifs.tellg()));
+				ifs.seekg(0, std::ios_base::beg);
+				ifs.read(reinterpret_cast<char*>(data.data()), data.size());
+			}
+
+			uint64_t const timestamp = filesystem::last_write_time(file_path).time_since_epoch().count();
+			writer.AddFile(path_in_package, data, timestamp, file_codec);
+			++ num_files;
+
+			if (!quiet)
+			{
+				cout << path_in_package << endl;
+			}
+		}
+
+		writer.Finish();
+	}
+
+	if (!quiet)
+	{
+		cout << num_files << " files are packed into " << output_name << '.' << endl;
+	}
+
+	Context::Destroy();
+
+	return 0;
+}
@@ -73,6 +73,18 @@ namespace
 
 		SaveTexture(out_tex, out_file);
 	}
+
+	void CompressToBC6H(std::string const & file)
+	{
+		TexturePtr in_tex = LoadSoftwareTexture(file);
+
+		TexturePtr out_tex = MakeSharedPtr<SoftwareTexture>(in_tex->Type(), in_tex->Width(0), in_tex->Height(0), in_tex->Depth(0),
+			in_tex->NumMipMaps(), in_tex->ArraySize(), EF_BC6, false);
+		out_tex->CreateHWResource({}, nullptr);
+		in_tex->CopyToTexture(*out_tex, TextureFilter::Point);
+
+		SaveTexture(out_tex, file);
+	}
 }
 
 class PrefilterCubeApp : public KlayGE::App3DFramework
@@ -111,7 +123,7 @@ int main(int argc, char* argv[])
 
 	if (argc < 2)
 	{
-		cout << "Usage: PrefilterCube xxx.dds [xxx_filtered.dds]" << endl;
+		cout << "Usage: PrefilterCube xxx.dds [xxx_filtered.dds] [BC6H]" << endl;
 		return 1;
 	}
 
@@ -127,9 +139,19 @@ int main(int argc, char* argv[])
 		output = output_path.stem().string() + "_filtered.dds";
 	}
 
+	bool bc6h = false;
+	if (argc >= 4)
+	{
+		bc6h = (std::string(argv[3]) == "BC6H");
+	}
+
 	Timer timer;
 
 	PrefilterCubeGPU(input, output);
+	if (bc6h)
+	{
+		CompressToBC6H(output);
+	}
 
 	cout << timer.elapsed() << " s" << endl;
 	cout << "Filtered cube map is saved into " << output << endl;